@@ -0,0 +1,342 @@
+#include "AccelerationStructure.h"
+#include "Profiling.h"
+#include <iomanip>
+#include <random>
+
+// Moeller-Trumbore, t within [ray.tMin, ray.tMax]
+static bool intersectTriangle(const BvhTriangle& triangle, const Ray& ray, float& t, float& u, float& v)
+{
+    glm::vec3 p = glm::cross(ray.direction, triangle.edge2);
+    float determinant = glm::dot(triangle.edge1, p);
+    if (std::abs(determinant) < 1e-12f)
+    {
+        return false;
+    }
+
+    float invDeterminant = 1.0f / determinant;
+    glm::vec3 s = ray.origin - triangle.v0;
+    u = glm::dot(s, p) * invDeterminant;
+    if (u < 0.0f || u > 1.0f)
+    {
+        return false;
+    }
+
+    glm::vec3 q = glm::cross(s, triangle.edge1);
+    v = glm::dot(ray.direction, q) * invDeterminant;
+    if (v < 0.0f || u + v > 1.0f)
+    {
+        return false;
+    }
+
+    t = glm::dot(triangle.edge2, q) * invDeterminant;
+    return ray.tMin <= t && t <= ray.tMax;
+}
+
+// shrinks ray.tMax on a hit
+static bool intersectTriangle(const BvhTriangle& triangle, Ray& ray, RayHit& hit)
+{
+    float t, u, v;
+    if (!intersectTriangle(triangle, ray, t, u, v))
+    {
+        return false;
+    }
+
+    ray.tMax = t;
+    hit.t = t;
+    hit.primitiveId = triangle.primitiveId;
+    hit.u = u;
+    hit.v = v;
+    return true;
+}
+
+Aabb transformAabb(const Aabb& bounds, const glm::mat4x4& transform)
+{
+    // Arvo's method: every matrix entry contributes its smaller product to min and the larger one to max
+    Aabb result;
+    result.min = result.max = glm::vec3(transform[3]);
+    for (int column = 0; column < 3; column++)
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            float a = transform[column][row] * bounds.min[column];
+            float b = transform[column][row] * bounds.max[column];
+            result.min[row] += std::min(a, b);
+            result.max[row] += std::max(a, b);
+        }
+    }
+    return result;
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+BottomLevelAs::BottomLevelAs(const std::vector<glm::vec3>& positions, const std::vector<uint32>& indices, const BvhBuildSettings& settings)
+{
+    assert(!indices.empty() && indices.size() % 3 == 0);
+
+    const size_t triangleCount = indices.size() / 3;
+    std::vector<Aabb> triangleBounds(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++)
+    {
+        for (size_t k = 0; k < 3; k++)
+        {
+            triangleBounds[i].grow(positions[indices[i * 3 + k]]);
+        }
+    }
+
+    m_bvh.build(triangleBounds, settings, [&](uint32 primitiveIndex, uint32 axis, float position, Aabb& left, Aabb& right)
+    {
+        // walk the edges, vertices go to their side and edges crossing the plane add the crossing point to both
+        for (uint32 k = 0; k < 3; k++)
+        {
+            const glm::vec3& a = positions[indices[primitiveIndex * 3 + k]];
+            const glm::vec3& b = positions[indices[primitiveIndex * 3 + (k + 1) % 3]];
+            if (a[axis] <= position)
+            {
+                left.grow(a);
+            }
+            if (a[axis] >= position)
+            {
+                right.grow(a);
+            }
+            if ((a[axis] < position && position < b[axis]) || (b[axis] < position && position < a[axis]))
+            {
+                glm::vec3 p = glm::mix(a, b, (position - a[axis]) / (b[axis] - a[axis]));
+                p[axis] = position;
+                left.grow(p);
+                right.grow(p);
+            }
+        }
+    });
+
+    storeTriangles(positions, indices);
+}
+
+BottomLevelAs::BottomLevelAs(const std::vector<glm::vec3>& positions, const std::vector<uint32>& indices, Bvh bvh)
+    : m_bvh(std::move(bvh))
+{
+    assert(!indices.empty() && indices.size() % 3 == 0);
+    storeTriangles(positions, indices);
+}
+
+BottomLevelAs::~BottomLevelAs()
+{
+
+}
+
+void BottomLevelAs::storeTriangles(const std::vector<glm::vec3>& positions, const std::vector<uint32>& indices)
+{
+    // store the triangles in leaf order so the traversal walks them linearly, spatial splits may repeat some of them
+    const size_t triangleCount = indices.size() / 3;
+    const std::vector<uint32>& primitiveIndices = m_bvh.getPrimitiveIndices();
+    m_triangles.resize(primitiveIndices.size());
+    m_trianglePositions.resize(triangleCount);
+    for (size_t i = 0; i < primitiveIndices.size(); i++)
+    {
+        uint32 primitiveId = primitiveIndices[i];
+        m_trianglePositions[primitiveId] = uint32(i);
+        const glm::vec3& v0 = positions[indices[primitiveId * 3 + 0]];
+        const glm::vec3& v1 = positions[indices[primitiveId * 3 + 1]];
+        const glm::vec3& v2 = positions[indices[primitiveId * 3 + 2]];
+        m_triangles[i] = { v0, primitiveId, v1 - v0, 0.0f, v2 - v0, 0.0f };
+    }
+}
+
+glm::vec3 BottomLevelAs::getNormal(uint32 primitiveId) const
+{
+    const BvhTriangle& triangle = m_triangles[m_trianglePositions[primitiveId]];
+    return glm::normalize(glm::cross(triangle.edge1, triangle.edge2));
+}
+
+bool BottomLevelAs::intersect(Ray& ray, RayHit& hit) const
+{
+    return m_bvh.traverse(ray, [&](uint32 i, Ray& r) { return intersectTriangle(m_triangles[i], r, hit); });
+}
+
+bool BottomLevelAs::occluded(const Ray& ray) const
+{
+    return m_bvh.traverseAny(ray, [&](uint32 i, const Ray& r)
+    {
+        float t, u, v;
+        return intersectTriangle(m_triangles[i], r, t, u, v);
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+TopLevelAs::TopLevelAs()
+    : m_dirty(false)
+    , m_version(0)
+{
+}
+
+TopLevelAs::~TopLevelAs()
+{
+
+}
+
+uint32 TopLevelAs::addBlas(std::shared_ptr<const BottomLevelAs> blas)
+{
+    m_blas.push_back(std::move(blas));
+    return uint32(m_blas.size() - 1);
+}
+
+uint32 TopLevelAs::addInstance(uint32 blasIndex, const glm::mat4x4& transform, const glm::vec3& albedo)
+{
+    assert(blasIndex < m_blas.size());
+
+    Instance instance;
+    instance.albedo = albedo;
+    instance.blasIndex = blasIndex;
+    m_instances.push_back(instance);
+    m_instanceBounds.push_back(Aabb());
+
+    uint32 instanceIndex = uint32(m_instances.size() - 1);
+    setInstanceTransform(instanceIndex, transform);
+    return instanceIndex;
+}
+
+void TopLevelAs::setInstanceTransform(uint32 instanceIndex, const glm::mat4x4& transform)
+{
+    Instance& instance = m_instances[instanceIndex];
+    instance.transform = transform;
+    instance.inverseTransform = glm::inverse(transform);
+    m_instanceBounds[instanceIndex] = transformAabb(m_blas[instance.blasIndex]->getBounds(), transform);
+    m_dirty = true;
+}
+
+bool TopLevelAs::update(const BvhBuildSettings& settings)
+{
+    if (!m_dirty)
+    {
+        return false;
+    }
+
+    // instances are few compared to triangles, rebuilding from scratch is cheaper than refitting a degraded tree. There is
+    // no way to clip an instance's bounds, and leaves sharing instances would not fit the GPU's top level buffers either.
+    BvhBuildSettings objectSplitSettings = settings;
+    objectSplitSettings.mode = BvhBuildMode::Binned;
+    m_bvh.build(m_instanceBounds, objectSplitSettings);
+    m_dirty = false;
+    m_version++;
+    return true;
+}
+
+bool TopLevelAs::intersect(const Ray& worldRay, RayHit& hit) const
+{
+    assert(!m_dirty);
+
+    const std::vector<uint32>& instanceIndices = m_bvh.getPrimitiveIndices();
+    Ray ray = worldRay;
+    return m_bvh.traverse(ray, [&](uint32 i, Ray& r)
+    {
+        const Instance& instance = m_instances[instanceIndices[i]];
+
+        // the direction is not normalized, so distances along the ray are the same in both spaces
+        Ray objectRay;
+        objectRay.origin = glm::vec3(instance.inverseTransform * glm::vec4(r.origin, 1.0f));
+        objectRay.direction = glm::vec3(instance.inverseTransform * glm::vec4(r.direction, 0.0f));
+        objectRay.tMin = r.tMin;
+        objectRay.tMax = r.tMax;
+        if (!m_blas[instance.blasIndex]->intersect(objectRay, hit))
+        {
+            return false;
+        }
+
+        r.tMax = objectRay.tMax;
+        hit.instanceId = instanceIndices[i];
+        return true;
+    });
+}
+
+bool TopLevelAs::occluded(const Ray& worldRay) const
+{
+    assert(!m_dirty);
+
+    const std::vector<uint32>& instanceIndices = m_bvh.getPrimitiveIndices();
+    return m_bvh.traverseAny(worldRay, [&](uint32 i, const Ray& r)
+    {
+        const Instance& instance = m_instances[instanceIndices[i]];
+
+        Ray objectRay;
+        objectRay.origin = glm::vec3(instance.inverseTransform * glm::vec4(r.origin, 1.0f));
+        objectRay.direction = glm::vec3(instance.inverseTransform * glm::vec4(r.direction, 0.0f));
+        objectRay.tMin = r.tMin;
+        objectRay.tMax = r.tMax;
+        return m_blas[instance.blasIndex]->occluded(objectRay);
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+void printBvhBuildComparison(std::ostream& os, const std::vector<glm::vec3>& positions, const std::vector<uint32>& indices, uint32 rayCount,
+                             const BvhBuildSettings& spatialSettings)
+{
+    BvhBuildSettings binnedSettings = spatialSettings;
+    binnedSettings.mode = BvhBuildMode::Binned;
+    const BvhBuildSettings settings[2] = { binnedSettings, spatialSettings };
+
+    struct Result
+    {
+        double  buildMs;
+        float   sahCost;
+        size_t  nodeCount;
+        size_t  referenceCount;
+        uint32  depth;
+        double  mraysPerSecond;
+        uint32  hitCount;
+    } results[2];
+
+    std::unique_ptr<BottomLevelAs> blas[2];
+    for (int i = 0; i < 2; i++)
+    {
+        Timer timer;
+        blas[i] = std::make_unique<BottomLevelAs>(positions, indices, settings[i]);
+        results[i].buildMs = timer.getElapsedMilliseconds();
+        results[i].sahCost = blas[i]->getBvh().computeSahCost(settings[i]);
+        results[i].nodeCount = blas[i]->getBvh().getNodes().size();
+        results[i].referenceCount = blas[i]->getBvh().getPrimitiveIndices().size();
+        results[i].depth = blas[i]->getBvh().getDepth();
+    }
+
+    // the same rays for both: from a sphere around the mesh towards random points inside its bounds
+    const Aabb bounds = blas[0]->getBounds();
+    const glm::vec3 center = bounds.getCenter();
+    const float radius = glm::length(bounds.getExtent());
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::normal_distribution<float> normal;
+    std::vector<Ray> rays(rayCount);
+    for (Ray& ray : rays)
+    {
+        glm::vec3 direction(normal(generator), normal(generator), normal(generator));
+        glm::vec3 target = bounds.min + bounds.getExtent() * glm::vec3(uniform(generator), uniform(generator), uniform(generator));
+        ray.origin = center + glm::normalize(direction) * radius;
+        ray.direction = glm::normalize(target - ray.origin);
+        ray.tMin = 0.0f;
+        ray.tMax = FLT_MAX;
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        results[i].hitCount = 0;
+        Timer timer;
+        for (const Ray& original : rays)
+        {
+            Ray ray = original;
+            RayHit hit;
+            results[i].hitCount += blas[i]->intersect(ray, hit) ? 1 : 0;
+        }
+        double milliseconds = timer.getElapsedMilliseconds();
+        results[i].mraysPerSecond = milliseconds > 0.0 ? rayCount / (milliseconds * 1000.0) : 0.0;
+    }
+
+    os << "            binned        sbvh\n" << std::fixed << std::setprecision(2);
+    os << "build ms" << std::setw(12) << results[0].buildMs << std::setw(12) << results[1].buildMs << "\n";
+    os << "SAH cost" << std::setw(12) << results[0].sahCost << std::setw(12) << results[1].sahCost << "\n";
+    os << "nodes   " << std::setw(12) << results[0].nodeCount << std::setw(12) << results[1].nodeCount << "\n";
+    os << "refs    " << std::setw(12) << results[0].referenceCount << std::setw(12) << results[1].referenceCount << "\n";
+    os << "depth   " << std::setw(12) << results[0].depth << std::setw(12) << results[1].depth << "\n";
+    os << "Mrays/s " << std::setw(12) << results[0].mraysPerSecond << std::setw(12) << results[1].mraysPerSecond << "\n";
+    os << "hits    " << std::setw(12) << results[0].hitCount << std::setw(12) << results[1].hitCount << "\n";
+    os << std::defaultfloat;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Bvh.h"
+#include <memory>
+#include <iosfwd>
+
+// Triangle in BVH order with precomputed edges, 48 bytes matching struct BvhTriangle in the traversal shaders
+struct BvhTriangle
+{
+    glm::vec3   v0;
+    uint32      primitiveId;    // index of the triangle in the source mesh
+    glm::vec3   edge1;
+    float       pad0;
+    glm::vec3   edge2;
+    float       pad1;
+};
+
+// Bottom level: a BVH over the triangles of one mesh in object space
+class BottomLevelAs
+{
+public:
+    // indices holds three entries per triangle and at least one triangle, an empty mesh has nothing to upload or hit
+    BottomLevelAs(const std::vector<glm::vec3>& positions, const std::vector<uint32>& indices, const BvhBuildSettings& settings = BvhBuildSettings());
+
+    // Uses a tree built earlier over the same mesh, e.g. loaded from a BvhCache
+    BottomLevelAs(const std::vector<glm::vec3>& positions, const std::vector<uint32>& indices, Bvh bvh);
+    ~BottomLevelAs();
+
+    // ray in object space, shrinks ray.tMax and fills primitiveId/u/v of hit on a closer hit
+    bool intersect(Ray& ray, RayHit& hit) const;
+
+    // true if anything lies within [ray.tMin, ray.tMax], stops at the first such triangle
+    bool occluded(const Ray& ray) const;
+
+    // geometric normal in object space, following the winding of the source triangle
+    glm::vec3 getNormal(uint32 primitiveId) const;
+
+    const Bvh& getBvh() const { return m_bvh; }
+    const std::vector<BvhTriangle>& getTriangles() const { return m_triangles; }
+    Aabb getBounds() const { return m_bvh.getBounds(); }
+
+private:
+    void storeTriangles(const std::vector<glm::vec3>& positions, const std::vector<uint32>& indices);
+
+    Bvh                         m_bvh;
+    std::vector<BvhTriangle>    m_triangles;
+    std::vector<uint32>         m_trianglePositions;    // primitiveId -> index into m_triangles
+};
+
+// 144 bytes, matches struct Instance in the traversal shaders
+struct Instance
+{
+    glm::mat4x4 transform;          // object to world, same convention as the model part of createModelViewProjectionClipMatrix
+    glm::mat4x4 inverseTransform;
+    glm::vec3   albedo;
+    uint32      blasIndex;
+};
+
+// Top level: a BVH over instances of bottom level structures. Moving instances only rebuilds this small tree.
+class TopLevelAs
+{
+public:
+    TopLevelAs();
+    ~TopLevelAs();
+
+    uint32 addBlas(std::shared_ptr<const BottomLevelAs> blas);
+    uint32 addInstance(uint32 blasIndex, const glm::mat4x4& transform, const glm::vec3& albedo = glm::vec3(0.8f));
+    void setInstanceTransform(uint32 instanceIndex, const glm::mat4x4& transform);
+
+    // Rebuilds the top level BVH if instances were added or moved since the last call, returns true if it did. Always
+    // with object splits, BvhBuildMode::SpatialSplits in settings is ignored.
+    bool update(const BvhBuildSettings& settings = BvhBuildSettings());
+
+    // world space ray, fills instanceId with the index of the instance that was hit
+    bool intersect(const Ray& ray, RayHit& hit) const;
+
+    // Occlusion only, for shadow and visibility rays: true as soon as any instance is hit within [ray.tMin, ray.tMax]
+    bool occluded(const Ray& ray) const;
+
+    const Bvh& getBvh() const { return m_bvh; }
+    const std::vector<Instance>& getInstances() const { return m_instances; }
+    const BottomLevelAs& getBlas(uint32 blasIndex) const { return *m_blas[blasIndex]; }
+    uint32 getBlasCount() const { return uint32(m_blas.size()); }
+    Aabb getBounds() const { return m_bvh.getBounds(); }
+
+    // Incremented on every rebuild, suitable as scene version of ProgressiveAccumulator::update
+    uint64 getVersion() const { return m_version; }
+
+private:
+    std::vector<std::shared_ptr<const BottomLevelAs>>   m_blas;
+    std::vector<Instance>                               m_instances;
+    std::vector<Aabb>                                   m_instanceBounds;
+    Bvh                                                 m_bvh;
+    bool                                                m_dirty;
+    uint64                                              m_version;
+};
+
+// World space bounds of a box under an affine transform
+Aabb transformAabb(const Aabb& bounds, const glm::mat4x4& transform);
+
+// Builds the mesh once with binned object splits and once with spatialSettings, then prints SAH cost, node and
+// reference count, depth, build time and single threaded closest hit throughput of rayCount random rays side by side
+void printBvhBuildComparison(std::ostream& os, const std::vector<glm::vec3>& positions, const std::vector<uint32>& indices, uint32 rayCount = 1 << 20,
+                             const BvhBuildSettings& spatialSettings = { BvhBuildMode::SpatialSplits });
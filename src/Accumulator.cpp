@@ -0,0 +1,237 @@
+#include "Accumulator.h"
+#include "GraphicsObjects.h"
+#include "shaders.hpp"
+
+// weight of the latest frame in the per sample cost estimate
+const double SampleCostSmoothing = 0.25;
+
+const uint32 AccumulateGroupSize = 8;
+
+// Matches the push constant block of computeShaderText_Accumulate
+struct AccumulatePushConstants
+{
+    uint32  accumulatedSamples;
+    uint32  batchSamples;
+};
+
+static float luminance(const glm::vec4& c)
+{
+    return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+}
+
+ProgressiveAccumulator::ProgressiveAccumulator(const vk::Extent2D& extent, float frameBudgetMs, uint32 maxSamplesPerFrame)
+    : m_extent(extent)
+    , m_frameBudgetMs(frameBudgetMs)
+    , m_maxSamplesPerFrame(maxSamplesPerFrame)
+    , m_lastMatrix(1.0f)
+    , m_lastSceneVersion(0)
+    , m_hasLastMatrix(false)
+    , m_sampleCount(0)
+    , m_samplesPerFrame(1)
+    , m_msPerSample(0.0)
+    , m_estimatedVariance(0.0f)
+{
+    assert(0 < maxSamplesPerFrame);
+
+    m_accumulation.resize(size_t(extent.width) * extent.height);
+    m_sampleBuffer.resize(m_accumulation.size());
+    reset();
+}
+
+ProgressiveAccumulator::~ProgressiveAccumulator()
+{
+
+}
+
+bool ProgressiveAccumulator::update(const glm::mat4x4& modelViewProjectionClip, uint64 sceneVersion)
+{
+    // any change of the camera or the scene invalidates what we have accumulated so far
+    bool changed = !m_hasLastMatrix || m_lastMatrix != modelViewProjectionClip || m_lastSceneVersion != sceneVersion;
+
+    m_lastMatrix = modelViewProjectionClip;
+    m_lastSceneVersion = sceneVersion;
+    m_hasLastMatrix = true;
+
+    if (changed)
+    {
+        reset();
+    }
+    return changed;
+}
+
+void ProgressiveAccumulator::reset()
+{
+    m_sampleCount = 0;
+    m_estimatedVariance = 0.0f;
+    std::fill(m_accumulation.begin(), m_accumulation.end(), glm::vec4(0.0f));
+}
+
+uint32 ProgressiveAccumulator::accumulate(const SampleFunc& sampleFunc)
+{
+    Timer timer;
+
+    uint32 samples = m_samplesPerFrame;
+    for (uint32 s = 0; s < samples; s++)
+    {
+        sampleFunc(m_sampleCount + s, m_sampleBuffer);
+
+        // Welford's online update, the luminance M2 is kept in w to estimate the variance
+        float n = float(m_sampleCount + s + 1);
+        for (size_t i = 0; i < m_accumulation.size(); i++)
+        {
+            glm::vec4& acc = m_accumulation[i];
+            const glm::vec4& sample = m_sampleBuffer[i];
+
+            float oldMean = luminance(acc);
+            acc.r += (sample.r - acc.r) / n;
+            acc.g += (sample.g - acc.g) / n;
+            acc.b += (sample.b - acc.b) / n;
+            acc.w += (luminance(sample) - oldMean) * (luminance(sample) - luminance(acc));
+        }
+    }
+
+    endFrame(samples, timer.getElapsedMilliseconds());
+    updateEstimatedVariance();
+    return samples;
+}
+
+void ProgressiveAccumulator::endFrame(uint32 samplesTaken, double frameTimeMs)
+{
+    if (samplesTaken == 0)
+    {
+        return;
+    }
+    m_sampleCount += samplesTaken;
+
+    double msPerSample = frameTimeMs / samplesTaken;
+    m_msPerSample = m_msPerSample == 0.0 ? msPerSample : glm::mix(m_msPerSample, msPerSample, SampleCostSmoothing);
+
+    // pick as many samples as fit into the budget, but never less than one so we keep converging
+    double fit = m_msPerSample > 0.0 ? m_frameBudgetMs / m_msPerSample : double(m_maxSamplesPerFrame);
+    m_samplesPerFrame = clamp(uint32(std::min(fit, double(m_maxSamplesPerFrame))), 1u, m_maxSamplesPerFrame);
+}
+
+void ProgressiveAccumulator::setAccumulation(const std::vector<glm::vec4>& accumulation)
+{
+    assert(accumulation.size() == m_accumulation.size());
+    m_accumulation = accumulation;
+    updateEstimatedVariance();
+}
+
+void ProgressiveAccumulator::updateEstimatedVariance()
+{
+    if (m_sampleCount < 2)
+    {
+        m_estimatedVariance = 0.0f;
+        return;
+    }
+
+    // sample variance M2 / (n - 1), and the variance of the mean is that divided by n
+    double sum = 0.0;
+    for (const glm::vec4& acc : m_accumulation)
+    {
+        sum += acc.w;
+    }
+    double n = double(m_sampleCount);
+    m_estimatedVariance = float(sum / (double(m_accumulation.size()) * (n - 1.0) * n));
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+GpuAccumulator::GpuAccumulator(const Device& device, const vk::UniqueCommandPool& commandPool, ProgressiveAccumulator& accumulator)
+    : m_device(device)
+    , m_accumulator(accumulator)
+    , m_timer(device)
+{
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+    const vk::Extent2D& extent = accumulator.getExtent();
+
+    m_accumulation = std::make_unique<Image>(device, vk::Format::eR32G32B32A32Sfloat, extent, vk::ImageTiling::eOptimal,
+                                             vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc, vk::ImageLayout::eUndefined,
+                                             vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor);
+    m_batch = std::make_unique<Image>(device, vk::Format::eR32G32B32A32Sfloat, extent, vk::ImageTiling::eOptimal,
+                                      vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferDst, vk::ImageLayout::eUndefined,
+                                      vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor);
+
+    // the batch image has to be in eGeneral before the caller renders into it for the first time
+    vk::su::oneTimeSubmit(vkDevice, commandPool, device.getGraphicsQueue(), [&](const vk::UniqueCommandBuffer& commandBuffer)
+    {
+        vk::su::setImageLayout(commandBuffer, m_accumulation->getVKImage().get(), m_accumulation->getFormat(), vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
+        vk::su::setImageLayout(commandBuffer, m_batch->getVKImage().get(), m_batch->getFormat(), vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
+    });
+
+    // 0: accumulation, 1: batch
+    m_descriptorSetLayout = vk::su::createDescriptorSetLayout(vkDevice, std::vector<std::tuple<vk::DescriptorType, uint32_t, vk::ShaderStageFlags>>(
+                                                                            2, { vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute }));
+    vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(AccumulatePushConstants));
+    m_pipelineLayout = vkDevice->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), 1, &m_descriptorSetLayout.get(), 1, &pushConstantRange));
+
+    m_descriptorPool = vk::su::createDescriptorPool(vkDevice, { { vk::DescriptorType::eStorageImage, 2 } });
+    m_descriptorSet = std::move(vkDevice->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(m_descriptorPool.get(), 1, &m_descriptorSetLayout.get())).front());
+
+    vk::DescriptorImageInfo imageInfos[2] =
+    {
+        vk::DescriptorImageInfo(nullptr, m_accumulation->getImageView().get(), vk::ImageLayout::eGeneral),
+        vk::DescriptorImageInfo(nullptr, m_batch->getImageView().get(), vk::ImageLayout::eGeneral)
+    };
+    vkDevice->updateDescriptorSets(vk::WriteDescriptorSet(m_descriptorSet.get(), 0, 0, 2, vk::DescriptorType::eStorageImage, imageInfos), nullptr);
+
+    vk::UniquePipelineCache pipelineCache = vkDevice->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+    vk::UniqueShaderModule shaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eCompute, computeShaderText_Accumulate);
+    m_pipeline = vk::su::createComputePipeline(vkDevice, pipelineCache, std::make_pair(shaderModule.get(), nullptr), m_pipelineLayout);
+}
+
+GpuAccumulator::~GpuAccumulator()
+{
+
+}
+
+void GpuAccumulator::record(const vk::UniqueCommandBuffer& commandBuffer, uint32 batchSamples)
+{
+    assert(0 < batchSamples);
+
+    // after a reset the shader overwrites the accumulation with the batch, so it never needs clearing
+    AccumulatePushConstants pushConstants;
+    pushConstants.accumulatedSamples = m_accumulator.getSampleCount();
+    pushConstants.batchSamples = batchSamples;
+
+    const vk::Extent2D& extent = m_accumulator.getExtent();
+
+    m_timer.reset(commandBuffer);
+    m_timer.begin(commandBuffer);
+
+    // the batch was rendered by a compute pass or a draw
+    vk::MemoryBarrier barrier(vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eTransferWrite,
+                              vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eTransfer,
+                                   vk::PipelineStageFlagBits::eComputeShader, {}, barrier, nullptr, nullptr);
+
+    commandBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline.get());
+    commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout.get(), 0, m_descriptorSet.get(), nullptr);
+    commandBuffer->pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+    commandBuffer->dispatch((extent.width + AccumulateGroupSize - 1) / AccumulateGroupSize, (extent.height + AccumulateGroupSize - 1) / AccumulateGroupSize, 1);
+    vk::su::computeToComputeBarrier(commandBuffer);
+
+    m_timer.end(commandBuffer);
+}
+
+void GpuAccumulator::readBack(const vk::UniqueCommandPool& commandPool)
+{
+    const vk::Extent2D& extent = m_accumulator.getExtent();
+    std::vector<glm::vec4> accumulation(size_t(extent.width) * extent.height);
+
+    Buffer readbackBuffer(m_device, accumulation.size() * sizeof(glm::vec4), vk::BufferUsageFlagBits::eTransferDst);
+    vk::su::oneTimeSubmit(m_device.getVKDevice(), commandPool, m_device.getGraphicsQueue(), [&](const vk::UniqueCommandBuffer& commandBuffer)
+    {
+        commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, {},
+                                       vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead), nullptr, nullptr);
+        commandBuffer->copyImageToBuffer(m_accumulation->getVKImage().get(), vk::ImageLayout::eGeneral, readbackBuffer.getVKBuffer().get(),
+                                         vk::BufferImageCopy(0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+                                                             vk::Offset3D(0, 0, 0), vk::Extent3D(extent, 1)));
+        commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {},
+                                       vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead), nullptr, nullptr);
+    });
+    readbackBuffer.download(accumulation.data(), accumulation.size() * sizeof(glm::vec4));
+
+    m_accumulator.setAccumulation(accumulation);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Common.h"
+#include "Profiling.h"
+#include <vulkan/vulkan.hpp>
+#include <functional>
+#include <memory>
+
+class Device;
+class Image;
+
+// Accumulates samples per pixel over frames while the view stays still. The number of samples taken per frame
+// adapts to the frame time budget, and everything is reset as soon as the camera (MVP) or the scene changes.
+class ProgressiveAccumulator
+{
+public:
+    // Renders one sample for every pixel into radiance (width * height entries, row major)
+    using SampleFunc = std::function<void(uint32 sampleIndex, std::vector<glm::vec4>& radiance)>;
+
+    ProgressiveAccumulator(const vk::Extent2D& extent, float frameBudgetMs = 16.0f, uint32 maxSamplesPerFrame = 64);
+    ~ProgressiveAccumulator();
+
+    // Returns true if the accumulation got reset because the matrix or the scene version differs from last frame
+    bool update(const glm::mat4x4& modelViewProjectionClip, uint64 sceneVersion = 0);
+    void reset();
+
+    // CPU path: renders getSamplesPerFrame() samples into the accumulation buffer, returns the samples taken
+    uint32 accumulate(const SampleFunc& sampleFunc);
+
+    // GPU path: merge a batch of getSamplesPerFrame() samples with GpuAccumulator, then report the samples taken and
+    // the frame time once the command buffer completed. Counts the samples for getSampleCount().
+    void endFrame(uint32 samplesTaken, double frameTimeMs);
+
+    // GPU path: the accumulation image read back by GpuAccumulator, updates getAccumulation() and the estimated variance
+    void setAccumulation(const std::vector<glm::vec4>& accumulation);
+
+    void setFrameBudget(float frameBudgetMs) { m_frameBudgetMs = frameBudgetMs; }
+
+    uint32 getSampleCount() const { return m_sampleCount; }
+    uint32 getSamplesPerFrame() const { return m_samplesPerFrame; }
+
+    // Mean over all pixels of the variance of the per-pixel estimate (luminance), i.e. sigma^2 / n. On the GPU path it
+    // follows the last GpuAccumulator::readBack().
+    float getEstimatedVariance() const { return m_estimatedVariance; }
+
+    // rgb holds the running mean, w the luminance sum of squared differences (Welford's M2)
+    const std::vector<glm::vec4>& getAccumulation() const { return m_accumulation; }
+    const vk::Extent2D& getExtent() const { return m_extent; }
+
+private:
+    void updateEstimatedVariance();
+
+    vk::Extent2D            m_extent;
+    float                   m_frameBudgetMs;
+    uint32                  m_maxSamplesPerFrame;
+
+    glm::mat4x4             m_lastMatrix;
+    uint64                  m_lastSceneVersion;
+    bool                    m_hasLastMatrix;
+
+    uint32                  m_sampleCount;
+    uint32                  m_samplesPerFrame;
+    double                  m_msPerSample;          // exponential moving average
+    float                   m_estimatedVariance;
+
+    std::vector<glm::vec4>  m_accumulation;
+    std::vector<glm::vec4>  m_sampleBuffer;
+};
+
+// GPU path of ProgressiveAccumulator: computeShaderText_Accumulate merges the batches of samples the caller renders into
+// an eR32G32B32A32Sfloat accumulation image laid out like getAccumulation(). Both images stay in vk::ImageLayout::eGeneral.
+class GpuAccumulator
+{
+public:
+    GpuAccumulator(const Device& device, const vk::UniqueCommandPool& commandPool, ProgressiveAccumulator& accumulator);
+    ~GpuAccumulator();
+
+    // Storage image the caller renders a batch into: rgb the mean of its samples, a their luminance M2 (0 for one sample)
+    const Image& getBatchImage() const { return *m_batch; }
+    const Image& getAccumulationImage() const { return *m_accumulation; }
+
+    // Records the merge of a batch of batchSamples samples, after the writes to the batch image. Starts over when the
+    // accumulator got reset. Once the command buffer completed report the batch with ProgressiveAccumulator::endFrame.
+    void record(const vk::UniqueCommandBuffer& commandBuffer, uint32 batchSamples);
+
+    // Copies the accumulation image into the accumulator, which estimates the variance from M2. Waits for the queue.
+    void readBack(const vk::UniqueCommandPool& commandPool);
+
+    // GPU time of the last recorded merge, false until its command buffer completed
+    bool getLastMergeMilliseconds(double& milliseconds) const { return m_timer.getMilliseconds(0, milliseconds); }
+
+private:
+    const Device&                   m_device;
+    ProgressiveAccumulator&         m_accumulator;
+
+    std::unique_ptr<Image>          m_accumulation;
+    std::unique_ptr<Image>          m_batch;
+
+    vk::UniqueDescriptorSetLayout   m_descriptorSetLayout;
+    vk::UniquePipelineLayout        m_pipelineLayout;
+    vk::UniqueDescriptorPool        m_descriptorPool;
+    vk::UniqueDescriptorSet         m_descriptorSet;
+    vk::UniquePipeline              m_pipeline;
+
+    GpuTimer                        m_timer;
+};
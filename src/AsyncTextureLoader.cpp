@@ -0,0 +1,333 @@
+#include "AsyncTextureLoader.h"
+#include "GraphicsObjects.h"
+#include "ImageDecoder.h"
+#include "MappedFile.h"
+#include "Profiling.h"
+#include "utils.hpp"
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+
+// Copies from the staging buffer start at multiples of this
+static const vk::DeviceSize StagingAlignment = 16;
+
+AsyncTextureLoader::AsyncTextureLoader(const Device& device, vk::DeviceSize stagingBudget, uint32 threadCount)
+    : m_device(device)
+    , m_stagingSize(stagingBudget)
+    , m_stagingHead(0)
+    , m_stagingUsed(0)
+    , m_firstStagingAllocation(0)
+    , m_stats()
+    , m_quit(false)
+{
+    m_stagingBuffer = std::make_unique<Buffer>(device, stagingBudget, vk::BufferUsageFlagBits::eTransferSrc);
+    m_stagingData = static_cast<uint8_t*>(device.getVKDevice()->mapMemory(m_stagingBuffer->getDeviceMemory().get(), 0, stagingBudget));
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+    for (uint32 i = 0; i < threadCount; i++)
+    {
+        m_workers.emplace_back(&AsyncTextureLoader::workerLoop, this);
+    }
+}
+
+AsyncTextureLoader::~AsyncTextureLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wakeCondition.notify_all();
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+
+    const vk::UniqueDevice& device = m_device.getVKDevice();
+    for (const UploadBatch& batch : m_uploads)
+    {
+        while (vk::Result::eTimeout == device->waitForFences(batch.fence.get(), VK_TRUE, vk::su::FenceTimeout))
+            ;
+    }
+    device->unmapMemory(m_stagingBuffer->getDeviceMemory().get());
+}
+
+uint32 AsyncTextureLoader::load(const string& path)
+{
+    m_requests.push_back(std::make_unique<Request>());
+    Request* request = m_requests.back().get();
+    request->path = path;
+    request->state = TextureLoadState::Queued;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(request);
+    }
+    m_wakeCondition.notify_one();
+    return uint32(m_requests.size() - 1);
+}
+
+vk::Fence AsyncTextureLoader::update(const vk::UniqueCommandBuffer& commandBuffer)
+{
+    const vk::UniqueDevice& device = m_device.getVKDevice();
+
+    std::vector<Completion> completions;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        completions.swap(m_completions);
+    }
+    for (const Completion& completion : completions)
+    {
+        Request& request = *completion.request;
+        if (!completion.success)
+        {
+            if (request.state == TextureLoadState::Decoding)
+            {
+                releaseStaging(request.stagingAllocation);
+            }
+            request.state = TextureLoadState::Failed;
+        }
+        else if (request.state == TextureLoadState::Queued)
+        {
+            // pixels that could never fit fail right away instead of blocking the ones behind them
+            bool fits = size_t(request.extent.width) * request.extent.height * 4 <= m_stagingSize;
+            request.state = fits ? TextureLoadState::Waiting : TextureLoadState::Failed;
+            if (fits)
+            {
+                m_waiting.push_back(&request);
+            }
+        }
+        else
+        {
+            request.state = TextureLoadState::Decoded;
+            m_decoded.push_back(&request);
+            m_stats.fileBytes += completion.fileBytes;
+            m_stats.decodedBytes += uint64(request.extent.width) * request.extent.height * 4;
+            m_stats.decodeSeconds += completion.seconds;
+        }
+    }
+
+    // uploads that completed give their staging space back
+    while (!m_uploads.empty() && device->getFenceStatus(m_uploads.front().fence.get()) == vk::Result::eSuccess)
+    {
+        for (Request* request : m_uploads.front().requests)
+        {
+            request->state = TextureLoadState::Loaded;
+            releaseStaging(request->stagingAllocation);
+        }
+        m_freeFences.push_back(std::move(m_uploads.front().fence));
+        m_uploads.pop_front();
+    }
+
+    // in the order of the queue, so large files are not passed over forever
+    size_t started = 0;
+    while (!m_waiting.empty())
+    {
+        Request& request = *m_waiting.front();
+        if (!allocateStaging(vk::DeviceSize(request.extent.width) * request.extent.height * 4, request.stagingOffset, request.stagingAllocation))
+        {
+            break;
+        }
+        request.state = TextureLoadState::Decoding;
+        m_waiting.pop_front();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(&request);
+        }
+        started++;
+    }
+    if (started)
+    {
+        m_wakeCondition.notify_all();
+    }
+
+    if (m_decoded.empty())
+    {
+        return vk::Fence();
+    }
+
+    UploadBatch batch;
+    for (Request* request : m_decoded)
+    {
+        request->image = std::make_unique<Image>(m_device, vk::Format::eR8G8B8A8Unorm, request->extent, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferDst,
+                                                 vk::ImageLayout::eUndefined, vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor);
+        vk::Image image = request->image->getVKImage().get();
+
+        vk::su::setImageLayout(commandBuffer, image, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+        vk::BufferImageCopy copyRegion(request->stagingOffset, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0),
+                                       vk::Extent3D(request->extent, 1));
+        commandBuffer->copyBufferToImage(m_stagingBuffer->getVKBuffer().get(), image, vk::ImageLayout::eTransferDstOptimal, copyRegion);
+        vk::su::setImageLayout(commandBuffer, image, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+        request->state = TextureLoadState::Uploading;
+        batch.requests.push_back(request);
+    }
+    m_decoded.clear();
+
+    if (m_freeFences.empty())
+    {
+        batch.fence = device->createFenceUnique(vk::FenceCreateInfo());
+    }
+    else
+    {
+        batch.fence = std::move(m_freeFences.back());
+        m_freeFences.pop_back();
+        device->resetFences(batch.fence.get());
+    }
+    m_uploads.push_back(std::move(batch));
+    return m_uploads.back().fence.get();
+}
+
+TextureLoadState AsyncTextureLoader::getState(uint32 handle) const
+{
+    assert(handle < m_requests.size());
+    return m_requests[handle]->state;
+}
+
+const Image* AsyncTextureLoader::getImage(uint32 handle) const
+{
+    assert(handle < m_requests.size());
+    const Request& request = *m_requests[handle];
+    return request.state == TextureLoadState::Loaded ? request.image.get() : nullptr;
+}
+
+AsyncTextureLoader::Stats AsyncTextureLoader::getStats() const
+{
+    Stats stats = m_stats;
+    for (const std::unique_ptr<Request>& request : m_requests)
+    {
+        stats.loaded += request->state == TextureLoadState::Loaded;
+        stats.failed += request->state == TextureLoadState::Failed;
+        stats.pending += request->state != TextureLoadState::Loaded && request->state != TextureLoadState::Failed;
+    }
+    stats.stagingUsed = m_stagingUsed;
+    return stats;
+}
+
+void AsyncTextureLoader::workerLoop()
+{
+    for (;;)
+    {
+        Request* request;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeCondition.wait(lock, [this]() { return m_quit || !m_jobs.empty(); });
+            if (m_quit)
+            {
+                return;
+            }
+            request = m_jobs.front();
+            m_jobs.pop_front();
+        }
+
+        Completion completion = { request, false, 0, 0.0 };
+        runJob(*request, completion);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_completions.push_back(completion);
+    }
+}
+
+// Worker threads. A queued request only gets its header read, so the file is mapped twice but no mapping stays open
+// while the request waits for staging space.
+void AsyncTextureLoader::runJob(Request& request, Completion& completion) const
+{
+    MappedFile file;
+    if (!file.open(request.path))
+    {
+        return;
+    }
+
+    if (request.state == TextureLoadState::Queued)
+    {
+        completion.success = readImageHeader(file.getData(), file.getSize(), request.extent);
+        return;
+    }
+
+    Timer timer;
+    completion.success = decodeImage(file.getData(), file.getSize(), request.extent, m_stagingData + request.stagingOffset, size_t(request.extent.width) * 4);
+    completion.seconds = timer.getElapsedMilliseconds() * 1e-3;
+    completion.fileBytes = file.getSize();
+}
+
+bool AsyncTextureLoader::allocateStaging(vk::DeviceSize size, vk::DeviceSize& offset, uint64& allocation)
+{
+    vk::DeviceSize start = (m_stagingHead + StagingAlignment - 1) & ~(StagingAlignment - 1);
+    if (start + size > m_stagingSize)
+    {
+        start = 0;
+    }
+    vk::DeviceSize consumed = (start >= m_stagingHead ? start - m_stagingHead : m_stagingSize - m_stagingHead) + size;
+    if (m_stagingUsed + consumed > m_stagingSize)
+    {
+        return false;
+    }
+
+    m_stagingUsed += consumed;
+    m_stagingHead = start + size == m_stagingSize ? 0 : start + size;
+    m_stagingAllocations.push_back({ consumed, false });
+
+    offset = start;
+    allocation = m_firstStagingAllocation + m_stagingAllocations.size() - 1;
+    return true;
+}
+
+void AsyncTextureLoader::releaseStaging(uint64 allocation)
+{
+    assert(m_firstStagingAllocation <= allocation && allocation - m_firstStagingAllocation < m_stagingAllocations.size());
+    m_stagingAllocations[size_t(allocation - m_firstStagingAllocation)].released = true;
+
+    while (!m_stagingAllocations.empty() && m_stagingAllocations.front().released)
+    {
+        m_stagingUsed -= m_stagingAllocations.front().size;
+        m_stagingAllocations.pop_front();
+        m_firstStagingAllocation++;
+    }
+    if (!m_stagingUsed)
+    {
+        m_stagingHead = 0;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+void printTextureLoadBenchmark(std::ostream& os, const Device& device, const std::vector<string>& paths)
+{
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+    vk::UniqueCommandPool commandPool = vkDevice->createCommandPoolUnique(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, device.getGraphicsQueueFamilyIndex()));
+    vk::UniqueCommandBuffer commandBuffer = std::move(vkDevice->allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo(commandPool.get(), vk::CommandBufferLevel::ePrimary, 1)).front());
+
+    Timer timer;
+    AsyncTextureLoader loader(device, 64 << 20);
+    for (const string& path : paths)
+    {
+        loader.load(path);
+    }
+
+    // stands in for the frame loop, which would record its draws into the same command buffer
+    uint32 updateCount = 0;
+    while (loader.getStats().pending)
+    {
+        commandBuffer->begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        vk::Fence fence = loader.update(commandBuffer);
+        commandBuffer->end();
+        updateCount++;
+        if (!fence)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        device.getGraphicsQueue().submit(vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer.get()), fence);
+        while (vk::Result::eTimeout == vkDevice->waitForFences(fence, VK_TRUE, vk::su::FenceTimeout))
+            ;
+    }
+    double seconds = timer.getElapsedMilliseconds() * 1e-3;
+
+    AsyncTextureLoader::Stats stats = loader.getStats();
+    os << std::fixed << std::setprecision(1);
+    os << stats.loaded << " loaded, " << stats.failed << " failed in " << seconds * 1e3 << " ms over " << updateCount << " updates\n";
+    os << stats.fileBytes * 1e-6 << " MB of files decoded to " << stats.decodedBytes * 1e-6 << " MB: " << stats.getDecodeMegabytesPerSecond()
+       << " MB/s per worker, " << (seconds > 0.0 ? stats.decodedBytes * 1e-6 / seconds : 0.0) << " MB/s overall\n";
+    os << std::defaultfloat;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Common.h"
+#include <vulkan/vulkan.hpp>
+#include <condition_variable>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class Buffer;
+class Device;
+class Image;
+
+enum class TextureLoadState
+{
+    Queued,         // waiting for a worker to read the header
+    Waiting,        // for its pixels to fit into the staging budget
+    Decoding,
+    Decoded,        // the next update() records the upload
+    Uploading,
+    Loaded,
+    Failed,
+};
+
+// Loads PNG and JPEG files into eR8G8B8A8Unorm textures without blocking the render thread. Worker threads map the
+// files and decode them straight into a persistently mapped staging buffer, the render thread only creates the
+// images and records the copies of the decodes that finished. The staging buffer is a fixed budget: a file waits
+// until its pixels fit, so the memory in flight stays bounded however many files are queued.
+class AsyncTextureLoader
+{
+public:
+    struct Stats
+    {
+        uint32          pending;            // queued, waiting, decoding or uploading
+        uint32          loaded;
+        uint32          failed;
+        vk::DeviceSize  stagingUsed;
+        uint64          fileBytes;          // of the files decoded so far
+        uint64          decodedBytes;       // RGBA bytes they decoded to
+        double          decodeSeconds;      // summed over the workers
+
+        // Per worker thread
+        double getDecodeMegabytesPerSecond() const { return decodeSeconds > 0.0 ? decodedBytes / decodeSeconds * 1e-6 : 0.0; }
+    };
+
+    // 0 threads uses one per hardware thread but one, which is left to the render thread
+    AsyncTextureLoader(const Device& device, vk::DeviceSize stagingBudget, uint32 threadCount = 0);
+    ~AsyncTextureLoader();
+
+    AsyncTextureLoader(const AsyncTextureLoader&) = delete;
+    AsyncTextureLoader& operator=(const AsyncTextureLoader&) = delete;
+
+    // Queues a file and returns the handle of its texture
+    uint32 load(const string& path);
+
+    // Render thread, e.g. once per frame: starts the decodes that fit into the budget and records the uploads of
+    // finished ones, leaving those images in eShaderReadOnlyOptimal. When anything was recorded, returns the fence the
+    // submission of commandBuffer has to signal before the next call, a null handle otherwise.
+    vk::Fence update(const vk::UniqueCommandBuffer& commandBuffer);
+
+    TextureLoadState getState(uint32 handle) const;
+
+    // nullptr until the texture is loaded
+    const Image* getImage(uint32 handle) const;
+
+    Stats getStats() const;
+
+private:
+    struct Request
+    {
+        string                  path;
+        TextureLoadState        state;
+        vk::Extent2D            extent;
+        uint64                  stagingAllocation;
+        vk::DeviceSize          stagingOffset;
+        std::unique_ptr<Image>  image;
+    };
+
+    // Decodes finish in any order but staging space is handed out front to back, so an allocation is only reused
+    // once every allocation before it is released too
+    struct StagingAllocation
+    {
+        vk::DeviceSize  size;               // including what was skipped to wrap around
+        bool            released;
+    };
+
+    struct Completion
+    {
+        Request*        request;
+        bool            success;
+        uint64          fileBytes;
+        double          seconds;
+    };
+
+    struct UploadBatch
+    {
+        vk::UniqueFence         fence;
+        std::vector<Request*>   requests;
+    };
+
+    void workerLoop();
+    void runJob(Request& request, Completion& completion) const;
+
+    bool allocateStaging(vk::DeviceSize size, vk::DeviceSize& offset, uint64& allocation);
+    void releaseStaging(uint64 allocation);
+
+    const Device&                           m_device;
+    std::unique_ptr<Buffer>                 m_stagingBuffer;
+    uint8_t*                                m_stagingData;
+    vk::DeviceSize                          m_stagingSize;
+    vk::DeviceSize                          m_stagingHead;
+    vk::DeviceSize                          m_stagingUsed;
+    std::deque<StagingAllocation>           m_stagingAllocations;
+    uint64                                  m_firstStagingAllocation;   // id of the front of m_stagingAllocations
+
+    std::vector<std::unique_ptr<Request>>   m_requests;         // by handle
+    std::deque<Request*>                    m_waiting;
+    std::vector<Request*>                   m_decoded;
+    std::deque<UploadBatch>                 m_uploads;
+    std::vector<vk::UniqueFence>            m_freeFences;
+    Stats                                   m_stats;
+
+    // shared with the workers
+    std::vector<std::thread>                m_workers;
+    mutable std::mutex                      m_mutex;
+    std::condition_variable                 m_wakeCondition;
+    std::deque<Request*>                    m_jobs;
+    std::vector<Completion>                 m_completions;
+    bool                                    m_quit;
+};
+
+// Loads the files through a loader with a 64 MB budget, one update per submission, and prints the wall time and the
+// decode throughput
+void printTextureLoadBenchmark(std::ostream& os, const Device& device, const std::vector<string>& paths);
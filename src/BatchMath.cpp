@@ -0,0 +1,483 @@
+#include "BatchMath.h"
+#include "AccelerationStructure.h"
+#include "Profiling.h"
+#include "math.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <immintrin.h>
+
+// AVX code is compiled next to the SSE code and only called when the CPU has it; MSVC allows the intrinsics
+// without /arch:AVX, GCC and Clang need them enabled per function
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX_FUNCTION
+#else
+#define AVX_FUNCTION __attribute__((target("avx")))
+#endif
+
+static SimdLevel detectSimdLevel()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    // the OS has to save the upper register halves as well
+    bool avx = (info[2] & (1 << 28)) && (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+#else
+    bool avx = __builtin_cpu_supports("avx");
+#endif
+    return avx ? SimdLevel::Avx : SimdLevel::Sse;
+}
+
+static const SimdLevel s_supportedSimdLevel = detectSimdLevel();
+static SimdLevel s_simdLevel = s_supportedSimdLevel;
+
+SimdLevel getSupportedSimdLevel()
+{
+    return s_supportedSimdLevel;
+}
+
+SimdLevel getSimdLevel()
+{
+    return s_simdLevel;
+}
+
+void setSimdLevel(SimdLevel level)
+{
+    s_simdLevel = std::min(level, s_supportedSimdLevel);
+}
+
+static size_t getPaddedCount(size_t count)
+{
+    return (count + BatchWidth - 1) / BatchWidth * BatchWidth;
+}
+
+void AabbBatch::resize(size_t newCount)
+{
+    count = newCount;
+    size_t paddedCount = getPaddedCount(count);
+    for (std::vector<float>* v : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+    {
+        v->resize(paddedCount);
+    }
+    for (size_t i = count; i < paddedCount; i++)
+    {
+        set(i, Aabb());
+    }
+}
+
+void AabbBatch::set(size_t i, const Aabb& box)
+{
+    minX[i] = box.min.x;
+    minY[i] = box.min.y;
+    minZ[i] = box.min.z;
+    maxX[i] = box.max.x;
+    maxY[i] = box.max.y;
+    maxZ[i] = box.max.z;
+}
+
+Aabb AabbBatch::get(size_t i) const
+{
+    Aabb box;
+    box.min = glm::vec3(minX[i], minY[i], minZ[i]);
+    box.max = glm::vec3(maxX[i], maxY[i], maxZ[i]);
+    return box;
+}
+
+void TransformBatch::resize(size_t newCount)
+{
+    count = newCount;
+    size_t paddedCount = getPaddedCount(count);
+    for (std::vector<float>& v : elements)
+    {
+        v.resize(paddedCount);
+    }
+    for (size_t i = count; i < paddedCount; i++)
+    {
+        set(i, glm::mat4x4(1.0f));
+    }
+}
+
+void TransformBatch::set(size_t i, const glm::mat4x4& transform)
+{
+    for (int column = 0; column < 4; column++)
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            elements[column * 3 + row][i] = transform[column][row];
+        }
+    }
+}
+
+glm::mat4x4 TransformBatch::get(size_t i) const
+{
+    glm::mat4x4 transform(1.0f);
+    for (int column = 0; column < 4; column++)
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            transform[column][row] = elements[column * 3 + row][i];
+        }
+    }
+    return transform;
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+// The lanes hold the same matrix element of consecutive instances. Element (column c, row r) of the product is
+// sum over k of viewProjection[k][r] * transform[c][k], where the fourth row of an affine transform is (0, 0, 0, 1).
+// A 4x4 transpose per column turns the rows back into columns of single matrices.
+
+static void multiplyTransformsSse(const glm::mat4x4& viewProjection, const TransformBatch& transforms, glm::mat4x4* mvps)
+{
+    for (size_t i = 0; i < transforms.count; i += 4)
+    {
+        __m128 m[12];
+        for (int e = 0; e < 12; e++)
+        {
+            m[e] = _mm_loadu_ps(&transforms.elements[e][i]);
+        }
+
+        size_t laneCount = std::min<size_t>(4, transforms.count - i);
+        for (int column = 0; column < 4; column++)
+        {
+            __m128 rows[4];
+            for (int row = 0; row < 4; row++)
+            {
+                __m128 sum = column == 3 ? _mm_set1_ps(viewProjection[3][row]) : _mm_setzero_ps();
+                for (int k = 0; k < 3; k++)
+                {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(viewProjection[k][row]), m[column * 3 + k]));
+                }
+                rows[row] = sum;
+            }
+            _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+            for (size_t lane = 0; lane < laneCount; lane++)
+            {
+                _mm_storeu_ps(&mvps[i + lane][column][0], rows[lane]);
+            }
+        }
+    }
+}
+
+AVX_FUNCTION static void multiplyTransformsAvx(const glm::mat4x4& viewProjection, const TransformBatch& transforms, glm::mat4x4* mvps)
+{
+    for (size_t i = 0; i < transforms.count; i += 8)
+    {
+        __m256 m[12];
+        for (int e = 0; e < 12; e++)
+        {
+            m[e] = _mm256_loadu_ps(&transforms.elements[e][i]);
+        }
+
+        size_t laneCount = std::min<size_t>(8, transforms.count - i);
+        for (int column = 0; column < 4; column++)
+        {
+            __m256 rows[4];
+            for (int row = 0; row < 4; row++)
+            {
+                __m256 sum = column == 3 ? _mm256_set1_ps(viewProjection[3][row]) : _mm256_setzero_ps();
+                for (int k = 0; k < 3; k++)
+                {
+                    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(viewProjection[k][row]), m[column * 3 + k]));
+                }
+                rows[row] = sum;
+            }
+
+            // unpack and shuffle work within 128 bit halves, so this transposes instances 0-3 and 4-7 separately
+            __m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+            __m256 t1 = _mm256_unpacklo_ps(rows[2], rows[3]);
+            __m256 t2 = _mm256_unpackhi_ps(rows[0], rows[1]);
+            __m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+            __m256 columns[4] =
+            {
+                _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0)),
+                _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2)),
+                _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0)),
+                _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2))
+            };
+            for (size_t lane = 0; lane < laneCount; lane++)
+            {
+                __m256 c = columns[lane & 3];
+                _mm_storeu_ps(&mvps[i + lane][column][0], lane < 4 ? _mm256_castps256_ps128(c) : _mm256_extractf128_ps(c, 1));
+            }
+        }
+    }
+    _mm256_zeroupper();
+}
+
+void multiplyTransforms(const glm::mat4x4& viewProjection, const TransformBatch& transforms, std::vector<glm::mat4x4>& mvps)
+{
+    mvps.resize(transforms.count);
+    switch (s_simdLevel)
+    {
+    case SimdLevel::Avx:
+        multiplyTransformsAvx(viewProjection, transforms, mvps.data());
+        break;
+    case SimdLevel::Sse:
+        multiplyTransformsSse(viewProjection, transforms, mvps.data());
+        break;
+    default:
+        for (size_t i = 0; i < transforms.count; i++)
+        {
+            mvps[i] = viewProjection * transforms.get(i);
+        }
+        break;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+// Arvo's method per lane, see transformAabb
+static void transformAabbsSse(const TransformBatch& transforms, const AabbBatch& localBoxes, AabbBatch& worldBoxes)
+{
+    const std::vector<float>* localMin[3] = { &localBoxes.minX, &localBoxes.minY, &localBoxes.minZ };
+    const std::vector<float>* localMax[3] = { &localBoxes.maxX, &localBoxes.maxY, &localBoxes.maxZ };
+    std::vector<float>* worldMin[3] = { &worldBoxes.minX, &worldBoxes.minY, &worldBoxes.minZ };
+    std::vector<float>* worldMax[3] = { &worldBoxes.maxX, &worldBoxes.maxY, &worldBoxes.maxZ };
+
+    for (size_t i = 0; i < transforms.count; i += 4)
+    {
+        __m128 lo[3], hi[3];
+        for (int c = 0; c < 3; c++)
+        {
+            lo[c] = _mm_loadu_ps(&(*localMin[c])[i]);
+            hi[c] = _mm_loadu_ps(&(*localMax[c])[i]);
+        }
+        for (int row = 0; row < 3; row++)
+        {
+            __m128 resultMin = _mm_loadu_ps(&transforms.elements[9 + row][i]);
+            __m128 resultMax = resultMin;
+            for (int column = 0; column < 3; column++)
+            {
+                __m128 e = _mm_loadu_ps(&transforms.elements[column * 3 + row][i]);
+                __m128 a = _mm_mul_ps(e, lo[column]);
+                __m128 b = _mm_mul_ps(e, hi[column]);
+                resultMin = _mm_add_ps(resultMin, _mm_min_ps(a, b));
+                resultMax = _mm_add_ps(resultMax, _mm_max_ps(a, b));
+            }
+            _mm_storeu_ps(&(*worldMin[row])[i], resultMin);
+            _mm_storeu_ps(&(*worldMax[row])[i], resultMax);
+        }
+    }
+}
+
+AVX_FUNCTION static void transformAabbsAvx(const TransformBatch& transforms, const AabbBatch& localBoxes, AabbBatch& worldBoxes)
+{
+    const std::vector<float>* localMin[3] = { &localBoxes.minX, &localBoxes.minY, &localBoxes.minZ };
+    const std::vector<float>* localMax[3] = { &localBoxes.maxX, &localBoxes.maxY, &localBoxes.maxZ };
+    std::vector<float>* worldMin[3] = { &worldBoxes.minX, &worldBoxes.minY, &worldBoxes.minZ };
+    std::vector<float>* worldMax[3] = { &worldBoxes.maxX, &worldBoxes.maxY, &worldBoxes.maxZ };
+
+    for (size_t i = 0; i < transforms.count; i += 8)
+    {
+        __m256 lo[3], hi[3];
+        for (int c = 0; c < 3; c++)
+        {
+            lo[c] = _mm256_loadu_ps(&(*localMin[c])[i]);
+            hi[c] = _mm256_loadu_ps(&(*localMax[c])[i]);
+        }
+        for (int row = 0; row < 3; row++)
+        {
+            __m256 resultMin = _mm256_loadu_ps(&transforms.elements[9 + row][i]);
+            __m256 resultMax = resultMin;
+            for (int column = 0; column < 3; column++)
+            {
+                __m256 e = _mm256_loadu_ps(&transforms.elements[column * 3 + row][i]);
+                __m256 a = _mm256_mul_ps(e, lo[column]);
+                __m256 b = _mm256_mul_ps(e, hi[column]);
+                resultMin = _mm256_add_ps(resultMin, _mm256_min_ps(a, b));
+                resultMax = _mm256_add_ps(resultMax, _mm256_max_ps(a, b));
+            }
+            _mm256_storeu_ps(&(*worldMin[row])[i], resultMin);
+            _mm256_storeu_ps(&(*worldMax[row])[i], resultMax);
+        }
+    }
+    _mm256_zeroupper();
+}
+
+void transformAabbs(const TransformBatch& transforms, const AabbBatch& localBoxes, AabbBatch& worldBoxes)
+{
+    assert(transforms.count == localBoxes.count && &localBoxes != &worldBoxes);
+    worldBoxes.resize(transforms.count);
+    switch (s_simdLevel)
+    {
+    case SimdLevel::Avx:
+        transformAabbsAvx(transforms, localBoxes, worldBoxes);
+        break;
+    case SimdLevel::Sse:
+        transformAabbsSse(transforms, localBoxes, worldBoxes);
+        break;
+    default:
+        for (size_t i = 0; i < transforms.count; i++)
+        {
+            worldBoxes.set(i, transformAabb(localBoxes.get(i), transforms.get(i)));
+        }
+        break;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+// The corner furthest along a plane normal comes from the same arrays for all lanes
+struct BatchPlane
+{
+    float           normal[3];
+    float           distance;
+    const float*    corner[3];
+};
+
+static void getBatchPlanes(const Frustum& frustum, const AabbBatch& boxes, BatchPlane planes[6])
+{
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4& plane = frustum.planes[p];
+        planes[p] = { { plane.x, plane.y, plane.z }, plane.w,
+                      { plane.x >= 0.0f ? boxes.maxX.data() : boxes.minX.data(), plane.y >= 0.0f ? boxes.maxY.data() : boxes.minY.data(),
+                        plane.z >= 0.0f ? boxes.maxZ.data() : boxes.minZ.data() } };
+    }
+}
+
+static void appendLanes(int mask, size_t first, size_t count, std::vector<uint32>& visible)
+{
+    for (size_t lane = 0; mask != 0 && first + lane < count; lane++, mask >>= 1)
+    {
+        if (mask & 1)
+        {
+            visible.push_back(uint32(first + lane));
+        }
+    }
+}
+
+static void cullAabbsSse(const BatchPlane planes[6], size_t count, std::vector<uint32>& visible)
+{
+    for (size_t i = 0; i < count; i += 4)
+    {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++)
+        {
+            const BatchPlane& plane = planes[p];
+            __m128 d = _mm_set1_ps(plane.distance);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.normal[axis]), _mm_loadu_ps(plane.corner[axis] + i)));
+            }
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+        }
+        appendLanes(_mm_movemask_ps(inside), i, count, visible);
+    }
+}
+
+AVX_FUNCTION static void cullAabbsAvx(const BatchPlane planes[6], size_t count, std::vector<uint32>& visible)
+{
+    for (size_t i = 0; i < count; i += 8)
+    {
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++)
+        {
+            const BatchPlane& plane = planes[p];
+            __m256 d = _mm256_set1_ps(plane.distance);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(plane.normal[axis]), _mm256_loadu_ps(plane.corner[axis] + i)));
+            }
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        appendLanes(_mm256_movemask_ps(inside), i, count, visible);
+    }
+    _mm256_zeroupper();
+}
+
+void cullAabbs(const Frustum& frustum, const AabbBatch& boxes, std::vector<uint32>& visible)
+{
+    BatchPlane planes[6];
+    getBatchPlanes(frustum, boxes, planes);
+    switch (s_simdLevel)
+    {
+    case SimdLevel::Avx:
+        cullAabbsAvx(planes, boxes.count, visible);
+        break;
+    case SimdLevel::Sse:
+        cullAabbsSse(planes, boxes.count, visible);
+        break;
+    default:
+        for (size_t i = 0; i < boxes.count; i++)
+        {
+            if (frustum.intersectsAabb(boxes.get(i)))
+            {
+                visible.push_back(uint32(i));
+            }
+        }
+        break;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+void printBatchMathBenchmark(std::ostream& os, size_t count)
+{
+    std::mt19937 rng(1);
+    auto random = [&](float a, float b) { return a + (b - a) * float(rng() >> 8) * (1.0f / 16777216.0f); };
+
+    TransformBatch transforms;
+    AabbBatch localBoxes;
+    transforms.resize(count);
+    localBoxes.resize(count);
+    float halfSide = 3.0f * std::cbrt(float(count));
+    for (size_t i = 0; i < count; i++)
+    {
+        glm::vec3 position(random(-halfSide, halfSide), random(-halfSide, halfSide), random(-halfSide, halfSide));
+        glm::vec3 axis = glm::normalize(glm::vec3(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(0.1f, 1.0f)));
+        transforms.set(i, glm::scale(glm::rotate(glm::translate(glm::mat4x4(1.0f), position), random(0.0f, 6.3f), axis), glm::vec3(random(0.5f, 1.5f))));
+        localBoxes.set(i, Aabb{ glm::vec3(-1.0f), glm::vec3(1.0f) });
+    }
+    glm::mat4x4 viewProjection = vk::su::createProjectionClipMatrix(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 4.0f * halfSide) *
+                                 glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.25f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+    // best of several runs, the first one may still fault in memory
+    const int RunCount = 5;
+    auto measure = [&](const std::function<void()>& func)
+    {
+        double best = DBL_MAX;
+        for (int run = 0; run < RunCount; run++)
+        {
+            Timer timer;
+            func();
+            best = std::min(best, timer.getElapsedMilliseconds());
+        }
+        return best;
+    };
+
+    const char* names[] = { "scalar", "SSE", "AVX" };
+    const SimdLevel previousLevel = getSimdLevel();
+    std::vector<glm::mat4x4> mvps;
+    AabbBatch worldBoxes;
+    std::vector<uint32> visible;
+    double scalarMilliseconds[3] = {};
+
+    os << std::fixed << std::setprecision(3) << count << " instances\n";
+    for (int level = 0; level <= int(getSupportedSimdLevel()); level++)
+    {
+        setSimdLevel(SimdLevel(level));
+        double milliseconds[3] =
+        {
+            measure([&]() { multiplyTransforms(viewProjection, transforms, mvps); }),
+            measure([&]() { transformAabbs(transforms, localBoxes, worldBoxes); }),
+            measure([&]() { visible.clear(); cullAabbs(frustum, worldBoxes, visible); })
+        };
+        if (level == 0)
+        {
+            std::copy(milliseconds, milliseconds + 3, scalarMilliseconds);
+        }
+        os << names[level] << ": multiply " << milliseconds[0] << " ms (" << scalarMilliseconds[0] / milliseconds[0] << "x), bounds "
+           << milliseconds[1] << " ms (" << scalarMilliseconds[1] / milliseconds[1] << "x), cull " << milliseconds[2] << " ms ("
+           << scalarMilliseconds[2] / milliseconds[2] << "x), " << visible.size() << " visible\n";
+    }
+    os << std::defaultfloat;
+    setSimdLevel(previousLevel);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Ray.h"
+#include <iosfwd>
+
+// Instruction sets the batch functions pick from, the best one the CPU supports unless lowered with setSimdLevel
+enum class SimdLevel
+{
+    Scalar,     // glm, one element at a time
+    Sse,        // 4 lanes, always there on x64
+    Avx,        // 8 lanes
+};
+
+SimdLevel getSupportedSimdLevel();
+SimdLevel getSimdLevel();
+// For comparisons, levels above the supported one are clamped
+void setSimdLevel(SimdLevel level);
+
+// Elements per batch step at the widest level, the arrays below are padded to a multiple of it
+const size_t BatchWidth = 8;
+
+// Boxes in structure of arrays layout, the padding holds empty boxes
+struct AabbBatch
+{
+    std::vector<float>  minX, minY, minZ;
+    std::vector<float>  maxX, maxY, maxZ;
+    size_t              count = 0;
+
+    void resize(size_t newCount);
+    void set(size_t i, const Aabb& box);
+    Aabb get(size_t i) const;
+};
+
+// Affine transforms in structure of arrays layout: the upper three rows of each matrix, element (column c, row r)
+// of all matrices in elements[c * 3 + r]. The padding holds identities.
+struct TransformBatch
+{
+    std::vector<float>  elements[12];
+    size_t              count = 0;
+
+    void resize(size_t newCount);
+    void set(size_t i, const glm::mat4x4& transform);
+    glm::mat4x4 get(size_t i) const;
+};
+
+// mvps[i] = viewProjection * transforms[i], the view projection is computed once per frame by the caller
+void multiplyTransforms(const glm::mat4x4& viewProjection, const TransformBatch& transforms, std::vector<glm::mat4x4>& mvps);
+
+// World space bounds of localBoxes[i] under transforms[i], the same as transformAabb
+void transformAabbs(const TransformBatch& transforms, const AabbBatch& localBoxes, AabbBatch& worldBoxes);
+
+// Appends the indices of the boxes that intersect the frustum to visible, the same test as Frustum::intersectsAabb
+void cullAabbs(const Frustum& frustum, const AabbBatch& boxes, std::vector<uint32>& visible);
+
+// Times the batch functions at every supported level against the scalar glm path for count random instances
+void printBatchMathBenchmark(std::ostream& os, size_t count);
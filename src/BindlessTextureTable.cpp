@@ -0,0 +1,272 @@
+#include "BindlessTextureTable.h"
+#include "GraphicsObjects.h"
+#include "Profiling.h"
+#include "geometries.hpp"
+#include "math.hpp"
+#include "shaders.hpp"
+#include "utils.hpp"
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+
+static const uint32 BindlessBenchmarkFrames = 64;
+static const vk::Extent2D BindlessRenderExtent = { 1280, 720 };
+
+bool BindlessTextureTable::isSupported(const Device& device)
+{
+    const vk::PhysicalDeviceDescriptorIndexingFeaturesEXT& features = device.getDescriptorIndexingFeatures();
+    return features.shaderSampledImageArrayNonUniformIndexing && features.descriptorBindingSampledImageUpdateAfterBind &&
+           features.descriptorBindingUpdateUnusedWhilePending && features.descriptorBindingPartiallyBound &&
+           features.descriptorBindingVariableDescriptorCount && features.runtimeDescriptorArray;
+}
+
+BindlessTextureTable::BindlessTextureTable(const Device& device, uint32 capacity, uint32 framesInFlight, vk::ShaderStageFlags stages)
+    : m_device(device)
+    , m_slotCount(0)
+    , m_highWater(0)
+    , m_removedSlots(framesInFlight)
+    , m_frameIndex(0)
+{
+    assert(isSupported(device) && 0 < capacity && 0 < framesInFlight);
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+
+    vk::PhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties;
+    vk::PhysicalDeviceProperties2 properties2;
+    properties2.pNext = &indexingProperties;
+    device.getPhysicalDevice().getProperties2(&properties2);
+    // every slot holds a combined image sampler, so the sampler limits bound the table too
+    m_capacity = std::min({ capacity, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+                            indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                            indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+                            indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers });
+
+    // the layout's count is an upper bound, the set gets its actual size when it is allocated
+    vk::DescriptorSetLayoutBinding binding(0, vk::DescriptorType::eCombinedImageSampler, m_capacity, stages);
+    vk::DescriptorBindingFlagsEXT bindingFlags = vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind | vk::DescriptorBindingFlagBitsEXT::eUpdateUnusedWhilePending |
+                                                 vk::DescriptorBindingFlagBitsEXT::ePartiallyBound | vk::DescriptorBindingFlagBitsEXT::eVariableDescriptorCount;
+    vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsCreateInfo(1, &bindingFlags);
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPoolEXT, 1, &binding);
+    layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+    m_descriptorSetLayout = vkDevice->createDescriptorSetLayoutUnique(layoutCreateInfo);
+
+    vk::DescriptorPoolSize poolSize(vk::DescriptorType::eCombinedImageSampler, m_capacity);
+    m_descriptorPool = vkDevice->createDescriptorPoolUnique(vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBindEXT, 1, 1, &poolSize));
+
+    vk::DescriptorSetVariableDescriptorCountAllocateInfoEXT variableCountInfo(1, &m_capacity);
+    vk::DescriptorSetAllocateInfo allocateInfo(m_descriptorPool.get(), 1, &m_descriptorSetLayout.get());
+    allocateInfo.pNext = &variableCountInfo;
+    // the pointer overload reports a failed allocation instead of throwing
+    vk::Result result = vkDevice->allocateDescriptorSets(&allocateInfo, &m_descriptorSet);
+    assert(result == vk::Result::eSuccess);
+    if (result != vk::Result::eSuccess)
+    {
+        // without a set no slot can be handed out, add() then reports a full table
+        m_descriptorSet = nullptr;
+        m_capacity = 0;
+    }
+}
+
+BindlessTextureTable::~BindlessTextureTable()
+{
+
+}
+
+void BindlessTextureTable::beginFrame()
+{
+    m_frameIndex = (m_frameIndex + 1) % m_removedSlots.size();
+
+    std::vector<uint32>& removedSlots = m_removedSlots[m_frameIndex];
+    m_freeSlots.insert(m_freeSlots.end(), removedSlots.begin(), removedSlots.end());
+    removedSlots.clear();
+}
+
+uint32 BindlessTextureTable::add(vk::ImageView imageView, vk::Sampler sampler, vk::ImageLayout layout)
+{
+    // recycled slots before the ones never used keep the array dense
+    uint32 slot;
+    if (!m_freeSlots.empty())
+    {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else if (m_highWater < m_capacity)
+    {
+        slot = m_highWater++;
+    }
+    else
+    {
+        return InvalidSlot;
+    }
+
+    vk::DescriptorImageInfo imageInfo(sampler, imageView, layout);
+    m_device.getVKDevice()->updateDescriptorSets(vk::WriteDescriptorSet(m_descriptorSet, 0, slot, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfo), nullptr);
+    m_slotCount++;
+    return slot;
+}
+
+void BindlessTextureTable::remove(uint32 slot)
+{
+    assert(slot < m_highWater && 0 < m_slotCount);
+
+    // the descriptor is left as it is, partially bound means nothing checks it once no shader reads it anymore
+    m_removedSlots[m_frameIndex].push_back(slot);
+    m_slotCount--;
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+void printBindlessBenchmark(std::ostream& os, const Device& device, uint32 materialCount)
+{
+    if (!BindlessTextureTable::isSupported(device))
+    {
+        os << "the device lacks the descriptor indexing features of BindlessTextureTable\n";
+        return;
+    }
+
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+    vk::UniqueCommandPool commandPool = vkDevice->createCommandPoolUnique(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, device.getGraphicsQueueFamilyIndex()));
+    vk::UniqueCommandBuffer commandBuffer = std::move(vkDevice->allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo(commandPool.get(), vk::CommandBufferLevel::ePrimary, 1)).front());
+
+    BindlessTextureTable table(device, materialCount, 1, vk::ShaderStageFlagBits::eFragment);
+    materialCount = std::min(materialCount, table.getCapacity());
+    if (!materialCount)
+    {
+        os << "the table has no room for any material\n";
+        return;
+    }
+
+    // small checkerboards in a different color each, copied from one staging buffer
+    vk::Extent2D textureExtent(64, 64);
+    size_t textureSize = size_t(textureExtent.width) * textureExtent.height * 4;
+    std::vector<uint8_t> pixels(textureSize * materialCount);
+    std::vector<std::unique_ptr<Image>> textures;
+    for (uint32 i = 0; i < materialCount; i++)
+    {
+        std::array<uint8_t, 3> color = { uint8_t(i * 37), uint8_t(i * 101), uint8_t(i * 173) };
+        vk::su::CheckerboardImageGenerator generator(color);
+        generator(pixels.data() + i * textureSize, textureExtent);
+        textures.push_back(std::make_unique<Image>(device, vk::Format::eR8G8B8A8Unorm, textureExtent, vk::ImageTiling::eOptimal,
+                                                   vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, vk::ImageLayout::eUndefined,
+                                                   vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor));
+    }
+    Buffer stagingBuffer(device, pixels.size(), vk::BufferUsageFlagBits::eTransferSrc);
+    stagingBuffer.upload(pixels.data(), pixels.size(), 0);
+    vk::su::oneTimeSubmit(commandBuffer, device.getGraphicsQueue(), [&](const vk::UniqueCommandBuffer& commandBuffer)
+    {
+        for (uint32 i = 0; i < materialCount; i++)
+        {
+            vk::Image image = textures[i]->getVKImage().get();
+            vk::su::setImageLayout(commandBuffer, image, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+            vk::BufferImageCopy copyRegion(i * textureSize, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0),
+                                           vk::Extent3D(textureExtent, 1));
+            commandBuffer->copyBufferToImage(stagingBuffer.getVKBuffer().get(), image, vk::ImageLayout::eTransferDstOptimal, copyRegion);
+            vk::su::setImageLayout(commandBuffer, image, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+        }
+    });
+    vk::UniqueSampler sampler = vkDevice->createSamplerUnique(vk::SamplerCreateInfo(vk::SamplerCreateFlags(), vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eNearest,
+                                                                                    vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat));
+    for (uint32 i = 0; i < materialCount; i++)
+    {
+        // a fresh table hands out its slots in order, so material i is at slot i as the vertex shader assumes
+        uint32 slot = table.add(textures[i]->getImageView().get(), sampler.get());
+        assert(slot == i);
+    }
+
+    OffscreenTarget target(device, BindlessRenderExtent);
+    Buffer vertexBuffer(device, sizeof(texturedCubeData), vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    vertexBuffer.upload(commandPool, device.getGraphicsQueue(), texturedCubeData, sizeof(texturedCubeData));
+
+    // the grid is 3 units per cell, scaled to fill about the view of createViewProjectionClipMatrix
+    uint32 gridSize = uint32(std::ceil(std::sqrt(double(materialCount))));
+    Buffer uniformBuffer(device, sizeof(glm::mat4x4), vk::BufferUsageFlagBits::eUniformBuffer);
+    uniformBuffer.upload(vk::su::createViewProjectionClipMatrix(BindlessRenderExtent) * glm::scale(glm::mat4x4(1.0f), glm::vec3(4.0f / (3.0f * gridSize))));
+
+    // per material sets: the uniform buffer and the material's texture, for fragmentShaderText_T_C
+    vk::UniqueDescriptorSetLayout boundSetLayout = vk::su::createDescriptorSetLayout(vkDevice, { { vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex },
+                                                                                                 { vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment } });
+    vk::UniqueDescriptorPool descriptorPool = vk::su::createDescriptorPool(vkDevice, { { vk::DescriptorType::eUniformBuffer, materialCount + 1 },
+                                                                                      { vk::DescriptorType::eCombinedImageSampler, materialCount } });
+    std::vector<vk::DescriptorSetLayout> setLayouts(materialCount, boundSetLayout.get());
+    std::vector<vk::UniqueDescriptorSet> boundSets = vkDevice->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(descriptorPool.get(), materialCount, setLayouts.data()));
+    vk::DescriptorBufferInfo bufferInfo(uniformBuffer.getVKBuffer().get(), 0, VK_WHOLE_SIZE);
+    for (uint32 i = 0; i < materialCount; i++)
+    {
+        vk::DescriptorImageInfo imageInfo(sampler.get(), textures[i]->getImageView().get(), vk::ImageLayout::eShaderReadOnlyOptimal);
+        vkDevice->updateDescriptorSets({ vk::WriteDescriptorSet(boundSets[i].get(), 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &bufferInfo),
+                                         vk::WriteDescriptorSet(boundSets[i].get(), 1, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfo) }, nullptr);
+    }
+
+    // bindless: set 0 holds the uniform buffer alone, set 1 is the table
+    vk::UniqueDescriptorSetLayout uniformSetLayout = vk::su::createDescriptorSetLayout(vkDevice, { { vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex } });
+    vk::UniqueDescriptorSet uniformSet = std::move(vkDevice->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(descriptorPool.get(), 1, &uniformSetLayout.get())).front());
+    vkDevice->updateDescriptorSets(vk::WriteDescriptorSet(uniformSet.get(), 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &bufferInfo), nullptr);
+
+    vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eVertex, 0, sizeof(uint32));
+    vk::UniquePipelineLayout boundPipelineLayout = vkDevice->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo({}, 1, &boundSetLayout.get(), 1, &pushConstantRange));
+    vk::DescriptorSetLayout bindlessSetLayouts[2] = { uniformSetLayout.get(), table.getDescriptorSetLayout().get() };
+    vk::UniquePipelineLayout bindlessPipelineLayout = vkDevice->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo({}, 2, bindlessSetLayouts, 1, &pushConstantRange));
+
+    vk::UniqueShaderModule vertexShaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eVertex, vertexShaderText_PT_T_Material);
+    vk::UniqueShaderModule boundShaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eFragment, fragmentShaderText_T_C);
+    vk::UniqueShaderModule bindlessShaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eFragment, fragmentShaderText_T_C_Bindless);
+    vk::UniquePipelineCache pipelineCache = vkDevice->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+    std::vector<std::pair<vk::Format, uint32_t>> attributes = { { vk::Format::eR32G32B32A32Sfloat, 0 }, { vk::Format::eR32G32Sfloat, 16 } };
+    vk::UniquePipeline boundPipeline = vk::su::createGraphicsPipeline(vkDevice, pipelineCache, std::make_pair(*vertexShaderModule, nullptr), std::make_pair(*boundShaderModule, nullptr),
+                                                                      sizeof(VertexPT), attributes, vk::FrontFace::eClockwise, true, boundPipelineLayout, target.getRenderPass());
+    vk::UniquePipeline bindlessPipeline = vk::su::createGraphicsPipeline(vkDevice, pipelineCache, std::make_pair(*vertexShaderModule, nullptr), std::make_pair(*bindlessShaderModule, nullptr),
+                                                                         sizeof(VertexPT), attributes, vk::FrontFace::eClockwise, true, bindlessPipelineLayout, target.getRenderPass());
+
+    // scope 0 binds a set per material, scope 1 draws all of them at once
+    const uint32 cubeVertexCount = uint32(sizeof(texturedCubeData) / sizeof(texturedCubeData[0]));
+    GpuTimer drawTimer(device, 2);
+    double recordMilliseconds[2] = { 0.0, 0.0 };
+    double drawMilliseconds[2] = { 0.0, 0.0 };
+    for (uint32 frame = 0; frame < BindlessBenchmarkFrames; frame++)
+    {
+        table.beginFrame();
+        commandBuffer->begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        drawTimer.reset(commandBuffer);
+        for (uint32 bindless = 0; bindless < 2; bindless++)
+        {
+            Timer timer;
+            drawTimer.begin(commandBuffer, bindless);
+            target.beginRenderPass(commandBuffer);
+            commandBuffer->bindVertexBuffers(0, vertexBuffer.getVKBuffer().get(), { 0 });
+            if (bindless)
+            {
+                commandBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, bindlessPipeline.get());
+                commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, bindlessPipelineLayout.get(), 0, { uniformSet.get(), table.getDescriptorSet() }, nullptr);
+                commandBuffer->pushConstants(bindlessPipelineLayout.get(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(uint32), &gridSize);
+                commandBuffer->draw(cubeVertexCount, materialCount, 0, 0);
+            }
+            else
+            {
+                commandBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, boundPipeline.get());
+                commandBuffer->pushConstants(boundPipelineLayout.get(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(uint32), &gridSize);
+                for (uint32 i = 0; i < materialCount; i++)
+                {
+                    commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, boundPipelineLayout.get(), 0, boundSets[i].get(), nullptr);
+                    commandBuffer->draw(cubeVertexCount, 1, 0, i);
+                }
+            }
+            commandBuffer->endRenderPass();
+            drawTimer.end(commandBuffer, bindless);
+            recordMilliseconds[bindless] += timer.getElapsedMilliseconds();
+        }
+        commandBuffer->end();
+        device.getGraphicsQueue().submit(vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer.get()), nullptr);
+        device.getGraphicsQueue().waitIdle();
+
+        double milliseconds = 0.0;
+        for (uint32 bindless = 0; bindless < 2; bindless++)
+        {
+            drawTimer.getMilliseconds(bindless, milliseconds);
+            drawMilliseconds[bindless] += milliseconds;
+        }
+    }
+
+    os << std::fixed << std::setprecision(3) << materialCount << " materials\n"
+       << "set per material: record " << recordMilliseconds[0] / BindlessBenchmarkFrames << " ms CPU, draw " << drawMilliseconds[0] / BindlessBenchmarkFrames << " ms GPU\n"
+       << "bindless: record " << recordMilliseconds[1] / BindlessBenchmarkFrames << " ms CPU, draw " << drawMilliseconds[1] / BindlessBenchmarkFrames << " ms GPU\n"
+       << std::defaultfloat;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Common.h"
+#include <vulkan/vulkan.hpp>
+#include <iosfwd>
+
+class Device;
+
+// One descriptor set holding a runtime sized array of combined image samplers at binding 0, which shaders index by
+// material ID (see fragmentShaderText_T_C_Bindless), so draws with different materials share a single bind and ray
+// tracing shaders can look up any material's textures.
+//
+// Slots are written while command buffers using other slots are pending (update after bind), slots never written stay
+// unbound (partially bound) and the set holds just the capacity asked for (variable descriptor count). A slot that was
+// removed can still be read by the frames in flight, so it is only handed out again once beginFrame() came round to
+// the same frame in flight.
+class BindlessTextureTable
+{
+public:
+    static const uint32 InvalidSlot = ~0u;
+
+    // Whether the device was created with the descriptor indexing features the table needs
+    static bool isSupported(const Device& device);
+
+    // capacity is clamped to the update after bind image and sampler limits of the device
+    BindlessTextureTable(const Device& device, uint32 capacity, uint32 framesInFlight,
+                         vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute);
+    ~BindlessTextureTable();
+
+    BindlessTextureTable(const BindlessTextureTable&) = delete;
+    BindlessTextureTable& operator=(const BindlessTextureTable&) = delete;
+
+    const vk::UniqueDescriptorSetLayout& getDescriptorSetLayout() const { return m_descriptorSetLayout; }
+    vk::DescriptorSet getDescriptorSet() const { return m_descriptorSet; }
+    uint32 getCapacity() const { return m_capacity; }
+    uint32 getSlotCount() const { return m_slotCount; }
+
+    // Once per frame, after waiting for the fence of the frame framesInFlight frames back. Returns the slots that
+    // frame was the last to use to the free list.
+    void beginFrame();
+
+    // Returns the slot shaders find the texture at, or InvalidSlot when the table is full. Slots cannot be written
+    // again while in use: to replace a texture, add the new one and remove the old slot.
+    uint32 add(vk::ImageView imageView, vk::Sampler sampler, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+    void remove(uint32 slot);
+
+private:
+    const Device&                       m_device;
+    uint32                              m_capacity;
+    vk::UniqueDescriptorSetLayout       m_descriptorSetLayout;
+    vk::UniqueDescriptorPool            m_descriptorPool;
+    vk::DescriptorSet                   m_descriptorSet;        // freed with the pool
+
+    uint32                              m_slotCount;
+    uint32                              m_highWater;            // slots above were never handed out
+    std::vector<uint32>                 m_freeSlots;
+    std::vector<std::vector<uint32>>    m_removedSlots;         // per frame in flight
+    uint32                              m_frameIndex;
+};
+
+// Draws a grid of materialCount cubes with a texture each, once binding a descriptor set per material and once as a
+// single instanced draw reading the materials from a BindlessTextureTable, and prints the CPU recording and GPU times
+void printBindlessBenchmark(std::ostream& os, const Device& device, uint32 materialCount);
@@ -0,0 +1,694 @@
+#include "Bvh.h"
+#include "ThreadPool.h"
+#include <numeric>
+
+struct BvhBin
+{
+    Aabb    bounds;
+    uint32  count = 0;
+};
+
+struct BvhReference
+{
+    Aabb    bounds;         // clipped to the node for references created by spatial splits
+    uint32  primitiveIndex;
+};
+
+struct SpatialBin
+{
+    Aabb    bounds;
+    uint32  entries = 0;    // references starting in this bin
+    uint32  exits = 0;      // references ending in this bin
+};
+
+// SBVH builder. Every node evaluates binned object splits like Bvh::subdivide and, where the resulting children
+// overlap, binned spatial splits which clip the references straddling the plane into both children. The top of the
+// tree is built serially until nodes fall below parallelSubtreeSize references, those subtrees are then built in
+// parallel into their own arrays and appended.
+class SpatialSplitBuilder
+{
+public:
+    SpatialSplitBuilder(const std::vector<Aabb>& primitiveBounds, const SplitPrimitiveFunc& splitPrimitive, const BvhBuildSettings& settings);
+
+    void build(std::vector<BvhNode>& nodes, std::vector<uint32>& primitiveIndices);
+
+private:
+    struct Subtree
+    {
+        std::vector<BvhReference>   references;
+        Aabb                        bounds;
+        uint32                      nodeIndex;      // placeholder node in the top of the tree
+        uint32                      depth;
+        uint64                      referenceBudget;
+        std::vector<BvhNode>        nodes;
+        std::vector<uint32>         primitiveIndices;
+    };
+
+    struct ObjectSplit
+    {
+        float   cost = FLT_MAX;
+        int     axis = -1;
+        uint32  bin = 0;
+        Aabb    centroidBounds;
+        Aabb    leftBounds;
+        Aabb    rightBounds;
+    };
+
+    struct SpatialSplit
+    {
+        float   cost = FLT_MAX;
+        int     axis = -1;
+        float   position = 0.0f;
+        Aabb    leftBounds;
+        Aabb    rightBounds;
+        uint32  leftCount = 0;
+        uint32  rightCount = 0;
+    };
+
+    // builds nodes[nodeIndex] and everything below, or queues it to deferred once it is small enough. referenceBudget
+    // counts the duplicates spatial splits may still create in this part of the tree.
+    void buildNode(std::vector<BvhReference>& references, const Aabb& bounds, uint32 nodeIndex, uint32 depth, uint64& referenceBudget,
+                   std::vector<BvhNode>& nodes, std::vector<uint32>& primitiveIndices, std::vector<Subtree>* deferred);
+
+    // distributes references to left and right, false if the node should become a leaf
+    bool split(const std::vector<BvhReference>& references, const Aabb& bounds, uint32 depth, uint64& referenceBudget, std::vector<BvhReference>& left,
+               std::vector<BvhReference>& right, uint32& axis);
+
+    ObjectSplit findObjectSplit(const std::vector<BvhReference>& references) const;
+    SpatialSplit findSpatialSplit(const std::vector<BvhReference>& references, const Aabb& bounds) const;
+    void performObjectSplit(const std::vector<BvhReference>& references, const ObjectSplit& objectSplit, std::vector<BvhReference>& left,
+                            std::vector<BvhReference>& right) const;
+    void performSpatialSplit(const std::vector<BvhReference>& references, const SpatialSplit& spatialSplit, std::vector<BvhReference>& left,
+                             std::vector<BvhReference>& right) const;
+    void splitReference(const BvhReference& reference, uint32 axis, float position, BvhReference& left, BvhReference& right) const;
+
+    const std::vector<Aabb>&    m_primitiveBounds;
+    const SplitPrimitiveFunc&   m_splitPrimitive;
+    BvhBuildSettings            m_settings;
+    float                       m_rootArea;
+};
+
+SpatialSplitBuilder::SpatialSplitBuilder(const std::vector<Aabb>& primitiveBounds, const SplitPrimitiveFunc& splitPrimitive, const BvhBuildSettings& settings)
+    : m_primitiveBounds(primitiveBounds)
+    , m_splitPrimitive(splitPrimitive)
+    , m_settings(settings)
+    , m_rootArea(FLT_MIN)
+{
+}
+
+void SpatialSplitBuilder::build(std::vector<BvhNode>& nodes, std::vector<uint32>& primitiveIndices)
+{
+    std::vector<BvhReference> references(m_primitiveBounds.size());
+    Aabb rootBounds;
+    for (size_t i = 0; i < m_primitiveBounds.size(); i++)
+    {
+        references[i] = { m_primitiveBounds[i], uint32(i) };
+        rootBounds.grow(m_primitiveBounds[i]);
+    }
+    m_rootArea = std::max(rootBounds.getSurfaceArea(), FLT_MIN);
+
+    uint64 referenceBudget = uint64(double(references.size()) * std::max(0.0f, m_settings.referenceBudget));
+    nodes.reserve((references.size() + referenceBudget) * 2);
+    primitiveIndices.reserve(references.size() + referenceBudget);
+    nodes.push_back({ rootBounds.min, 0, rootBounds.max, 0 });
+
+    std::vector<Subtree> subtrees;
+    buildNode(references, rootBounds, 0, 1, referenceBudget, nodes, primitiveIndices, &subtrees);
+
+    // what is left of the budget is shared by reference count, which keeps the result independent of the thread timing
+    size_t deferredCount = 0;
+    for (const Subtree& subtree : subtrees)
+    {
+        deferredCount += subtree.references.size();
+    }
+    for (Subtree& subtree : subtrees)
+    {
+        subtree.referenceBudget = uint64(double(referenceBudget) * subtree.references.size() / std::max(deferredCount, size_t(1)));
+    }
+
+    // biggest first, so the pool does not end up waiting on one large subtree started last
+    std::sort(subtrees.begin(), subtrees.end(), [](const Subtree& a, const Subtree& b) { return a.references.size() > b.references.size(); });
+    ThreadPool::getInstance().parallelFor(uint32(subtrees.size()), [&](uint32 i)
+    {
+        Subtree& subtree = subtrees[i];
+        subtree.nodes.push_back({ subtree.bounds.min, 0, subtree.bounds.max, 0 });
+        buildNode(subtree.references, subtree.bounds, 0, subtree.depth, subtree.referenceBudget, subtree.nodes, subtree.primitiveIndices, nullptr);
+    });
+
+    // append the subtrees, their root replaces the placeholder and the other nodes move behind the current end
+    for (const Subtree& subtree : subtrees)
+    {
+        const uint32 nodeOffset = uint32(nodes.size()) - 1;
+        const uint32 primitiveOffset = uint32(primitiveIndices.size());
+        for (size_t k = 0; k < subtree.nodes.size(); k++)
+        {
+            BvhNode node = subtree.nodes[k];
+            node.leftFirst += node.isLeaf() ? primitiveOffset : nodeOffset;
+            if (k == 0)
+            {
+                nodes[subtree.nodeIndex] = node;
+            }
+            else
+            {
+                nodes.push_back(node);
+            }
+        }
+        primitiveIndices.insert(primitiveIndices.end(), subtree.primitiveIndices.begin(), subtree.primitiveIndices.end());
+    }
+}
+
+void SpatialSplitBuilder::buildNode(std::vector<BvhReference>& references, const Aabb& bounds, uint32 nodeIndex, uint32 depth, uint64& referenceBudget,
+                                    std::vector<BvhNode>& nodes, std::vector<uint32>& primitiveIndices, std::vector<Subtree>* deferred)
+{
+    if (deferred && references.size() < m_settings.parallelSubtreeSize)
+    {
+        Subtree subtree;
+        subtree.references = std::move(references);
+        subtree.bounds = bounds;
+        subtree.nodeIndex = nodeIndex;
+        subtree.depth = depth;
+        deferred->push_back(std::move(subtree));
+        return;
+    }
+
+    std::vector<BvhReference> left, right;
+    uint32 axis;
+    if (!split(references, bounds, depth, referenceBudget, left, right, axis))
+    {
+        nodes[nodeIndex].leftFirst = uint32(primitiveIndices.size());
+        nodes[nodeIndex].count = uint32(references.size());
+        for (const BvhReference& reference : references)
+        {
+            primitiveIndices.push_back(reference.primitiveIndex);
+        }
+        return;
+    }
+    // the children hold their own copies, release these before going deeper
+    references = std::vector<BvhReference>();
+
+    Aabb leftBounds, rightBounds;
+    for (const BvhReference& reference : left)
+    {
+        leftBounds.grow(reference.bounds);
+    }
+    for (const BvhReference& reference : right)
+    {
+        rightBounds.grow(reference.bounds);
+    }
+
+    uint32 leftIndex = uint32(nodes.size());
+    nodes.push_back({ leftBounds.min, 0, leftBounds.max, 0 });
+    nodes.push_back({ rightBounds.min, 0, rightBounds.max, 0 });
+    nodes[nodeIndex].leftFirst = leftIndex;
+    nodes[nodeIndex].count = BvhInnerNode | axis;
+
+    buildNode(left, leftBounds, leftIndex, depth + 1, referenceBudget, nodes, primitiveIndices, deferred);
+    buildNode(right, rightBounds, leftIndex + 1, depth + 1, referenceBudget, nodes, primitiveIndices, deferred);
+}
+
+bool SpatialSplitBuilder::split(const std::vector<BvhReference>& references, const Aabb& bounds, uint32 depth, uint64& referenceBudget,
+                                std::vector<BvhReference>& left, std::vector<BvhReference>& right, uint32& axis)
+{
+    const uint32 count = uint32(references.size());
+    // the traversal stack holds at most one entry per level
+    if (count <= 1 || BvhMaxDepth <= depth)
+    {
+        return false;
+    }
+
+    ObjectSplit objectSplit = findObjectSplit(references);
+
+    // spatial splits only pay off where the object split leaves the children overlapping, e.g. around long triangles
+    SpatialSplit spatialSplit;
+    bool trySpatial = objectSplit.axis < 0;
+    if (!trySpatial)
+    {
+        Aabb overlap = objectSplit.leftBounds;
+        overlap.clip(objectSplit.rightBounds);
+        trySpatial = overlap.getSurfaceArea() > m_settings.splitAlpha * m_rootArea;
+    }
+    if (trySpatial && referenceBudget != 0)
+    {
+        spatialSplit = findSpatialSplit(references, bounds);
+    }
+
+    float leafCost = m_settings.intersectionCost * count;
+    float splitCost = m_settings.traversalCost + m_settings.intersectionCost * std::min(objectSplit.cost, spatialSplit.cost) / std::max(bounds.getSurfaceArea(), FLT_MIN);
+    if ((objectSplit.axis < 0 && spatialSplit.axis < 0) || (count <= m_settings.maxLeafSize && leafCost <= splitCost))
+    {
+        return false;
+    }
+
+    // the sweep counts straddling references on both sides, so this bounds the duplicates from above
+    if (spatialSplit.cost < objectSplit.cost && spatialSplit.leftCount + spatialSplit.rightCount - count <= referenceBudget)
+    {
+        performSpatialSplit(references, spatialSplit, left, right);
+        if (!left.empty() && !right.empty())
+        {
+            referenceBudget -= std::min(referenceBudget, uint64(left.size() + right.size() - count));
+            axis = uint32(spatialSplit.axis);
+            return true;
+        }
+        left.clear();
+        right.clear();
+    }
+
+    if (objectSplit.axis < 0)
+    {
+        return false;
+    }
+    performObjectSplit(references, objectSplit, left, right);
+    axis = uint32(objectSplit.axis);
+    return true;
+}
+
+SpatialSplitBuilder::ObjectSplit SpatialSplitBuilder::findObjectSplit(const std::vector<BvhReference>& references) const
+{
+    ObjectSplit best;
+    for (const BvhReference& reference : references)
+    {
+        best.centroidBounds.grow(reference.bounds.getCenter());
+    }
+
+    const uint32 count = uint32(references.size());
+    const uint32 binCount = m_settings.binCount;
+    std::vector<BvhBin> bins(binCount);
+    std::vector<Aabb> rightBounds(binCount);
+    std::vector<float> rightCosts(binCount);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = best.centroidBounds.max[axis] - best.centroidBounds.min[axis];
+        if (extent <= 0.0f)
+        {
+            continue;
+        }
+
+        std::fill(bins.begin(), bins.end(), BvhBin());
+        float scale = float(binCount) / extent;
+        for (const BvhReference& reference : references)
+        {
+            uint32 bin = std::min(binCount - 1, uint32((reference.bounds.getCenter()[axis] - best.centroidBounds.min[axis]) * scale));
+            bins[bin].count++;
+            bins[bin].bounds.grow(reference.bounds);
+        }
+
+        Aabb sweepBounds;
+        uint32 rightCount = 0;
+        for (uint32 b = binCount - 1; b > 0; b--)
+        {
+            sweepBounds.grow(bins[b].bounds);
+            rightCount += bins[b].count;
+            rightBounds[b] = sweepBounds;
+            rightCosts[b] = sweepBounds.getSurfaceArea() * rightCount;
+        }
+
+        Aabb leftBounds;
+        uint32 leftCount = 0;
+        for (uint32 b = 0; b < binCount - 1; b++)
+        {
+            leftBounds.grow(bins[b].bounds);
+            leftCount += bins[b].count;
+            float cost = leftBounds.getSurfaceArea() * leftCount + rightCosts[b + 1];
+            if (leftCount != 0 && leftCount != count && cost < best.cost)
+            {
+                best.cost = cost;
+                best.axis = axis;
+                best.bin = b + 1;
+                best.leftBounds = leftBounds;
+                best.rightBounds = rightBounds[b + 1];
+            }
+        }
+    }
+    return best;
+}
+
+SpatialSplitBuilder::SpatialSplit SpatialSplitBuilder::findSpatialSplit(const std::vector<BvhReference>& references, const Aabb& bounds) const
+{
+    SpatialSplit best;
+    const uint32 binCount = m_settings.binCount;
+    std::vector<SpatialBin> bins(binCount);
+    std::vector<Aabb> rightBounds(binCount);
+    std::vector<uint32> rightCounts(binCount);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        // unlike object splits the bins cover the node itself, not the centroids
+        float origin = bounds.min[axis];
+        float binWidth = (bounds.max[axis] - origin) / binCount;
+        if (binWidth <= 0.0f)
+        {
+            continue;
+        }
+
+        std::fill(bins.begin(), bins.end(), SpatialBin());
+        float scale = 1.0f / binWidth;
+        for (const BvhReference& reference : references)
+        {
+            uint32 firstBin = std::min(binCount - 1, uint32(std::max(0.0f, (reference.bounds.min[axis] - origin) * scale)));
+            uint32 lastBin = std::max(firstBin, std::min(binCount - 1, uint32(std::max(0.0f, (reference.bounds.max[axis] - origin) * scale))));
+
+            // chop the reference at every boundary it crosses, each bin gets the exact bounds of its piece
+            BvhReference remainder = reference;
+            for (uint32 b = firstBin; b < lastBin; b++)
+            {
+                BvhReference binPart, rest;
+                splitReference(remainder, uint32(axis), origin + binWidth * (b + 1), binPart, rest);
+                if (binPart.bounds.isValid())
+                {
+                    bins[b].bounds.grow(binPart.bounds);
+                }
+                remainder = rest;
+            }
+            if (remainder.bounds.isValid())
+            {
+                bins[lastBin].bounds.grow(remainder.bounds);
+            }
+            bins[firstBin].entries++;
+            bins[lastBin].exits++;
+        }
+
+        Aabb sweepBounds;
+        uint32 rightCount = 0;
+        for (uint32 b = binCount - 1; b > 0; b--)
+        {
+            sweepBounds.grow(bins[b].bounds);
+            rightCount += bins[b].exits;
+            rightBounds[b] = sweepBounds;
+            rightCounts[b] = rightCount;
+        }
+
+        Aabb leftBounds;
+        uint32 leftCount = 0;
+        for (uint32 b = 0; b < binCount - 1; b++)
+        {
+            leftBounds.grow(bins[b].bounds);
+            leftCount += bins[b].entries;
+            if (leftCount == 0 || rightCounts[b + 1] == 0)
+            {
+                continue;
+            }
+
+            float cost = leftBounds.getSurfaceArea() * leftCount + rightBounds[b + 1].getSurfaceArea() * rightCounts[b + 1];
+            if (cost < best.cost)
+            {
+                best.cost = cost;
+                best.axis = axis;
+                best.position = origin + binWidth * (b + 1);
+                best.leftBounds = leftBounds;
+                best.rightBounds = rightBounds[b + 1];
+                best.leftCount = leftCount;
+                best.rightCount = rightCounts[b + 1];
+            }
+        }
+    }
+    return best;
+}
+
+void SpatialSplitBuilder::performObjectSplit(const std::vector<BvhReference>& references, const ObjectSplit& objectSplit, std::vector<BvhReference>& left,
+                                             std::vector<BvhReference>& right) const
+{
+    const uint32 binCount = m_settings.binCount;
+    const int axis = objectSplit.axis;
+    float scale = float(binCount) / (objectSplit.centroidBounds.max[axis] - objectSplit.centroidBounds.min[axis]);
+    for (const BvhReference& reference : references)
+    {
+        uint32 bin = std::min(binCount - 1, uint32((reference.bounds.getCenter()[axis] - objectSplit.centroidBounds.min[axis]) * scale));
+        (bin < objectSplit.bin ? left : right).push_back(reference);
+    }
+}
+
+void SpatialSplitBuilder::performSpatialSplit(const std::vector<BvhReference>& references, const SpatialSplit& spatialSplit, std::vector<BvhReference>& left,
+                                              std::vector<BvhReference>& right) const
+{
+    const uint32 axis = uint32(spatialSplit.axis);
+    const float position = spatialSplit.position;
+    Aabb leftBounds = spatialSplit.leftBounds;
+    Aabb rightBounds = spatialSplit.rightBounds;
+    float leftCount = float(spatialSplit.leftCount);
+    float rightCount = float(spatialSplit.rightCount);
+    for (const BvhReference& reference : references)
+    {
+        if (reference.bounds.max[axis] <= position)
+        {
+            left.push_back(reference);
+            continue;
+        }
+        if (reference.bounds.min[axis] >= position)
+        {
+            right.push_back(reference);
+            continue;
+        }
+
+        // reference unsplitting: moving a straddling reference entirely to one side can be cheaper than duplicating it
+        Aabb leftGrown = leftBounds;
+        leftGrown.grow(reference.bounds);
+        Aabb rightGrown = rightBounds;
+        rightGrown.grow(reference.bounds);
+        float leftArea = leftBounds.getSurfaceArea();
+        float rightArea = rightBounds.getSurfaceArea();
+        float duplicateCost = leftArea * leftCount + rightArea * rightCount;
+        float leftCost = leftGrown.getSurfaceArea() * leftCount + rightArea * (rightCount - 1.0f);
+        float rightCost = leftArea * (leftCount - 1.0f) + rightGrown.getSurfaceArea() * rightCount;
+        if (leftCost < duplicateCost && leftCost <= rightCost)
+        {
+            left.push_back(reference);
+            leftBounds = leftGrown;
+            rightCount -= 1.0f;
+        }
+        else if (rightCost < duplicateCost)
+        {
+            right.push_back(reference);
+            rightBounds = rightGrown;
+            leftCount -= 1.0f;
+        }
+        else
+        {
+            BvhReference leftPart, rightPart;
+            splitReference(reference, axis, position, leftPart, rightPart);
+            if (leftPart.bounds.isValid())
+            {
+                left.push_back(leftPart);
+            }
+            if (rightPart.bounds.isValid())
+            {
+                right.push_back(rightPart);
+            }
+        }
+    }
+}
+
+void SpatialSplitBuilder::splitReference(const BvhReference& reference, uint32 axis, float position, BvhReference& left, BvhReference& right) const
+{
+    left = right = { Aabb(), reference.primitiveIndex };
+    m_splitPrimitive(reference.primitiveIndex, axis, position, left.bounds, right.bounds);
+
+    // the reference may be a piece clipped by earlier splits
+    Aabb leftClip = reference.bounds;
+    leftClip.max[axis] = std::min(leftClip.max[axis], position);
+    left.bounds.clip(leftClip);
+    Aabb rightClip = reference.bounds;
+    rightClip.min[axis] = std::max(rightClip.min[axis], position);
+    right.bounds.clip(rightClip);
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+Bvh::Bvh()
+{
+}
+
+Bvh::~Bvh()
+{
+
+}
+
+void Bvh::build(const std::vector<Aabb>& primitiveBounds, const BvhBuildSettings& settings, const SplitPrimitiveFunc& splitPrimitive)
+{
+    assert(1 < settings.binCount && 0 < settings.maxLeafSize);
+
+    m_nodes.clear();
+    if (settings.mode == BvhBuildMode::SpatialSplits)
+    {
+        assert(splitPrimitive);
+        m_primitiveIndices.clear();
+        if (!primitiveBounds.empty())
+        {
+            SpatialSplitBuilder builder(primitiveBounds, splitPrimitive, settings);
+            builder.build(m_nodes, m_primitiveIndices);
+        }
+        return;
+    }
+
+    m_primitiveIndices.resize(primitiveBounds.size());
+    std::iota(m_primitiveIndices.begin(), m_primitiveIndices.end(), 0u);
+    if (primitiveBounds.empty())
+    {
+        return;
+    }
+
+    std::vector<glm::vec3> centroids(primitiveBounds.size());
+    Aabb rootBounds;
+    for (size_t i = 0; i < primitiveBounds.size(); i++)
+    {
+        centroids[i] = primitiveBounds[i].getCenter();
+        rootBounds.grow(primitiveBounds[i]);
+    }
+
+    // a binary tree with single primitive leaves has 2n - 1 nodes
+    m_nodes.reserve(primitiveBounds.size() * 2);
+    m_nodes.push_back({ rootBounds.min, 0, rootBounds.max, uint32(primitiveBounds.size()) });
+    subdivide(0, 1, primitiveBounds, centroids, settings);
+}
+
+void Bvh::subdivide(uint32 nodeIndex, uint32 depth, const std::vector<Aabb>& primitiveBounds, const std::vector<glm::vec3>& centroids, const BvhBuildSettings& settings)
+{
+    const uint32 first = m_nodes[nodeIndex].leftFirst;
+    const uint32 count = m_nodes[nodeIndex].count;
+    // the traversal stack holds at most one entry per level
+    if (count <= 1 || BvhMaxDepth <= depth)
+    {
+        return;
+    }
+
+    Aabb centroidBounds;
+    for (uint32 i = first; i < first + count; i++)
+    {
+        centroidBounds.grow(centroids[m_primitiveIndices[i]]);
+    }
+
+    // evaluate the SAH at the bin boundaries of every axis
+    const uint32 binCount = settings.binCount;
+    std::vector<BvhBin> bins(binCount);
+    std::vector<float> rightCosts(binCount);
+
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    uint32 bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+        if (extent <= 0.0f)
+        {
+            continue;
+        }
+
+        std::fill(bins.begin(), bins.end(), BvhBin());
+        float scale = float(binCount) / extent;
+        for (uint32 i = first; i < first + count; i++)
+        {
+            uint32 primitiveIndex = m_primitiveIndices[i];
+            uint32 bin = std::min(binCount - 1, uint32((centroids[primitiveIndex][axis] - centroidBounds.min[axis]) * scale));
+            bins[bin].count++;
+            bins[bin].bounds.grow(primitiveBounds[primitiveIndex]);
+        }
+
+        // sweep from the right, then from the left combining both sides
+        Aabb rightBounds;
+        uint32 rightCount = 0;
+        for (uint32 b = binCount - 1; b > 0; b--)
+        {
+            rightBounds.grow(bins[b].bounds);
+            rightCount += bins[b].count;
+            rightCosts[b] = rightBounds.getSurfaceArea() * rightCount;
+        }
+
+        Aabb leftBounds;
+        uint32 leftCount = 0;
+        for (uint32 b = 0; b < binCount - 1; b++)
+        {
+            leftBounds.grow(bins[b].bounds);
+            leftCount += bins[b].count;
+            float cost = leftBounds.getSurfaceArea() * leftCount + rightCosts[b + 1];
+            if (leftCount != 0 && leftCount != count && cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b + 1;
+            }
+        }
+    }
+
+    // compare splitting against keeping everything in a leaf
+    float parentArea = m_nodes[nodeIndex].getBounds().getSurfaceArea();
+    float leafCost = settings.intersectionCost * count;
+    float splitCost = settings.traversalCost + settings.intersectionCost * bestCost / std::max(parentArea, FLT_MIN);
+    if (bestAxis < 0 || (count <= settings.maxLeafSize && leafCost <= splitCost))
+    {
+        return;
+    }
+
+    float scale = float(binCount) / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+    uint32* middle = std::partition(&m_primitiveIndices[first], &m_primitiveIndices[first] + count, [&](uint32 primitiveIndex)
+    {
+        uint32 bin = std::min(binCount - 1, uint32((centroids[primitiveIndex][bestAxis] - centroidBounds.min[bestAxis]) * scale));
+        return bin < bestSplit;
+    });
+    uint32 leftCount = uint32(middle - &m_primitiveIndices[first]);
+    assert(0 < leftCount && leftCount < count);
+
+    Aabb leftBounds, rightBounds;
+    for (uint32 i = first; i < first + leftCount; i++)
+    {
+        leftBounds.grow(primitiveBounds[m_primitiveIndices[i]]);
+    }
+    for (uint32 i = first + leftCount; i < first + count; i++)
+    {
+        rightBounds.grow(primitiveBounds[m_primitiveIndices[i]]);
+    }
+
+    uint32 leftIndex = uint32(m_nodes.size());
+    m_nodes.push_back({ leftBounds.min, first, leftBounds.max, leftCount });
+    m_nodes.push_back({ rightBounds.min, first + leftCount, rightBounds.max, count - leftCount });
+    m_nodes[nodeIndex].leftFirst = leftIndex;
+    m_nodes[nodeIndex].count = BvhInnerNode | uint32(bestAxis);
+
+    subdivide(leftIndex, depth + 1, primitiveBounds, centroids, settings);
+    subdivide(leftIndex + 1, depth + 1, primitiveBounds, centroids, settings);
+}
+
+void Bvh::assign(const BvhNode* nodes, size_t nodeCount, const uint32* primitiveIndices, size_t primitiveIndexCount)
+{
+    m_nodes.assign(nodes, nodes + nodeCount);
+    m_primitiveIndices.assign(primitiveIndices, primitiveIndices + primitiveIndexCount);
+}
+
+uint32 Bvh::getDepth() const
+{
+    if (m_nodes.empty())
+    {
+        return 0;
+    }
+
+    uint32 maxDepth = 0;
+    std::vector<std::pair<uint32, uint32>> stack = { { 0, 1 } };
+    while (!stack.empty())
+    {
+        std::pair<uint32, uint32> entry = stack.back();
+        stack.pop_back();
+
+        const BvhNode& node = m_nodes[entry.first];
+        maxDepth = std::max(maxDepth, entry.second);
+        if (!node.isLeaf())
+        {
+            stack.push_back({ node.leftFirst, entry.second + 1 });
+            stack.push_back({ node.leftFirst + 1, entry.second + 1 });
+        }
+    }
+    return maxDepth;
+}
+
+float Bvh::computeSahCost(const BvhBuildSettings& settings) const
+{
+    if (m_nodes.empty())
+    {
+        return 0.0f;
+    }
+
+    float rootArea = std::max(m_nodes[0].getBounds().getSurfaceArea(), FLT_MIN);
+    double cost = 0.0;
+    for (const BvhNode& node : m_nodes)
+    {
+        float area = node.getBounds().getSurfaceArea() / rootArea;
+        cost += node.isLeaf() ? area * settings.intersectionCost * node.count : area * settings.traversalCost;
+    }
+    return float(cost);
+}
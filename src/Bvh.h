@@ -0,0 +1,239 @@
+#pragma once
+
+#include "Ray.h"
+#include <functional>
+
+// set in BvhNode::count of inner nodes, the low bits hold the split axis
+const uint32 BvhInnerNode = 0x80000000u;
+
+// 32 bytes, matches struct BvhNode in the traversal shaders
+struct BvhNode
+{
+    glm::vec3   boundsMin;
+    uint32      leftFirst;      // inner node: index of the left child, the right one follows it. Leaf: first primitive
+    glm::vec3   boundsMax;
+    uint32      count;          // primitive count of a leaf, BvhInnerNode | split axis for inner nodes
+
+    bool isLeaf() const { return (count & BvhInnerNode) == 0; }
+    uint32 getSplitAxis() const { return count & 3; }
+
+    Aabb getBounds() const
+    {
+        Aabb bounds;
+        bounds.min = boundsMin;
+        bounds.max = boundsMax;
+        return bounds;
+    }
+};
+
+enum class BvhBuildMode
+{
+    Binned,             // object splits only, every primitive ends up in exactly one leaf
+    SpatialSplits,      // SBVH (Stich et al. 2009), also splits primitives between children so leaves may share them
+};
+
+struct BvhBuildSettings
+{
+    BvhBuildMode    mode                = BvhBuildMode::Binned;
+    uint32          binCount            = 16;
+    uint32          maxLeafSize         = 4;
+    float           traversalCost       = 1.0f;
+    float           intersectionCost    = 1.0f;
+
+    // SpatialSplits only
+    float           splitAlpha          = 1e-5f;    // spatial splits are tried where the object split children overlap by more than this fraction of the root area
+    float           referenceBudget     = 0.5f;     // extra primitive references spatial splits may create, relative to the primitive count
+    uint32          parallelSubtreeSize = 4096;     // nodes with fewer references are built as independent subtrees on ThreadPool::getInstance()
+};
+
+// Fills left and right with the bounds of the parts of a primitive below and above position on axis, used by spatial
+// splits. Either may be left invalid if the primitive lies entirely on the other side.
+typedef std::function<void(uint32 primitiveIndex, uint32 axis, float position, Aabb& left, Aabb& right)> SplitPrimitiveFunc;
+
+const uint32 BvhMaxDepth = 64;
+
+// Bounding volume hierarchy over arbitrary primitives given by their bounds, built with binned SAH object splits and
+// optionally spatial splits
+class Bvh
+{
+public:
+    Bvh();
+    ~Bvh();
+
+    // BvhBuildMode::SpatialSplits needs splitPrimitive, the binned build ignores it
+    void build(const std::vector<Aabb>& primitiveBounds, const BvhBuildSettings& settings = BvhBuildSettings(),
+               const SplitPrimitiveFunc& splitPrimitive = nullptr);
+
+    // Takes over a tree built earlier, e.g. mapped from a BvhCache file, instead of building one
+    void assign(const BvhNode* nodes, size_t nodeCount, const uint32* primitiveIndices, size_t primitiveIndexCount);
+
+    const std::vector<BvhNode>& getNodes() const { return m_nodes; }
+
+    // Leaves reference primitives through this array, the value is the index into the primitive bounds given to build().
+    // After a build with spatial splits a primitive can be referenced by several leaves, so this may be longer.
+    const std::vector<uint32>& getPrimitiveIndices() const { return m_primitiveIndices; }
+
+    Aabb getBounds() const { return m_nodes.empty() ? Aabb() : m_nodes[0].getBounds(); }
+    uint32 getDepth() const;
+
+    // Expected cost of a random ray hitting the root, relative to the root surface area
+    float computeSahCost(const BvhBuildSettings& settings = BvhBuildSettings()) const;
+
+    // Returns the entry distance into the box or FLT_MAX on a miss
+    static float intersectAabb(const Ray& ray, const glm::vec3& invDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        glm::vec3 t0 = (boundsMin - ray.origin) * invDirection;
+        glm::vec3 t1 = (boundsMax - ray.origin) * invDirection;
+        glm::vec3 tNear = glm::min(t0, t1);
+        glm::vec3 tFar = glm::max(t0, t1);
+        float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, ray.tMin));
+        float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, ray.tMax));
+        return tEnter <= tExit ? tEnter : FLT_MAX;
+    }
+
+    // Closest hit traversal, visiting the nearer child first. intersectPrimitive(i, ray) is called with the position
+    // of the primitive in getPrimitiveIndices() and has to shrink ray.tMax and return true when it finds a closer hit.
+    template <typename IntersectPrimitive>
+    bool traverse(Ray& ray, IntersectPrimitive&& intersectPrimitive) const
+    {
+        if (m_nodes.empty())
+        {
+            return false;
+        }
+
+        glm::vec3 invDirection = 1.0f / ray.direction;
+        if (intersectAabb(ray, invDirection, m_nodes[0].boundsMin, m_nodes[0].boundsMax) == FLT_MAX)
+        {
+            return false;
+        }
+
+        bool hit = false;
+        struct StackEntry { uint32 nodeIndex; float t; } stack[BvhMaxDepth];
+        uint32 stackSize = 0;
+        uint32 nodeIndex = 0;
+        while (true)
+        {
+            const BvhNode& node = m_nodes[nodeIndex];
+            if (node.isLeaf())
+            {
+                for (uint32 i = node.leftFirst; i < node.leftFirst + node.count; i++)
+                {
+                    hit |= intersectPrimitive(i, ray);
+                }
+            }
+            else
+            {
+                const BvhNode& left = m_nodes[node.leftFirst];
+                const BvhNode& right = m_nodes[node.leftFirst + 1];
+                float tLeft = intersectAabb(ray, invDirection, left.boundsMin, left.boundsMax);
+                float tRight = intersectAabb(ray, invDirection, right.boundsMin, right.boundsMax);
+
+                uint32 nearIndex = node.leftFirst;
+                uint32 farIndex = node.leftFirst + 1;
+                if (tRight < tLeft)
+                {
+                    std::swap(tLeft, tRight);
+                    std::swap(nearIndex, farIndex);
+                }
+
+                if (tLeft != FLT_MAX)
+                {
+                    if (tRight != FLT_MAX)
+                    {
+                        assert(stackSize < BvhMaxDepth);
+                        stack[stackSize++] = { farIndex, tRight };
+                    }
+                    nodeIndex = nearIndex;
+                    continue;
+                }
+            }
+
+            // pop the next node which is still in front of the closest hit
+            bool found = false;
+            while (stackSize && !found)
+            {
+                const StackEntry& entry = stack[--stackSize];
+                nodeIndex = entry.nodeIndex;
+                found = entry.t <= ray.tMax;
+            }
+            if (!found)
+            {
+                break;
+            }
+        }
+        return hit;
+    }
+
+    // Occlusion traversal for shadow and visibility rays, returns on the first primitive for which
+    // isOccluded(i, ray) returns true. There is no closest hit to cull against, so instead of sorting the children by
+    // their entry distance they are visited front to back along the split axis, which only needs the ray direction sign.
+    template <typename IsOccluded>
+    bool traverseAny(const Ray& ray, IsOccluded&& isOccluded) const
+    {
+        if (m_nodes.empty())
+        {
+            return false;
+        }
+
+        glm::vec3 invDirection = 1.0f / ray.direction;
+        if (intersectAabb(ray, invDirection, m_nodes[0].boundsMin, m_nodes[0].boundsMax) == FLT_MAX)
+        {
+            return false;
+        }
+
+        uint32 stack[BvhMaxDepth];
+        uint32 stackSize = 0;
+        uint32 nodeIndex = 0;
+        while (true)
+        {
+            const BvhNode& node = m_nodes[nodeIndex];
+            if (node.isLeaf())
+            {
+                for (uint32 i = node.leftFirst; i < node.leftFirst + node.count; i++)
+                {
+                    if (isOccluded(i, ray))
+                    {
+                        return true;
+                    }
+                }
+            }
+            else
+            {
+                uint32 firstIndex = node.leftFirst;
+                uint32 secondIndex = node.leftFirst + 1;
+                if (ray.direction[node.getSplitAxis()] < 0.0f)
+                {
+                    std::swap(firstIndex, secondIndex);
+                }
+
+                const BvhNode& first = m_nodes[firstIndex];
+                const BvhNode& second = m_nodes[secondIndex];
+                bool hitFirst = intersectAabb(ray, invDirection, first.boundsMin, first.boundsMax) != FLT_MAX;
+                bool hitSecond = intersectAabb(ray, invDirection, second.boundsMin, second.boundsMax) != FLT_MAX;
+                if (hitFirst || hitSecond)
+                {
+                    if (hitFirst && hitSecond)
+                    {
+                        assert(stackSize < BvhMaxDepth);
+                        stack[stackSize++] = secondIndex;
+                    }
+                    nodeIndex = hitFirst ? firstIndex : secondIndex;
+                    continue;
+                }
+            }
+
+            if (stackSize == 0)
+            {
+                break;
+            }
+            nodeIndex = stack[--stackSize];
+        }
+        return false;
+    }
+
+private:
+    void subdivide(uint32 nodeIndex, uint32 depth, const std::vector<Aabb>& primitiveBounds, const std::vector<glm::vec3>& centroids, const BvhBuildSettings& settings);
+
+    std::vector<BvhNode>    m_nodes;
+    std::vector<uint32>     m_primitiveIndices;
+};
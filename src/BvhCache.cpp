@@ -0,0 +1,231 @@
+#include "BvhCache.h"
+#include "GraphicsObjects.h"
+#include <cstring>
+#include <fstream>
+
+// FNV-1a over 64 bit words, a byte at a time would take seconds on meshes with tens of millions of vertices
+static uint64 hashBytes(const void* data, size_t size, uint64 hash)
+{
+    const uint64 Prime = 0x100000001b3ull;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t i = 0;
+    for (; i + sizeof(uint64) <= size; i += sizeof(uint64))
+    {
+        uint64 word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * Prime;
+    }
+    for (; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * Prime;
+    }
+    return hash;
+}
+
+template <typename T>
+static uint64 hashValue(const T& value, uint64 hash)
+{
+    return hashBytes(&value, sizeof(value), hash);
+}
+
+static uint64 alignOffset(uint64 offset)
+{
+    return (offset + BvhCacheAlignment - 1) / BvhCacheAlignment * BvhCacheAlignment;
+}
+
+static std::unique_ptr<Buffer> createStorageBuffer(const Device& device, const vk::UniqueCommandPool& commandPool, const void* data, size_t size)
+{
+    assert(0 < size);
+    std::unique_ptr<Buffer> buffer = std::make_unique<Buffer>(device, size, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                                                              vk::MemoryPropertyFlagBits::eDeviceLocal);
+    buffer->upload(commandPool, device.getGraphicsQueue(), data, size);
+    return buffer;
+}
+
+BvhCache::BvhCache()
+    : m_header(nullptr)
+{
+}
+
+BvhCache::~BvhCache()
+{
+
+}
+
+uint64 BvhCache::computeKey(const std::vector<glm::vec3>& positions, const std::vector<uint32>& indices, const BvhBuildSettings& settings)
+{
+    uint64 hash = 0xcbf29ce484222325ull;
+    hash = hashValue(uint64(positions.size()), hash);
+    hash = hashBytes(positions.data(), positions.size() * sizeof(glm::vec3), hash);
+    hash = hashValue(uint64(indices.size()), hash);
+    hash = hashBytes(indices.data(), indices.size() * sizeof(uint32), hash);
+
+    // field by field, the struct has padding
+    hash = hashValue(uint32(settings.mode), hash);
+    hash = hashValue(settings.binCount, hash);
+    hash = hashValue(settings.maxLeafSize, hash);
+    hash = hashValue(settings.traversalCost, hash);
+    hash = hashValue(settings.intersectionCost, hash);
+    if (settings.mode == BvhBuildMode::SpatialSplits)
+    {
+        hash = hashValue(settings.splitAlpha, hash);
+        hash = hashValue(settings.referenceBudget, hash);
+        hash = hashValue(settings.parallelSubtreeSize, hash);
+    }
+    return hash;
+}
+
+bool BvhCache::write(const string& path, const Bvh& bvh, uint64 key)
+{
+    const std::vector<BvhNode>& nodes = bvh.getNodes();
+    const std::vector<uint32>& primitiveIndices = bvh.getPrimitiveIndices();
+
+    BvhCacheHeader header = {};
+    header.magic = BvhCacheMagic;
+    header.version = BvhCacheVersion;
+    header.key = key;
+    header.nodeOffset = alignOffset(sizeof(BvhCacheHeader));
+    header.nodeCount = nodes.size();
+    header.primitiveIndexOffset = alignOffset(header.nodeOffset + nodes.size() * sizeof(BvhNode));
+    header.primitiveIndexCount = primitiveIndices.size();
+    header.fileSize = header.primitiveIndexOffset + primitiveIndices.size() * sizeof(uint32);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        return false;
+    }
+
+    static const char padding[BvhCacheAlignment] = {};
+    uint64 position = 0;
+    auto writeAt = [&](uint64 offset, const void* data, size_t size)
+    {
+        assert(position <= offset && offset - position <= BvhCacheAlignment);
+        file.write(padding, std::streamsize(offset - position));
+        file.write(static_cast<const char*>(data), std::streamsize(size));
+        position = offset + size;
+    };
+    writeAt(0, &header, sizeof(header));
+    writeAt(header.nodeOffset, nodes.data(), nodes.size() * sizeof(BvhNode));
+    writeAt(header.primitiveIndexOffset, primitiveIndices.data(), primitiveIndices.size() * sizeof(uint32));
+    return bool(file);
+}
+
+bool BvhCache::open(const string& path, uint64 key, size_t triangleCount)
+{
+    close();
+    if (!m_file.open(path))
+    {
+        return false;
+    }
+
+    const uint64 fileSize = m_file.getSize();
+    const BvhCacheHeader* header = static_cast<const BvhCacheHeader*>(m_file.getData());
+    bool valid = sizeof(BvhCacheHeader) <= fileSize
+              && header->magic == BvhCacheMagic
+              && header->version == BvhCacheVersion
+              && header->key == key
+              && header->fileSize == fileSize
+              && header->nodeOffset % BvhCacheAlignment == 0
+              && header->primitiveIndexOffset % BvhCacheAlignment == 0
+              && header->nodeCount <= fileSize / sizeof(BvhNode)
+              && header->primitiveIndexCount <= fileSize / sizeof(uint32)
+              // compare sizes against the room left behind an offset, offset + size could wrap around
+              && sizeof(BvhCacheHeader) <= header->nodeOffset
+              && header->nodeOffset <= header->primitiveIndexOffset
+              && header->nodeCount * sizeof(BvhNode) <= header->primitiveIndexOffset - header->nodeOffset
+              && header->primitiveIndexOffset <= fileSize
+              && header->primitiveIndexCount * sizeof(uint32) <= fileSize - header->primitiveIndexOffset;
+    if (!valid)
+    {
+        m_file.close();
+        return false;
+    }
+
+    m_header = header;
+    if (!validateBody(triangleCount))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+// The builders append children behind their parent, so requiring that also rules out cycles
+bool BvhCache::validateBody(size_t triangleCount) const
+{
+    const BvhNode* nodes = getNodes();
+    const uint64 nodeCount = m_header->nodeCount;
+    const uint64 primitiveIndexCount = m_header->primitiveIndexCount;
+    if (nodeCount == 0)
+    {
+        return false;
+    }
+    for (uint64 i = 0; i < nodeCount; i++)
+    {
+        const BvhNode& node = nodes[i];
+        bool valid = node.isLeaf() ? uint64(node.leftFirst) + node.count <= primitiveIndexCount
+                                   : i < node.leftFirst && uint64(node.leftFirst) + 1 < nodeCount;
+        if (!valid)
+        {
+            return false;
+        }
+    }
+
+    const uint32* primitiveIndices = getPrimitiveIndices();
+    for (uint64 i = 0; i < primitiveIndexCount; i++)
+    {
+        if (primitiveIndices[i] >= triangleCount)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BvhCache::close()
+{
+    m_header = nullptr;
+    m_file.close();
+}
+
+const BvhNode* BvhCache::getNodes() const
+{
+    assert(m_header);
+    return reinterpret_cast<const BvhNode*>(static_cast<const char*>(m_file.getData()) + m_header->nodeOffset);
+}
+
+const uint32* BvhCache::getPrimitiveIndices() const
+{
+    assert(m_header);
+    return reinterpret_cast<const uint32*>(static_cast<const char*>(m_file.getData()) + m_header->primitiveIndexOffset);
+}
+
+std::unique_ptr<Buffer> BvhCache::createNodeBuffer(const Device& device, const vk::UniqueCommandPool& commandPool) const
+{
+    return createStorageBuffer(device, commandPool, getNodes(), getNodeCount() * sizeof(BvhNode));
+}
+
+std::unique_ptr<Buffer> BvhCache::createPrimitiveIndexBuffer(const Device& device, const vk::UniqueCommandPool& commandPool) const
+{
+    return createStorageBuffer(device, commandPool, getPrimitiveIndices(), getPrimitiveIndexCount() * sizeof(uint32));
+}
+
+std::shared_ptr<BottomLevelAs> BvhCache::loadOrBuild(const string& cachePath, const std::vector<glm::vec3>& positions, const std::vector<uint32>& indices,
+                                                     const BvhBuildSettings& settings)
+{
+    uint64 key = computeKey(positions, indices, settings);
+
+    BvhCache cache;
+    if (cache.open(cachePath, key, indices.size() / 3))
+    {
+        Bvh bvh;
+        cache.load(bvh);
+        return std::make_shared<BottomLevelAs>(positions, indices, std::move(bvh));
+    }
+
+    // a failed write only costs the next start another build
+    std::shared_ptr<BottomLevelAs> blas = std::make_shared<BottomLevelAs>(positions, indices, settings);
+    write(cachePath, blas->getBvh(), key);
+    return blas;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "AccelerationStructure.h"
+#include "MappedFile.h"
+#include <vulkan/vulkan.hpp>
+#include <memory>
+
+class Device;
+class Buffer;
+
+// On-disk image of a bottom level BVH that is used in place once mapped:
+//
+//   BvhCacheHeader | padding | BvhNode[nodeCount] | padding | uint32[primitiveIndexCount]
+//
+// Both arrays start on a BvhCacheAlignment boundary, so they sit on their own pages and can be copied to a staging
+// buffer or handed to Bvh::assign without any parsing. Little endian only, like every platform this runs on.
+const uint32 BvhCacheMagic = 0x43485642u;      // "BVHC"
+const uint32 BvhCacheVersion = 1;               // bump with any change to the layout, BvhNode or the builders
+const uint64 BvhCacheAlignment = 4096;
+
+struct BvhCacheHeader
+{
+    uint32  magic;
+    uint32  version;
+    uint64  key;                    // BvhCache::computeKey of the source mesh and build settings
+    uint64  fileSize;
+    uint64  nodeOffset;
+    uint64  nodeCount;
+    uint64  primitiveIndexOffset;
+    uint64  primitiveIndexCount;
+};
+
+class BvhCache
+{
+public:
+    BvhCache();
+    ~BvhCache();
+
+    // Hash of the vertex and index data and of every setting that changes the tree, a cache with another key is stale
+    static uint64 computeKey(const std::vector<glm::vec3>& positions, const std::vector<uint32>& indices, const BvhBuildSettings& settings);
+
+    static bool write(const string& path, const Bvh& bvh, uint64 key);
+
+    // Maps the file and validates magic, version, key and size, then that every child, leaf range and primitive index
+    // of the body is in range for a mesh of triangleCount triangles. Returns false for missing, stale, truncated or
+    // corrupted files.
+    bool open(const string& path, uint64 key, size_t triangleCount);
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+
+    // Point into the mapped file, valid until close()
+    const BvhNode* getNodes() const;
+    size_t getNodeCount() const { return size_t(m_header->nodeCount); }
+    const uint32* getPrimitiveIndices() const;
+    size_t getPrimitiveIndexCount() const { return size_t(m_header->primitiveIndexCount); }
+
+    void load(Bvh& bvh) const { bvh.assign(getNodes(), getNodeCount(), getPrimitiveIndices(), getPrimitiveIndexCount()); }
+
+    // Device local storage buffers filled straight from the mapped pages
+    std::unique_ptr<Buffer> createNodeBuffer(const Device& device, const vk::UniqueCommandPool& commandPool) const;
+    std::unique_ptr<Buffer> createPrimitiveIndexBuffer(const Device& device, const vk::UniqueCommandPool& commandPool) const;
+
+    // Loads the bottom level structure from cachePath if the cache matches the mesh and settings, otherwise builds it
+    // and writes a new cache file
+    static std::shared_ptr<BottomLevelAs> loadOrBuild(const string& cachePath, const std::vector<glm::vec3>& positions, const std::vector<uint32>& indices,
+                                                      const BvhBuildSettings& settings = BvhBuildSettings());
+
+private:
+    bool validateBody(size_t triangleCount) const;
+
+    MappedFile              m_file;
+    const BvhCacheHeader*   m_header;
+};
@@ -5,6 +5,7 @@
 #include <optional>
 #include <glm/glm.hpp>
 #include <cstdint>
+#include <algorithm>
 
 using string = std::string;
 
@@ -36,5 +37,5 @@ template <typename T>
 T clamp(const T& x, const T& min, const T& max)
 {
     if (x < min)return min;
-    return x > max ? max : x
+    return x > max ? max : x;
 }
\ No newline at end of file
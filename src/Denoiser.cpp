@@ -0,0 +1,482 @@
+#include "Denoiser.h"
+#include "GraphicsObjects.h"
+#include "shaders.hpp"
+
+// keep in sync with denoiseShaderHeader
+const float AlbedoEpsilon = 1e-3f;
+const float MaxHistoryLength = 32.0f;
+const float ReprojectionNormalThreshold = 0.9f;
+const float ReprojectionDepthTolerance = 2.0f;
+const float MinReprojectionWeight = 0.01f;
+const float ShortHistoryLength = 4.0f;
+
+const float AtrousKernel[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+const float VarianceGaussian[2] = { 1.0f / 2.0f, 1.0f / 4.0f };
+
+const uint32 DenoiseGroupSize = 8;
+
+// Matches the push constant block of denoiseShaderHeader
+struct DenoisePushConstants
+{
+    glm::mat4x4 reprojection;
+    float       colorAlpha;
+    float       momentsAlpha;
+    float       phiColor;
+    float       phiNormal;
+    float       phiDepth;
+    int32       stepSize;
+    uint32      writeHistory;
+    uint32      historyValid;
+};
+
+static float luminance(const glm::vec3& c)
+{
+    return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+}
+
+static glm::vec3 albedoFactor(const glm::vec4& albedo)
+{
+    return glm::max(glm::vec3(albedo), glm::vec3(AlbedoEpsilon));
+}
+
+static bool isBackground(const glm::vec4& normalDepth)
+{
+    return normalDepth.w >= 1.0f;
+}
+
+// smaller of the one sided differences per axis, so depth discontinuities do not blow it up
+static float depthGradient(const std::vector<glm::vec4>& normalDepth, const vk::Extent2D& extent, int x, int y)
+{
+    const int width = int(extent.width);
+    const int height = int(extent.height);
+    auto depth = [&](int px, int py) { return normalDepth[size_t(glm::clamp(py, 0, height - 1)) * width + glm::clamp(px, 0, width - 1)].w; };
+
+    float d = depth(x, y);
+    float gradientX = std::min(std::abs(depth(x + 1, y) - d), std::abs(d - depth(x - 1, y)));
+    float gradientY = std::min(std::abs(depth(x, y + 1) - d), std::abs(d - depth(x, y - 1)));
+    return std::max(gradientX, gradientY);
+}
+
+static float edgeWeight(const glm::vec4& center, const glm::vec4& normalDepth, float depthTolerance, float phiNormal)
+{
+    float depthWeight = std::exp(-std::abs(center.w - normalDepth.w) / (depthTolerance + 1e-5f));
+    float normalWeight = std::pow(std::max(0.0f, glm::dot(glm::vec3(center), glm::vec3(normalDepth))), phiNormal);
+    return depthWeight * normalWeight;
+}
+
+CpuDenoiser::CpuDenoiser(const vk::Extent2D& extent, const DenoiserSettings& settings)
+    : m_extent(extent)
+    , m_settings(settings)
+    , m_lastViewProjectionClip(1.0f)
+    , m_historyValid(false)
+{
+    const size_t pixelCount = size_t(extent.width) * extent.height;
+    m_historyColor.resize(pixelCount);
+    m_historyMoments.resize(pixelCount);
+    m_historyNormalDepth.resize(pixelCount);
+    m_moments.resize(pixelCount);
+    m_filter[0].resize(pixelCount);
+    m_filter[1].resize(pixelCount);
+}
+
+CpuDenoiser::~CpuDenoiser()
+{
+
+}
+
+void CpuDenoiser::denoise(const glm::mat4x4& viewProjectionClip, const std::vector<glm::vec4>& radiance, const std::vector<glm::vec4>& normalDepth,
+                          const std::vector<glm::vec4>& albedo, std::vector<glm::vec4>& output)
+{
+    const size_t pixelCount = m_filter[0].size();
+    assert(radiance.size() == pixelCount && normalDepth.size() == pixelCount && albedo.size() == pixelCount);
+    assert(0 < m_settings.filterIterations);
+
+    temporalAccumulate(m_lastViewProjectionClip * glm::inverse(viewProjectionClip), radiance, normalDepth, albedo);
+    estimateVariance(normalDepth);
+    for (uint32 iteration = 0; iteration < m_settings.filterIterations; iteration++)
+    {
+        filter(iteration, normalDepth);
+    }
+
+    const std::vector<glm::vec4>& filtered = m_filter[(m_settings.filterIterations - 1) & 1];
+    output.resize(pixelCount);
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        output[i] = glm::vec4(glm::vec3(filtered[i]) * albedoFactor(albedo[i]), 1.0f);
+    }
+
+    m_historyMoments.swap(m_moments);
+    m_historyNormalDepth = normalDepth;
+    m_lastViewProjectionClip = viewProjectionClip;
+    m_historyValid = true;
+}
+
+void CpuDenoiser::temporalAccumulate(const glm::mat4x4& reprojection, const std::vector<glm::vec4>& radiance, const std::vector<glm::vec4>& normalDepth,
+                                     const std::vector<glm::vec4>& albedo)
+{
+    const int width = int(m_extent.width);
+    const int height = int(m_extent.height);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const size_t i = size_t(y) * width + x;
+            const glm::vec4& center = normalDepth[i];
+            glm::vec3 illumination = glm::vec3(radiance[i]) / albedoFactor(albedo[i]);
+            float lum = luminance(illumination);
+
+            // bilinear reprojection over the taps whose normal and depth are consistent with this pixel
+            glm::vec3 historyColor(0.0f);
+            glm::vec2 historyMoments(0.0f);
+            float historyLength = 0.0f;
+            float weightSum = 0.0f;
+            if (m_historyValid && !isBackground(center))
+            {
+                glm::vec2 ndc((x + 0.5f) / width * 2.0f - 1.0f, (y + 0.5f) / height * 2.0f - 1.0f);
+                glm::vec4 previousClip = reprojection * glm::vec4(ndc, center.w, 1.0f);
+                glm::vec3 previousNdc = glm::vec3(previousClip) / previousClip.w;
+                glm::vec2 previousPixel = (glm::vec2(previousNdc) * 0.5f + 0.5f) * glm::vec2(width, height) - 0.5f;
+                glm::vec2 base = glm::floor(previousPixel);
+                glm::vec2 f = previousPixel - base;
+                float depthTolerance = ReprojectionDepthTolerance * depthGradient(normalDepth, m_extent, x, y) + 1e-5f;
+                for (int k = 0; k < 4; k++)
+                {
+                    int tapX = int(base.x) + (k & 1);
+                    int tapY = int(base.y) + (k >> 1);
+                    if (tapX < 0 || tapY < 0 || width <= tapX || height <= tapY)
+                    {
+                        continue;
+                    }
+
+                    const size_t tap = size_t(tapY) * width + tapX;
+                    const glm::vec4& previous = m_historyNormalDepth[tap];
+                    if (glm::dot(glm::vec3(center), glm::vec3(previous)) < ReprojectionNormalThreshold || std::abs(previous.w - previousNdc.z) > depthTolerance)
+                    {
+                        continue;
+                    }
+
+                    float w = ((k & 1) ? f.x : 1.0f - f.x) * ((k >> 1) ? f.y : 1.0f - f.y);
+                    historyColor += w * glm::vec3(m_historyColor[tap]);
+                    historyMoments += w * glm::vec2(m_historyMoments[tap]);
+                    historyLength += w * m_historyMoments[tap].z;
+                    weightSum += w;
+                }
+            }
+
+            float length = 1.0f;
+            float colorAlpha = 1.0f;
+            float momentsAlpha = 1.0f;
+            if (weightSum > MinReprojectionWeight)
+            {
+                historyColor /= weightSum;
+                historyMoments /= weightSum;
+                length = std::min(historyLength / weightSum + 1.0f, MaxHistoryLength);
+                colorAlpha = std::max(m_settings.colorAlpha, 1.0f / length);
+                momentsAlpha = std::max(m_settings.momentsAlpha, 1.0f / length);
+            }
+
+            m_filter[0][i] = glm::vec4(glm::mix(historyColor, illumination, colorAlpha), 0.0f);
+            m_moments[i] = glm::vec4(glm::mix(historyMoments, glm::vec2(lum, lum * lum), momentsAlpha), length, 0.0f);
+        }
+    }
+}
+
+void CpuDenoiser::estimateVariance(const std::vector<glm::vec4>& normalDepth)
+{
+    const int width = int(m_extent.width);
+    const int height = int(m_extent.height);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const size_t i = size_t(y) * width + x;
+            const glm::vec4& moments = m_moments[i];
+            const glm::vec4& center = normalDepth[i];
+            if (ShortHistoryLength <= moments.z || isBackground(center))
+            {
+                m_filter[1][i] = glm::vec4(glm::vec3(m_filter[0][i]), std::max(0.0f, moments.y - moments.x * moments.x));
+                continue;
+            }
+
+            // too few frames for the temporal moments, estimate them over the neighbourhood instead
+            float gradient = depthGradient(normalDepth, m_extent, x, y);
+            glm::vec3 colorSum(0.0f);
+            glm::vec2 momentsSum(0.0f);
+            float weightSum = 0.0f;
+            for (int dy = -3; dy <= 3; dy++)
+            {
+                for (int dx = -3; dx <= 3; dx++)
+                {
+                    int tapX = x + dx;
+                    int tapY = y + dy;
+                    if (tapX < 0 || tapY < 0 || width <= tapX || height <= tapY)
+                    {
+                        continue;
+                    }
+
+                    const size_t tap = size_t(tapY) * width + tapX;
+                    float w = (dx == 0 && dy == 0) ? 1.0f : edgeWeight(center, normalDepth[tap], m_settings.phiDepth * gradient * std::sqrt(float(dx * dx + dy * dy)),
+                                                                         m_settings.phiNormal);
+                    colorSum += w * glm::vec3(m_filter[0][tap]);
+                    momentsSum += w * glm::vec2(m_moments[tap]);
+                    weightSum += w;
+                }
+            }
+
+            glm::vec2 m = momentsSum / weightSum;
+            float variance = std::max(0.0f, m.y - m.x * m.x) * ShortHistoryLength / moments.z;
+            m_filter[1][i] = glm::vec4(colorSum / weightSum, variance);
+        }
+    }
+}
+
+void CpuDenoiser::filter(uint32 iteration, const std::vector<glm::vec4>& normalDepth)
+{
+    const std::vector<glm::vec4>& input = m_filter[(iteration + 1) & 1];
+    std::vector<glm::vec4>& output = m_filter[iteration & 1];
+
+    const int width = int(m_extent.width);
+    const int height = int(m_extent.height);
+    const int stepSize = 1 << iteration;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const size_t i = size_t(y) * width + x;
+            const glm::vec4& center = normalDepth[i];
+            const glm::vec4& c = input[i];
+            if (isBackground(center))
+            {
+                output[i] = c;
+                continue;
+            }
+
+            // a 3x3 gaussian of the variance makes the luminance edge stopping more stable
+            float variance = 0.0f;
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    size_t tap = size_t(glm::clamp(y + dy, 0, height - 1)) * width + glm::clamp(x + dx, 0, width - 1);
+                    variance += VarianceGaussian[std::abs(dx)] * VarianceGaussian[std::abs(dy)] * input[tap].w;
+                }
+            }
+
+            float luminanceTolerance = m_settings.phiColor * std::sqrt(std::max(0.0f, variance)) + 1e-6f;
+            float gradient = depthGradient(normalDepth, m_extent, x, y);
+            float lum = luminance(glm::vec3(c));
+
+            float weightSum = AtrousKernel[0] * AtrousKernel[0];
+            glm::vec3 colorSum = weightSum * glm::vec3(c);
+            float varianceSum = weightSum * weightSum * c.w;
+            for (int dy = -2; dy <= 2; dy++)
+            {
+                for (int dx = -2; dx <= 2; dx++)
+                {
+                    int tapX = x + dx * stepSize;
+                    int tapY = y + dy * stepSize;
+                    if ((dx == 0 && dy == 0) || tapX < 0 || tapY < 0 || width <= tapX || height <= tapY)
+                    {
+                        continue;
+                    }
+
+                    const size_t tap = size_t(tapY) * width + tapX;
+                    const glm::vec4& t = input[tap];
+                    float w = AtrousKernel[std::abs(dx)] * AtrousKernel[std::abs(dy)]
+                            * edgeWeight(center, normalDepth[tap], m_settings.phiDepth * gradient * stepSize * std::sqrt(float(dx * dx + dy * dy)), m_settings.phiNormal)
+                            * std::exp(-std::abs(lum - luminance(glm::vec3(t))) / luminanceTolerance);
+                    colorSum += w * glm::vec3(t);
+                    varianceSum += w * w * t.w;
+                    weightSum += w;
+                }
+            }
+            output[i] = glm::vec4(colorSum / weightSum, varianceSum / (weightSum * weightSum));
+        }
+    }
+
+    // the output of the first iteration is what gets reprojected next frame
+    if (iteration == 0)
+    {
+        m_historyColor = output;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+GpuDenoiser::GpuDenoiser(const Device& device, const vk::Extent2D& extent, const DenoiserSettings& settings)
+    : m_device(device)
+    , m_extent(extent)
+    , m_settings(settings)
+    , m_lastViewProjectionClip(1.0f)
+    , m_historyValid(false)
+    , m_imagesInitialized(false)
+    , m_historyIndex(0)
+    , m_timer(device)
+{
+    assert(0 < settings.filterIterations);
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+
+    auto createStorageImage = [&]()
+    {
+        return std::make_unique<Image>(device, vk::Format::eR32G32B32A32Sfloat, extent, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eStorage,
+                                       vk::ImageLayout::eUndefined, vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor);
+    };
+    for (int i = 0; i < 2; i++)
+    {
+        m_historyColor[i] = createStorageImage();
+        m_historyMoments[i] = createStorageImage();
+        m_filter[i] = createStorageImage();
+    }
+    m_historyNormalDepth = createStorageImage();
+    m_output = createStorageImage();
+
+    // 0: radiance, 1: normal depth, 2: albedo, 3: history normal depth, 4/5: history color/moments in, 6/7: history color/moments out,
+    // 8: filter in, 9: filter out, 10: output
+    m_descriptorSetLayout = vk::su::createDescriptorSetLayout(vkDevice, std::vector<std::tuple<vk::DescriptorType, uint32_t, vk::ShaderStageFlags>>(
+                                                                            11, { vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute }));
+    vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(DenoisePushConstants));
+    m_pipelineLayout = vkDevice->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), 1, &m_descriptorSetLayout.get(), 1, &pushConstantRange));
+
+    m_descriptorPool = vk::su::createDescriptorPool(vkDevice, { { vk::DescriptorType::eStorageImage, 44 } });
+    vk::DescriptorSetLayout layouts[4] = { m_descriptorSetLayout.get(), m_descriptorSetLayout.get(), m_descriptorSetLayout.get(), m_descriptorSetLayout.get() };
+    std::vector<vk::UniqueDescriptorSet> descriptorSets = vkDevice->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(m_descriptorPool.get(), 4, layouts));
+    for (int h = 0; h < 2; h++)
+    {
+        for (int f = 0; f < 2; f++)
+        {
+            m_descriptorSets[h][f] = std::move(descriptorSets[h * 2 + f]);
+
+            const Image* images[8] =
+            {
+                m_historyNormalDepth.get(), m_historyColor[1 - h].get(), m_historyMoments[1 - h].get(), m_historyColor[h].get(), m_historyMoments[h].get(),
+                m_filter[f].get(), m_filter[1 - f].get(), m_output.get()
+            };
+            vk::DescriptorImageInfo imageInfos[8];
+            for (int i = 0; i < 8; i++)
+            {
+                imageInfos[i] = vk::DescriptorImageInfo(nullptr, images[i]->getImageView().get(), vk::ImageLayout::eGeneral);
+            }
+            vkDevice->updateDescriptorSets(vk::WriteDescriptorSet(m_descriptorSets[h][f].get(), 3, 0, 8, vk::DescriptorType::eStorageImage, imageInfos), nullptr);
+        }
+    }
+
+    vk::UniquePipelineCache pipelineCache = vkDevice->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+    auto createPipeline = [&](const std::string& shaderText)
+    {
+        vk::UniqueShaderModule shaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eCompute, shaderText);
+        return vk::su::createComputePipeline(vkDevice, pipelineCache, std::make_pair(shaderModule.get(), nullptr), m_pipelineLayout);
+    };
+    m_temporalPipeline = createPipeline(computeShaderText_DenoiseTemporal);
+    m_variancePipeline = createPipeline(computeShaderText_DenoiseVariance);
+    m_atrousPipeline = createPipeline(computeShaderText_DenoiseAtrous);
+    m_modulatePipeline = createPipeline(computeShaderText_DenoiseModulate);
+}
+
+GpuDenoiser::~GpuDenoiser()
+{
+
+}
+
+void GpuDenoiser::setSettings(const DenoiserSettings& settings)
+{
+    assert(0 < settings.filterIterations);
+    m_settings = settings;
+}
+
+void GpuDenoiser::bindInputs(const Image& radiance, const Image& normalDepth, const Image& albedo)
+{
+    // the descriptor sets must not be in flight when different images get bound
+    vk::ImageView views[3] = { radiance.getImageView().get(), normalDepth.getImageView().get(), albedo.getImageView().get() };
+    if (std::equal(views, views + 3, m_boundInputs))
+    {
+        return;
+    }
+    std::copy(views, views + 3, m_boundInputs);
+
+    vk::DescriptorImageInfo imageInfos[3] =
+    {
+        vk::DescriptorImageInfo(nullptr, views[0], vk::ImageLayout::eGeneral),
+        vk::DescriptorImageInfo(nullptr, views[1], vk::ImageLayout::eGeneral),
+        vk::DescriptorImageInfo(nullptr, views[2], vk::ImageLayout::eGeneral)
+    };
+    for (auto& descriptorSets : m_descriptorSets)
+    {
+        for (const vk::UniqueDescriptorSet& descriptorSet : descriptorSets)
+        {
+            m_device.getVKDevice()->updateDescriptorSets(vk::WriteDescriptorSet(descriptorSet.get(), 0, 0, 3, vk::DescriptorType::eStorageImage, imageInfos), nullptr);
+        }
+    }
+}
+
+void GpuDenoiser::transitionImages(const vk::UniqueCommandBuffer& commandBuffer)
+{
+    const Image* images[8] =
+    {
+        m_historyColor[0].get(), m_historyColor[1].get(), m_historyMoments[0].get(), m_historyMoments[1].get(),
+        m_filter[0].get(), m_filter[1].get(), m_historyNormalDepth.get(), m_output.get()
+    };
+
+    std::vector<vk::ImageMemoryBarrier> barriers;
+    for (const Image* image : images)
+    {
+        barriers.push_back(vk::ImageMemoryBarrier(vk::AccessFlags(), vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, vk::ImageLayout::eUndefined,
+                                                  vk::ImageLayout::eGeneral, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image->getVKImage().get(),
+                                                  vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)));
+    }
+    commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, barriers);
+}
+
+void GpuDenoiser::record(const vk::UniqueCommandBuffer& commandBuffer, const glm::mat4x4& viewProjectionClip, const Image& radiance, const Image& normalDepth,
+                         const Image& albedo)
+{
+    bindInputs(radiance, normalDepth, albedo);
+
+    m_timer.reset(commandBuffer);
+    m_timer.begin(commandBuffer);
+
+    if (!m_imagesInitialized)
+    {
+        transitionImages(commandBuffer);
+        m_imagesInitialized = true;
+    }
+
+    DenoisePushConstants pushConstants;
+    pushConstants.reprojection = m_lastViewProjectionClip * glm::inverse(viewProjectionClip);
+    pushConstants.colorAlpha = m_settings.colorAlpha;
+    pushConstants.momentsAlpha = m_settings.momentsAlpha;
+    pushConstants.phiColor = m_settings.phiColor;
+    pushConstants.phiNormal = m_settings.phiNormal;
+    pushConstants.phiDepth = m_settings.phiDepth;
+    pushConstants.stepSize = 1;
+    pushConstants.writeHistory = 0;
+    pushConstants.historyValid = m_historyValid ? 1 : 0;
+
+    const uint32 groupCountX = (m_extent.width + DenoiseGroupSize - 1) / DenoiseGroupSize;
+    const uint32 groupCountY = (m_extent.height + DenoiseGroupSize - 1) / DenoiseGroupSize;
+    auto dispatch = [&](const vk::UniquePipeline& pipeline, const vk::UniqueDescriptorSet& descriptorSet)
+    {
+        commandBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, pipeline.get());
+        commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout.get(), 0, descriptorSet.get(), nullptr);
+        commandBuffer->pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+        commandBuffer->dispatch(groupCountX, groupCountY, 1);
+        vk::su::computeToComputeBarrier(commandBuffer);
+    };
+
+    // descriptor set [h][f] reads filter image f and writes 1 - f, the temporal pass starts in filter image 0
+    const uint32 h = m_historyIndex;
+    dispatch(m_temporalPipeline, m_descriptorSets[h][1]);
+    dispatch(m_variancePipeline, m_descriptorSets[h][0]);
+    for (uint32 iteration = 0; iteration < m_settings.filterIterations; iteration++)
+    {
+        pushConstants.stepSize = 1 << iteration;
+        pushConstants.writeHistory = iteration == 0 ? 1 : 0;
+        dispatch(m_atrousPipeline, m_descriptorSets[h][(iteration + 1) & 1]);
+    }
+    dispatch(m_modulatePipeline, m_descriptorSets[h][(m_settings.filterIterations - 1) & 1]);
+
+    m_timer.end(commandBuffer);
+
+    m_historyIndex = 1 - h;
+    m_lastViewProjectionClip = viewProjectionClip;
+    m_historyValid = true;
+}
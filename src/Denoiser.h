@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Common.h"
+#include "Profiling.h"
+#include <vulkan/vulkan.hpp>
+#include <memory>
+
+class Device;
+class Image;
+
+// Spatiotemporal variance-guided filtering (SVGF, Schied et al. 2017). The noisy radiance is demodulated by the albedo,
+// accumulated over frames through reprojection, and smoothed by an edge-aware a-trous wavelet filter whose luminance
+// edge stopping is scaled by the per pixel variance.
+//
+// Inputs per pixel: radiance (rgb), normalDepth (world space normal, depth as in the depth buffer, 1 for the background)
+// and albedo (rgb).
+struct DenoiserSettings
+{
+    uint32  filterIterations    = 5;        // a-trous passes with step sizes 1, 2, 4, ..., at least 1
+    float   colorAlpha          = 0.2f;     // weight of the new frame in the temporal color average
+    float   momentsAlpha        = 0.2f;     // same for the luminance moments
+    float   phiColor            = 4.0f;     // luminance edge stopping, in standard deviations
+    float   phiNormal           = 128.0f;   // exponent of the normal edge stopping
+    float   phiDepth            = 1.0f;     // depth edge stopping, in multiples of the local depth gradient
+};
+
+// Reference implementation on the CPU, following the compute shaders step by step
+class CpuDenoiser
+{
+public:
+    CpuDenoiser(const vk::Extent2D& extent, const DenoiserSettings& settings = DenoiserSettings());
+    ~CpuDenoiser();
+
+    void setSettings(const DenoiserSettings& settings) { m_settings = settings; }
+    const DenoiserSettings& getSettings() const { return m_settings; }
+
+    // Drops the history, e.g. on a camera cut
+    void reset() { m_historyValid = false; }
+
+    // All buffers hold width * height entries, row major. viewProjectionClip is the matrix the frame was rendered with,
+    // the one of the previous frame is remembered for the reprojection.
+    void denoise(const glm::mat4x4& viewProjectionClip, const std::vector<glm::vec4>& radiance, const std::vector<glm::vec4>& normalDepth,
+                 const std::vector<glm::vec4>& albedo, std::vector<glm::vec4>& output);
+
+private:
+    void temporalAccumulate(const glm::mat4x4& reprojection, const std::vector<glm::vec4>& radiance, const std::vector<glm::vec4>& normalDepth,
+                            const std::vector<glm::vec4>& albedo);
+    void estimateVariance(const std::vector<glm::vec4>& normalDepth);
+    void filter(uint32 iteration, const std::vector<glm::vec4>& normalDepth);
+
+    vk::Extent2D            m_extent;
+    DenoiserSettings        m_settings;
+    glm::mat4x4             m_lastViewProjectionClip;
+    bool                    m_historyValid;
+
+    std::vector<glm::vec4>  m_historyColor;         // filtered illumination after the first a-trous pass
+    std::vector<glm::vec4>  m_historyMoments;       // luminance mean, mean of squares, history length
+    std::vector<glm::vec4>  m_historyNormalDepth;
+    std::vector<glm::vec4>  m_moments;
+    std::vector<glm::vec4>  m_filter[2];            // illumination and variance, ping pong between the passes
+};
+
+// The same on the GPU with compute shaders, all images stay in vk::ImageLayout::eGeneral
+class GpuDenoiser
+{
+public:
+    GpuDenoiser(const Device& device, const vk::Extent2D& extent, const DenoiserSettings& settings = DenoiserSettings());
+    ~GpuDenoiser();
+
+    void setSettings(const DenoiserSettings& settings);
+    const DenoiserSettings& getSettings() const { return m_settings; }
+
+    void reset() { m_historyValid = false; }
+
+    // Inputs are storage images in eGeneral layout: radiance and normalDepth eR32G32B32A32Sfloat, albedo eR8G8B8A8Unorm.
+    // The result ends up in getOutput(), also eR32G32B32A32Sfloat.
+    void record(const vk::UniqueCommandBuffer& commandBuffer, const glm::mat4x4& viewProjectionClip, const Image& radiance, const Image& normalDepth,
+                const Image& albedo);
+
+    const Image& getOutput() const { return *m_output; }
+
+    // GPU time of the last recorded frame, false until its command buffer completed
+    bool getLastDenoiseMilliseconds(double& milliseconds) const { return m_timer.getMilliseconds(0, milliseconds); }
+
+private:
+    void bindInputs(const Image& radiance, const Image& normalDepth, const Image& albedo);
+    void transitionImages(const vk::UniqueCommandBuffer& commandBuffer);
+
+    const Device&                   m_device;
+    vk::Extent2D                    m_extent;
+    DenoiserSettings                m_settings;
+    glm::mat4x4                     m_lastViewProjectionClip;
+    bool                            m_historyValid;
+    bool                            m_imagesInitialized;
+    uint32                          m_historyIndex;
+    vk::ImageView                   m_boundInputs[3];
+
+    std::unique_ptr<Image>          m_historyColor[2];
+    std::unique_ptr<Image>          m_historyMoments[2];
+    std::unique_ptr<Image>          m_historyNormalDepth;
+    std::unique_ptr<Image>          m_filter[2];
+    std::unique_ptr<Image>          m_output;
+
+    vk::UniqueDescriptorSetLayout   m_descriptorSetLayout;
+    vk::UniquePipelineLayout        m_pipelineLayout;
+    vk::UniqueDescriptorPool        m_descriptorPool;
+    vk::UniqueDescriptorSet         m_descriptorSets[2][2];     // [h][f] writes history h and reads filter image f
+
+    vk::UniquePipeline              m_temporalPipeline;
+    vk::UniquePipeline              m_variancePipeline;
+    vk::UniquePipeline              m_atrousPipeline;
+    vk::UniquePipeline              m_modulatePipeline;
+
+    GpuTimer                        m_timer;
+};
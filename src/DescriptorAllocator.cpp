@@ -0,0 +1,81 @@
+#include "DescriptorAllocator.h"
+#include "GraphicsObjects.h"
+
+DescriptorAllocator::DescriptorAllocator(const Device& device, uint32 framesInFlight, const std::vector<vk::DescriptorPoolSize>& poolSizes, uint32 maxSets)
+    : m_device(device)
+    , m_poolSizes(poolSizes)
+    , m_maxSets(maxSets)
+    , m_framePools(framesInFlight)
+    , m_frameIndex(0)
+    , m_poolCount(0)
+    , m_setCount(0)
+{
+    assert(0 < framesInFlight && !poolSizes.empty() && 0 < maxSets);
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+
+}
+
+void DescriptorAllocator::beginFrame()
+{
+    m_frameIndex = (m_frameIndex + 1) % m_framePools.size();
+    m_setCount = 0;
+
+    const vk::UniqueDevice& vkDevice = m_device.getVKDevice();
+    for (vk::UniqueDescriptorPool& pool : m_framePools[m_frameIndex])
+    {
+        vkDevice->resetDescriptorPool(pool.get());
+        m_freePools.push_back(std::move(pool));
+    }
+    m_framePools[m_frameIndex].clear();
+}
+
+vk::DescriptorSet DescriptorAllocator::allocate(const vk::UniqueDescriptorSetLayout& descriptorSetLayout)
+{
+    std::vector<vk::UniqueDescriptorPool>& pools = m_framePools[m_frameIndex];
+    if (pools.empty())
+    {
+        pools.push_back(acquirePool());
+    }
+
+    // the pointer overload reports running out of pool memory instead of throwing
+    const vk::UniqueDevice& vkDevice = m_device.getVKDevice();
+    vk::DescriptorSet descriptorSet;
+    vk::DescriptorSetAllocateInfo allocateInfo(pools.back().get(), 1, &descriptorSetLayout.get());
+    vk::Result result = vkDevice->allocateDescriptorSets(&allocateInfo, &descriptorSet);
+    if (result == vk::Result::eErrorOutOfPoolMemory || result == vk::Result::eErrorFragmentedPool)
+    {
+        pools.push_back(acquirePool());
+        allocateInfo.descriptorPool = pools.back().get();
+        result = vkDevice->allocateDescriptorSets(&allocateInfo, &descriptorSet);
+    }
+    // a set a whole pool cannot hold does not fit the pool sizes
+    assert(result == vk::Result::eSuccess);
+
+    m_setCount++;
+    return descriptorSet;
+}
+
+DescriptorAllocator::Stats DescriptorAllocator::getStats() const
+{
+    Stats stats;
+    stats.poolCount = m_poolCount;
+    stats.setCount = m_setCount;
+    stats.framePoolCount = uint32(m_framePools[m_frameIndex].size());
+    return stats;
+}
+
+vk::UniqueDescriptorPool DescriptorAllocator::acquirePool()
+{
+    if (!m_freePools.empty())
+    {
+        vk::UniqueDescriptorPool pool = std::move(m_freePools.back());
+        m_freePools.pop_back();
+        return pool;
+    }
+
+    m_poolCount++;
+    return m_device.getVKDevice()->createDescriptorPoolUnique(vk::DescriptorPoolCreateInfo({}, m_maxSets, uint32(m_poolSizes.size()), m_poolSizes.data()));
+}
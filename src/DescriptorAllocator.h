@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Common.h"
+#include <vulkan/vulkan.hpp>
+
+class Device;
+
+// Transient descriptor sets, valid for the frame they were allocated in. Each frame in flight has its own list of
+// pools, which beginFrame() resets as a whole once the frame completed, so sets are never freed one by one and the
+// pools are created without eFreeDescriptorSet, which lets drivers allocate by bumping an offset. A frame that runs
+// out of pool memory moves on to a pool another frame gave back, or a new one, so the pools grow to what the busiest
+// frame needs and are then only reused.
+//
+// Pools are externally synchronized, so one allocator serves one recording thread.
+class DescriptorAllocator
+{
+public:
+    struct Stats
+    {
+        uint32  poolCount;          // created so far
+        uint32  setCount;           // allocated in the current frame
+        uint32  framePoolCount;     // used by the current frame
+    };
+
+    // Every pool gets poolSizes and maxSets, which have to hold the largest set allocated
+    DescriptorAllocator(const Device& device, uint32 framesInFlight, const std::vector<vk::DescriptorPoolSize>& poolSizes, uint32 maxSets);
+    ~DescriptorAllocator();
+
+    DescriptorAllocator(const DescriptorAllocator&) = delete;
+    DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+    // Once per frame, after waiting for the fence of the frame framesInFlight frames back. Resets the pools that frame
+    // used and gives them back.
+    void beginFrame();
+
+    // The set lives until beginFrame() comes round to the current frame in flight again
+    vk::DescriptorSet allocate(const vk::UniqueDescriptorSetLayout& descriptorSetLayout);
+
+    Stats getStats() const;
+
+private:
+    vk::UniqueDescriptorPool acquirePool();
+
+    const Device&                                       m_device;
+    std::vector<vk::DescriptorPoolSize>                 m_poolSizes;
+    uint32                                              m_maxSets;
+    std::vector<std::vector<vk::UniqueDescriptorPool>>  m_framePools;   // per frame in flight, allocating from the last one
+    std::vector<vk::UniqueDescriptorPool>               m_freePools;
+    uint32                                              m_frameIndex;
+    uint32                                              m_poolCount;
+    uint32                                              m_setCount;
+};
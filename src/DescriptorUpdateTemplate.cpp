@@ -0,0 +1,69 @@
+#include "DescriptorUpdateTemplate.h"
+#include "GraphicsObjects.h"
+
+DescriptorUpdateTemplate::DescriptorUpdateTemplate(const Device& device, const vk::UniqueDescriptorSetLayout& descriptorSetLayout,
+                                                   const std::vector<std::tuple<vk::DescriptorType, uint32_t, vk::ShaderStageFlags>>& bindingData)
+    : m_device(device)
+    , m_dataSize(0)
+{
+    assert(!bindingData.empty());
+
+    // bindings are numbered by their position, as vk::su::createDescriptorSetLayout does
+    std::vector<vk::DescriptorUpdateTemplateEntry> entries;
+    entries.reserve(bindingData.size());
+    m_offsets.reserve(bindingData.size());
+    for (size_t i = 0; i < bindingData.size(); i++)
+    {
+        vk::DescriptorType type = std::get<0>(bindingData[i]);
+        uint32 count = std::get<1>(bindingData[i]);
+        size_t infoSize = getInfoSize(type);
+
+        entries.push_back(vk::DescriptorUpdateTemplateEntry(uint32(i), 0, count, type, m_dataSize, infoSize));
+        m_offsets.push_back(m_dataSize);
+        m_dataSize += infoSize * count;
+    }
+
+    m_template = device.getVKDevice()->createDescriptorUpdateTemplateUnique(vk::DescriptorUpdateTemplateCreateInfo({}, uint32(entries.size()), entries.data(),
+                                                                                                                    vk::DescriptorUpdateTemplateType::eDescriptorSet,
+                                                                                                                    descriptorSetLayout.get()));
+}
+
+DescriptorUpdateTemplate::~DescriptorUpdateTemplate()
+{
+
+}
+
+size_t DescriptorUpdateTemplate::getOffset(uint32 binding) const
+{
+    assert(binding < m_offsets.size());
+    return m_offsets[binding];
+}
+
+void DescriptorUpdateTemplate::update(vk::DescriptorSet descriptorSet, const void* data) const
+{
+    m_device.getVKDevice()->updateDescriptorSetWithTemplate(descriptorSet, m_template.get(), data);
+}
+
+size_t DescriptorUpdateTemplate::getInfoSize(vk::DescriptorType type)
+{
+    switch (type)
+    {
+        case vk::DescriptorType::eSampler:
+        case vk::DescriptorType::eCombinedImageSampler:
+        case vk::DescriptorType::eSampledImage:
+        case vk::DescriptorType::eStorageImage:
+        case vk::DescriptorType::eInputAttachment:
+            return sizeof(vk::DescriptorImageInfo);
+        case vk::DescriptorType::eUniformTexelBuffer:
+        case vk::DescriptorType::eStorageTexelBuffer:
+            return sizeof(vk::BufferView);
+        case vk::DescriptorType::eUniformBuffer:
+        case vk::DescriptorType::eStorageBuffer:
+        case vk::DescriptorType::eUniformBufferDynamic:
+        case vk::DescriptorType::eStorageBufferDynamic:
+            return sizeof(vk::DescriptorBufferInfo);
+        default:
+            assert(0);
+            return 0;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Common.h"
+#include <vulkan/vulkan.hpp>
+
+class Device;
+
+// Writes every descriptor of a set with one vkUpdateDescriptorSetWithTemplate call, from a struct holding one info per
+// descriptor in binding order: vk::DescriptorBufferInfo for buffers, vk::DescriptorImageInfo for images and samplers,
+// vk::BufferView for texel buffers. All three are 8 byte aligned, so the members pack without padding, e.g. for the
+// bindings { eUniformBuffer, 1 }, { eCombinedImageSampler, 2 }:
+//
+//     struct MaterialDescriptors
+//     {
+//         vk::DescriptorBufferInfo    uniforms;
+//         vk::DescriptorImageInfo     textures[2];
+//     };
+//
+// The struct lives on the stack of the caller, so updates allocate nothing and the driver gets all writes at once
+// instead of a vk::WriteDescriptorSet each. Needs a Vulkan 1.1 device.
+class DescriptorUpdateTemplate
+{
+public:
+    // bindingData as passed to vk::su::createDescriptorSetLayout for descriptorSetLayout: type, count and stages
+    DescriptorUpdateTemplate(const Device& device, const vk::UniqueDescriptorSetLayout& descriptorSetLayout,
+                             const std::vector<std::tuple<vk::DescriptorType, uint32_t, vk::ShaderStageFlags>>& bindingData);
+    ~DescriptorUpdateTemplate();
+
+    DescriptorUpdateTemplate(const DescriptorUpdateTemplate&) = delete;
+    DescriptorUpdateTemplate& operator=(const DescriptorUpdateTemplate&) = delete;
+
+    // Bytes of the struct update() reads
+    size_t getDataSize() const { return m_dataSize; }
+
+    // Offset of the first info of a binding within that struct
+    size_t getOffset(uint32 binding) const;
+
+    template <typename DataType>
+    void update(vk::DescriptorSet descriptorSet, const DataType& data) const
+    {
+        assert(sizeof(DataType) == m_dataSize);
+        update(descriptorSet, static_cast<const void*>(&data));
+    }
+
+    void update(vk::DescriptorSet descriptorSet, const void* data) const;
+
+    // Size of the info the template reads for each descriptor of type
+    static size_t getInfoSize(vk::DescriptorType type);
+
+private:
+    const Device&                       m_device;
+    vk::UniqueDescriptorUpdateTemplate  m_template;
+    std::vector<size_t>                 m_offsets;      // per binding
+    size_t                              m_dataSize;
+};
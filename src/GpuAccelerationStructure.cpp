@@ -0,0 +1,173 @@
+#include "GpuAccelerationStructure.h"
+#include "GraphicsObjects.h"
+#include "shaders.hpp"
+
+const uint32 TraceGroupSize = 64;
+
+// Matches the push constant block of traceShaderHeader
+struct TracePushConstants
+{
+    uint32  rayCount;
+    uint32  useOrder;
+};
+
+GpuAccelerationStructure::GpuAccelerationStructure(const Device& device, const vk::UniqueCommandPool& commandPool, const TopLevelAs& scene, uint32 maxInstances)
+    : m_device(device)
+    , m_scene(scene)
+    , m_maxInstances(maxInstances)
+    , m_uploadedVersion(~0ull)
+{
+    assert(0 < scene.getBlasCount() && 0 < maxInstances);
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+
+    // concatenate all bottom level structures, the shaders add the offsets of blasInfos to node and leaf indices
+    std::vector<BvhNode> blasNodes;
+    std::vector<BvhTriangle> triangles;
+    std::vector<glm::uvec2> blasInfos;
+    for (uint32 i = 0; i < scene.getBlasCount(); i++)
+    {
+        const BottomLevelAs& blas = scene.getBlas(i);
+        blasInfos.push_back(glm::uvec2(blasNodes.size(), triangles.size()));
+        blasNodes.insert(blasNodes.end(), blas.getBvh().getNodes().begin(), blas.getBvh().getNodes().end());
+        triangles.insert(triangles.end(), blas.getTriangles().begin(), blas.getTriangles().end());
+    }
+
+    auto createStaticBuffer = [&](const auto& data)
+    {
+        // Vulkan has no empty buffers, BottomLevelAs rejects empty meshes
+        assert(!data.empty());
+        std::unique_ptr<Buffer> buffer = std::make_unique<Buffer>(device, data.size() * sizeof(data[0]),
+                                                                  vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                                                                  vk::MemoryPropertyFlagBits::eDeviceLocal);
+        buffer->upload(commandPool, device.getGraphicsQueue(), data, 0);
+        return buffer;
+    };
+    m_blasNodes = createStaticBuffer(blasNodes);
+    m_blasInfos = createStaticBuffer(blasInfos);
+    m_triangles = createStaticBuffer(triangles);
+
+    // a binary tree over maxInstances single instance leaves has 2 * maxInstances - 1 nodes
+    m_tlasNodes = std::make_unique<Buffer>(device, (2 * maxInstances - 1) * sizeof(BvhNode), vk::BufferUsageFlagBits::eStorageBuffer);
+    m_tlasIndices = std::make_unique<Buffer>(device, maxInstances * sizeof(uint32), vk::BufferUsageFlagBits::eStorageBuffer);
+    m_instances = std::make_unique<Buffer>(device, maxInstances * sizeof(Instance), vk::BufferUsageFlagBits::eStorageBuffer);
+    m_dummyOrder = std::make_unique<Buffer>(device, sizeof(uint32), vk::BufferUsageFlagBits::eStorageBuffer);
+
+    // 0: rays, 1: hits or occlusion results, 2: order, 3: tlas nodes, 4: tlas indices, 5: instances, 6: blas nodes, 7: blas infos, 8: triangles
+    m_descriptorSetLayout = vk::su::createDescriptorSetLayout(vkDevice, std::vector<std::tuple<vk::DescriptorType, uint32_t, vk::ShaderStageFlags>>(
+                                                                            9, { vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute }));
+    vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(TracePushConstants));
+    m_pipelineLayout = vkDevice->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), 1, &m_descriptorSetLayout.get(), 1, &pushConstantRange));
+
+    m_descriptorPool = vk::su::createDescriptorPool(vkDevice, { { vk::DescriptorType::eStorageBuffer, 18 } });
+    vk::DescriptorSetLayout layouts[2] = { m_descriptorSetLayout.get(), m_descriptorSetLayout.get() };
+    std::vector<vk::UniqueDescriptorSet> descriptorSets = vkDevice->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(m_descriptorPool.get(), 2, layouts));
+
+    vk::DescriptorBufferInfo bufferInfos[6] =
+    {
+        vk::DescriptorBufferInfo(m_tlasNodes->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_tlasIndices->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_instances->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_blasNodes->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_blasInfos->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_triangles->getVKBuffer().get(), 0, VK_WHOLE_SIZE)
+    };
+    for (int i = 0; i < 2; i++)
+    {
+        m_traversals[i].descriptorSet = std::move(descriptorSets[i]);
+        m_traversals[i].timer = std::make_unique<GpuTimer>(device);
+        vkDevice->updateDescriptorSets(vk::WriteDescriptorSet(m_traversals[i].descriptorSet.get(), 3, 0, 6, vk::DescriptorType::eStorageBuffer, nullptr, bufferInfos), nullptr);
+    }
+
+    vk::UniquePipelineCache pipelineCache = vkDevice->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+    auto createPipeline = [&](const std::string& shaderText)
+    {
+        vk::UniqueShaderModule shaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eCompute, shaderText);
+        return vk::su::createComputePipeline(vkDevice, pipelineCache, std::make_pair(shaderModule.get(), nullptr), m_pipelineLayout);
+    };
+    m_traversals[0].pipeline = createPipeline(computeShaderText_TraceClosest);
+    m_traversals[1].pipeline = createPipeline(computeShaderText_TraceOcclusion);
+}
+
+GpuAccelerationStructure::~GpuAccelerationStructure()
+{
+
+}
+
+void GpuAccelerationStructure::update()
+{
+    if (m_uploadedVersion == m_scene.getVersion())
+    {
+        return;
+    }
+    m_uploadedVersion = m_scene.getVersion();
+
+    assert(m_scene.getInstances().size() <= m_maxInstances);
+    m_tlasNodes->upload(m_scene.getBvh().getNodes());
+    m_tlasIndices->upload(m_scene.getBvh().getPrimitiveIndices());
+    m_instances->upload(m_scene.getInstances());
+}
+
+void GpuAccelerationStructure::bindRayBuffers(Traversal& traversal, const Buffer& rayBuffer, const Buffer& resultBuffer, const Buffer& orderBuffer)
+{
+    // the descriptor set must not be in flight when different buffers get bound
+    vk::Buffer buffers[3] = { rayBuffer.getVKBuffer().get(), resultBuffer.getVKBuffer().get(), orderBuffer.getVKBuffer().get() };
+    if (std::equal(buffers, buffers + 3, traversal.boundBuffers))
+    {
+        return;
+    }
+    std::copy(buffers, buffers + 3, traversal.boundBuffers);
+
+    vk::DescriptorBufferInfo bufferInfos[3] =
+    {
+        vk::DescriptorBufferInfo(buffers[0], 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(buffers[1], 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(buffers[2], 0, VK_WHOLE_SIZE)
+    };
+    m_device.getVKDevice()->updateDescriptorSets(vk::WriteDescriptorSet(traversal.descriptorSet.get(), 0, 0, 3, vk::DescriptorType::eStorageBuffer, nullptr, bufferInfos), nullptr);
+}
+
+void GpuAccelerationStructure::recordDispatch(const vk::UniqueCommandBuffer& commandBuffer, Traversal& traversal, const Buffer& rayBuffer,
+                                              const Buffer& resultBuffer, uint32 rayCount, const Buffer* orderBuffer)
+{
+    // the traversal starts at the root node, an empty scene has none
+    assert(!m_scene.getInstances().empty() && m_uploadedVersion == m_scene.getVersion());
+    bindRayBuffers(traversal, rayBuffer, resultBuffer, orderBuffer ? *orderBuffer : *m_dummyOrder);
+
+    TracePushConstants pushConstants;
+    pushConstants.rayCount = rayCount;
+    pushConstants.useOrder = orderBuffer ? 1 : 0;
+
+    traversal.timer->reset(commandBuffer);
+    traversal.timer->begin(commandBuffer);
+
+    commandBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, traversal.pipeline.get());
+    commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout.get(), 0, traversal.descriptorSet.get(), nullptr);
+    commandBuffer->pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+    commandBuffer->dispatch((rayCount + TraceGroupSize - 1) / TraceGroupSize, 1, 1);
+
+    traversal.timer->end(commandBuffer);
+    traversal.lastRayCount = rayCount;
+}
+
+void GpuAccelerationStructure::recordTrace(const vk::UniqueCommandBuffer& commandBuffer, const Buffer& rayBuffer, const Buffer& hitBuffer, uint32 rayCount,
+                                           const Buffer* orderBuffer)
+{
+    recordDispatch(commandBuffer, m_traversals[0], rayBuffer, hitBuffer, rayCount, orderBuffer);
+}
+
+void GpuAccelerationStructure::recordOcclusion(const vk::UniqueCommandBuffer& commandBuffer, const Buffer& rayBuffer, const Buffer& occludedBuffer, uint32 rayCount,
+                                               const Buffer* orderBuffer)
+{
+    recordDispatch(commandBuffer, m_traversals[1], rayBuffer, occludedBuffer, rayCount, orderBuffer);
+}
+
+bool GpuAccelerationStructure::getLastMraysPerSecond(const Traversal& traversal, double& mraysPerSecond)
+{
+    double milliseconds;
+    if (!traversal.timer->getMilliseconds(0, milliseconds))
+    {
+        return false;
+    }
+    mraysPerSecond = milliseconds > 0.0 ? traversal.lastRayCount / (milliseconds * 1000.0) : 0.0;
+    return true;
+}
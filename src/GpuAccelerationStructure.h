@@ -0,0 +1,72 @@
+#pragma once
+
+#include "AccelerationStructure.h"
+#include "Profiling.h"
+#include <vulkan/vulkan.hpp>
+
+class Device;
+class Buffer;
+
+// GPU copy of a TopLevelAs traced by computeShaderText_TraceClosest and computeShaderText_TraceOcclusion. The bottom level data of all meshes is uploaded
+// once into device local memory, the small top level structure lives in host visible memory and is rewritten on update.
+class GpuAccelerationStructure
+{
+public:
+    // All bottom level structures have to be added to scene before, instances can be added later up to maxInstances
+    GpuAccelerationStructure(const Device& device, const vk::UniqueCommandPool& commandPool, const TopLevelAs& scene, uint32 maxInstances);
+    ~GpuAccelerationStructure();
+
+    // Uploads the top level structure if the scene was rebuilt since the last call, must not happen while a trace is in flight
+    void update();
+
+    // Records closest hit traversal of rayBuffer (an array of Ray), writing one RayHit per ray into hitBuffer.
+    // With an orderBuffer, e.g. GpuRaySorter::getSortedIndexBuffer(), invocation i traces ray order[i] so neighbouring
+    // invocations get coherent rays. Hits are still written at the index of their ray.
+    void recordTrace(const vk::UniqueCommandBuffer& commandBuffer, const Buffer& rayBuffer, const Buffer& hitBuffer, uint32 rayCount,
+                     const Buffer* orderBuffer = nullptr);
+
+    // Occlusion only traversal for shadow and visibility rays, writes one uint32 per ray into occludedBuffer:
+    // 1 if anything lies within [tMin, tMax] of the ray, 0 otherwise
+    void recordOcclusion(const vk::UniqueCommandBuffer& commandBuffer, const Buffer& rayBuffer, const Buffer& occludedBuffer, uint32 rayCount,
+                         const Buffer* orderBuffer = nullptr);
+
+    // GPU time and throughput of the last recorded traversal of each kind, false until its command buffer completed
+    bool getLastTraceMilliseconds(double& milliseconds) const { return m_traversals[0].timer->getMilliseconds(0, milliseconds); }
+    bool getLastOcclusionMilliseconds(double& milliseconds) const { return m_traversals[1].timer->getMilliseconds(0, milliseconds); }
+    bool getLastTraceMraysPerSecond(double& mraysPerSecond) const { return getLastMraysPerSecond(m_traversals[0], mraysPerSecond); }
+    bool getLastOcclusionMraysPerSecond(double& mraysPerSecond) const { return getLastMraysPerSecond(m_traversals[1], mraysPerSecond); }
+
+private:
+    // closest hit [0] and occlusion [1] traversal have their own descriptor sets, so both can be recorded into one command buffer
+    struct Traversal
+    {
+        vk::UniquePipeline          pipeline;
+        vk::UniqueDescriptorSet     descriptorSet;
+        vk::Buffer                  boundBuffers[3];
+        std::unique_ptr<GpuTimer>   timer;
+        uint32                      lastRayCount = 0;
+    };
+
+    void recordDispatch(const vk::UniqueCommandBuffer& commandBuffer, Traversal& traversal, const Buffer& rayBuffer, const Buffer& resultBuffer,
+                        uint32 rayCount, const Buffer* orderBuffer);
+    void bindRayBuffers(Traversal& traversal, const Buffer& rayBuffer, const Buffer& resultBuffer, const Buffer& orderBuffer);
+    static bool getLastMraysPerSecond(const Traversal& traversal, double& mraysPerSecond);
+
+    const Device&                   m_device;
+    const TopLevelAs&               m_scene;
+    uint32                          m_maxInstances;
+    uint64                          m_uploadedVersion;
+
+    std::unique_ptr<Buffer>         m_tlasNodes;
+    std::unique_ptr<Buffer>         m_tlasIndices;
+    std::unique_ptr<Buffer>         m_instances;
+    std::unique_ptr<Buffer>         m_blasNodes;
+    std::unique_ptr<Buffer>         m_blasInfos;
+    std::unique_ptr<Buffer>         m_triangles;
+    std::unique_ptr<Buffer>         m_dummyOrder;
+
+    vk::UniqueDescriptorSetLayout   m_descriptorSetLayout;
+    vk::UniquePipelineLayout        m_pipelineLayout;
+    vk::UniqueDescriptorPool        m_descriptorPool;
+    Traversal                       m_traversals[2];
+};
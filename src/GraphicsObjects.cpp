@@ -103,7 +103,7 @@ std::vector<std::string> getDeviceExtensions()
     return{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 }
 
-Device::Device(const RenderWindow& window, vk::PhysicalDevice physicalDevice)
+Device::Device(const RenderWindow& window, vk::PhysicalDevice physicalDevice, uint32 instanceApiVersion)
     : m_physicalDevice(physicalDevice)
 {
     auto queueIndices = findGraphicsAndPresentQueueFamilyIndex(m_physicalDevice, window.getVKSurface().get());
@@ -111,18 +111,63 @@ Device::Device(const RenderWindow& window, vk::PhysicalDevice physicalDevice)
     m_graphicsQueueFamilyIndex = queueIndices.first;
     m_presentQueueFamilyIndex = queueIndices.second;
 
+    createDevice(getDeviceExtensions(), instanceApiVersion);
+}
+
+Device::Device(vk::PhysicalDevice physicalDevice, uint32 instanceApiVersion)
+    : m_physicalDevice(physicalDevice)
+{
+    m_graphicsQueueFamilyIndex = findGraphicsQueueFamilyIndex(m_physicalDevice.getQueueFamilyProperties());
+    m_presentQueueFamilyIndex = m_graphicsQueueFamilyIndex;
+
+    createDevice({}, instanceApiVersion);
+}
+
+void Device::createDevice(const std::vector<std::string>& extensions, uint32 instanceApiVersion)
+{
     std::vector<const char*> enabledExtensions;
-    for (const auto& ext : getDeviceExtensions())
+    for (const auto& ext : extensions)
     {
         enabledExtensions.push_back(ext.data());
     }
 
+    // GPU driven draws: many indirect draws per call, with firstInstance offsetting gl_InstanceIndex
+    vk::PhysicalDeviceFeatures supportedFeatures = m_physicalDevice.getFeatures();
+    m_enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    m_enabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    // block compressed textures
+    m_enabledFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    // storage buffer writes from fragment shaders, the TextureStreamer feedback
+    m_enabledFeatures.fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics;
+    // bindless textures, vkGetPhysicalDeviceFeatures2 is core 1.1 on both the instance and the physical device
+    std::vector<vk::ExtensionProperties> extensionProperties = m_physicalDevice.enumerateDeviceExtensionProperties();
+    bool descriptorIndexing = instanceApiVersion >= VK_API_VERSION_1_1 && m_physicalDevice.getProperties().apiVersion >= VK_API_VERSION_1_1 &&
+                              std::any_of(extensionProperties.begin(), extensionProperties.end(), [](const vk::ExtensionProperties& ep)
+                              {
+                                  return strcmp(ep.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+                              });
+    if (descriptorIndexing)
+    {
+        vk::PhysicalDeviceDescriptorIndexingFeaturesEXT supportedIndexingFeatures;
+        vk::PhysicalDeviceFeatures2 features2;
+        features2.pNext = &supportedIndexingFeatures;
+        m_physicalDevice.getFeatures2(&features2);
+
+        m_descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = supportedIndexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+        m_descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = supportedIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+        m_descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = supportedIndexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+        m_descriptorIndexingFeatures.descriptorBindingPartiallyBound = supportedIndexingFeatures.descriptorBindingPartiallyBound;
+        m_descriptorIndexingFeatures.descriptorBindingVariableDescriptorCount = supportedIndexingFeatures.descriptorBindingVariableDescriptorCount;
+        m_descriptorIndexingFeatures.runtimeDescriptorArray = supportedIndexingFeatures.runtimeDescriptorArray;
+        enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    }
+
     // create a UniqueDevice
     float queuePriority = 0.0f;
     vk::DeviceQueueCreateInfo deviceQueueCreateInfo(vk::DeviceQueueCreateFlags(), m_graphicsQueueFamilyIndex, 1, &queuePriority);
-    vk::DeviceCreateInfo deviceCreateInfo(vk::DeviceCreateFlags(), 1, &deviceQueueCreateInfo, 0, nullptr, (uint32_t)enabledExtensions.size(), enabledExtensions.data(), nullptr);
-    deviceCreateInfo.pNext = nullptr;
-    m_device = physicalDevice.createDeviceUnique(deviceCreateInfo);
+    vk::DeviceCreateInfo deviceCreateInfo(vk::DeviceCreateFlags(), 1, &deviceQueueCreateInfo, 0, nullptr, (uint32_t)enabledExtensions.size(), enabledExtensions.data(), &m_enabledFeatures);
+    deviceCreateInfo.pNext = descriptorIndexing ? &m_descriptorIndexingFeatures : nullptr;
+    m_device = m_physicalDevice.createDeviceUnique(deviceCreateInfo);
 
     m_graphicsQueue = m_device->getQueue(m_graphicsQueueFamilyIndex, 0);
     m_presentQueue = m_device->getQueue(m_presentQueueFamilyIndex, 0);
@@ -133,57 +178,66 @@ Device::~Device()
 
 }
 
-void Device::updateDescriptorSets(const vk::UniqueDescriptorSet& descriptorSet,
-                                  const std::vector<std::tuple<vk::DescriptorType, const vk::UniqueBuffer&, const vk::UniqueBufferView&>>& bufferData, 
-                                  const Texture& textureData, uint32_t bindingOffset)
+// Bindings and textures one call writes at most, so the infos live on the stack
+static const size_t MaxWrittenBindings = 16;
+
+// Writes of one descriptor each for bufferData, from bindingOffset on
+static uint32_t fillBufferWrites(const vk::UniqueDescriptorSet& descriptorSet,
+                                 const std::vector<std::tuple<vk::DescriptorType, const vk::UniqueBuffer&, const vk::UniqueBufferView&>>& bufferData,
+                                 uint32_t bindingOffset, vk::DescriptorBufferInfo* bufferInfos, vk::WriteDescriptorSet* writeDescriptorSets)
 {
-    std::vector<vk::DescriptorBufferInfo> bufferInfos;
-    bufferInfos.reserve(bufferData.size());
+    assert(bufferData.size() < MaxWrittenBindings);
 
-    std::vector<vk::WriteDescriptorSet> writeDescriptorSets;
-    writeDescriptorSets.reserve(bufferData.size() + 1);
-    uint32_t dstBinding = bindingOffset;
+    uint32_t writeCount = 0;
     for (auto const& bd : bufferData)
     {
-        bufferInfos.push_back(vk::DescriptorBufferInfo(*std::get<1>(bd), 0, VK_WHOLE_SIZE));
-        writeDescriptorSets.push_back(vk::WriteDescriptorSet(*descriptorSet, dstBinding++, 0, 1, std::get<0>(bd), nullptr, &bufferInfos.back(), std::get<2>(bd) ? &*std::get<2>(bd) : nullptr));
+        bufferInfos[writeCount] = vk::DescriptorBufferInfo(*std::get<1>(bd), 0, VK_WHOLE_SIZE);
+        writeDescriptorSets[writeCount] = vk::WriteDescriptorSet(*descriptorSet, bindingOffset + writeCount, 0, 1, std::get<0>(bd), nullptr, &bufferInfos[writeCount],
+                                                                 std::get<2>(bd) ? &*std::get<2>(bd) : nullptr);
+        writeCount++;
     }
+    return writeCount;
+}
+
+void Device::updateDescriptorSets(const vk::UniqueDescriptorSet& descriptorSet,
+                                  const std::vector<std::tuple<vk::DescriptorType, const vk::UniqueBuffer&, const vk::UniqueBufferView&>>& bufferData, 
+                                  const Texture& texture, vk::Sampler sampler, uint32_t bindingOffset)
+{
+    std::array<vk::DescriptorBufferInfo, MaxWrittenBindings> bufferInfos;
+    std::array<vk::WriteDescriptorSet, MaxWrittenBindings> writeDescriptorSets;
+    uint32_t writeCount = fillBufferWrites(descriptorSet, bufferData, bindingOffset, bufferInfos.data(), writeDescriptorSets.data());
 
-    vk::DescriptorImageInfo imageInfo(*textureData.m_textureSampler, *textureData.m_imageData->m_imageView, vk::ImageLayout::eShaderReadOnlyOptimal);
-    writeDescriptorSets.push_back(vk::WriteDescriptorSet(*descriptorSet, dstBinding, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfo, nullptr, nullptr));
+    vk::DescriptorImageInfo imageInfo(sampler, *texture.getImage().getImageView(), vk::ImageLayout::eShaderReadOnlyOptimal);
+    writeDescriptorSets[writeCount] = vk::WriteDescriptorSet(*descriptorSet, bindingOffset + writeCount, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfo);
+    writeCount++;
 
-    m_device->updateDescriptorSets(writeDescriptorSets, nullptr);
+    m_device->updateDescriptorSets(writeCount, writeDescriptorSets.data(), 0, nullptr);
 }
 
 void Device::updateDescriptorSets(const vk::UniqueDescriptorSet& descriptorSet,
                                   const std::vector<std::tuple<vk::DescriptorType, const vk::UniqueBuffer&, const vk::UniqueBufferView&>>& bufferData,
-                                  const std::vector<Texture>& textureData, uint32_t bindingOffset)
+                                  const std::vector<Texture>& textureData, vk::Sampler sampler, uint32_t bindingOffset)
 {
-    std::vector<vk::DescriptorBufferInfo> bufferInfos;
-    bufferInfos.reserve(bufferData.size());
+    assert(textureData.size() <= MaxWrittenBindings);
 
-    std::vector<vk::WriteDescriptorSet> writeDescriptorSets;
-    writeDescriptorSets.reserve(bufferData.size() + textureData.empty() ? 0 : 1);
-    uint32_t dstBinding = bindingOffset;
-    for (auto const& bd : bufferData)
-    {
-        bufferInfos.push_back(vk::DescriptorBufferInfo(*std::get<1>(bd), 0, VK_WHOLE_SIZE));
-        writeDescriptorSets.push_back(vk::WriteDescriptorSet(*descriptorSet, dstBinding++, 0, 1, std::get<0>(bd), nullptr, &bufferInfos.back(), std::get<2>(bd) ? &*std::get<2>(bd) : nullptr));
-    }
+    std::array<vk::DescriptorBufferInfo, MaxWrittenBindings> bufferInfos;
+    std::array<vk::WriteDescriptorSet, MaxWrittenBindings> writeDescriptorSets;
+    uint32_t writeCount = fillBufferWrites(descriptorSet, bufferData, bindingOffset, bufferInfos.data(), writeDescriptorSets.data());
 
-    std::vector<vk::DescriptorImageInfo> imageInfos;
+    // the textures are one array binding after the buffers
+    std::array<vk::DescriptorImageInfo, MaxWrittenBindings> imageInfos;
     if (!textureData.empty())
     {
-        imageInfos.reserve(textureData.size());
-        for (auto const& td : textureData)
+        for (size_t i = 0; i < textureData.size(); i++)
         {
-            imageInfos.push_back(vk::DescriptorImageInfo(*td.m_textureSampler, *td.m_imageData->m_imageView, vk::ImageLayout::eShaderReadOnlyOptimal));
+            imageInfos[i] = vk::DescriptorImageInfo(sampler, *textureData[i].getImage().getImageView(), vk::ImageLayout::eShaderReadOnlyOptimal);
         }
-        writeDescriptorSets.push_back(vk::WriteDescriptorSet(*descriptorSet, dstBinding, 0, (uint32_t)imageInfos.size(), vk::DescriptorType::eCombinedImageSampler, imageInfos.data(),
-                                                             nullptr, nullptr));
+        writeDescriptorSets[writeCount] = vk::WriteDescriptorSet(*descriptorSet, bindingOffset + writeCount, 0, (uint32_t)textureData.size(),
+                                                                 vk::DescriptorType::eCombinedImageSampler, imageInfos.data());
+        writeCount++;
     }
 
-    m_device->updateDescriptorSets(writeDescriptorSets, nullptr);
+    m_device->updateDescriptorSets(writeCount, writeDescriptorSets.data(), 0, nullptr);
 }
 
 
@@ -286,6 +340,7 @@ SwapChain::SwapChain(const Device& device, const RenderWindow& window, vk::Image
         swapChainCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
     }
     m_swapChain = vkdevice->createSwapchainKHRUnique(swapChainCreateInfo);
+    m_extent = swapchainExtent;
     m_images = vkdevice->getSwapchainImagesKHR(m_swapChain.get());
 
     m_imageViews.reserve(m_images.size());
@@ -319,7 +374,8 @@ void SwapChain::Acquire()
 void SwapChain::Present()
 {
     const vk::Queue& presentQueue = m_device.getPresentQueue();
-    presentQueue.presentKHR(vk::PresentInfoKHR(0, nullptr, 1, &m_swapChain.get(), &m_currentBufferIndex.value));
+    uint32 imageIndex = m_currentBufferIndex.value();
+    presentQueue.presentKHR(vk::PresentInfoKHR(0, nullptr, 1, &m_swapChain.get(), &imageIndex));
 }
 
 /////////////////////////////////////////////////////////////////////////
@@ -342,7 +398,7 @@ Buffer::~Buffer()
 
 }
 
-void Buffer::upload(const void* data, size_t size, size_t stride)
+void Buffer::upload(const void* data, size_t size, size_t stride) const
 {
     assert((m_propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent) && (m_propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible));
     assert(size <= m_size);
@@ -350,19 +406,52 @@ void Buffer::upload(const void* data, size_t size, size_t stride)
     const vk::UniqueDevice& device = m_device.getVKDevice();
 
     void* dataPtr = device->mapMemory(*m_deviceMemory, 0, size);
-    memcpy(dataPtr, &data, size);
+    memcpy(dataPtr, data, size);
     device->unmapMemory(*m_deviceMemory);
 }
 
+void Buffer::download(void* data, size_t size) const
+{
+    assert((m_propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent) && (m_propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible));
+    assert(size <= m_size);
+
+    const vk::UniqueDevice& device = m_device.getVKDevice();
+
+    void* dataPtr = device->mapMemory(*m_deviceMemory, 0, size);
+    memcpy(data, dataPtr, size);
+    device->unmapMemory(*m_deviceMemory);
+}
+
+void Buffer::upload(const vk::UniqueCommandPool& commandPool, vk::Queue queue, const void* data, size_t size) const
+{
+    assert(m_usage & vk::BufferUsageFlagBits::eTransferDst);
+    assert(m_propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal);
+    assert(size <= m_size);
+
+    const vk::UniqueDevice& device = m_device.getVKDevice();
+
+    Buffer stagingBuffer(m_device, size, vk::BufferUsageFlagBits::eTransferSrc);
+    void* dataPtr = device->mapMemory(*stagingBuffer.m_deviceMemory, 0, size);
+    memcpy(dataPtr, data, size);
+    device->unmapMemory(*stagingBuffer.m_deviceMemory);
+
+    vk::su::oneTimeSubmit(device, commandPool, queue, [&](const vk::UniqueCommandBuffer& commandBuffer)
+    {
+        commandBuffer->copyBuffer(*stagingBuffer.m_buffer, *m_buffer, vk::BufferCopy(0, 0, size));
+    });
+}
+
 /////////////////////////////////////////////////////////////////////////
 
-Image::Image(const Device& device, vk::Format format_, const vk::Extent2D& extent, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::ImageLayout initialLayout, vk::MemoryPropertyFlags memoryProperties, vk::ImageAspectFlags aspectMask)
+Image::Image(const Device& device, vk::Format format_, const vk::Extent2D& extent, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::ImageLayout initialLayout, vk::MemoryPropertyFlags memoryProperties, vk::ImageAspectFlags aspectMask,
+             uint32 mipLevels)
     : m_format(format_)
+    , m_mipLevels(mipLevels)
 {
     const vk::UniqueDevice& vkDevice = device.getVKDevice();
     const vk::PhysicalDevice& physicalDevice = device.getPhysicalDevice();
 
-    vk::ImageCreateInfo imageCreateInfo(vk::ImageCreateFlags(), vk::ImageType::e2D, m_format, vk::Extent3D(extent, 1), 1, 1,
+    vk::ImageCreateInfo imageCreateInfo(vk::ImageCreateFlags(), vk::ImageType::e2D, m_format, vk::Extent3D(extent, 1), m_mipLevels, 1,
                                         vk::SampleCountFlagBits::e1, tiling, usage | vk::ImageUsageFlagBits::eSampled, vk::SharingMode::eExclusive, 0, nullptr, initialLayout);
     m_image = vkDevice->createImageUnique(imageCreateInfo);
 
@@ -371,7 +460,7 @@ Image::Image(const Device& device, vk::Format format_, const vk::Extent2D& exten
     vkDevice->bindImageMemory(m_image.get(), m_deviceMemory.get(), 0);
 
     vk::ComponentMapping componentMapping(vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA);
-    vk::ImageViewCreateInfo imageViewCreateInfo(vk::ImageViewCreateFlags(), m_image.get(), vk::ImageViewType::e2D, m_format, componentMapping, vk::ImageSubresourceRange(aspectMask, 0, 1, 0, 1));
+    vk::ImageViewCreateInfo imageViewCreateInfo(vk::ImageViewCreateFlags(), m_image.get(), vk::ImageViewType::e2D, m_format, componentMapping, vk::ImageSubresourceRange(aspectMask, 0, m_mipLevels, 0, 1));
     m_imageView = vkDevice->createImageViewUnique(imageViewCreateInfo);
 }
 
@@ -390,9 +479,48 @@ DepthBuffer::DepthBuffer(const Device& device, vk::Format format, const vk::Exte
 
 /////////////////////////////////////////////////////////////////////////
 
-Texture::Texture(const Device& device, const vk::Extent2D& extent_, vk::ImageUsageFlags usageFlags, vk::FormatFeatureFlags formatFeatureFlags, bool anisotropyEnable, bool forceStaging)
-    : m_format(vk::Format::eR8G8B8A8Unorm)
+OffscreenTarget::OffscreenTarget(const Device& device, const vk::Extent2D& extent, vk::Format colorFormat)
+    : m_extent(extent)
+    , m_colorImage(device, colorFormat, extent, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eColorAttachment, vk::ImageLayout::eUndefined,
+                   vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor)
+    , m_depthBuffer(device, vk::su::pickDepthFormat(device.getPhysicalDevice()), extent)
+{
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+    m_renderPass = vk::su::createRenderPass(vkDevice, colorFormat, m_depthBuffer.getFormat(), vk::AttachmentLoadOp::eClear, vk::ImageLayout::eColorAttachmentOptimal);
+    vk::ImageView attachments[2] = { m_colorImage.getImageView().get(), m_depthBuffer.getImageView().get() };
+    m_framebuffer = vkDevice->createFramebufferUnique(vk::FramebufferCreateInfo({}, m_renderPass.get(), 2, attachments, extent.width, extent.height, 1));
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+
+}
+
+void OffscreenTarget::beginRenderPass(const vk::UniqueCommandBuffer& commandBuffer) const
+{
+    // the clear of this pass must not overtake the attachment writes of the one before
+    vk::PipelineStageFlags attachmentStages = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests |
+                                              vk::PipelineStageFlagBits::eLateFragmentTests;
+    vk::MemoryBarrier barrier(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                              vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+    commandBuffer->pipelineBarrier(attachmentStages, attachmentStages, {}, barrier, nullptr, nullptr);
+
+    vk::ClearValue clearValues[2];
+    clearValues[0].color = vk::ClearColorValue(std::array<float, 4>({ 0.2f, 0.2f, 0.2f, 0.2f }));
+    clearValues[1].depthStencil = vk::ClearDepthStencilValue(1.0f, 0);
+    vk::Rect2D area(vk::Offset2D(0, 0), m_extent);
+    commandBuffer->beginRenderPass(vk::RenderPassBeginInfo(m_renderPass.get(), m_framebuffer.get(), area, 2, clearValues), vk::SubpassContents::eInline);
+    commandBuffer->setViewport(0, vk::Viewport(0.0f, 0.0f, float(m_extent.width), float(m_extent.height), 0.0f, 1.0f));
+    commandBuffer->setScissor(0, area);
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+Texture::Texture(const Device& device, const vk::Extent2D& extent_, vk::ImageUsageFlags usageFlags, vk::FormatFeatureFlags formatFeatureFlags, bool anisotropyEnable, bool forceStaging,
+                 bool mipmaps, vk::Format format)
+    : m_format(format)
     , m_extent(extent_)
+    , m_blitMips(false)
 {
     const vk::UniqueDevice& vkDevice = device.getVKDevice();
     const vk::PhysicalDevice& physicalDevice = device.getPhysicalDevice();
@@ -401,16 +529,25 @@ Texture::Texture(const Device& device, const vk::Extent2D& extent_, vk::ImageUsa
     vk::FormatProperties formatProperties = physicalDevice.getFormatProperties(m_format);
 
     formatFeatureFlags |= vk::FormatFeatureFlagBits::eSampledImage;
-    m_needsStaging = forceStaging || ((formatProperties.linearTilingFeatures & formatFeatureFlags) != formatFeatureFlags);
+    // linear tiling has a single level, and block compressed formats are encoded on the CPU into the staging buffer
+    uint32 mipLevels = mipmaps ? getMipLevelCount(m_extent) : 1;
+    bool compressed = isBlockCompressed(m_format);
+    assert(!compressed || (device.getEnabledFeatures().textureCompressionBC && isBlockFormatSupported(physicalDevice, m_format)));
+    m_needsStaging = forceStaging || mipLevels > 1 || compressed || ((formatProperties.linearTilingFeatures & formatFeatureFlags) != formatFeatureFlags);
     vk::ImageTiling imageTiling;
     vk::ImageLayout initialLayout;
     vk::MemoryPropertyFlags requirements;
     if (m_needsStaging)
     {
         assert((formatProperties.optimalTilingFeatures & formatFeatureFlags) == formatFeatureFlags);
-        m_stagingBufferData = std::make_unique<Buffer>(physicalDevice, device, m_extent.width * m_extent.height * 4, vk::BufferUsageFlagBits::eTransferSrc);
+        m_blitMips = mipLevels > 1 && !compressed && canBlitMips(physicalDevice, m_format);
+        m_stagingBufferData = std::make_unique<Buffer>(device, getMipChainSize(m_extent, m_blitMips ? 1 : mipLevels, m_format), vk::BufferUsageFlagBits::eTransferSrc);
         imageTiling = vk::ImageTiling::eOptimal;
         usageFlags |= vk::ImageUsageFlagBits::eTransferDst;
+        if (m_blitMips)
+        {
+            usageFlags |= vk::ImageUsageFlagBits::eTransferSrc;
+        }
         initialLayout = vk::ImageLayout::eUndefined;
     }
     else
@@ -419,8 +556,8 @@ Texture::Texture(const Device& device, const vk::Extent2D& extent_, vk::ImageUsa
         initialLayout = vk::ImageLayout::ePreinitialized;
         requirements = vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible;
     }
-    m_imageData = std::make_unique<Image>(physicalDevice, device, m_format, m_extent, imageTiling, usageFlags | vk::ImageUsageFlagBits::eSampled, initialLayout, requirements,
-                                            vk::ImageAspectFlagBits::eColor);
+    m_imageData = std::make_unique<Image>(device, m_format, m_extent, imageTiling, usageFlags | vk::ImageUsageFlagBits::eSampled, initialLayout, requirements,
+                                            vk::ImageAspectFlagBits::eColor, mipLevels);
 
     //textureSampler = device->createSamplerUnique(vk::SamplerCreateInfo(vk::SamplerCreateFlags(), vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear,
     //                                                                   vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, 0.0f, anisotropyEnable,
@@ -431,3 +568,39 @@ Texture::~Texture()
 {
 
 }
+
+void Texture::recordUpload(const vk::UniqueCommandBuffer& commandBuffer) const
+{
+    vk::Image image = m_imageData->getVKImage().get();
+    if (!m_needsStaging)
+    {
+        // If we can use the linear tiled image as a texture, just do it
+        vk::su::setImageLayout(commandBuffer, image, m_format, vk::ImageLayout::ePreinitialized, vk::ImageLayout::eShaderReadOnlyOptimal);
+        return;
+    }
+
+    // Since we're going to blit to the texture image, set its layout to eTransferDstOptimal
+    uint32 mipLevels = getMipLevels();
+    vk::su::setImageLayout(commandBuffer, image, m_format, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, 0, mipLevels);
+
+    // one region per level the staging buffer holds, tightly packed, which block compressed levels narrower than a
+    // block need
+    std::vector<vk::BufferImageCopy> copyRegions;
+    vk::DeviceSize offset = 0;
+    for (uint32 level = 0; level < (m_blitMips ? 1 : mipLevels); level++)
+    {
+        vk::Extent2D extent = getMipExtent(m_extent, level);
+        copyRegions.push_back(vk::BufferImageCopy(offset, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1),
+                                                  vk::Offset3D(0, 0, 0), vk::Extent3D(extent, 1)));
+        offset += getImageSize(m_format, extent);
+    }
+    commandBuffer->copyBufferToImage(m_stagingBufferData->getVKBuffer().get(), image, vk::ImageLayout::eTransferDstOptimal, copyRegions);
+
+    if (m_blitMips)
+    {
+        recordMipBlits(commandBuffer, image, m_format, m_extent, mipLevels);
+        return;
+    }
+    // Set the layout for the texture image from eTransferDstOptimal to SHADER_READ_ONLY
+    vk::su::setImageLayout(commandBuffer, image, m_format, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, 0, mipLevels);
+}
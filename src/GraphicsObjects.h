@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Common.h"
+#include "Mipmaps.h"
+#include "PixelConversion.h"
+#include "TextureCompression.h"
 #include <vulkan/vulkan.hpp>
 
 class RenderWindow
@@ -24,30 +27,46 @@ private:
     uint32                m_height;
 };
 
+class Texture;
+
 class Device
 {
 public:
-    Device(const RenderWindow& window, vk::PhysicalDevice physicalDevice);
+    // instanceApiVersion is the apiVersion the instance was created with, the default the one of vk::su::createInstance.
+    // Features that need Vulkan 1.1 are only queried when both the instance and the physical device have it.
+    Device(const RenderWindow& window, vk::PhysicalDevice physicalDevice, uint32 instanceApiVersion = VK_API_VERSION_1_1);
+    // Headless, for compute and benchmarks: a graphics queue that doubles as present queue and no swapchain support
+    explicit Device(vk::PhysicalDevice physicalDevice, uint32 instanceApiVersion = VK_API_VERSION_1_1);
     ~Device();
 
     const vk::PhysicalDevice& getPhysicalDevice() const { return m_physicalDevice; }
     const vk::UniqueDevice& getVKDevice() const { return m_device; }
 
+    const vk::Queue& getGraphicsQueue() const { return m_graphicsQueue; }
     const vk::Queue& getPresentQueue() const { return m_presentQueue; }
 
     uint32 getGraphicsQueueFamilyIndex() const { return m_graphicsQueueFamilyIndex; }
     uint32 getPresentQueueFamilyIndex() const { return m_presentQueueFamilyIndex; }
 
+    // Optional features the device was created with when the physical device supports them
+    const vk::PhysicalDeviceFeatures& getEnabledFeatures() const { return m_enabledFeatures; }
+
+    // The descriptor indexing features enabled for BindlessTextureTable, all off when the device lacks VK_EXT_descriptor_indexing
+    const vk::PhysicalDeviceDescriptorIndexingFeaturesEXT& getDescriptorIndexingFeatures() const { return m_descriptorIndexingFeatures; }
+
+    // Buffers at consecutive bindings from bindingOffset on, then the texture or the array of textures. Up to 15 buffers
+    // and 16 textures, written without allocating, see DescriptorUpdateTemplate for sets updated every frame.
     void updateDescriptorSets(const vk::UniqueDescriptorSet& descriptorSet,
                               const std::vector<std::tuple<vk::DescriptorType, const vk::UniqueBuffer&, const vk::UniqueBufferView&>>& bufferData,
-                              const std::pair<Texture, const vk::UniqueSampler&>& sr,
-                              uint32_t bindingOffset = 0);
+                              const Texture& texture, vk::Sampler sampler, uint32_t bindingOffset = 0);
     
     void updateDescriptorSets(const vk::UniqueDescriptorSet& descriptorSet,
                               const std::vector<std::tuple<vk::DescriptorType, const vk::UniqueBuffer&, const vk::UniqueBufferView&>>& bufferData,
-                              const std::vector<Texture>& textureData, uint32_t bindingOffset = 0);
+                              const std::vector<Texture>& textureData, vk::Sampler sampler, uint32_t bindingOffset = 0);
 
 private:
+    void createDevice(const std::vector<std::string>& extensions, uint32 instanceApiVersion);
+
     vk::PhysicalDevice    m_physicalDevice;
     vk::UniqueDevice      m_device;
     vk::Queue             m_graphicsQueue;
@@ -55,6 +74,9 @@ private:
 
     uint32                m_graphicsQueueFamilyIndex;
     uint32                m_presentQueueFamilyIndex;
+
+    vk::PhysicalDeviceFeatures                      m_enabledFeatures;
+    vk::PhysicalDeviceDescriptorIndexingFeaturesEXT m_descriptorIndexingFeatures;
 };
 
 class SwapChain
@@ -63,14 +85,21 @@ public:
     SwapChain(const Device& device, const RenderWindow& window, vk::ImageUsageFlags usage, const vk::UniqueSwapchainKHR& oldSwapChain);
     ~SwapChain();
 
+    // Acquire signals getImageAcquiredSemaphore(), which the submission drawing to the image waits for before Present
     void Acquire();
     void Present();
 
     uint32 getCurrentImageIndex() const { return m_currentBufferIndex.value(); } 
 
+    vk::Format getColorFormat() const { return m_colorFormat; }
+    const vk::Extent2D& getExtent() const { return m_extent; }
+    const std::vector<vk::UniqueImageView>& getImageViews() const { return m_imageViews; }
+    const vk::UniqueSemaphore& getImageAcquiredSemaphore() const { return m_imageAcquiredSemaphore; }
+
 private:
     const Device&                     m_device;
     vk::Format                        m_colorFormat;
+    vk::Extent2D                      m_extent;
     vk::UniqueSwapchainKHR            m_swapChain;
     std::vector<vk::Image>            m_images;
     std::vector<vk::UniqueImageView>  m_imageViews;
@@ -86,7 +115,14 @@ public:
     Buffer(const Device& device, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags propertyFlags = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
     ~Buffer();
 
-    void upload(const void* data, size_t size, size_t stride);
+    const vk::UniqueBuffer& getVKBuffer() const { return m_buffer; }
+    const vk::UniqueDeviceMemory& getDeviceMemory() const { return m_deviceMemory; }
+    vk::DeviceSize getSize() const { return m_size; }
+
+    void upload(const void* data, size_t size, size_t stride) const;
+
+    // Host visible buffers only, e.g. counters a dispatch wrote, once its command buffer completed
+    void download(void* data, size_t size) const;
 
     template <typename DataType>
     void upload(const DataType& data) const
@@ -104,7 +140,7 @@ public:
 
         const vk::UniqueDevice& device = m_device.getVKDevice();
 
-        copyToDevice(device, m_deviceMemory, data.data(), data.size(), elementSize);
+        vk::su::copyToDevice(device, m_deviceMemory, data.data(), data.size(), elementSize);
     }
 
     template <typename DataType>
@@ -119,8 +155,10 @@ public:
         size_t dataSize = data.size() * elementSize;
         assert(dataSize <= m_size);
 
+        const vk::UniqueDevice& device = m_device.getVKDevice();
+
         Buffer stagingBuffer(m_device, dataSize, vk::BufferUsageFlagBits::eTransferSrc);
-        copyToDevice(device, stagingBuffer.m_deviceMemory, data.data(), data.size(), elementSize);
+        vk::su::copyToDevice(device, stagingBuffer.m_deviceMemory, data.data(), data.size(), elementSize);
 
         vk::su::oneTimeSubmit(device, commandPool, queue, [&](const vk::UniqueCommandBuffer& commandBuffer) 
         {
@@ -128,6 +166,9 @@ public:
         });
     }
 
+    // Device local upload of raw bytes through a staging buffer, e.g. straight from the pages of a MappedFile
+    void upload(const vk::UniqueCommandPool& commandPool, vk::Queue queue, const void* data, size_t size) const;
+
 private:
     const Device&           m_device;
     vk::UniqueBuffer        m_buffer;
@@ -142,11 +183,18 @@ class Image
 {
 public:
     Image(const Device& device, vk::Format format, const vk::Extent2D& extent, vk::ImageTiling tiling, vk::ImageUsageFlags usage, 
-          vk::ImageLayout initialLayout, vk::MemoryPropertyFlags memoryProperties, vk::ImageAspectFlags aspectMask);
+          vk::ImageLayout initialLayout, vk::MemoryPropertyFlags memoryProperties, vk::ImageAspectFlags aspectMask, uint32 mipLevels = 1);
     virtual ~Image();
 
+    const vk::UniqueImage& getVKImage() const { return m_image; }
+    // Covers all mip levels
+    const vk::UniqueImageView& getImageView() const { return m_imageView; }
+    vk::Format getFormat() const { return m_format; }
+    uint32 getMipLevels() const { return m_mipLevels; }
+
 private:
     vk::Format              m_format;
+    uint32                  m_mipLevels;
     vk::UniqueImage         m_image;
     vk::UniqueDeviceMemory  m_deviceMemory;
     vk::UniqueImageView     m_imageView;
@@ -158,13 +206,44 @@ public:
     DepthBuffer(const Device& device, vk::Format format, const vk::Extent2D& extent);
 };
 
+// Color and depth image with a render pass drawing into them, for benchmarks that render without a window. The color
+// image stays in eColorAttachmentOptimal.
+class OffscreenTarget
+{
+public:
+    OffscreenTarget(const Device& device, const vk::Extent2D& extent, vk::Format colorFormat = vk::Format::eR8G8B8A8Unorm);
+    ~OffscreenTarget();
+
+    const vk::UniqueRenderPass& getRenderPass() const { return m_renderPass; }
+    const vk::Extent2D& getExtent() const { return m_extent; }
+    const Image& getColorImage() const { return m_colorImage; }
+
+    // Clears both images and sets viewport and scissor to the whole target. Waits for the attachment writes of the
+    // passes recorded before, so several passes can follow each other in one command buffer.
+    void beginRenderPass(const vk::UniqueCommandBuffer& commandBuffer) const;
+
+private:
+    vk::Extent2D            m_extent;
+    Image                   m_colorImage;
+    DepthBuffer             m_depthBuffer;
+    vk::UniqueRenderPass    m_renderPass;
+    vk::UniqueFramebuffer   m_framebuffer;
+};
+
 class Texture
 {
 public:
+    // With mipmaps the image gets a full chain in optimal tiling, blitted on the GPU where the format allows it and
+    // filtered on the CPU otherwise. format is eR8G8B8A8Unorm or one of the block formats of TextureCompression.h,
+    // into which setImage encodes the generated pixels.
     Texture(const Device& device, const vk::Extent2D& extent_ = { 256, 256 }, vk::ImageUsageFlags usageFlags = {},
-            vk::FormatFeatureFlags formatFeatureFlags = {}, bool anisotropyEnable = false, bool forceStaging = false);
+            vk::FormatFeatureFlags formatFeatureFlags = {}, bool anisotropyEnable = false, bool forceStaging = false, bool mipmaps = false,
+            vk::Format format = vk::Format::eR8G8B8A8Unorm);
     ~Texture();
 
+    const Image& getImage() const { return *m_imageData; }
+    uint32 getMipLevels() const { return m_imageData->getMipLevels(); }
+
     template <typename ImageGenerator>
     void setImage(const Device& device, const vk::UniqueCommandBuffer& commandBuffer, const ImageGenerator& imageGenerator)
     {
@@ -173,30 +252,56 @@ public:
         void* data = m_needsStaging
             ? vkDevice->mapMemory(m_stagingBufferData->m_deviceMemory.get(), 0, vkDevice->getBufferMemoryRequirements(m_stagingBufferData->m_buffer.get()).size)
             : vkDevice->mapMemory(m_imageData->m_deviceMemory.get(), 0, vkDevice->getImageMemoryRequirements(m_imageData->m_image.get()).size);
-        imageGenerator(data, m_extent);
-        vkDevice->unmapMemory(m_needsStaging ? m_stagingBufferData->m_deviceMemory.get() : m_imageData->m_deviceMemory.get());
 
-        if (m_needsStaging)
+        // generators write tightly packed rows, the rows of a linear image may be padded
+        size_t rowBytes = size_t(m_extent.width) * 4;
+        vk::SubresourceLayout layout(0, 0, rowBytes);
+        if (!m_needsStaging)
         {
-            // Since we're going to blit to the texture image, set its layout to eTransferDstOptimal
-            vk::su::setImageLayout(commandBuffer, m_imageData->m_image.get(), m_imageData->m_format, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-            vk::BufferImageCopy copyRegion(0, m_extent.width, m_extent.height, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0), vk::Extent3D(extent, 1));
-            commandBuffer->copyBufferToImage(m_stagingBufferData->m_buffer.get(), m_imageData->m_image.get(), vk::ImageLayout::eTransferDstOptimal, copyRegion);
-            // Set the layout for the texture image from eTransferDstOptimal to SHADER_READ_ONLY
-            vk::su::setImageLayout(commandBuffer, m_imageData->m_image.get(), m_imageData->m_format, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+            layout = vkDevice->getImageSubresourceLayout(m_imageData->m_image.get(), vk::ImageSubresource(vk::ImageAspectFlagBits::eColor, 0, 0));
+        }
+        if (isBlockCompressed(m_format))
+        {
+            std::vector<uint8_t> pixels(rowBytes * m_extent.height);
+            imageGenerator(pixels.data(), m_extent);
+            if (getMipLevels() > 1)
+            {
+                std::vector<uint8_t> chain(getMipChainSize(m_extent, getMipLevels()));
+                generateMipChain(pixels.data(), m_extent, MipFilter::Kaiser, chain.data());
+                pixels.swap(chain);
+            }
+            compressMipChain(pixels.data(), m_extent, getMipLevels(), m_format, CompressionQuality::Normal, static_cast<uint8_t*>(data));
+        }
+        else if (getMipLevels() > 1 && !m_blitMips)
+        {
+            // the staging buffer holds the whole chain, filtered from a copy of the top level
+            std::vector<uint8_t> pixels(rowBytes * m_extent.height);
+            imageGenerator(pixels.data(), m_extent);
+            generateMipChain(pixels.data(), m_extent, MipFilter::Kaiser, static_cast<uint8_t*>(data));
+        }
+        else if (layout.rowPitch == rowBytes)
+        {
+            imageGenerator(static_cast<uint8_t*>(data) + layout.offset, m_extent);
         }
         else
         {
-            // If we can use the linear tiled image as a texture, just do it
-            vk::su::setImageLayout(commandBuffer, m_imageData->m_image.get(), m_imageData->m_format, vk::ImageLayout::ePreinitialized, vk::ImageLayout::eShaderReadOnlyOptimal);
+            std::vector<uint8_t> pixels(rowBytes * m_extent.height);
+            imageGenerator(pixels.data(), m_extent);
+            copyPixels(pixels.data(), rowBytes, static_cast<uint8_t*>(data) + layout.offset, size_t(layout.rowPitch), m_extent);
         }
+        vkDevice->unmapMemory(m_needsStaging ? m_stagingBufferData->m_deviceMemory.get() : m_imageData->m_deviceMemory.get());
+
+        recordUpload(commandBuffer);
     }
 
 private:
+    // Copies the staging buffer to the image and brings every level into eShaderReadOnlyOptimal
+    void recordUpload(const vk::UniqueCommandBuffer& commandBuffer) const;
 
     vk::Format                  m_format;
     vk::Extent2D                m_extent;
     bool                        m_needsStaging;
+    bool                        m_blitMips;
     std::unique_ptr<Buffer>     m_stagingBufferData;
     std::unique_ptr<Image>      m_imageData;
-};
\ No newline at end of file
+};
\ No newline at end of file
@@ -0,0 +1,1423 @@
+#include "ImageDecoder.h"
+#include "PixelConversion.h"
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+// Codes up to this long decode with a single table lookup, longer ones walk the code lengths
+static const uint32 HuffmanFastBits = 10;
+
+// Larger images are rejected before anything gets allocated for them
+static const uint32 MaxImageDimension = 1 << 15;
+
+static uint32 readBigEndian32(const uint8_t* data)
+{
+    return (uint32(data[0]) << 24) | (uint32(data[1]) << 16) | (uint32(data[2]) << 8) | uint32(data[3]);
+}
+
+static uint32 readBigEndian16(const uint8_t* data)
+{
+    return (uint32(data[0]) << 8) | uint32(data[1]);
+}
+
+/////////////////////////////////////////////////////////////////////////
+// Inflate (RFC 1950 and 1951) of the zlib stream in the IDAT chunks of a PNG
+
+// Reads bits from the least significant end of each byte. Reading past the end returns zeros and is detected by
+// isOverrun(), so decoding loops need no checks of their own.
+class DeflateReader
+{
+public:
+    DeflateReader(const uint8_t* data, size_t size)
+        : m_data(data)
+        , m_end(data + size)
+        , m_bits(0)
+        , m_count(0)
+        , m_paddingBits(0)
+    {
+    }
+
+    // count up to 32
+    uint32 peek(uint32 count)
+    {
+        if (m_count < count)
+        {
+            refill();
+        }
+        return uint32(m_bits & ((uint64(1) << count) - 1));
+    }
+
+    void skip(uint32 count)
+    {
+        m_bits >>= count;
+        m_count -= count;
+    }
+
+    uint32 read(uint32 count)
+    {
+        uint32 value = peek(count);
+        skip(count);
+        return value;
+    }
+
+    void alignToByte()
+    {
+        skip(m_count & 7);
+    }
+
+    bool isOverrun() const { return m_paddingBits > m_count; }
+
+private:
+    void refill()
+    {
+        while (m_count <= 56)
+        {
+            uint64 byte = 0;
+            if (m_data < m_end)
+            {
+                byte = *m_data++;
+            }
+            else
+            {
+                m_paddingBits += 8;
+            }
+            m_bits |= byte << m_count;
+            m_count += 8;
+        }
+    }
+
+    const uint8_t*  m_data;
+    const uint8_t*  m_end;
+    uint64          m_bits;
+    uint32          m_count;
+    uint32          m_paddingBits;  // zeros at the top of m_bits that are not in the stream
+};
+
+struct DeflateHuffmanTable
+{
+    uint16  fast[1 << HuffmanFastBits];     // (symbol << 4) | length, 0 for longer codes
+    uint16  counts[16];
+    uint16  symbols[288];                   // sorted by code length, then by symbol
+};
+
+static const uint16 LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16 DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                         6145, 8193, 12289, 16385, 24577 };
+static const uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// Incomplete codes are allowed, deflate uses them for distance codes with a single symbol
+static bool buildHuffmanTable(DeflateHuffmanTable& table, const uint8_t* lengths, uint32 count)
+{
+    memset(table.counts, 0, sizeof(table.counts));
+    for (uint32 i = 0; i < count; i++)
+    {
+        table.counts[lengths[i]]++;
+    }
+    table.counts[0] = 0;
+
+    int32 left = 1;
+    uint16 offsets[16] = {};
+    for (uint32 length = 1; length < 16; length++)
+    {
+        left = (left << 1) - table.counts[length];
+        if (left < 0)
+        {
+            return false;
+        }
+        if (length < 15)
+        {
+            offsets[length + 1] = offsets[length] + table.counts[length];
+        }
+    }
+    for (uint32 i = 0; i < count; i++)
+    {
+        if (lengths[i])
+        {
+            table.symbols[offsets[lengths[i]]++] = uint16(i);
+        }
+    }
+
+    // the stream holds codes from their most significant bit on, the lookup index is in reading order
+    memset(table.fast, 0, sizeof(table.fast));
+    uint32 code = 0;
+    uint32 index = 0;
+    for (uint32 length = 1; length <= HuffmanFastBits; length++)
+    {
+        for (uint32 i = 0; i < table.counts[length]; i++, code++, index++)
+        {
+            uint32 reversed = 0;
+            for (uint32 bit = 0; bit < length; bit++)
+            {
+                reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+            }
+            for (uint32 entry = reversed; entry < (1u << HuffmanFastBits); entry += 1u << length)
+            {
+                table.fast[entry] = uint16((table.symbols[index] << 4) | length);
+            }
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+static int32 decodeSymbol(DeflateReader& reader, const DeflateHuffmanTable& table)
+{
+    uint32 entry = table.fast[reader.peek(HuffmanFastBits)];
+    if (entry)
+    {
+        reader.skip(entry & 15);
+        return int32(entry >> 4);
+    }
+
+    // one bit at a time, from the first code of each length
+    int32 code = 0;
+    int32 first = 0;
+    int32 index = 0;
+    for (uint32 length = 1; length < 16; length++)
+    {
+        code |= int32(reader.read(1));
+        int32 count = table.counts[length];
+        if (code - first < count)
+        {
+            return table.symbols[index + code - first];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static bool readDynamicTables(DeflateReader& reader, DeflateHuffmanTable& literals, DeflateHuffmanTable& distances)
+{
+    uint32 literalCount = reader.read(5) + 257;
+    uint32 distanceCount = reader.read(5) + 1;
+    uint32 codeLengthCount = reader.read(4) + 4;
+    if (literalCount > 286 || distanceCount > 30)
+    {
+        return false;
+    }
+
+    uint8_t lengths[286 + 30] = {};
+    for (uint32 i = 0; i < codeLengthCount; i++)
+    {
+        lengths[CodeLengthOrder[i]] = uint8_t(reader.read(3));
+    }
+    DeflateHuffmanTable codeLengths;
+    if (!buildHuffmanTable(codeLengths, lengths, 19))
+    {
+        return false;
+    }
+
+    memset(lengths, 0, sizeof(lengths));
+    uint32 count = literalCount + distanceCount;
+    for (uint32 index = 0; index < count;)
+    {
+        int32 symbol = decodeSymbol(reader, codeLengths);
+        if (symbol < 0 || reader.isOverrun())
+        {
+            return false;
+        }
+        if (symbol < 16)
+        {
+            lengths[index++] = uint8_t(symbol);
+            continue;
+        }
+
+        uint8_t length = 0;
+        uint32 repeat;
+        if (symbol == 16)
+        {
+            if (!index)
+            {
+                return false;
+            }
+            length = lengths[index - 1];
+            repeat = 3 + reader.read(2);
+        }
+        else
+        {
+            repeat = symbol == 17 ? 3 + reader.read(3) : 11 + reader.read(7);
+        }
+        if (index + repeat > count)
+        {
+            return false;
+        }
+        memset(lengths + index, length, repeat);
+        index += repeat;
+    }
+
+    return lengths[256] && buildHuffmanTable(literals, lengths, literalCount) && buildHuffmanTable(distances, lengths + literalCount, distanceCount);
+}
+
+static void buildFixedTables(DeflateHuffmanTable& literals, DeflateHuffmanTable& distances)
+{
+    uint8_t lengths[288];
+    memset(lengths, 8, 144);
+    memset(lengths + 144, 9, 112);
+    memset(lengths + 256, 7, 24);
+    memset(lengths + 280, 8, 8);
+    buildHuffmanTable(literals, lengths, 288);
+
+    memset(lengths, 5, 30);
+    buildHuffmanTable(distances, lengths, 30);
+}
+
+// Succeeds only when the stream fills output exactly
+static bool inflate(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize)
+{
+    // deflate without a preset dictionary
+    if (size < 2 || (data[0] & 15) != 8 || (data[0] >> 4) > 7 || readBigEndian16(data) % 31 || (data[1] & 0x20))
+    {
+        return false;
+    }
+
+    DeflateReader reader(data + 2, size - 2);
+    DeflateHuffmanTable literals;
+    DeflateHuffmanTable distances;
+    size_t position = 0;
+    bool lastBlock;
+    do
+    {
+        lastBlock = reader.read(1) != 0;
+        uint32 blockType = reader.read(2);
+        if (blockType == 0)
+        {
+            reader.alignToByte();
+            uint32 length = reader.read(16);
+            if (length != (~reader.read(16) & 0xffff) || length > outputSize - position)
+            {
+                return false;
+            }
+            for (uint32 i = 0; i < length; i++)
+            {
+                output[position++] = uint8_t(reader.read(8));
+            }
+        }
+        else if (blockType == 3)
+        {
+            return false;
+        }
+        else
+        {
+            if (blockType == 1)
+            {
+                buildFixedTables(literals, distances);
+            }
+            else if (!readDynamicTables(reader, literals, distances))
+            {
+                return false;
+            }
+
+            for (;;)
+            {
+                int32 symbol = decodeSymbol(reader, literals);
+                if (symbol < 0 || reader.isOverrun())
+                {
+                    return false;
+                }
+                if (symbol < 256)
+                {
+                    if (position == outputSize)
+                    {
+                        return false;
+                    }
+                    output[position++] = uint8_t(symbol);
+                    continue;
+                }
+                if (symbol == 256)
+                {
+                    break;
+                }
+
+                symbol -= 257;
+                if (symbol >= 29)
+                {
+                    return false;
+                }
+                uint32 length = LengthBase[symbol] + reader.read(LengthExtra[symbol]);
+                int32 distanceSymbol = decodeSymbol(reader, distances);
+                if (distanceSymbol < 0 || distanceSymbol >= 30)
+                {
+                    return false;
+                }
+                uint32 distance = DistanceBase[distanceSymbol] + reader.read(DistanceExtra[distanceSymbol]);
+                if (distance > position || length > outputSize - position)
+                {
+                    return false;
+                }
+
+                // byte by byte, the source may overlap what is written
+                const uint8_t* source = output + position - distance;
+                for (uint32 i = 0; i < length; i++)
+                {
+                    output[position + i] = source[i];
+                }
+                position += length;
+            }
+        }
+        if (reader.isOverrun())
+        {
+            return false;
+        }
+    } while (!lastBlock);
+
+    return position == outputSize;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// PNG
+
+static const uint8_t PngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+struct PngHeader
+{
+    vk::Extent2D    extent;
+    uint32          bitDepth;
+    uint32          colorType;      // 0 gray, 2 RGB, 3 palette, 4 gray and alpha, 6 RGBA
+    uint32          channels;
+    size_t          rowSize;        // without the filter type byte
+    size_t          pixelSize;      // bytes, at least 1, the distance filters look back
+};
+
+static bool readPngHeader(const uint8_t* data, size_t size, PngHeader& header)
+{
+    // the IHDR chunk comes first
+    if (size < 33 || memcmp(data, PngSignature, 8) || readBigEndian32(data + 8) != 13 || memcmp(data + 12, "IHDR", 4))
+    {
+        return false;
+    }
+
+    header.extent = vk::Extent2D(readBigEndian32(data + 16), readBigEndian32(data + 20));
+    header.bitDepth = data[24];
+    header.colorType = data[25];
+    if (!header.extent.width || !header.extent.height || header.extent.width > MaxImageDimension || header.extent.height > MaxImageDimension ||
+        data[26] != 0 || data[27] != 0 || data[28] != 0)
+    {
+        return false;
+    }
+
+    uint32 depth = header.bitDepth;
+    switch (header.colorType)
+    {
+    case 0:
+        header.channels = 1;
+        if (depth != 1 && depth != 2 && depth != 4 && depth != 8 && depth != 16)
+        {
+            return false;
+        }
+        break;
+    case 3:
+        header.channels = 1;
+        if (depth != 1 && depth != 2 && depth != 4 && depth != 8)
+        {
+            return false;
+        }
+        break;
+    case 2:
+    case 4:
+    case 6:
+        header.channels = header.colorType == 2 ? 3 : header.colorType == 4 ? 2 : 4;
+        if (depth != 8 && depth != 16)
+        {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+
+    uint32 pixelBits = header.channels * depth;
+    header.rowSize = (size_t(header.extent.width) * pixelBits + 7) / 8;
+    header.pixelSize = std::max(pixelBits / 8, 1u);
+    return true;
+}
+
+static uint8_t paethPredictor(int32 left, int32 up, int32 upLeft)
+{
+    int32 estimate = left + up - upLeft;
+    int32 distanceLeft = abs(estimate - left);
+    int32 distanceUp = abs(estimate - up);
+    int32 distanceUpLeft = abs(estimate - upLeft);
+    if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft)
+    {
+        return uint8_t(left);
+    }
+    return uint8_t(distanceUp <= distanceUpLeft ? up : upLeft);
+}
+
+// In place, previous is the unfiltered row above or zeros for the first row
+static bool unfilterPngRow(uint32 filterType, uint8_t* row, const uint8_t* previous, size_t rowSize, size_t pixelSize)
+{
+    switch (filterType)
+    {
+    case 0:
+        break;
+    case 1:
+        for (size_t i = pixelSize; i < rowSize; i++)
+        {
+            row[i] = uint8_t(row[i] + row[i - pixelSize]);
+        }
+        break;
+    case 2:
+        for (size_t i = 0; i < rowSize; i++)
+        {
+            row[i] = uint8_t(row[i] + previous[i]);
+        }
+        break;
+    case 3:
+        for (size_t i = 0; i < rowSize; i++)
+        {
+            uint32 left = i >= pixelSize ? row[i - pixelSize] : 0;
+            row[i] = uint8_t(row[i] + ((left + previous[i]) >> 1));
+        }
+        break;
+    case 4:
+        for (size_t i = 0; i < rowSize; i++)
+        {
+            bool first = i < pixelSize;
+            row[i] = uint8_t(row[i] + paethPredictor(first ? 0 : row[i - pixelSize], previous[i], first ? 0 : previous[i - pixelSize]));
+        }
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+static uint32 getPngSample(const uint8_t* row, size_t index, uint32 depth)
+{
+    switch (depth)
+    {
+    case 8:
+        return row[index];
+    case 16:
+        return readBigEndian16(row + index * 2);
+    default:
+        {
+            size_t bit = index * depth;
+            return (row[bit / 8] >> (8 - depth - bit % 8)) & ((1u << depth) - 1);
+        }
+    }
+}
+
+// Palette entries and the transparent color of the tRNS chunk
+struct PngColors
+{
+    uint32  palette[256];
+    uint32  transparent[3];
+    bool    hasTransparent;
+};
+
+static void convertPngRow(const PngHeader& header, const PngColors& colors, const uint8_t* row, uint8_t* rgba)
+{
+    uint32 width = header.extent.width;
+    uint32 depth = header.bitDepth;
+    if (header.colorType == 6 && depth == 8)
+    {
+        memcpy(rgba, row, size_t(width) * 4);
+        return;
+    }
+    if (header.colorType == 2 && depth == 8 && !colors.hasTransparent)
+    {
+        expandRgbToRgba(row, header.rowSize, rgba, size_t(width) * 4, vk::Extent2D(width, 1));
+        return;
+    }
+    if (header.colorType == 3)
+    {
+        for (uint32 x = 0; x < width; x++)
+        {
+            memcpy(rgba + x * 4, &colors.palette[getPngSample(row, x, depth)], 4);
+        }
+        return;
+    }
+
+    // samples scaled to 8 bits, 16 bit ones by their high byte
+    uint32 scale = depth < 8 ? 255 / ((1u << depth) - 1) : 1;
+    uint32 shift = depth == 16 ? 8 : 0;
+    uint32 channels = header.channels;
+    for (uint32 x = 0; x < width; x++)
+    {
+        uint32 samples[4];
+        for (uint32 channel = 0; channel < channels; channel++)
+        {
+            samples[channel] = getPngSample(row, size_t(x) * channels + channel, depth);
+        }
+
+        uint8_t* pixel = rgba + x * 4;
+        if (channels <= 2)
+        {
+            pixel[0] = pixel[1] = pixel[2] = uint8_t((samples[0] * scale) >> shift);
+            pixel[3] = channels == 2 ? uint8_t(samples[1] >> shift) : colors.hasTransparent && samples[0] == colors.transparent[0] ? 0 : 255;
+        }
+        else
+        {
+            pixel[0] = uint8_t(samples[0] >> shift);
+            pixel[1] = uint8_t(samples[1] >> shift);
+            pixel[2] = uint8_t(samples[2] >> shift);
+            pixel[3] = channels == 4 ? uint8_t(samples[3] >> shift)
+                : colors.hasTransparent && samples[0] == colors.transparent[0] && samples[1] == colors.transparent[1] && samples[2] == colors.transparent[2] ? 0 : 255;
+        }
+    }
+}
+
+static bool decodePng(const uint8_t* data, size_t size, const vk::Extent2D& extent, uint8_t* rgba, size_t rowPitch)
+{
+    PngHeader header;
+    if (!readPngHeader(data, size, header) || header.extent != extent)
+    {
+        return false;
+    }
+
+    PngColors colors;
+    colors.hasTransparent = false;
+    std::fill(colors.palette, colors.palette + 256, packRgba(0, 0, 0));
+
+    // the compressed stream may be split into any number of IDAT chunks
+    std::vector<uint8_t> compressed;
+    bool ended = false;
+    for (size_t offset = 8; !ended && offset + 12 <= size;)
+    {
+        uint32 length = readBigEndian32(data + offset);
+        const uint8_t* type = data + offset + 4;
+        const uint8_t* chunk = data + offset + 8;
+        if (length > size - offset - 12)
+        {
+            return false;
+        }
+
+        if (!memcmp(type, "PLTE", 4))
+        {
+            if (length % 3 || length > 256 * 3)
+            {
+                return false;
+            }
+            for (uint32 i = 0; i < length / 3; i++)
+            {
+                colors.palette[i] = packRgba(chunk[i * 3], chunk[i * 3 + 1], chunk[i * 3 + 2]);
+            }
+        }
+        else if (!memcmp(type, "tRNS", 4))
+        {
+            if (header.colorType == 3)
+            {
+                for (uint32 i = 0; i < std::min(length, 256u); i++)
+                {
+                    colors.palette[i] = (colors.palette[i] & 0xffffff) | (uint32(chunk[i]) << 24);
+                }
+            }
+            else if (length >= header.channels * 2u && (header.colorType == 0 || header.colorType == 2))
+            {
+                colors.hasTransparent = true;
+                for (uint32 channel = 0; channel < header.channels; channel++)
+                {
+                    colors.transparent[channel] = readBigEndian16(chunk + channel * 2) & ((1u << header.bitDepth) - 1);
+                }
+            }
+        }
+        else if (!memcmp(type, "IDAT", 4))
+        {
+            compressed.insert(compressed.end(), chunk, chunk + length);
+        }
+        else if (!memcmp(type, "IEND", 4))
+        {
+            ended = true;
+        }
+        offset += size_t(length) + 12;
+    }
+
+    size_t filteredRowSize = header.rowSize + 1;
+    std::vector<uint8_t> filtered(filteredRowSize * header.extent.height);
+    if (!inflate(compressed.data(), compressed.size(), filtered.data(), filtered.size()))
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> zeros(header.rowSize, 0);
+    const uint8_t* previous = zeros.data();
+    for (uint32 y = 0; y < header.extent.height; y++)
+    {
+        uint8_t* row = filtered.data() + y * filteredRowSize + 1;
+        if (!unfilterPngRow(row[-1], row, previous, header.rowSize, header.pixelSize))
+        {
+            return false;
+        }
+        convertPngRow(header, colors, row, rgba + y * rowPitch);
+        previous = row;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// JPEG (ITU T.81), sequential Huffman coded only
+
+static const uint8_t ZigzagToNatural[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
+
+// Reads the entropy coded data of a scan from the most significant bit of each byte on, dropping the zero after
+// each stuffed 0xff. Stops in front of the first marker and returns zeros from there on.
+class JpegReader
+{
+public:
+    JpegReader(const uint8_t* data, const uint8_t* end)
+        : m_data(data)
+        , m_end(end)
+        , m_bits(0)
+        , m_count(0)
+        , m_atMarker(false)
+    {
+    }
+
+    // count from 1 to 16
+    uint32 peek(uint32 count)
+    {
+        if (m_count < count)
+        {
+            refill();
+        }
+        return uint32(m_bits >> (64 - count));
+    }
+
+    void skip(uint32 count)
+    {
+        m_bits <<= count;
+        m_count -= count;
+    }
+
+    uint32 read(uint32 count)
+    {
+        uint32 value = peek(count);
+        skip(count);
+        return value;
+    }
+
+    // Drops the bits left and steps over the RSTn marker that must follow
+    bool restart()
+    {
+        m_bits = 0;
+        m_count = 0;
+        const uint8_t* marker = findMarker();
+        if (!marker || marker[1] < 0xd0 || marker[1] > 0xd7)
+        {
+            return false;
+        }
+        m_data = marker + 2;
+        m_atMarker = false;
+        return true;
+    }
+
+    // The marker that ends the scan, or nullptr at the end of data
+    const uint8_t* findMarker() const
+    {
+        for (const uint8_t* data = m_data; data + 1 < m_end; data++)
+        {
+            if (data[0] == 0xff && data[1] != 0 && data[1] != 0xff)
+            {
+                return data;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    void refill()
+    {
+        while (m_count <= 56)
+        {
+            uint64 byte = 0;
+            if (!m_atMarker && m_data < m_end)
+            {
+                byte = *m_data;
+                if (byte != 0xff)
+                {
+                    m_data++;
+                }
+                else if (m_data + 1 < m_end && m_data[1] == 0)
+                {
+                    m_data += 2;
+                }
+                else
+                {
+                    m_atMarker = true;
+                    byte = 0;
+                }
+            }
+            m_bits |= byte << (56 - m_count);
+            m_count += 8;
+        }
+    }
+
+    const uint8_t*  m_data;
+    const uint8_t*  m_end;
+    uint64          m_bits;         // next bit in the most significant position
+    uint32          m_count;
+    bool            m_atMarker;
+};
+
+struct JpegHuffmanTable
+{
+    uint16  fast[1 << HuffmanFastBits];     // (symbol << 4) | length, 0 for longer codes
+    int32   maxCode[17];                    // largest code of each length, -1 for none
+    int32   valueOffset[17];                // index into symbols minus the first code of each length
+    uint8_t symbols[256];
+    bool    defined;
+};
+
+static bool buildHuffmanTable(JpegHuffmanTable& table, const uint8_t* counts, const uint8_t* symbols, uint32 symbolCount)
+{
+    memcpy(table.symbols, symbols, symbolCount);
+    memset(table.fast, 0, sizeof(table.fast));
+
+    uint32 code = 0;
+    uint32 index = 0;
+    for (uint32 length = 1; length <= 16; length++)
+    {
+        table.valueOffset[length] = int32(index) - int32(code);
+        for (uint32 i = 0; i < counts[length - 1]; i++, code++, index++)
+        {
+            if (length <= HuffmanFastBits)
+            {
+                uint32 first = code << (HuffmanFastBits - length);
+                for (uint32 entry = first; entry < first + (1u << (HuffmanFastBits - length)); entry++)
+                {
+                    table.fast[entry] = uint16((table.symbols[index] << 4) | length);
+                }
+            }
+        }
+        table.maxCode[length] = counts[length - 1] ? int32(code) - 1 : -1;
+        if (code > (1u << length))
+        {
+            return false;
+        }
+        code <<= 1;
+    }
+    table.defined = true;
+    return true;
+}
+
+static int32 decodeSymbol(JpegReader& reader, const JpegHuffmanTable& table)
+{
+    uint32 entry = table.fast[reader.peek(HuffmanFastBits)];
+    if (entry)
+    {
+        reader.skip(entry & 15);
+        return int32(entry >> 4);
+    }
+
+    uint32 bits = reader.peek(16);
+    for (uint32 length = HuffmanFastBits + 1; length <= 16; length++)
+    {
+        int32 code = int32(bits >> (16 - length));
+        if (code <= table.maxCode[length])
+        {
+            reader.skip(length);
+            return table.symbols[code + table.valueOffset[length]];
+        }
+    }
+    return -1;
+}
+
+// The signed value of a size bit difference
+static int32 receiveExtend(JpegReader& reader, uint32 size)
+{
+    if (!size)
+    {
+        return 0;
+    }
+    int32 value = int32(reader.read(size));
+    return value < (1 << (size - 1)) ? value - (1 << size) + 1 : value;
+}
+
+struct JpegComponent
+{
+    uint32                  id;
+    uint32                  horizontal;     // sampling factors
+    uint32                  vertical;
+    uint32                  quantizationTable;
+    uint32                  dcTable;
+    uint32                  acTable;
+    int32                   dcPrediction;
+    vk::Extent2D            extent;         // samples with data, the plane is padded to whole MCUs
+    uint32                  planeWidth;
+    std::vector<uint8_t>    plane;
+};
+
+struct JpegDecoder
+{
+    vk::Extent2D        extent;
+    uint32              componentCount;
+    JpegComponent       components[3];
+    uint32              maxHorizontal;
+    uint32              maxVertical;
+    uint32              mcusX;
+    uint32              mcusY;
+    uint32              restartInterval;
+    int32               adobeTransform;     // -1 without an Adobe segment
+    bool                hasFrame;
+    uint32              scanCount;
+    uint16              quantizationTables[4][64];      // in zigzag order
+    JpegHuffmanTable    dcTables[4];
+    JpegHuffmanTable    acTables[4];
+};
+
+// Entries [u][x] of the separable 8 point inverse DCT, with the scale of both passes
+struct IdctTable
+{
+    float   weights[8][8];
+
+    IdctTable()
+    {
+        const float pi = 3.14159265358979f;
+        for (uint32 u = 0; u < 8; u++)
+        {
+            float scale = u ? 0.5f : 0.5f / sqrtf(2.0f);
+            for (uint32 x = 0; x < 8; x++)
+            {
+                weights[u][x] = scale * cosf((2 * x + 1) * u * pi / 16);
+            }
+        }
+    }
+};
+
+static void inverseDct(const float* coefficients, uint8_t* samples, size_t pitch)
+{
+    static const IdctTable table;
+
+    // rows first, most of them are all zero past the first few
+    float rows[64];
+    for (uint32 v = 0; v < 8; v++)
+    {
+        const float* input = coefficients + v * 8;
+        float* output = rows + v * 8;
+        uint32 last = 8;
+        while (last && input[last - 1] == 0.0f)
+        {
+            last--;
+        }
+        for (uint32 x = 0; x < 8; x++)
+        {
+            float sum = 0.0f;
+            for (uint32 u = 0; u < last; u++)
+            {
+                sum += input[u] * table.weights[u][x];
+            }
+            output[x] = sum;
+        }
+    }
+    for (uint32 y = 0; y < 8; y++)
+    {
+        for (uint32 x = 0; x < 8; x++)
+        {
+            float sum = 128.5f;
+            for (uint32 v = 0; v < 8; v++)
+            {
+                sum += rows[v * 8 + x] * table.weights[v][y];
+            }
+            samples[y * pitch + x] = uint8_t(clamp(sum, 0.0f, 255.0f));
+        }
+    }
+}
+
+static bool decodeBlock(JpegDecoder& decoder, JpegReader& reader, JpegComponent& component, uint32 blockX, uint32 blockY)
+{
+    const uint16* quantization = decoder.quantizationTables[component.quantizationTable];
+    alignas(16) float coefficients[64] = {};
+
+    int32 category = decodeSymbol(reader, decoder.dcTables[component.dcTable]);
+    if (category < 0 || category > 11)
+    {
+        return false;
+    }
+    component.dcPrediction += receiveExtend(reader, uint32(category));
+    coefficients[0] = float(component.dcPrediction * quantization[0]);
+
+    const JpegHuffmanTable& acTable = decoder.acTables[component.acTable];
+    for (uint32 k = 1; k < 64;)
+    {
+        int32 symbol = decodeSymbol(reader, acTable);
+        if (symbol < 0)
+        {
+            return false;
+        }
+        uint32 run = uint32(symbol) >> 4;
+        uint32 size = uint32(symbol) & 15;
+        if (!size)
+        {
+            // end of block, or 16 zeros
+            if (run != 15)
+            {
+                break;
+            }
+            k += 16;
+            continue;
+        }
+        k += run;
+        if (k > 63)
+        {
+            return false;
+        }
+        coefficients[ZigzagToNatural[k]] = float(receiveExtend(reader, size) * quantization[k]);
+        k++;
+    }
+
+    inverseDct(coefficients, component.plane.data() + size_t(blockY) * 8 * component.planeWidth + blockX * 8, component.planeWidth);
+    return true;
+}
+
+static bool readJpegFrame(JpegDecoder& decoder, const uint8_t* segment, uint32 length, bool allocatePlanes)
+{
+    if (decoder.hasFrame || length < 6 || segment[0] != 8)
+    {
+        return false;
+    }
+    decoder.extent = vk::Extent2D(readBigEndian16(segment + 3), readBigEndian16(segment + 1));
+    decoder.componentCount = segment[5];
+    if (!decoder.extent.width || !decoder.extent.height || decoder.extent.width > MaxImageDimension || decoder.extent.height > MaxImageDimension ||
+        (decoder.componentCount != 1 && decoder.componentCount != 3) || length < 6 + decoder.componentCount * 3)
+    {
+        return false;
+    }
+
+    decoder.maxHorizontal = 1;
+    decoder.maxVertical = 1;
+    for (uint32 i = 0; i < decoder.componentCount; i++)
+    {
+        JpegComponent& component = decoder.components[i];
+        const uint8_t* entry = segment + 6 + i * 3;
+        component.id = entry[0];
+        component.horizontal = entry[1] >> 4;
+        component.vertical = entry[1] & 15;
+        component.quantizationTable = entry[2];
+        component.dcPrediction = 0;
+        if (component.horizontal < 1 || component.horizontal > 4 || component.vertical < 1 || component.vertical > 4 || component.quantizationTable > 3)
+        {
+            return false;
+        }
+        decoder.maxHorizontal = std::max(decoder.maxHorizontal, component.horizontal);
+        decoder.maxVertical = std::max(decoder.maxVertical, component.vertical);
+    }
+
+    decoder.mcusX = (decoder.extent.width + decoder.maxHorizontal * 8 - 1) / (decoder.maxHorizontal * 8);
+    decoder.mcusY = (decoder.extent.height + decoder.maxVertical * 8 - 1) / (decoder.maxVertical * 8);
+    for (uint32 i = 0; i < decoder.componentCount; i++)
+    {
+        JpegComponent& component = decoder.components[i];
+        component.extent = vk::Extent2D((decoder.extent.width * component.horizontal + decoder.maxHorizontal - 1) / decoder.maxHorizontal,
+                                        (decoder.extent.height * component.vertical + decoder.maxVertical - 1) / decoder.maxVertical);
+        component.planeWidth = decoder.mcusX * component.horizontal * 8;
+        if (allocatePlanes)
+        {
+            component.plane.assign(size_t(component.planeWidth) * decoder.mcusY * component.vertical * 8, 0);
+        }
+    }
+    decoder.hasFrame = true;
+    return true;
+}
+
+static bool readJpegQuantizationTables(JpegDecoder& decoder, const uint8_t* segment, uint32 length)
+{
+    for (uint32 offset = 0; offset < length;)
+    {
+        uint32 precision = segment[offset] >> 4;
+        uint32 index = segment[offset] & 15;
+        uint32 tableSize = precision ? 128 : 64;
+        if (precision > 1 || index > 3 || offset + 1 + tableSize > length)
+        {
+            return false;
+        }
+        for (uint32 i = 0; i < 64; i++)
+        {
+            decoder.quantizationTables[index][i] = uint16(precision ? readBigEndian16(segment + offset + 1 + i * 2) : segment[offset + 1 + i]);
+        }
+        offset += 1 + tableSize;
+    }
+    return true;
+}
+
+static bool readJpegHuffmanTables(JpegDecoder& decoder, const uint8_t* segment, uint32 length)
+{
+    for (uint32 offset = 0; offset < length;)
+    {
+        if (offset + 17 > length)
+        {
+            return false;
+        }
+        uint32 tableClass = segment[offset] >> 4;
+        uint32 index = segment[offset] & 15;
+        const uint8_t* counts = segment + offset + 1;
+        uint32 symbolCount = 0;
+        for (uint32 i = 0; i < 16; i++)
+        {
+            symbolCount += counts[i];
+        }
+        if (tableClass > 1 || index > 3 || symbolCount > 256 || offset + 17 + symbolCount > length)
+        {
+            return false;
+        }
+        JpegHuffmanTable& table = tableClass ? decoder.acTables[index] : decoder.dcTables[index];
+        if (!buildHuffmanTable(table, counts, segment + offset + 17, symbolCount))
+        {
+            return false;
+        }
+        offset += 17 + symbolCount;
+    }
+    return true;
+}
+
+// Decodes the entropy coded data following the scan header, returns where the next marker starts or nullptr
+static const uint8_t* decodeJpegScan(JpegDecoder& decoder, const uint8_t* segment, uint32 length, const uint8_t* end)
+{
+    uint32 count = length ? segment[0] : 0;
+    if (!decoder.hasFrame || count < 1 || count > decoder.componentCount || length != 4 + count * 2)
+    {
+        return nullptr;
+    }
+
+    JpegComponent* components[3];
+    for (uint32 i = 0; i < count; i++)
+    {
+        const uint8_t* entry = segment + 1 + i * 2;
+        JpegComponent* component = nullptr;
+        for (uint32 j = 0; j < decoder.componentCount; j++)
+        {
+            if (decoder.components[j].id == entry[0])
+            {
+                component = &decoder.components[j];
+            }
+        }
+        if (!component)
+        {
+            return nullptr;
+        }
+        component->dcTable = entry[1] >> 4;
+        component->acTable = entry[1] & 15;
+        component->dcPrediction = 0;
+        if (component->dcTable > 3 || component->acTable > 3 || !decoder.dcTables[component->dcTable].defined || !decoder.acTables[component->acTable].defined)
+        {
+            return nullptr;
+        }
+        components[i] = component;
+    }
+
+    // spectral selection and successive approximation are progressive only
+    const uint8_t* selection = segment + 1 + count * 2;
+    if (selection[0] != 0 || selection[1] != 63 || selection[2] != 0)
+    {
+        return nullptr;
+    }
+
+    // a scan of one component goes through its blocks in raster order, an interleaved one through whole MCUs
+    uint32 unitsX = decoder.mcusX;
+    uint32 unitsY = decoder.mcusY;
+    if (count == 1)
+    {
+        unitsX = (components[0]->extent.width + 7) / 8;
+        unitsY = (components[0]->extent.height + 7) / 8;
+    }
+
+    JpegReader reader(segment + length, end);
+    uint32 unitCount = unitsX * unitsY;
+    for (uint32 unit = 0; unit < unitCount; unit++)
+    {
+        if (decoder.restartInterval && unit && unit % decoder.restartInterval == 0)
+        {
+            if (!reader.restart())
+            {
+                return nullptr;
+            }
+            for (uint32 i = 0; i < count; i++)
+            {
+                components[i]->dcPrediction = 0;
+            }
+        }
+
+        uint32 unitX = unit % unitsX;
+        uint32 unitY = unit / unitsX;
+        if (count == 1)
+        {
+            if (!decodeBlock(decoder, reader, *components[0], unitX, unitY))
+            {
+                return nullptr;
+            }
+            continue;
+        }
+        for (uint32 i = 0; i < count; i++)
+        {
+            JpegComponent& component = *components[i];
+            for (uint32 v = 0; v < component.vertical; v++)
+            {
+                for (uint32 h = 0; h < component.horizontal; h++)
+                {
+                    if (!decodeBlock(decoder, reader, component, unitX * component.horizontal + h, unitY * component.vertical + v))
+                    {
+                        return nullptr;
+                    }
+                }
+            }
+        }
+    }
+
+    // truncated files end without one
+    return reader.findMarker();
+}
+
+// One row of a component at the full image size, interpolated between the centers of its samples
+static void upsampleJpegRow(const JpegDecoder& decoder, const JpegComponent& component, uint32 y, uint8_t* row)
+{
+    uint32 width = decoder.extent.width;
+    if (component.horizontal == decoder.maxHorizontal && component.vertical == decoder.maxVertical)
+    {
+        memcpy(row, component.plane.data() + size_t(y) * component.planeWidth, width);
+        return;
+    }
+
+    float sourceY = std::max((y + 0.5f) * component.vertical / decoder.maxVertical - 0.5f, 0.0f);
+    uint32 y0 = std::min(uint32(sourceY), component.extent.height - 1);
+    uint32 y1 = std::min(y0 + 1, component.extent.height - 1);
+    float weightY = std::min(sourceY - y0, 1.0f);
+    const uint8_t* row0 = component.plane.data() + size_t(y0) * component.planeWidth;
+    const uint8_t* row1 = component.plane.data() + size_t(y1) * component.planeWidth;
+
+    float stepX = float(component.horizontal) / decoder.maxHorizontal;
+    for (uint32 x = 0; x < width; x++)
+    {
+        float sourceX = std::max((x + 0.5f) * stepX - 0.5f, 0.0f);
+        uint32 x0 = std::min(uint32(sourceX), component.extent.width - 1);
+        uint32 x1 = std::min(x0 + 1, component.extent.width - 1);
+        float weightX = std::min(sourceX - x0, 1.0f);
+        float top = row0[x0] + (row0[x1] - row0[x0]) * weightX;
+        float bottom = row1[x0] + (row1[x1] - row1[x0]) * weightX;
+        row[x] = uint8_t(top + (bottom - top) * weightY + 0.5f);
+    }
+}
+
+static void convertJpegToRgba(const JpegDecoder& decoder, uint8_t* rgba, size_t rowPitch)
+{
+    uint32 width = decoder.extent.width;
+    std::vector<uint8_t> rows(size_t(width) * decoder.componentCount);
+
+    // three components are YCbCr, unless an Adobe segment or the component ids say RGB
+    bool rgb = decoder.adobeTransform == 0 ||
+               (decoder.adobeTransform < 0 && decoder.components[0].id == 'R' && decoder.components[1].id == 'G' && decoder.components[2].id == 'B');
+    for (uint32 y = 0; y < decoder.extent.height; y++)
+    {
+        for (uint32 i = 0; i < decoder.componentCount; i++)
+        {
+            upsampleJpegRow(decoder, decoder.components[i], y, rows.data() + size_t(i) * width);
+        }
+
+        uint32* pixels = reinterpret_cast<uint32*>(rgba + y * rowPitch);
+        const uint8_t* luma = rows.data();      // or red
+        if (decoder.componentCount == 1)
+        {
+            for (uint32 x = 0; x < width; x++)
+            {
+                pixels[x] = packRgba(luma[x], luma[x], luma[x]);
+            }
+            continue;
+        }
+
+        const uint8_t* second = rows.data() + width;
+        const uint8_t* third = rows.data() + size_t(width) * 2;
+        for (uint32 x = 0; x < width; x++)
+        {
+            if (rgb)
+            {
+                pixels[x] = packRgba(luma[x], second[x], third[x]);
+                continue;
+            }
+
+            // BT.601 full range in 16 bit fixed point
+            int32 value = luma[x];
+            int32 cb = int32(second[x]) - 128;
+            int32 cr = int32(third[x]) - 128;
+            int32 r = value + ((91881 * cr + 32768) >> 16);
+            int32 g = value + ((-22554 * cb - 46802 * cr + 32768) >> 16);
+            int32 b = value + ((116130 * cb + 32768) >> 16);
+            pixels[x] = packRgba(uint8_t(clamp(r, 0, 255)), uint8_t(clamp(g, 0, 255)), uint8_t(clamp(b, 0, 255)));
+        }
+    }
+}
+
+// With rgba null only reads up to the frame header and returns its extent, otherwise the frame has to match extent
+static bool decodeJpeg(const uint8_t* data, size_t size, uint8_t* rgba, size_t rowPitch, vk::Extent2D& extent)
+{
+    if (size < 4 || data[0] != 0xff || data[1] != 0xd8)
+    {
+        return false;
+    }
+
+    std::unique_ptr<JpegDecoder> decoder = std::make_unique<JpegDecoder>();
+    decoder->restartInterval = 0;
+    decoder->adobeTransform = -1;
+    decoder->hasFrame = false;
+    decoder->scanCount = 0;
+    for (uint32 i = 0; i < 4; i++)
+    {
+        decoder->dcTables[i].defined = false;
+        decoder->acTables[i].defined = false;
+    }
+
+    const uint8_t* end = data + size;
+    for (const uint8_t* position = data + 2; position + 2 <= end;)
+    {
+        if (position[0] != 0xff)
+        {
+            return false;
+        }
+        uint32 marker = position[1];
+        position += 2;
+        if (marker == 0xff)
+        {
+            // fill byte
+            position--;
+            continue;
+        }
+        if (marker == 0xd9)
+        {
+            break;
+        }
+        if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7))
+        {
+            continue;
+        }
+
+        if (position + 2 > end)
+        {
+            return false;
+        }
+        uint32 length = readBigEndian16(position);
+        if (length < 2 || length > size_t(end - position))
+        {
+            return false;
+        }
+        const uint8_t* segment = position + 2;
+        length -= 2;
+        position += length + 2;
+
+        switch (marker)
+        {
+        case 0xc0:
+        case 0xc1:
+            if (!readJpegFrame(*decoder, segment, length, rgba != nullptr))
+            {
+                return false;
+            }
+            if (!rgba)
+            {
+                extent = decoder->extent;
+                return true;
+            }
+            if (decoder->extent != extent)
+            {
+                return false;
+            }
+            break;
+        case 0xc4:
+            if (!readJpegHuffmanTables(*decoder, segment, length))
+            {
+                return false;
+            }
+            break;
+        case 0xdb:
+            if (!readJpegQuantizationTables(*decoder, segment, length))
+            {
+                return false;
+            }
+            break;
+        case 0xdd:
+            if (length < 2)
+            {
+                return false;
+            }
+            decoder->restartInterval = readBigEndian16(segment);
+            break;
+        case 0xee:
+            if (length >= 12 && !memcmp(segment, "Adobe", 5))
+            {
+                decoder->adobeTransform = segment[11];
+            }
+            break;
+        case 0xda:
+            position = decodeJpegScan(*decoder, segment, length, end);
+            if (!position)
+            {
+                return false;
+            }
+            decoder->scanCount++;
+            break;
+        default:
+            // other frame types are progressive, lossless or arithmetic coded
+            if (marker >= 0xc2 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc)
+            {
+                return false;
+            }
+            break;
+        }
+    }
+
+    if (!rgba || !decoder->scanCount)
+    {
+        return false;
+    }
+    convertJpegToRgba(*decoder, rgba, rowPitch);
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+ImageFileType getImageFileType(const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (size >= 8 && !memcmp(bytes, PngSignature, 8))
+    {
+        return ImageFileType::Png;
+    }
+    if (size >= 3 && bytes[0] == 0xff && bytes[1] == 0xd8 && bytes[2] == 0xff)
+    {
+        return ImageFileType::Jpeg;
+    }
+    return ImageFileType::Unknown;
+}
+
+bool readImageHeader(const void* data, size_t size, vk::Extent2D& extent)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    switch (getImageFileType(data, size))
+    {
+    case ImageFileType::Png:
+        {
+            PngHeader header;
+            if (!readPngHeader(bytes, size, header))
+            {
+                return false;
+            }
+            extent = header.extent;
+            return true;
+        }
+    case ImageFileType::Jpeg:
+        return decodeJpeg(bytes, size, nullptr, 0, extent);
+    default:
+        return false;
+    }
+}
+
+bool decodeImage(const void* data, size_t size, const vk::Extent2D& extent, uint8_t* rgba, size_t rowPitch)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    vk::Extent2D frameExtent = extent;
+    switch (getImageFileType(data, size))
+    {
+    case ImageFileType::Png:
+        return decodePng(bytes, size, extent, rgba, rowPitch);
+    case ImageFileType::Jpeg:
+        return decodeJpeg(bytes, size, rgba, rowPitch, frameExtent);
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Common.h"
+#include <vulkan/vulkan.hpp>
+
+// Decoders of image files into 8 bit RGBA, sources without alpha get opaque alpha. Both are plain single threaded
+// functions, so several files can be decoded on different threads at once.
+//   PNG   every bit depth and color type, palettes and tRNS transparency, not interlaced; 16 bit samples keep their
+//         high byte
+//   JPEG  baseline and extended Huffman coded, 8 bit, grayscale or YCbCr with any sampling factors, restart intervals;
+//         not progressive or arithmetic coded. Chroma is upsampled bilinearly.
+enum class ImageFileType
+{
+    Unknown,
+    Png,
+    Jpeg,
+};
+
+// From the signature at the start of data
+ImageFileType getImageFileType(const void* data, size_t size);
+
+// Reads the size only, e.g. to allocate the memory to decode into. Returns false for files the decoders reject from
+// their headers.
+bool readImageHeader(const void* data, size_t size, vk::Extent2D& extent);
+
+// rgba holds extent.height rows of rowPitch bytes, extent as readImageHeader returned it. Returns false for corrupt or
+// unsupported files and for files whose header disagrees with extent, e.g. because the file changed in between. rgba
+// may be partially written then, but never beyond extent.
+bool decodeImage(const void* data, size_t size, const vk::Extent2D& extent, uint8_t* rgba, size_t rowPitch);
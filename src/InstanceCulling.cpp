@@ -0,0 +1,188 @@
+#include "InstanceCulling.h"
+#include "AccelerationStructure.h"
+#include "GraphicsObjects.h"
+#include "shaders.hpp"
+
+const uint32 InstanceCullGroupSize = 256;
+
+// Matches the push constant block of computeShaderText_InstanceCull
+struct InstanceCullPushConstants
+{
+    glm::vec4   planes[6];
+    uint32      instanceCount;
+};
+
+// Instances of each mesh get a range of the visible instance list as large as their count, the commands start
+// without instances
+static void getInitialCommands(const std::vector<DrawMesh>& meshes, const std::vector<DrawInstance>& instances, std::vector<vk::DrawIndexedIndirectCommand>& commands)
+{
+    std::vector<uint32> instanceCounts(meshes.size(), 0);
+    for (const DrawInstance& instance : instances)
+    {
+        assert(instance.meshId < meshes.size());
+        instanceCounts[instance.meshId]++;
+    }
+
+    commands.resize(meshes.size());
+    uint32 firstInstance = 0;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        commands[i] = vk::DrawIndexedIndirectCommand(meshes[i].indexCount, 0, meshes[i].firstIndex, meshes[i].vertexOffset, firstInstance);
+        firstInstance += instanceCounts[i];
+    }
+}
+
+uint32 cullInstances(const std::vector<DrawMesh>& meshes, const std::vector<DrawInstance>& instances, const Frustum& frustum,
+                     std::vector<vk::DrawIndexedIndirectCommand>& commands, std::vector<uint32>& visibleInstances)
+{
+    getInitialCommands(meshes, instances, commands);
+    visibleInstances.assign(instances.size(), ~0u);
+
+    uint32 visibleCount = 0;
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        const DrawInstance& instance = instances[i];
+        if (frustum.intersectsAabb(transformAabb(meshes[instance.meshId].bounds, instance.transform)))
+        {
+            vk::DrawIndexedIndirectCommand& command = commands[instance.meshId];
+            visibleInstances[command.firstInstance + command.instanceCount++] = uint32(i);
+            visibleCount++;
+        }
+    }
+    return visibleCount;
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+GpuInstanceCuller::GpuInstanceCuller(const Device& device, const vk::UniqueCommandPool& commandPool, const std::vector<DrawMesh>& meshes, uint32 maxInstances)
+    : m_device(device)
+    , m_meshCount(uint32(meshes.size()))
+    , m_maxInstances(maxInstances)
+    , m_instanceCount(0)
+    , m_meshes(meshes)
+    , m_timer(device)
+{
+    assert(!meshes.empty() && maxInstances > 0);
+    assert(device.getEnabledFeatures().drawIndirectFirstInstance);
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+
+    // bounds as two vec4 per mesh
+    std::vector<glm::vec4> bounds;
+    for (const DrawMesh& mesh : meshes)
+    {
+        bounds.push_back(glm::vec4(mesh.bounds.min, 0.0f));
+        bounds.push_back(glm::vec4(mesh.bounds.max, 0.0f));
+    }
+    m_meshBounds = std::make_unique<Buffer>(device, bounds.size() * sizeof(glm::vec4), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                                            vk::MemoryPropertyFlagBits::eDeviceLocal);
+    m_meshBounds->upload(commandPool, device.getGraphicsQueue(), bounds, 0);
+
+    // instances change from the CPU, like the top level of GpuAccelerationStructure they live in host visible memory
+    m_instances = std::make_unique<Buffer>(device, maxInstances * sizeof(DrawInstance), vk::BufferUsageFlagBits::eStorageBuffer);
+    m_visibleInstances = std::make_unique<Buffer>(device, maxInstances * sizeof(uint32), vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    m_initialCommands = std::make_unique<Buffer>(device, m_meshCount * sizeof(vk::DrawIndexedIndirectCommand), vk::BufferUsageFlagBits::eTransferSrc);
+    m_drawCommands = std::make_unique<Buffer>(device, m_meshCount * sizeof(vk::DrawIndexedIndirectCommand), vk::BufferUsageFlagBits::eIndirectBuffer |
+                                              vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    m_visibleCount = std::make_unique<Buffer>(device, sizeof(uint32), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst);
+
+    // 0: instances, 1: mesh bounds, 2: draw commands, 3: visible instances, 4: visible count
+    m_descriptorSetLayout = vk::su::createDescriptorSetLayout(vkDevice, std::vector<std::tuple<vk::DescriptorType, uint32_t, vk::ShaderStageFlags>>(
+                                                                            5, { vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute }));
+    vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(InstanceCullPushConstants));
+    m_pipelineLayout = vkDevice->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), 1, &m_descriptorSetLayout.get(), 1, &pushConstantRange));
+
+    m_descriptorPool = vk::su::createDescriptorPool(vkDevice, { { vk::DescriptorType::eStorageBuffer, 5 } });
+    m_descriptorSet = std::move(vkDevice->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(m_descriptorPool.get(), 1, &m_descriptorSetLayout.get())).front());
+
+    vk::DescriptorBufferInfo bufferInfos[5] =
+    {
+        vk::DescriptorBufferInfo(m_instances->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_meshBounds->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_drawCommands->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_visibleInstances->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_visibleCount->getVKBuffer().get(), 0, VK_WHOLE_SIZE)
+    };
+    vkDevice->updateDescriptorSets(vk::WriteDescriptorSet(m_descriptorSet.get(), 0, 0, 5, vk::DescriptorType::eStorageBuffer, nullptr, bufferInfos), nullptr);
+
+    vk::UniquePipelineCache pipelineCache = vkDevice->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+    vk::UniqueShaderModule shaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eCompute, computeShaderText_InstanceCull);
+    m_pipeline = vk::su::createComputePipeline(vkDevice, pipelineCache, std::make_pair(shaderModule.get(), nullptr), m_pipelineLayout);
+
+    setInstances({});
+}
+
+GpuInstanceCuller::~GpuInstanceCuller()
+{
+
+}
+
+void GpuInstanceCuller::setInstances(const std::vector<DrawInstance>& instances)
+{
+    assert(instances.size() <= m_maxInstances);
+    m_instanceCount = uint32(instances.size());
+
+    std::vector<vk::DrawIndexedIndirectCommand> commands;
+    getInitialCommands(m_meshes, instances, commands);
+    m_initialCommands->upload(commands);
+    if (!instances.empty())
+    {
+        m_instances->upload(instances);
+    }
+}
+
+void GpuInstanceCuller::record(const vk::UniqueCommandBuffer& commandBuffer, const glm::mat4x4& viewProjection)
+{
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+    InstanceCullPushConstants pushConstants;
+    for (int i = 0; i < 6; i++)
+    {
+        pushConstants.planes[i] = frustum.planes[i];
+    }
+    pushConstants.instanceCount = m_instanceCount;
+
+    m_timer.reset(commandBuffer);
+    m_timer.begin(commandBuffer);
+
+    // the draws of the previous frame may still read the commands and visible instances that get rewritten here
+    commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader,
+                                   vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, nullptr);
+
+    commandBuffer->copyBuffer(m_initialCommands->getVKBuffer().get(), m_drawCommands->getVKBuffer().get(),
+                              vk::BufferCopy(0, 0, m_meshCount * sizeof(vk::DrawIndexedIndirectCommand)));
+    commandBuffer->fillBuffer(m_visibleCount->getVKBuffer().get(), 0, sizeof(uint32), 0);
+    vk::su::transferToComputeBarrier(commandBuffer);
+
+    commandBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline.get());
+    commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout.get(), 0, m_descriptorSet.get(), nullptr);
+    commandBuffer->pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+    commandBuffer->dispatch((m_instanceCount + InstanceCullGroupSize - 1) / InstanceCullGroupSize, 1, 1);
+    vk::su::computeToDrawBarrier(commandBuffer);
+    // getLastVisibleCount maps the counter once the fence of this command buffer signaled
+    commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost, {},
+                                   vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eHostRead), nullptr, nullptr);
+
+    m_timer.end(commandBuffer);
+}
+
+void GpuInstanceCuller::recordDraw(const vk::UniqueCommandBuffer& commandBuffer) const
+{
+    const uint32 stride = sizeof(vk::DrawIndexedIndirectCommand);
+    if (m_device.getEnabledFeatures().multiDrawIndirect)
+    {
+        commandBuffer->drawIndexedIndirect(m_drawCommands->getVKBuffer().get(), 0, m_meshCount, stride);
+        return;
+    }
+
+    for (uint32 i = 0; i < m_meshCount; i++)
+    {
+        commandBuffer->drawIndexedIndirect(m_drawCommands->getVKBuffer().get(), i * stride, 1, stride);
+    }
+}
+
+uint32 GpuInstanceCuller::getLastVisibleCount() const
+{
+    uint32 visibleCount = 0;
+    m_visibleCount->download(&visibleCount, sizeof(visibleCount));
+    return visibleCount;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Ray.h"
+#include "Profiling.h"
+#include <vulkan/vulkan.hpp>
+#include <memory>
+
+class Device;
+class Buffer;
+
+// Index range of a mesh in the vertex and index buffers shared by all meshes. The bounds are in the space of the
+// vertex positions: with CompressedVertices they are [-1, 1] and the dequantization matrix goes into the instance transforms.
+struct DrawMesh
+{
+    uint32  indexCount;
+    uint32  firstIndex;
+    int32   vertexOffset;
+    Aabb    bounds;
+};
+
+// 80 bytes, matches struct DrawInstance in computeShaderText_InstanceCull and vertexShaderText_PC_C_Instanced
+struct DrawInstance
+{
+    glm::mat4x4 transform;      // object to world
+    uint32      meshId;
+    uint32      padding[3];
+};
+
+// CPU reference of GpuInstanceCuller: one command per mesh drawing its visible instances, whose indices are listed
+// in visibleInstances from command.firstInstance on. Returns the number of visible instances.
+uint32 cullInstances(const std::vector<DrawMesh>& meshes, const std::vector<DrawInstance>& instances, const Frustum& frustum,
+                     std::vector<vk::DrawIndexedIndirectCommand>& commands, std::vector<uint32>& visibleInstances);
+
+// GPU driven drawing of many instances of a few meshes. A compute pass tests the world space bounds of every instance
+// against the frustum and writes one VkDrawIndexedIndirectCommand per mesh, so recording the draws costs the same
+// for ten and for a million instances. The vertex shader finds its instance as
+//
+//   instances[visibleInstances[gl_InstanceIndex]]
+//
+// see vertexShaderText_PC_C_Instanced. Needs the drawIndirectFirstInstance feature; without multiDrawIndirect
+// recordDraw issues one indirect draw per mesh.
+class GpuInstanceCuller
+{
+public:
+    GpuInstanceCuller(const Device& device, const vk::UniqueCommandPool& commandPool, const std::vector<DrawMesh>& meshes, uint32 maxInstances);
+    ~GpuInstanceCuller();
+
+    // Replaces the instances, must not happen while a cull or draw is in flight
+    void setInstances(const std::vector<DrawInstance>& instances);
+
+    // Records the culling pass outside of a render pass, viewProjection maps world space to clip space
+    void record(const vk::UniqueCommandBuffer& commandBuffer, const glm::mat4x4& viewProjection);
+
+    // Draws the visible instances, with the shared vertex and index buffers, the pipeline and its descriptor set bound by the caller
+    void recordDraw(const vk::UniqueCommandBuffer& commandBuffer) const;
+
+    // Storage buffers for the vertex shader
+    const Buffer& getInstanceBuffer() const { return *m_instances; }
+    const Buffer& getVisibleInstanceBuffer() const { return *m_visibleInstances; }
+    const Buffer& getDrawCommandBuffer() const { return *m_drawCommands; }
+
+    uint32 getInstanceCount() const { return m_instanceCount; }
+
+    // Visible instances and GPU time of the last recorded pass, only valid once its command buffer completed
+    uint32 getLastVisibleCount() const;
+    bool getLastCullMilliseconds(double& milliseconds) const { return m_timer.getMilliseconds(0, milliseconds); }
+
+private:
+    const Device&                   m_device;
+    uint32                          m_meshCount;
+    uint32                          m_maxInstances;
+    uint32                          m_instanceCount;
+    std::vector<DrawMesh>           m_meshes;
+
+    std::unique_ptr<Buffer>         m_meshBounds;
+    std::unique_ptr<Buffer>         m_instances;
+    std::unique_ptr<Buffer>         m_visibleInstances;
+    std::unique_ptr<Buffer>         m_initialCommands;      // instanceCount 0, copied over m_drawCommands every frame
+    std::unique_ptr<Buffer>         m_drawCommands;
+    std::unique_ptr<Buffer>         m_visibleCount;
+
+    vk::UniqueDescriptorSetLayout   m_descriptorSetLayout;
+    vk::UniquePipelineLayout        m_pipelineLayout;
+    vk::UniqueDescriptorPool        m_descriptorPool;
+    vk::UniqueDescriptorSet         m_descriptorSet;
+    vk::UniquePipeline              m_pipeline;
+
+    GpuTimer                        m_timer;
+};
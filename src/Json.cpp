@@ -0,0 +1,300 @@
+#include "Json.h"
+#include <cstdlib>
+#include <cstring>
+
+// nesting limit, keeps the recursive descent from overflowing the stack on hostile input
+const uint32 JsonMaxDepth = 256;
+
+class JsonValue::Parser
+{
+public:
+    Parser(const char* text, size_t size) : m_p(text), m_end(text + size) {}
+
+    bool parseDocument(JsonValue& value)
+    {
+        if (!parseValue(value, 0))
+        {
+            return false;
+        }
+        skipSpaces();
+        return m_p == m_end;
+    }
+
+private:
+    void skipSpaces()
+    {
+        while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+        {
+            m_p++;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skipSpaces();
+        if (m_p < m_end && *m_p == c)
+        {
+            m_p++;
+            return true;
+        }
+        return false;
+    }
+
+    bool consumeLiteral(const char* literal)
+    {
+        size_t length = strlen(literal);
+        if (size_t(m_end - m_p) < length || memcmp(m_p, literal, length) != 0)
+        {
+            return false;
+        }
+        m_p += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue& value, uint32 depth)
+    {
+        skipSpaces();
+        if (m_p == m_end || JsonMaxDepth <= depth)
+        {
+            return false;
+        }
+
+        switch (*m_p)
+        {
+        case '{':
+            return parseObject(value, depth);
+        case '[':
+            return parseArray(value, depth);
+        case '"':
+            value.m_type = Type::String;
+            return parseString(value.m_string);
+        case 't':
+            value.m_type = Type::Bool;
+            value.m_bool = true;
+            return consumeLiteral("true");
+        case 'f':
+            value.m_type = Type::Bool;
+            value.m_bool = false;
+            return consumeLiteral("false");
+        case 'n':
+            value.m_type = Type::Null;
+            return consumeLiteral("null");
+        default:
+            return parseNumber(value);
+        }
+    }
+
+    bool parseObject(JsonValue& value, uint32 depth)
+    {
+        value.m_type = Type::Object;
+        m_p++;
+        if (consume('}'))
+        {
+            return true;
+        }
+
+        do
+        {
+            skipSpaces();
+            value.m_members.emplace_back();
+            std::pair<string, JsonValue>& member = value.m_members.back();
+            if (m_p == m_end || *m_p != '"' || !parseString(member.first) || !consume(':') || !parseValue(member.second, depth + 1))
+            {
+                return false;
+            }
+        } while (consume(','));
+        return consume('}');
+    }
+
+    bool parseArray(JsonValue& value, uint32 depth)
+    {
+        value.m_type = Type::Array;
+        m_p++;
+        if (consume(']'))
+        {
+            return true;
+        }
+
+        do
+        {
+            value.m_elements.emplace_back();
+            if (!parseValue(value.m_elements.back(), depth + 1))
+            {
+                return false;
+            }
+        } while (consume(','));
+        return consume(']');
+    }
+
+    bool parseNumber(JsonValue& value)
+    {
+        // strtod would accept more than JSON does and reads past m_end, so check the characters first
+        const char* begin = m_p;
+        while (m_p < m_end && (('0' <= *m_p && *m_p <= '9') || *m_p == '-' || *m_p == '+' || *m_p == '.' || *m_p == 'e' || *m_p == 'E'))
+        {
+            m_p++;
+        }
+        if (m_p == begin || 63 < m_p - begin)
+        {
+            return false;
+        }
+
+        char buffer[64];
+        memcpy(buffer, begin, m_p - begin);
+        buffer[m_p - begin] = 0;
+        char* end;
+        value.m_type = Type::Number;
+        value.m_number = strtod(buffer, &end);
+        return end == buffer + (m_p - begin);
+    }
+
+    static void appendUtf8(string& s, uint32 codePoint)
+    {
+        if (codePoint < 0x80)
+        {
+            s += char(codePoint);
+        }
+        else if (codePoint < 0x800)
+        {
+            s += char(0xc0 | (codePoint >> 6));
+            s += char(0x80 | (codePoint & 0x3f));
+        }
+        else if (codePoint < 0x10000)
+        {
+            s += char(0xe0 | (codePoint >> 12));
+            s += char(0x80 | ((codePoint >> 6) & 0x3f));
+            s += char(0x80 | (codePoint & 0x3f));
+        }
+        else
+        {
+            s += char(0xf0 | (codePoint >> 18));
+            s += char(0x80 | ((codePoint >> 12) & 0x3f));
+            s += char(0x80 | ((codePoint >> 6) & 0x3f));
+            s += char(0x80 | (codePoint & 0x3f));
+        }
+    }
+
+    bool parseHex4(uint32& value)
+    {
+        if (m_end - m_p < 4)
+        {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            char c = *m_p++;
+            uint32 digit = ('0' <= c && c <= '9') ? c - '0' : ('a' <= c && c <= 'f') ? c - 'a' + 10 : ('A' <= c && c <= 'F') ? c - 'A' + 10 : 16;
+            if (digit == 16)
+            {
+                return false;
+            }
+            value = value * 16 + digit;
+        }
+        return true;
+    }
+
+    bool parseString(string& s)
+    {
+        m_p++;
+        s.clear();
+        while (m_p < m_end && *m_p != '"')
+        {
+            if (*m_p != '\\')
+            {
+                s += *m_p++;
+                continue;
+            }
+
+            if (++m_p == m_end)
+            {
+                return false;
+            }
+            char escape = *m_p++;
+            switch (escape)
+            {
+            case '"': case '\\': case '/': s += escape; break;
+            case 'b': s += '\b'; break;
+            case 'f': s += '\f'; break;
+            case 'n': s += '\n'; break;
+            case 'r': s += '\r'; break;
+            case 't': s += '\t'; break;
+            case 'u':
+            {
+                uint32 codePoint;
+                if (!parseHex4(codePoint))
+                {
+                    return false;
+                }
+                // surrogate pair
+                if (0xd800 <= codePoint && codePoint < 0xdc00 && 2 <= m_end - m_p && m_p[0] == '\\' && m_p[1] == 'u')
+                {
+                    m_p += 2;
+                    uint32 low;
+                    if (!parseHex4(low) || low < 0xdc00 || 0xe000 <= low)
+                    {
+                        return false;
+                    }
+                    codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                }
+                appendUtf8(s, codePoint);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        if (m_p == m_end)
+        {
+            return false;
+        }
+        m_p++;
+        return true;
+    }
+
+    const char* m_p;
+    const char* m_end;
+};
+
+JsonValue::JsonValue()
+    : m_type(Type::Null)
+    , m_bool(false)
+    , m_number(0.0)
+{
+}
+
+JsonValue::~JsonValue()
+{
+
+}
+
+bool JsonValue::parse(const char* text, size_t size, JsonValue& value)
+{
+    value = JsonValue();
+    Parser parser(text, size);
+    return parser.parseDocument(value);
+}
+
+bool JsonValue::has(const string& key) const
+{
+    return contains_if(m_members, [&](const std::pair<string, JsonValue>& member) { return member.first == key; });
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+    static const JsonValue null;
+    return index < m_elements.size() ? m_elements[index] : null;
+}
+
+const JsonValue& JsonValue::operator[](const string& key) const
+{
+    static const JsonValue null;
+    for (const std::pair<string, JsonValue>& member : m_members)
+    {
+        if (member.first == key)
+        {
+            return member.second;
+        }
+    }
+    return null;
+}
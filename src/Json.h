@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Common.h"
+
+// Minimal JSON document, enough for glTF headers. Lookups of missing members or out of range elements return a null
+// value, so optional fields can be read without checking every step.
+class JsonValue
+{
+public:
+    enum class Type
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object,
+    };
+
+    JsonValue();
+    ~JsonValue();
+
+    // Returns false on malformed input, value is undefined then
+    static bool parse(const char* text, size_t size, JsonValue& value);
+
+    Type getType() const { return m_type; }
+    bool isNull() const { return m_type == Type::Null; }
+    bool isArray() const { return m_type == Type::Array; }
+    bool isObject() const { return m_type == Type::Object; }
+
+    bool getBool(bool defaultValue = false) const { return m_type == Type::Bool ? m_bool : defaultValue; }
+    double getNumber(double defaultValue = 0.0) const { return m_type == Type::Number ? m_number : defaultValue; }
+    uint32 getUint(uint32 defaultValue = 0) const { return m_type == Type::Number && m_number >= 0.0 ? uint32(m_number) : defaultValue; }
+    const string& getString() const { return m_string; }
+
+    // Element count of arrays, member count of objects
+    size_t size() const { return m_type == Type::Object ? m_members.size() : m_elements.size(); }
+    bool has(const string& key) const;
+
+    const JsonValue& operator[](size_t index) const;
+    const JsonValue& operator[](const string& key) const;
+
+private:
+    class Parser;
+
+    Type                                        m_type;
+    bool                                        m_bool;
+    double                                      m_number;
+    string                                      m_string;
+    std::vector<JsonValue>                      m_elements;
+    std::vector<std::pair<string, JsonValue>>   m_members;
+};
@@ -0,0 +1,259 @@
+#include "Ktx2Texture.h"
+#include "GraphicsObjects.h"
+#include "Mipmaps.h"
+#include "StagingRing.h"
+#include "TextureCompression.h"
+#include "utils.hpp"
+#include <cstring>
+
+static const uint8_t Ktx2Identifier[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+
+#pragma pack(push, 1)
+struct Ktx2Header
+{
+    uint8_t identifier[12];
+    uint32  vkFormat;
+    uint32  typeSize;
+    uint32  pixelWidth;
+    uint32  pixelHeight;
+    uint32  pixelDepth;
+    uint32  layerCount;
+    uint32  faceCount;
+    uint32  levelCount;
+    uint32  supercompressionScheme;
+    uint32  dfdByteOffset;
+    uint32  dfdByteLength;
+    uint32  kvdByteOffset;
+    uint32  kvdByteLength;
+    uint64  sgdByteOffset;
+    uint64  sgdByteLength;
+};
+
+struct Ktx2LevelIndex
+{
+    uint64  byteOffset;
+    uint64  byteLength;
+    uint64  uncompressedByteLength;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+static bool isSupportedFormat(vk::Format format)
+{
+    return format == vk::Format::eR8G8B8A8Unorm || isBlockCompressed(format);
+}
+
+// Height in texels of the rows uploads are split into
+static uint32 getRowHeight(vk::Format format)
+{
+    return isBlockCompressed(format) ? 4 : 1;
+}
+
+Ktx2File::Ktx2File()
+    : m_format(vk::Format::eUndefined)
+{
+}
+
+bool Ktx2File::open(const string& path)
+{
+    close();
+    if (!m_file.open(path) || m_file.getSize() < sizeof(Ktx2Header))
+    {
+        m_file.close();
+        return false;
+    }
+
+    // the header fields are little endian and 4 byte aligned, the levels follow right after it
+    const uint8_t* data = static_cast<const uint8_t*>(m_file.getData());
+    const Ktx2Header& header = *reinterpret_cast<const Ktx2Header*>(data);
+    uint32 levelCount = std::max(header.levelCount, 1u);
+    vk::Format format = vk::Format(header.vkFormat);
+    vk::Extent2D extent(header.pixelWidth, header.pixelHeight);
+    if (memcmp(header.identifier, Ktx2Identifier, sizeof(Ktx2Identifier)) || !isSupportedFormat(format) || !extent.width || !extent.height ||
+        header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.supercompressionScheme != 0 ||
+        levelCount > getMipLevelCount(extent) || m_file.getSize() < sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex))
+    {
+        m_file.close();
+        return false;
+    }
+
+    const Ktx2LevelIndex* levelIndex = reinterpret_cast<const Ktx2LevelIndex*>(data + sizeof(Ktx2Header));
+    for (uint32 level = 0; level < levelCount; level++)
+    {
+        const Ktx2LevelIndex& index = levelIndex[level];
+        if (index.byteLength != getImageSize(format, getMipExtent(extent, level)) || index.byteOffset > m_file.getSize() ||
+            index.byteLength > m_file.getSize() - index.byteOffset)
+        {
+            close();
+            return false;
+        }
+        m_levels.push_back({ index.byteOffset, index.byteLength });
+    }
+
+    m_format = format;
+    m_extent = extent;
+    return true;
+}
+
+void Ktx2File::close()
+{
+    m_file.close();
+    m_format = vk::Format::eUndefined;
+    m_extent = vk::Extent2D();
+    m_levels.clear();
+}
+
+const uint8_t* Ktx2File::getLevelData(uint32 level) const
+{
+    assert(level < m_levels.size());
+    return static_cast<const uint8_t*>(m_file.getData()) + m_levels[level].offset;
+}
+
+size_t Ktx2File::getLevelSize(uint32 level) const
+{
+    assert(level < m_levels.size());
+    return size_t(m_levels[level].size);
+}
+
+uint32 Ktx2File::getRowCount(uint32 level) const
+{
+    uint32 rowHeight = getRowHeight(m_format);
+    return (getMipExtent(m_extent, level).height + rowHeight - 1) / rowHeight;
+}
+
+size_t Ktx2File::getRowSize(uint32 level) const
+{
+    return getImageSize(m_format, vk::Extent2D(getMipExtent(m_extent, level).width, getRowHeight(m_format)));
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+bool recordKtx2Rows(const vk::UniqueCommandBuffer& commandBuffer, StagingRing& ring, const Ktx2File& file, uint32 level, vk::Image image, uint32 imageLevel,
+                    vk::DeviceSize alignment, vk::DeviceSize budget, uint32& nextRow, vk::DeviceSize& copied)
+{
+    vk::Extent2D extent = getMipExtent(file.getExtent(), level);
+    uint32 rowHeight = getRowHeight(file.getFormat());
+    uint32 rowCount = file.getRowCount(level);
+    size_t rowSize = file.getRowSize(level);
+    assert(nextRow < rowCount && rowSize <= ring.getSize());
+
+    // as many rows as the budget asks for, fewer while the ring is still busy with earlier submissions
+    vk::DeviceSize budgetRows = copied < budget ? (budget - copied + rowSize - 1) / rowSize : 1;
+    uint32 rows = uint32(std::min<vk::DeviceSize>({ rowCount - nextRow, budgetRows, ring.getSize() / rowSize }));
+    vk::DeviceSize offset;
+    void* data;
+    while (rows && !ring.allocate(rows * rowSize, alignment, offset, data))
+    {
+        rows /= 2;
+    }
+    if (!rows)
+    {
+        return false;
+    }
+    memcpy(data, file.getLevelData(level) + nextRow * rowSize, rows * rowSize);
+
+    uint32 y = nextRow * rowHeight;
+    vk::BufferImageCopy copyRegion(offset, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, imageLevel, 0, 1), vk::Offset3D(0, int32(y), 0),
+                                   vk::Extent3D(extent.width, std::min(rows * rowHeight, extent.height - y), 1));
+    commandBuffer->copyBufferToImage(ring.getBuffer().getVKBuffer().get(), image, vk::ImageLayout::eTransferDstOptimal, copyRegion);
+
+    nextRow += rows;
+    copied += rows * rowSize;
+    return true;
+}
+
+vk::DeviceSize getKtx2CopyAlignment(const vk::PhysicalDevice& physicalDevice, vk::Format format)
+{
+    return std::max<vk::DeviceSize>(isBlockCompressed(format) ? getBlockSize(format) : 4, physicalDevice.getProperties().limits.optimalBufferCopyOffsetAlignment);
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+Ktx2Texture::Ktx2Texture(const Device& device)
+    : m_device(device)
+    , m_copyAlignment(4)
+    , m_firstResidentLevel(0)
+    , m_nextRow(0)
+{
+}
+
+Ktx2Texture::~Ktx2Texture()
+{
+
+}
+
+bool Ktx2Texture::open(const string& path)
+{
+    m_levelViews.clear();
+    m_image.reset();
+    m_firstResidentLevel = 0;
+    m_nextRow = 0;
+
+    if (!m_file.open(path))
+    {
+        return false;
+    }
+
+    const vk::UniqueDevice& vkDevice = m_device.getVKDevice();
+    const vk::PhysicalDevice& physicalDevice = m_device.getPhysicalDevice();
+    vk::Format format = m_file.getFormat();
+    if (isBlockCompressed(format) && !(m_device.getEnabledFeatures().textureCompressionBC && isBlockFormatSupported(physicalDevice, format)))
+    {
+        m_file.close();
+        return false;
+    }
+
+    uint32 levelCount = m_file.getLevelCount();
+    m_image = std::make_unique<Image>(m_device, format, m_file.getExtent(), vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+                                      vk::ImageLayout::eUndefined, vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor, levelCount);
+
+    vk::ComponentMapping componentMapping(vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA);
+    for (uint32 level = 0; level < levelCount; level++)
+    {
+        vk::ImageViewCreateInfo imageViewCreateInfo(vk::ImageViewCreateFlags(), m_image->getVKImage().get(), vk::ImageViewType::e2D, format, componentMapping,
+                                                    vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level, levelCount - level, 0, 1));
+        m_levelViews.push_back(vkDevice->createImageViewUnique(imageViewCreateInfo));
+    }
+
+    m_copyAlignment = getKtx2CopyAlignment(physicalDevice, format);
+    m_firstResidentLevel = levelCount;
+    return true;
+}
+
+bool Ktx2Texture::update(const vk::UniqueCommandBuffer& commandBuffer, StagingRing& ring, vk::DeviceSize budget)
+{
+    assert(m_image);
+
+    vk::Image image = m_image->getVKImage().get();
+    vk::Format format = m_file.getFormat();
+
+    vk::DeviceSize copied = 0;
+    while (m_firstResidentLevel > 0 && copied < budget)
+    {
+        // a level that is still empty can go through eUndefined again when the ring had no room for it
+        uint32 level = m_firstResidentLevel - 1;
+        if (m_nextRow == 0)
+        {
+            vk::su::setImageLayout(commandBuffer, image, format, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, level, 1);
+        }
+        if (!recordKtx2Rows(commandBuffer, ring, m_file, level, image, level, m_copyAlignment, budget, m_nextRow, copied))
+        {
+            break;
+        }
+
+        if (m_nextRow == m_file.getRowCount(level))
+        {
+            vk::su::setImageLayout(commandBuffer, image, format, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, level, 1);
+            m_firstResidentLevel = level;
+            m_nextRow = 0;
+        }
+    }
+    return m_firstResidentLevel == 0;
+}
+
+const vk::UniqueImageView& Ktx2Texture::getImageView() const
+{
+    assert(m_firstResidentLevel < m_levelViews.size());
+    return m_levelViews[m_firstResidentLevel];
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Common.h"
+#include "MappedFile.h"
+#include <vulkan/vulkan.hpp>
+#include <memory>
+
+class Device;
+class Image;
+class StagingRing;
+
+// Mapped KTX2 container of a single 2D texture. Level data is never read up front, uploads copy it straight out of
+// the mapping.
+class Ktx2File
+{
+public:
+    Ktx2File();
+
+    // Returns false unless the file is a KTX2 2D texture without layers, faces or supercompression, in eR8G8B8A8Unorm
+    // or a block format of TextureCompression.h, and every level lies within the file with the expected size
+    bool open(const string& path);
+    void close();
+
+    vk::Format getFormat() const { return m_format; }
+    vk::Extent2D getExtent() const { return m_extent; }
+    uint32 getLevelCount() const { return uint32(m_levels.size()); }
+
+    // Tightly packed rows of texels or blocks, valid until close()
+    const uint8_t* getLevelData(uint32 level) const;
+    size_t getLevelSize(uint32 level) const;
+
+    // Uploads split levels into rows of texels, or of blocks for the block formats
+    uint32 getRowCount(uint32 level) const;
+    size_t getRowSize(uint32 level) const;
+
+private:
+    struct Level
+    {
+        uint64  offset;
+        uint64  size;
+    };
+
+    MappedFile          m_file;
+    vk::Format          m_format;
+    vk::Extent2D        m_extent;
+    std::vector<Level>  m_levels;
+};
+
+// Copies the rows of level from nextRow on into imageLevel of image, which has to be in eTransferDstOptimal, as many
+// as the budget left after copied asks for and the ring has room for. Advances nextRow and copied, returns false
+// when the ring had no room for a single row.
+bool recordKtx2Rows(const vk::UniqueCommandBuffer& commandBuffer, StagingRing& ring, const Ktx2File& file, uint32 level, vk::Image image, uint32 imageLevel,
+                    vk::DeviceSize alignment, vk::DeviceSize budget, uint32& nextRow, vk::DeviceSize& copied);
+
+// Buffer offsets of copies into images of format: multiples of the texel block size and of 4, and of the optimal
+// alignment of the device
+vk::DeviceSize getKtx2CopyAlignment(const vk::PhysicalDevice& physicalDevice, vk::Format format);
+
+// Texture filled from a Ktx2File over several frames, smallest level first, so a blurry version can be drawn after
+// the first update while the detail streams in. Levels larger than what the ring or the budget allows are split into
+// rows of texels or blocks.
+class Ktx2Texture
+{
+public:
+    Ktx2Texture(const Device& device);
+    ~Ktx2Texture();
+
+    // Maps the file and creates the image with all of its levels, nothing is uploaded yet
+    bool open(const string& path);
+
+    // Records the copies of up to about budget bytes of the levels still missing, and the transitions of the levels
+    // it completes to eShaderReadOnlyOptimal. Stops early when the ring is full; the command buffer has to be
+    // submitted with ring.getSubmitFence(). Returns true once every level is resident.
+    bool update(const vk::UniqueCommandBuffer& commandBuffer, StagingRing& ring, vk::DeviceSize budget);
+
+    bool isResident() const { return m_firstResidentLevel == 0; }
+
+    // getLevelCount() while no level is resident yet
+    uint32 getFirstResidentLevel() const { return m_firstResidentLevel; }
+    uint32 getLevelCount() const { return m_file.getLevelCount(); }
+
+    const Image& getImage() const { return *m_image; }
+
+    // Covers the resident levels only, the levels still being written are in another layout. Descriptors need to be
+    // written again when getFirstResidentLevel() changes; views of levels that were resident stay valid.
+    const vk::UniqueImageView& getImageView() const;
+
+private:
+    const Device&                       m_device;
+    Ktx2File                            m_file;
+    std::unique_ptr<Image>              m_image;
+    std::vector<vk::UniqueImageView>    m_levelViews;       // [level] covers [level, levelCount)
+    vk::DeviceSize                      m_copyAlignment;
+    uint32                              m_firstResidentLevel;
+    uint32                              m_nextRow;          // of the level being written
+};
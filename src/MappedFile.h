@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Common.h"
+
+// Read only mapping of a whole file. Pages are shared with the OS file cache and only read from disk on first access,
+// so opening a large file is cheap and data can be copied straight out of it.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file does not exist, is empty or cannot be mapped
+    bool open(const string& path);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+
+    // Page aligned, valid until close()
+    const void* getData() const { return m_data; }
+    size_t getSize() const { return m_size; }
+
+private:
+    const void* m_data;
+    size_t      m_size;
+#ifdef _WIN32
+    void*       m_file;
+    void*       m_mapping;
+#else
+    int         m_file;
+#endif
+};
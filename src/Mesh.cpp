@@ -0,0 +1,67 @@
+#include "Mesh.h"
+
+VertexLayout VertexLayout::getVertexPNTLayout()
+{
+    VertexLayout layout;
+    layout.stride = sizeof(VertexPNT);
+    layout.attributes = { { vk::Format::eR32G32B32Sfloat, 0 }, { vk::Format::eR32G32B32Sfloat, 12 }, { vk::Format::eR32G32Sfloat, 24 } };
+    return layout;
+}
+
+std::vector<glm::vec3> Mesh::getPositions() const
+{
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        positions[i] = glm::vec3(vertices[i].x, vertices[i].y, vertices[i].z);
+    }
+    return positions;
+}
+
+void Mesh::computeBounds()
+{
+    bounds = Aabb();
+    for (const VertexPNT& vertex : vertices)
+    {
+        bounds.grow(glm::vec3(vertex.x, vertex.y, vertex.z));
+    }
+}
+
+void Mesh::computeNormals(size_t firstIndex, size_t indexCount)
+{
+    assert(firstIndex + indexCount <= indices.size());
+    const size_t lastIndex = firstIndex + indexCount / 3 * 3;
+
+    for (size_t i = firstIndex; i < lastIndex; i++)
+    {
+        VertexPNT& vertex = vertices[indices[i]];
+        vertex.nx = vertex.ny = vertex.nz = 0.0f;
+    }
+
+    // the cross product is twice the triangle area, so larger triangles weigh more
+    for (size_t i = firstIndex; i < lastIndex; i += 3)
+    {
+        VertexPNT* corners[3] = { &vertices[indices[i]], &vertices[indices[i + 1]], &vertices[indices[i + 2]] };
+        glm::vec3 p0(corners[0]->x, corners[0]->y, corners[0]->z);
+        glm::vec3 p1(corners[1]->x, corners[1]->y, corners[1]->z);
+        glm::vec3 p2(corners[2]->x, corners[2]->y, corners[2]->z);
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        for (VertexPNT* corner : corners)
+        {
+            corner->nx += n.x;
+            corner->ny += n.y;
+            corner->nz += n.z;
+        }
+    }
+
+    for (size_t i = firstIndex; i < lastIndex; i++)
+    {
+        VertexPNT& vertex = vertices[indices[i]];
+        glm::vec3 n(vertex.nx, vertex.ny, vertex.nz);
+        float length = glm::length(n);
+        n = length > 0.0f ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        vertex.nx = n.x;
+        vertex.ny = n.y;
+        vertex.nz = n.z;
+    }
+}
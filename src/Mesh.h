@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Ray.h"
+#include <vulkan/vulkan.hpp>
+
+// Interleaved vertex of imported meshes, 32 bytes
+struct VertexPNT
+{
+    float x, y, z;      // Position
+    float nx, ny, nz;   // Normal
+    float u, v;         // Texture coordinate
+};
+
+// Vertex input description in the form createGraphicsPipeline takes it
+struct VertexLayout
+{
+    uint32                                      stride = 0;
+    std::vector<std::pair<vk::Format, uint32_t>> attributes;    // format and offset per location
+
+    bool operator==(const VertexLayout& other) const { return stride == other.stride && attributes == other.attributes; }
+    bool operator!=(const VertexLayout& other) const { return !(*this == other); }
+
+    static VertexLayout getVertexPNTLayout();
+};
+
+// Cluster of triangles that are culled together. Its vertices are listed in Mesh::meshletVertices and its triangles
+// in Mesh::meshletTriangles, three bytes per triangle indexing the meshlet's own vertex list.
+struct Meshlet
+{
+    uint32  vertexOffset;
+    uint32  vertexCount;
+    uint32  triangleOffset;     // in triangles
+    uint32  triangleCount;
+    float   center[3];          // bounding sphere
+    float   radius;
+    float   coneAxis[3];        // average of the counter-clockwise triangle normals
+    float   coneCutoff;         // all triangles face away from a viewer at v if dot(center - v, coneAxis) >= coneCutoff * |center - v| + radius
+};
+
+// Triangle mesh in upload ready arrays, three indices per triangle. Meshlets are optional.
+struct Mesh
+{
+    std::vector<VertexPNT>  vertices;
+    std::vector<uint32>     indices;
+    Aabb                    bounds;
+
+    std::vector<Meshlet>    meshlets;
+    std::vector<uint32>     meshletVertices;
+    std::vector<uint8_t>    meshletTriangles;
+
+    size_t getSizeInBytes() const { return vertices.size() * sizeof(VertexPNT) + indices.size() * sizeof(uint32); }
+
+    // Positions alone, as BottomLevelAs takes them
+    std::vector<glm::vec3> getPositions() const;
+
+    void computeBounds();
+
+    // Area weighted vertex normals from the triangles in [firstIndex, firstIndex + indexCount), replacing the normals
+    // of every vertex they reference
+    void computeNormals(size_t firstIndex, size_t indexCount);
+    void computeNormals() { computeNormals(0, indices.size()); }
+};
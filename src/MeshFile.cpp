@@ -0,0 +1,304 @@
+#include "MeshFile.h"
+#include "GraphicsObjects.h"
+#include "MeshImporter.h"
+#include "MeshOptimizer.h"
+#include "Profiling.h"
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+
+static uint64 alignOffset(uint64 offset)
+{
+    return (offset + MeshFileAlignment - 1) / MeshFileAlignment * MeshFileAlignment;
+}
+
+static uint32 getIndexSize(vk::IndexType indexType)
+{
+    switch (indexType)
+    {
+    case vk::IndexType::eUint16: return 2;
+    case vk::IndexType::eUint32: return 4;
+    default: return 0;
+    }
+}
+
+// Element size every stream must have, the vertex stream follows the layout
+static uint32 getStreamElementSize(const MeshFileHeader& header, MeshStream stream)
+{
+    switch (stream)
+    {
+    case MeshStream::Vertices: return header.vertexStride;
+    case MeshStream::Indices: return getIndexSize(vk::IndexType(header.indexType));
+    case MeshStream::Meshlets: return sizeof(Meshlet);
+    case MeshStream::MeshletVertices: return sizeof(uint32);
+    case MeshStream::MeshletTriangles: return sizeof(uint8_t);
+    default: return 0;
+    }
+}
+
+MeshFile::MeshFile()
+    : m_header(nullptr)
+{
+}
+
+MeshFile::~MeshFile()
+{
+
+}
+
+bool MeshFile::write(const string& path, const Mesh& mesh)
+{
+    const VertexLayout layout = VertexLayout::getVertexPNTLayout();
+    assert(layout.attributes.size() <= MeshFileMaxAttributes);
+
+    MeshFileHeader header = {};
+    header.magic = MeshFileMagic;
+    header.version = MeshFileVersion;
+    memcpy(header.boundsMin, &mesh.bounds.min, sizeof(header.boundsMin));
+    memcpy(header.boundsMax, &mesh.bounds.max, sizeof(header.boundsMax));
+    header.vertexStride = layout.stride;
+    header.attributeCount = uint32(layout.attributes.size());
+    for (uint32 i = 0; i < header.attributeCount; i++)
+    {
+        header.attributes[i] = { uint32(layout.attributes[i].first), layout.attributes[i].second };
+    }
+    const IndexData indexData = IndexData::pack(mesh.indices, mesh.vertices.size());
+    header.indexType = uint32(indexData.type);
+
+    const void* streamData[uint32(MeshStream::Count)] = { mesh.vertices.data(), indexData.bytes.data(), mesh.meshlets.data(), mesh.meshletVertices.data(), mesh.meshletTriangles.data() };
+    const size_t streamCounts[uint32(MeshStream::Count)] = { mesh.vertices.size(), mesh.indices.size(), mesh.meshlets.size(), mesh.meshletVertices.size(), mesh.meshletTriangles.size() };
+    uint64 offset = sizeof(MeshFileHeader);
+    for (uint32 i = 0; i < uint32(MeshStream::Count); i++)
+    {
+        MeshFileStream& stream = header.streams[i];
+        stream.elementSize = getStreamElementSize(header, MeshStream(i));
+        stream.count = streamCounts[i];
+        stream.offset = stream.count ? alignOffset(offset) : 0;
+        offset = stream.count ? stream.offset + stream.count * stream.elementSize : offset;
+    }
+    header.fileSize = offset;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        return false;
+    }
+
+    static const char padding[MeshFileAlignment] = {};
+    uint64 position = 0;
+    auto writeAt = [&](uint64 offset, const void* data, size_t size)
+    {
+        assert(position <= offset && offset - position <= MeshFileAlignment);
+        file.write(padding, std::streamsize(offset - position));
+        file.write(static_cast<const char*>(data), std::streamsize(size));
+        position = offset + size;
+    };
+    writeAt(0, &header, sizeof(header));
+    for (uint32 i = 0; i < uint32(MeshStream::Count); i++)
+    {
+        const MeshFileStream& stream = header.streams[i];
+        if (stream.count)
+        {
+            writeAt(stream.offset, streamData[i], size_t(stream.count * stream.elementSize));
+        }
+    }
+    return bool(file);
+}
+
+bool MeshFile::convert(const string& sourcePath, const string& path, MeshImportStats* stats)
+{
+    Mesh mesh;
+    return importMesh(sourcePath, mesh, stats) && write(path, mesh);
+}
+
+bool MeshFile::open(const string& path)
+{
+    close();
+    if (!m_file.open(path))
+    {
+        return false;
+    }
+
+    const uint64 fileSize = m_file.getSize();
+    const MeshFileHeader* header = static_cast<const MeshFileHeader*>(m_file.getData());
+    bool valid = sizeof(MeshFileHeader) <= fileSize
+              && header->magic == MeshFileMagic
+              && header->version == MeshFileVersion
+              && header->fileSize == fileSize
+              && 0 < header->vertexStride
+              && header->attributeCount <= MeshFileMaxAttributes
+              && getIndexSize(vk::IndexType(header->indexType)) != 0;
+    for (uint32 i = 0; valid && i < header->attributeCount; i++)
+    {
+        valid = header->attributes[i].offset < header->vertexStride;
+    }
+    // an offset near 2^64 would wrap offset + size, so the size is checked against what is left behind the offset
+    for (uint32 i = 0; valid && i < uint32(MeshStream::Count); i++)
+    {
+        const MeshFileStream& stream = header->streams[i];
+        valid = stream.elementSize == getStreamElementSize(*header, MeshStream(i))
+             && stream.count <= fileSize / stream.elementSize
+             && (stream.count == 0 || (stream.offset % MeshFileAlignment == 0 && sizeof(MeshFileHeader) <= stream.offset
+                                       && stream.offset <= fileSize && stream.count * stream.elementSize <= fileSize - stream.offset));
+    }
+    if (!valid)
+    {
+        m_file.close();
+        return false;
+    }
+
+    m_header = header;
+    return true;
+}
+
+void MeshFile::close()
+{
+    m_header = nullptr;
+    m_file.close();
+}
+
+VertexLayout MeshFile::getVertexLayout() const
+{
+    assert(m_header);
+    VertexLayout layout;
+    layout.stride = m_header->vertexStride;
+    for (uint32 i = 0; i < m_header->attributeCount; i++)
+    {
+        layout.attributes.push_back({ vk::Format(m_header->attributes[i].format), m_header->attributes[i].offset });
+    }
+    return layout;
+}
+
+Aabb MeshFile::getBounds() const
+{
+    assert(m_header);
+    Aabb bounds;
+    memcpy(&bounds.min, m_header->boundsMin, sizeof(m_header->boundsMin));
+    memcpy(&bounds.max, m_header->boundsMax, sizeof(m_header->boundsMax));
+    return bounds;
+}
+
+const void* MeshFile::getStreamData(MeshStream stream) const
+{
+    assert(m_header);
+    const MeshFileStream& s = m_header->streams[uint32(stream)];
+    return s.count ? static_cast<const char*>(m_file.getData()) + s.offset : nullptr;
+}
+
+template <typename T>
+static void copyStream(const MeshFile& file, MeshStream stream, std::vector<T>& v)
+{
+    v.resize(file.getStreamCount(stream));
+    if (!v.empty())
+    {
+        memcpy(v.data(), file.getStreamData(stream), file.getStreamSize(stream));
+    }
+}
+
+bool MeshFile::load(Mesh& mesh) const
+{
+    assert(m_header);
+    if (getVertexLayout() != VertexLayout::getVertexPNTLayout())
+    {
+        return false;
+    }
+
+    copyStream(*this, MeshStream::Vertices, mesh.vertices);
+    if (getIndexType() == vk::IndexType::eUint16)
+    {
+        std::vector<uint16> indices;
+        copyStream(*this, MeshStream::Indices, indices);
+        mesh.indices.assign(indices.begin(), indices.end());
+    }
+    else
+    {
+        copyStream(*this, MeshStream::Indices, mesh.indices);
+    }
+    copyStream(*this, MeshStream::Meshlets, mesh.meshlets);
+    copyStream(*this, MeshStream::MeshletVertices, mesh.meshletVertices);
+    copyStream(*this, MeshStream::MeshletTriangles, mesh.meshletTriangles);
+    mesh.bounds = getBounds();
+    return true;
+}
+
+std::unique_ptr<Buffer> MeshFile::createBuffer(const Device& device, const vk::UniqueCommandPool& commandPool, MeshStream stream, vk::BufferUsageFlags usage) const
+{
+    size_t size = getStreamSize(stream);
+    if (size == 0)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<Buffer> buffer = std::make_unique<Buffer>(device, size, usage | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    buffer->upload(commandPool, device.getGraphicsQueue(), getStreamData(stream), size);
+    return buffer;
+}
+
+std::unique_ptr<Buffer> MeshFile::createVertexBuffer(const Device& device, const vk::UniqueCommandPool& commandPool) const
+{
+    return createBuffer(device, commandPool, MeshStream::Vertices, vk::BufferUsageFlagBits::eVertexBuffer);
+}
+
+std::unique_ptr<Buffer> MeshFile::createIndexBuffer(const Device& device, const vk::UniqueCommandPool& commandPool) const
+{
+    return createBuffer(device, commandPool, MeshStream::Indices, vk::BufferUsageFlagBits::eIndexBuffer);
+}
+
+void printMeshLoadBenchmark(std::ostream& os, const string& sourcePath, const string& meshFilePath)
+{
+    MeshImportStats importStats;
+    if (!MeshFile::convert(sourcePath, meshFilePath, &importStats))
+    {
+        os << "cannot convert " << sourcePath << "\n";
+        return;
+    }
+
+    // best of several runs, the first one may still read from disk
+    const int RunCount = 5;
+    double loadMilliseconds = DBL_MAX;
+    size_t loadBytes = 0;
+    std::vector<uint8_t> staging;
+    for (int run = 0; run < RunCount; run++)
+    {
+        Timer timer;
+        MeshFile file;
+        if (!file.open(meshFilePath))
+        {
+            os << "cannot open " << meshFilePath << "\n";
+            return;
+        }
+
+        loadBytes = 0;
+        for (uint32 i = 0; i < uint32(MeshStream::Count); i++)
+        {
+            loadBytes += file.getStreamSize(MeshStream(i));
+        }
+        // sized once, like a staging buffer that is reused
+        if (staging.size() < loadBytes)
+        {
+            staging.resize(loadBytes);
+            timer.reset();
+        }
+
+        size_t offset = 0;
+        for (uint32 i = 0; i < uint32(MeshStream::Count); i++)
+        {
+            size_t size = file.getStreamSize(MeshStream(i));
+            if (size)
+            {
+                memcpy(staging.data() + offset, file.getStreamData(MeshStream(i)), size);
+                offset += size;
+            }
+        }
+        file.close();
+        loadMilliseconds = std::min(loadMilliseconds, timer.getElapsedMilliseconds());
+    }
+
+    os << std::fixed << std::setprecision(1)
+       << "import " << sourcePath << ": " << importStats.milliseconds << " ms, " << importStats.getMegabytesPerSecond() << " MB/s\n"
+       << "load " << meshFilePath << ": " << loadMilliseconds << " ms, " << loadBytes / (loadMilliseconds * 1000.0) << " MB/s, "
+       << importStats.milliseconds / loadMilliseconds << "x faster\n"
+       << std::defaultfloat;
+}
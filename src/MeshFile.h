@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Mesh.h"
+#include "MappedFile.h"
+#include <iosfwd>
+#include <memory>
+
+class Device;
+class Buffer;
+struct MeshImportStats;
+
+// Native mesh file, used in place once mapped:
+//
+//   MeshFileHeader | padding | stream | padding | stream ...
+//
+// Every stream starts on a MeshFileAlignment boundary, so the loader copies vertex and index data from the mapped
+// pages straight into staging buffers without parsing. The header carries the vertex layout for
+// createGraphicsPipeline, the index type, 16 bit whenever the vertex count allows, and the bounds. Little endian only, like every platform this runs on.
+const uint32 MeshFileMagic = 0x4853454du;      // "MESH"
+const uint32 MeshFileVersion = 1;               // bump with any change to the layout or the stream element types
+const uint64 MeshFileAlignment = 4096;
+const uint32 MeshFileMaxAttributes = 8;
+
+enum class MeshStream
+{
+    Vertices,
+    Indices,
+    Meshlets,           // Meshlet
+    MeshletVertices,    // uint32
+    MeshletTriangles,   // uint8, three per triangle
+
+    Count
+};
+
+struct MeshFileAttribute
+{
+    uint32  format;     // vk::Format
+    uint32  offset;
+};
+
+struct MeshFileStream
+{
+    uint64  offset;
+    uint64  count;      // in elements, 0 for absent streams
+    uint32  elementSize;
+    uint32  reserved;
+};
+
+struct MeshFileHeader
+{
+    uint32              magic;
+    uint32              version;
+    uint64              fileSize;
+    float               boundsMin[3];
+    float               boundsMax[3];
+    uint32              vertexStride;
+    uint32              attributeCount;
+    MeshFileAttribute   attributes[MeshFileMaxAttributes];
+    uint32              indexType;      // vk::IndexType
+    uint32              reserved;
+    MeshFileStream      streams[uint32(MeshStream::Count)];
+};
+
+class MeshFile
+{
+public:
+    MeshFile();
+    ~MeshFile();
+
+    static bool write(const string& path, const Mesh& mesh);
+
+    // Imports a text mesh with importMesh and writes it as a mesh file
+    static bool convert(const string& sourcePath, const string& path, MeshImportStats* stats = nullptr);
+
+    // Maps the file and validates magic, version, sizes and stream ranges. Returns false for missing, outdated or
+    // truncated files.
+    bool open(const string& path);
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+
+    VertexLayout getVertexLayout() const;
+    vk::IndexType getIndexType() const { return vk::IndexType(m_header->indexType); }
+    Aabb getBounds() const;
+    size_t getVertexCount() const { return getStreamCount(MeshStream::Vertices); }
+    size_t getIndexCount() const { return getStreamCount(MeshStream::Indices); }
+
+    // Point into the mapped file, valid until close()
+    const void* getStreamData(MeshStream stream) const;
+    size_t getStreamCount(MeshStream stream) const { return size_t(m_header->streams[uint32(stream)].count); }
+    size_t getStreamSize(MeshStream stream) const { return getStreamCount(stream) * m_header->streams[uint32(stream)].elementSize; }
+
+    // Copies the streams into mesh, for CPU side work like BVH builds, widening 16 bit indices. Returns false unless
+    // the file holds VertexPNT vertices.
+    bool load(Mesh& mesh) const;
+
+    // Device local buffers filled straight from the mapped pages, nullptr for an absent stream
+    std::unique_ptr<Buffer> createBuffer(const Device& device, const vk::UniqueCommandPool& commandPool, MeshStream stream, vk::BufferUsageFlags usage) const;
+    std::unique_ptr<Buffer> createVertexBuffer(const Device& device, const vk::UniqueCommandPool& commandPool) const;
+    std::unique_ptr<Buffer> createIndexBuffer(const Device& device, const vk::UniqueCommandPool& commandPool) const;
+
+private:
+    MappedFile              m_file;
+    const MeshFileHeader*   m_header;
+};
+
+// Times importing sourcePath against loading the same mesh from a mesh file at meshFilePath, which is written first.
+// Loading copies every stream out of the mapping into one host buffer, the way uploads fill staging memory.
+void printMeshLoadBenchmark(std::ostream& os, const string& sourcePath, const string& meshFilePath);
@@ -0,0 +1,1145 @@
+#include "MeshImporter.h"
+#include "Json.h"
+#include "MappedFile.h"
+#include "Profiling.h"
+#include "ThreadPool.h"
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <tuple>
+
+// OBJ chunks are at least this large, so the per chunk bookkeeping stays negligible
+const size_t ObjMinChunkSize = 1 << 20;
+// duplicate vertices are resolved in this many independent groups, a constant keeps the result independent of the thread count
+const uint32 ObjDuplicateShards = 64;
+const uint64 ObjUnclaimed = ~0ull;
+
+// arrays larger than this are split into several tasks, a multiple of 3 so index ranges never cut a triangle
+const uint32 ImportTaskSize = 3 << 18;
+
+// Counts the bytes held by the importer's own arrays
+class MemoryCounter
+{
+public:
+    MemoryCounter() : m_current(0), m_peak(0) {}
+
+    template <typename T>
+    void add(const std::vector<T>& v) { add(v.capacity() * sizeof(T)); }
+    template <typename T>
+    void remove(const std::vector<T>& v) { remove(v.capacity() * sizeof(T)); }
+
+    void add(uint64 bytes)
+    {
+        m_current += bytes;
+        m_peak = std::max(m_peak, m_current);
+    }
+    void remove(uint64 bytes) { m_current -= std::min(m_current, bytes); }
+
+    uint64 getPeak() const { return m_peak; }
+
+private:
+    uint64  m_current;
+    uint64  m_peak;
+};
+
+template <typename T>
+static void freeVector(std::vector<T>& v, MemoryCounter& memory)
+{
+    memory.remove(v);
+    std::vector<T>().swap(v);
+}
+
+static string getExtension(const string& path)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == string::npos || path.find_first_of("/\\", dot) != string::npos)
+    {
+        return string();
+    }
+    string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return char(tolower(c)); });
+    return extension;
+}
+
+static void finishStats(MeshImportStats* stats, const Timer& timer, uint64 fileBytes, const MemoryCounter& memory, const Mesh& mesh)
+{
+    if (stats)
+    {
+        stats->milliseconds = timer.getElapsedMilliseconds();
+        stats->fileBytes = fileBytes;
+        stats->peakBytes = memory.getPeak();
+        stats->meshBytes = mesh.getSizeInBytes();
+    }
+}
+
+void printMeshImportStats(std::ostream& os, const MeshImportStats& stats)
+{
+    os << std::fixed << std::setprecision(1)
+       << "imported " << stats.fileBytes / 1e6 << " MB in " << stats.milliseconds << " ms, " << stats.getMegabytesPerSecond() << " MB/s\n"
+       << "mesh " << stats.meshBytes / 1e6 << " MB, peak " << stats.peakBytes / 1e6 << " MB (" << std::setprecision(2) << stats.getPeakRatio() << "x)\n"
+       << std::defaultfloat;
+}
+
+bool importMesh(const string& path, Mesh& mesh, MeshImportStats* stats)
+{
+    string extension = getExtension(path);
+    if (extension == "obj")
+    {
+        return importObj(path, mesh, stats);
+    }
+    if (extension == "gltf" || extension == "glb")
+    {
+        return importGltf(path, mesh, stats);
+    }
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// OBJ
+//
+// 1. The file is cut into chunks at line breaks. Each chunk counts its positions, texture coordinates, normals and
+//    triangles, prefix sums turn the counts into the chunk's write offsets.
+// 2. The chunks parse in parallel straight into the attribute arrays and the final index array. Vertex i is meant to be
+//    position i: every position is claimed by the smallest (texcoord, normal) key of the corners using it, which does
+//    not depend on the order the chunks run in.
+// 3. Only if some position is used with different keys, the faces are parsed again and the corners whose key lost the
+//    claim are recorded, sorted into shards by position. Smooth meshes without seams skip this.
+// 4. Each shard gathers its recorded corners and sorts them by (position, key), which numbers its extra vertices the
+//    same way on every run. The extra vertices are appended after the positions.
+// 5. The vertices are assembled in parallel and the attribute arrays freed.
+
+struct ObjCorner
+{
+    uint32  index;          // into Mesh::indices
+    uint32  position;
+    uint64  key;            // (texcoord + 1) << 32 | (normal + 1), 0 for a missing one
+};
+
+struct ObjChunk
+{
+    const char*             begin;
+    const char*             end;
+    uint32                  positionCount = 0;
+    uint32                  texcoordCount = 0;
+    uint32                  normalCount = 0;
+    uint32                  triangleCount = 0;
+    uint32                  positionBase = 0;
+    uint32                  texcoordBase = 0;
+    uint32                  normalBase = 0;
+    uint32                  triangleBase = 0;
+    std::vector<ObjCorner>  duplicates[ObjDuplicateShards];
+};
+
+struct ObjShard
+{
+    std::vector<ObjCorner>  corners;
+    uint32                  vertexCount = 0;
+    uint32                  vertexBase = 0;
+};
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* skipSpaces(const char* p, const char* end)
+{
+    while (p < end && isSpace(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+static const char* findLineEnd(const char* p, const char* end)
+{
+    const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+    return newline ? newline : end;
+}
+
+// strtof is locale dependent, slow, and needs a terminated string
+static const char* parseFloat(const char* p, const char* end, float& value)
+{
+    static const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+
+    p = skipSpaces(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p++ == '-';
+    }
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    bool digits = false;
+    for (; p < end && '0' <= *p && *p <= '9'; p++, digits = true)
+    {
+        mantissa = mantissa * 10.0 + (*p - '0');
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && '0' <= *p && *p <= '9'; p++, digits = true)
+        {
+            mantissa = mantissa * 10.0 + (*p - '0');
+            exponent--;
+        }
+    }
+    if (!digits)
+    {
+        return nullptr;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negativeExponent = *p++ == '-';
+        }
+        int e = 0;
+        for (; p < end && '0' <= *p && *p <= '9'; p++)
+        {
+            e = std::min(e * 10 + (*p - '0'), 1000);
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    double scale = std::abs(exponent) <= 18 ? powersOf10[std::abs(exponent)] : std::pow(10.0, std::abs(exponent));
+    double result = exponent < 0 ? mantissa / scale : mantissa * scale;
+    value = float(negative ? -result : result);
+    return p;
+}
+
+static const char* parseInt(const char* p, const char* end, int64& value)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p++ == '-';
+    }
+    const char* digitsBegin = p;
+    value = 0;
+    for (; p < end && '0' <= *p && *p <= '9'; p++)
+    {
+        value = std::min<int64>(value * 10 + (*p - '0'), int64(1) << 40);
+    }
+    if (p == digitsBegin)
+    {
+        return nullptr;
+    }
+    value = negative ? -value : value;
+    return p;
+}
+
+// 1 based, negative counts back from the last element defined so far. Returns ~0u for invalid references.
+static uint32 resolveObjIndex(int64 index, uint32 countSoFar, uint32 totalCount)
+{
+    int64 resolved = index > 0 ? index - 1 : int64(countSoFar) + index;
+    return index != 0 && 0 <= resolved && resolved < totalCount ? uint32(resolved) : ~0u;
+}
+
+enum class ObjLine
+{
+    Other,
+    Position,
+    Texcoord,
+    Normal,
+    Face,
+};
+
+static ObjLine classifyObjLine(const char*& p, const char* end)
+{
+    p = skipSpaces(p, end);
+    if (end - p < 2)
+    {
+        return ObjLine::Other;
+    }
+    if (p[0] == 'f' && isSpace(p[1]))
+    {
+        p += 2;
+        return ObjLine::Face;
+    }
+    if (p[0] != 'v')
+    {
+        return ObjLine::Other;
+    }
+    if (isSpace(p[1]))
+    {
+        p += 2;
+        return ObjLine::Position;
+    }
+    if (end - p >= 3 && isSpace(p[2]) && (p[1] == 't' || p[1] == 'n'))
+    {
+        ObjLine type = p[1] == 't' ? ObjLine::Texcoord : ObjLine::Normal;
+        p += 3;
+        return type;
+    }
+    return ObjLine::Other;
+}
+
+static uint32 countObjFaceCorners(const char* p, const char* lineEnd)
+{
+    uint32 corners = 0;
+    bool inToken = false;
+    for (; p < lineEnd && *p != '#'; p++)
+    {
+        bool space = isSpace(*p);
+        corners += !space && !inToken ? 1 : 0;
+        inToken = !space;
+    }
+    return corners;
+}
+
+static void countObjChunk(ObjChunk& chunk)
+{
+    for (const char* line = chunk.begin; line < chunk.end; )
+    {
+        const char* lineEnd = findLineEnd(line, chunk.end);
+        const char* p = line;
+        switch (classifyObjLine(p, lineEnd))
+        {
+        case ObjLine::Position: chunk.positionCount++; break;
+        case ObjLine::Texcoord: chunk.texcoordCount++; break;
+        case ObjLine::Normal: chunk.normalCount++; break;
+        case ObjLine::Face: chunk.triangleCount += std::max(2u, countObjFaceCorners(p, lineEnd)) - 2; break;
+        default: break;
+        }
+        line = lineEnd + 1;
+    }
+}
+
+struct ObjArrays
+{
+    std::vector<glm::vec3>                  positions;
+    std::vector<glm::vec2>                  texcoords;
+    std::vector<glm::vec3>                  normals;
+    std::unique_ptr<std::atomic<uint64>[]>  claims;     // smallest key of the corners using each position
+    std::atomic<bool>                       conflicts;  // some position is used with different keys
+    uint32*                                 indices;
+};
+
+// The first pass fills the attributes, claims and indices. With recordDuplicates the faces are parsed once more after
+// all claims are settled, recording the corners that lost.
+static bool parseObjChunk(ObjChunk& chunk, ObjArrays& arrays, bool recordDuplicates)
+{
+    const uint32 positionTotal = uint32(arrays.positions.size());
+    const uint32 texcoordTotal = uint32(arrays.texcoords.size());
+    const uint32 normalTotal = uint32(arrays.normals.size());
+    uint32 positionCount = chunk.positionBase;
+    uint32 texcoordCount = chunk.texcoordBase;
+    uint32 normalCount = chunk.normalBase;
+    uint32 index = chunk.triangleBase * 3;
+    const uint32 indexEnd = (chunk.triangleBase + chunk.triangleCount) * 3;
+
+    bool conflicts = false;
+    auto emitCorner = [&](uint32 position, uint64 key)
+    {
+        if (recordDuplicates)
+        {
+            if (arrays.claims[position].load(std::memory_order_relaxed) != key)
+            {
+                chunk.duplicates[position % ObjDuplicateShards].push_back({ index, position, key });
+            }
+            index++;
+            return;
+        }
+
+        uint64 claimed = arrays.claims[position].load(std::memory_order_relaxed);
+        while (key < claimed && !arrays.claims[position].compare_exchange_weak(claimed, key, std::memory_order_relaxed))
+        {
+        }
+        conflicts |= claimed != key && claimed != ObjUnclaimed;
+        arrays.indices[index++] = position;
+    };
+
+    for (const char* line = chunk.begin; line < chunk.end; )
+    {
+        const char* lineEnd = findLineEnd(line, chunk.end);
+        const char* p = line;
+        ObjLine type = classifyObjLine(p, lineEnd);
+        line = lineEnd + 1;
+
+        if (recordDuplicates && type != ObjLine::Face)
+        {
+            // only the counts matter for relative indices
+            positionCount += type == ObjLine::Position ? 1 : 0;
+            texcoordCount += type == ObjLine::Texcoord ? 1 : 0;
+            normalCount += type == ObjLine::Normal ? 1 : 0;
+        }
+        else if (type == ObjLine::Position || type == ObjLine::Normal)
+        {
+            glm::vec3 v;
+            for (int k = 0; k < 3; k++)
+            {
+                p = p ? parseFloat(p, lineEnd, v[k]) : nullptr;
+            }
+            if (!p)
+            {
+                return false;
+            }
+            (type == ObjLine::Position ? arrays.positions[positionCount++] : arrays.normals[normalCount++]) = v;
+        }
+        else if (type == ObjLine::Texcoord)
+        {
+            // the second coordinate is optional
+            glm::vec2 t(0.0f);
+            p = parseFloat(p, lineEnd, t.x);
+            if (!p)
+            {
+                return false;
+            }
+            parseFloat(p, lineEnd, t.y);
+            arrays.texcoords[texcoordCount++] = t;
+        }
+        else if (type == ObjLine::Face)
+        {
+            uint32 cornerCount = countObjFaceCorners(p, lineEnd);
+            uint32 firstPosition = 0, previousPosition = 0;
+            uint64 firstKey = 0, previousKey = 0;
+            for (uint32 c = 0; c < cornerCount; c++)
+            {
+                // v, v/vt, v//vn or v/vt/vn
+                int64 v, vt = 0, vn = 0;
+                p = parseInt(skipSpaces(p, lineEnd), lineEnd, v);
+                if (p && p < lineEnd && *p == '/')
+                {
+                    p++;
+                    if (p < lineEnd && *p != '/')
+                    {
+                        p = parseInt(p, lineEnd, vt);
+                    }
+                    if (p && p < lineEnd && *p == '/')
+                    {
+                        p = parseInt(p + 1, lineEnd, vn);
+                    }
+                }
+                if (!p)
+                {
+                    return false;
+                }
+
+                uint32 position = resolveObjIndex(v, positionCount, positionTotal);
+                uint32 texcoord = vt ? resolveObjIndex(vt, texcoordCount, texcoordTotal) : ~0u;
+                uint32 normal = vn ? resolveObjIndex(vn, normalCount, normalTotal) : ~0u;
+                if (position == ~0u || (vt && texcoord == ~0u) || (vn && normal == ~0u))
+                {
+                    return false;
+                }
+                uint64 key = (uint64(texcoord + 1) << 32) | uint32(normal + 1);
+
+                // fan around the first corner
+                if (2 <= c)
+                {
+                    emitCorner(firstPosition, firstKey);
+                    emitCorner(previousPosition, previousKey);
+                    emitCorner(position, key);
+                }
+                if (c == 0)
+                {
+                    firstPosition = position;
+                    firstKey = key;
+                }
+                previousPosition = position;
+                previousKey = key;
+            }
+        }
+    }
+
+    if (conflicts)
+    {
+        arrays.conflicts = true;
+    }
+    return index == indexEnd;
+}
+
+static bool isSameObjVertex(const ObjCorner& a, const ObjCorner& b)
+{
+    return a.position == b.position && a.key == b.key;
+}
+
+// Sorts the corners that lost their claim and counts the distinct (position, key) among them
+static void sortObjShard(ObjShard& shard)
+{
+    std::sort(shard.corners.begin(), shard.corners.end(), [](const ObjCorner& a, const ObjCorner& b)
+    {
+        return std::tie(a.position, a.key, a.index) < std::tie(b.position, b.key, b.index);
+    });
+    for (size_t i = 0; i < shard.corners.size(); i++)
+    {
+        shard.vertexCount += i == 0 || !isSameObjVertex(shard.corners[i - 1], shard.corners[i]) ? 1 : 0;
+    }
+}
+
+static void assembleObjVertex(VertexPNT& vertex, uint32 position, uint64 key, const ObjArrays& arrays)
+{
+    const glm::vec3& p = arrays.positions[position];
+    vertex = { p.x, p.y, p.z, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+    uint32 texcoord = uint32(key >> 32);
+    uint32 normal = uint32(key);
+    if (key != ObjUnclaimed && texcoord)
+    {
+        vertex.u = arrays.texcoords[texcoord - 1].x;
+        vertex.v = arrays.texcoords[texcoord - 1].y;
+    }
+    if (key != ObjUnclaimed && normal)
+    {
+        const glm::vec3& n = arrays.normals[normal - 1];
+        vertex.nx = n.x;
+        vertex.ny = n.y;
+        vertex.nz = n.z;
+    }
+}
+
+bool importObj(const string& path, Mesh& mesh, MeshImportStats* stats)
+{
+    Timer timer;
+    MemoryCounter memory;
+    ThreadPool& pool = ThreadPool::getInstance();
+
+    MappedFile file;
+    if (!file.open(path))
+    {
+        return false;
+    }
+    const char* text = static_cast<const char*>(file.getData());
+    const char* textEnd = text + file.getSize();
+
+    // cut into chunks at line breaks
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(file.getSize() / ObjMinChunkSize, pool.getThreadCount() * 8));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* chunkBegin = text;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        const char* chunkEnd = i + 1 == chunkCount ? textEnd : text + file.getSize() * (i + 1) / chunkCount;
+        chunkEnd = chunkBegin < chunkEnd ? std::min(textEnd, findLineEnd(chunkEnd, textEnd) + 1) : chunkBegin;
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    pool.parallelFor(uint32(chunkCount), [&](uint32 i) { countObjChunk(chunks[i]); });
+
+    uint64 positionCount = 0, texcoordCount = 0, normalCount = 0, triangleCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.positionBase = uint32(positionCount);
+        chunk.texcoordBase = uint32(texcoordCount);
+        chunk.normalBase = uint32(normalCount);
+        chunk.triangleBase = uint32(triangleCount);
+        positionCount += chunk.positionCount;
+        texcoordCount += chunk.texcoordCount;
+        normalCount += chunk.normalCount;
+        triangleCount += chunk.triangleCount;
+    }
+    if (positionCount == 0 || triangleCount == 0 || UINT32_MAX / 3 < triangleCount || UINT32_MAX / 2 < positionCount)
+    {
+        return false;
+    }
+
+    ObjArrays arrays;
+    arrays.positions.resize(positionCount);
+    arrays.texcoords.resize(texcoordCount);
+    arrays.normals.resize(normalCount);
+    arrays.claims.reset(new std::atomic<uint64>[positionCount]);
+    arrays.conflicts = false;
+    mesh.indices.resize(triangleCount * 3);
+    arrays.indices = mesh.indices.data();
+    memory.add(arrays.positions);
+    memory.add(arrays.texcoords);
+    memory.add(arrays.normals);
+    memory.add(positionCount * sizeof(uint64));
+    memory.add(mesh.indices);
+
+    const uint32 vertexBlocks = uint32((positionCount + ImportTaskSize - 1) / ImportTaskSize);
+    pool.parallelFor(vertexBlocks, [&](uint32 block)
+    {
+        for (uint64 i = uint64(block) * ImportTaskSize; i < std::min<uint64>(positionCount, uint64(block + 1) * ImportTaskSize); i++)
+        {
+            arrays.claims[i].store(ObjUnclaimed, std::memory_order_relaxed);
+        }
+    });
+
+    std::atomic<bool> valid(true);
+    pool.parallelFor(uint32(chunkCount), [&](uint32 i)
+    {
+        if (!parseObjChunk(chunks[i], arrays, false))
+        {
+            valid = false;
+        }
+    });
+    if (!valid)
+    {
+        return false;
+    }
+
+    std::vector<ObjShard> shards(ObjDuplicateShards);
+    if (arrays.conflicts)
+    {
+        pool.parallelFor(uint32(chunkCount), [&](uint32 i) { parseObjChunk(chunks[i], arrays, true); });
+        for (const ObjChunk& chunk : chunks)
+        {
+            for (const std::vector<ObjCorner>& duplicates : chunk.duplicates)
+            {
+                memory.add(duplicates);
+            }
+        }
+
+        // serially, so the chunk lists are freed as fast as the shards fill
+        for (uint32 i = 0; i < ObjDuplicateShards; i++)
+        {
+            size_t cornerCount = 0;
+            for (const ObjChunk& chunk : chunks)
+            {
+                cornerCount += chunk.duplicates[i].size();
+            }
+            shards[i].corners.reserve(cornerCount);
+            memory.add(shards[i].corners);
+            for (ObjChunk& chunk : chunks)
+            {
+                shards[i].corners.insert(shards[i].corners.end(), chunk.duplicates[i].begin(), chunk.duplicates[i].end());
+                freeVector(chunk.duplicates[i], memory);
+            }
+        }
+        pool.parallelFor(ObjDuplicateShards, [&](uint32 i) { sortObjShard(shards[i]); });
+    }
+
+    uint64 vertexCount = positionCount;
+    for (ObjShard& shard : shards)
+    {
+        shard.vertexBase = uint32(vertexCount);
+        vertexCount += shard.vertexCount;
+    }
+    if (UINT32_MAX < vertexCount)
+    {
+        return false;
+    }
+
+    mesh.vertices.resize(vertexCount);
+    memory.add(mesh.vertices);
+    pool.parallelFor(ObjDuplicateShards, [&](uint32 i)
+    {
+        ObjShard& shard = shards[i];
+        uint32 vertex = shard.vertexBase - 1;
+        for (size_t k = 0; k < shard.corners.size(); k++)
+        {
+            const ObjCorner& corner = shard.corners[k];
+            if (k == 0 || !isSameObjVertex(shard.corners[k - 1], corner))
+            {
+                assembleObjVertex(mesh.vertices[++vertex], corner.position, corner.key, arrays);
+            }
+            mesh.indices[corner.index] = vertex;
+        }
+    });
+    pool.parallelFor(vertexBlocks, [&](uint32 block)
+    {
+        for (uint64 i = uint64(block) * ImportTaskSize; i < std::min<uint64>(positionCount, uint64(block + 1) * ImportTaskSize); i++)
+        {
+            assembleObjVertex(mesh.vertices[i], uint32(i), arrays.claims[i].load(std::memory_order_relaxed), arrays);
+        }
+    });
+
+    const bool hasNormals = !arrays.normals.empty();
+    for (ObjShard& shard : shards)
+    {
+        freeVector(shard.corners, memory);
+    }
+    freeVector(arrays.positions, memory);
+    freeVector(arrays.texcoords, memory);
+    freeVector(arrays.normals, memory);
+    arrays.claims.reset();
+    memory.remove(positionCount * sizeof(uint64));
+
+    if (!hasNormals)
+    {
+        mesh.computeNormals();
+    }
+    mesh.computeBounds();
+
+    finishStats(stats, timer, file.getSize(), memory, mesh);
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// glTF
+//
+// The JSON is parsed serially, it is small next to the binary buffers. Every primitive gets its range of the final
+// vertex and index arrays up front, then its POSITION, NORMAL, TEXCOORD_0 and index accessors are read in parallel,
+// large ones in several tasks, each writing its own part of the interleaved vertices.
+
+const uint32 GlbMagic = 0x46546c67;            // "glTF"
+const uint32 GlbChunkJson = 0x4e4f534a;        // "JSON"
+const uint32 GlbChunkBin = 0x004e4942;         // "BIN\0"
+
+enum GltfComponentType
+{
+    GltfByte            = 5120,
+    GltfUnsignedByte    = 5121,
+    GltfShort           = 5122,
+    GltfUnsignedShort   = 5123,
+    GltfUnsignedInt     = 5125,
+    GltfFloat           = 5126,
+};
+
+struct GltfBuffer
+{
+    const uint8_t*  data = nullptr;
+    size_t          size = 0;
+};
+
+struct GltfAccessor
+{
+    const uint8_t*  data = nullptr;
+    uint32          count = 0;
+    uint32          stride = 0;
+    uint32          componentType = 0;
+    uint32          componentCount = 0;
+    bool            normalized = false;
+
+    bool isValid() const { return data != nullptr; }
+
+    float read(uint32 element, uint32 component) const
+    {
+        const uint8_t* p = data + size_t(element) * stride;
+        switch (componentType)
+        {
+        case GltfFloat:         { float v; memcpy(&v, p + component * 4, 4); return v; }
+        case GltfUnsignedInt:   { uint32 v; memcpy(&v, p + component * 4, 4); return float(v); }
+        case GltfUnsignedShort: { uint16 v; memcpy(&v, p + component * 2, 2); return normalized ? v / 65535.0f : float(v); }
+        case GltfShort:         { int16 v; memcpy(&v, p + component * 2, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : float(v); }
+        case GltfUnsignedByte:  { uint8_t v = p[component]; return normalized ? v / 255.0f : float(v); }
+        case GltfByte:          { int8_t v = int8_t(p[component]); return normalized ? std::max(v / 127.0f, -1.0f) : float(v); }
+        default:                return 0.0f;
+        }
+    }
+
+    uint32 readIndex(uint32 element) const
+    {
+        const uint8_t* p = data + size_t(element) * stride;
+        switch (componentType)
+        {
+        case GltfUnsignedInt:   { uint32 v; memcpy(&v, p, 4); return v; }
+        case GltfUnsignedShort: { uint16 v; memcpy(&v, p, 2); return v; }
+        case GltfUnsignedByte:  return *p;
+        default:                return 0;
+        }
+    }
+};
+
+struct GltfPrimitive
+{
+    glm::mat4x4     transform;
+    glm::mat3x3     normalTransform;
+    bool            flipWinding;        // mirroring transforms turn the triangles inside out
+    GltfAccessor    positions;
+    GltfAccessor    normals;
+    GltfAccessor    texcoords;
+    GltfAccessor    indices;
+    uint32          vertexBase;
+    uint32          indexBase;
+    uint32          indexCount;
+};
+
+enum class GltfTaskType
+{
+    Positions,
+    Normals,
+    Texcoords,
+    Indices,
+};
+
+struct GltfTask
+{
+    uint32          primitive;
+    GltfTaskType    type;
+    uint32          begin;
+    uint32          end;
+};
+
+static uint32 getGltfComponentSize(uint32 componentType)
+{
+    switch (componentType)
+    {
+    case GltfByte: case GltfUnsignedByte: return 1;
+    case GltfShort: case GltfUnsignedShort: return 2;
+    case GltfUnsignedInt: case GltfFloat: return 4;
+    default: return 0;
+    }
+}
+
+static uint32 getGltfComponentCount(const string& type)
+{
+    return type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+}
+
+// Indices are unsigned integer scalars, readIndex knows no other type
+static bool isGltfIndexAccessor(const GltfAccessor& accessor)
+{
+    return accessor.componentCount == 1
+        && (accessor.componentType == GltfUnsignedByte || accessor.componentType == GltfUnsignedShort || accessor.componentType == GltfUnsignedInt);
+}
+
+// Resolves accessor index through its buffer view, checking every element lies within the buffer
+static bool getGltfAccessor(const JsonValue& gltf, const std::vector<GltfBuffer>& buffers, uint32 index, GltfAccessor& accessor)
+{
+    const JsonValue& json = gltf["accessors"][index];
+    const JsonValue& view = gltf["bufferViews"][json["bufferView"].getUint(~0u)];
+    uint32 bufferIndex = view["buffer"].getUint(~0u);
+    if (json.isNull() || view.isNull() || json.has("sparse") || buffers.size() <= bufferIndex)
+    {
+        return false;
+    }
+
+    accessor.componentType = json["componentType"].getUint();
+    accessor.componentCount = getGltfComponentCount(json["type"].getString());
+    accessor.normalized = json["normalized"].getBool();
+    accessor.count = json["count"].getUint();
+    uint32 elementSize = getGltfComponentSize(accessor.componentType) * accessor.componentCount;
+    accessor.stride = view["byteStride"].getUint(elementSize);
+    uint64 offset = uint64(view["byteOffset"].getUint()) + json["byteOffset"].getUint();
+    uint64 viewEnd = uint64(view["byteOffset"].getUint()) + view["byteLength"].getUint();
+    if (elementSize == 0 || accessor.count == 0 || accessor.stride < elementSize || viewEnd > buffers[bufferIndex].size
+        || offset + uint64(accessor.count - 1) * accessor.stride + elementSize > viewEnd)
+    {
+        return false;
+    }
+    accessor.data = buffers[bufferIndex].data + offset;
+    return true;
+}
+
+static glm::mat4x4 getGltfNodeTransform(const JsonValue& node)
+{
+    const JsonValue& matrix = node["matrix"];
+    if (matrix.size() == 16)
+    {
+        glm::mat4x4 m;
+        for (int i = 0; i < 16; i++)
+        {
+            m[i / 4][i % 4] = float(matrix[i].getNumber());
+        }
+        return m;
+    }
+
+    const JsonValue& t = node["translation"];
+    const JsonValue& r = node["rotation"];
+    const JsonValue& s = node["scale"];
+    glm::vec3 translation(t[0].getNumber(), t[1].getNumber(), t[2].getNumber());
+    glm::quat rotation(float(r[3].getNumber(1.0)), float(r[0].getNumber()), float(r[1].getNumber()), float(r[2].getNumber()));
+    glm::vec3 scale(s[0].getNumber(1.0), s[1].getNumber(1.0), s[2].getNumber(1.0));
+
+    glm::mat4x4 m = glm::mat4_cast(rotation);
+    m[0] *= scale.x;
+    m[1] *= scale.y;
+    m[2] *= scale.z;
+    m[3] = glm::vec4(translation, 1.0f);
+    return m;
+}
+
+static void collectGltfMeshes(const JsonValue& gltf, uint32 nodeIndex, const glm::mat4x4& parentTransform, uint32 depth,
+                              std::vector<std::pair<uint32, glm::mat4x4>>& meshInstances)
+{
+    const JsonValue& node = gltf["nodes"][nodeIndex];
+    // the node graph has to be a forest, the depth limit guards against cycles in broken files
+    if (node.isNull() || 64 < depth)
+    {
+        return;
+    }
+
+    glm::mat4x4 transform = parentTransform * getGltfNodeTransform(node);
+    if (node.has("mesh"))
+    {
+        meshInstances.push_back({ node["mesh"].getUint(), transform });
+    }
+    const JsonValue& children = node["children"];
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        collectGltfMeshes(gltf, children[i].getUint(~0u), transform, depth + 1, meshInstances);
+    }
+}
+
+static string decodeUri(const string& uri)
+{
+    string path;
+    for (size_t i = 0; i < uri.size(); i++)
+    {
+        if (uri[i] == '%' && i + 2 < uri.size() && isxdigit(uri[i + 1]) && isxdigit(uri[i + 2]))
+        {
+            path += char(strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        }
+        else
+        {
+            path += uri[i];
+        }
+    }
+    return path;
+}
+
+static void runGltfTask(const GltfTask& task, const std::vector<GltfPrimitive>& primitives, Mesh& mesh)
+{
+    const GltfPrimitive& primitive = primitives[task.primitive];
+    VertexPNT* vertices = mesh.vertices.data() + primitive.vertexBase;
+    switch (task.type)
+    {
+    case GltfTaskType::Positions:
+        for (uint32 i = task.begin; i < task.end; i++)
+        {
+            glm::vec3 p(primitive.positions.read(i, 0), primitive.positions.read(i, 1), primitive.positions.read(i, 2));
+            p = glm::vec3(primitive.transform * glm::vec4(p, 1.0f));
+            vertices[i].x = p.x;
+            vertices[i].y = p.y;
+            vertices[i].z = p.z;
+        }
+        break;
+
+    case GltfTaskType::Normals:
+        for (uint32 i = task.begin; i < task.end; i++)
+        {
+            glm::vec3 n(primitive.normals.read(i, 0), primitive.normals.read(i, 1), primitive.normals.read(i, 2));
+            float length = glm::length(primitive.normalTransform * n);
+            n = length > 0.0f ? primitive.normalTransform * n / length : n;
+            vertices[i].nx = n.x;
+            vertices[i].ny = n.y;
+            vertices[i].nz = n.z;
+        }
+        break;
+
+    case GltfTaskType::Texcoords:
+        for (uint32 i = task.begin; i < task.end; i++)
+        {
+            vertices[i].u = primitive.texcoords.read(i, 0);
+            vertices[i].v = primitive.texcoords.read(i, 1);
+        }
+        break;
+
+    case GltfTaskType::Indices:
+        // begin and end are multiples of 3, non indexed primitives use the vertices in order
+        for (uint32 i = task.begin; i < task.end; i += 3)
+        {
+            uint32 triangle[3];
+            for (uint32 k = 0; k < 3; k++)
+            {
+                triangle[k] = primitive.vertexBase + (primitive.indices.isValid() ? primitive.indices.readIndex(i + k) : i + k);
+            }
+            if (primitive.flipWinding)
+            {
+                std::swap(triangle[1], triangle[2]);
+            }
+            std::copy(triangle, triangle + 3, mesh.indices.begin() + primitive.indexBase + i);
+        }
+        break;
+    }
+}
+
+bool importGltf(const string& path, Mesh& mesh, MeshImportStats* stats)
+{
+    Timer timer;
+    MemoryCounter memory;
+
+    MappedFile file;
+    if (!file.open(path))
+    {
+        return false;
+    }
+    uint64 fileBytes = file.getSize();
+
+    // a .glb holds the JSON and the first buffer in chunks, a .gltf is the JSON alone
+    const uint8_t* bytes = static_cast<const uint8_t*>(file.getData());
+    const char* jsonText = static_cast<const char*>(file.getData());
+    size_t jsonSize = file.getSize();
+    GltfBuffer glbBuffer;
+    uint32 header[3];
+    if (file.getSize() >= 12 && (memcpy(header, bytes, 12), header[0] == GlbMagic))
+    {
+        if (header[1] != 2 || header[2] > file.getSize())
+        {
+            return false;
+        }
+        jsonSize = 0;
+        for (size_t offset = 12; offset + 8 <= header[2]; )
+        {
+            uint32 chunk[2];
+            memcpy(chunk, bytes + offset, 8);
+            if (offset + 8 + chunk[0] > header[2])
+            {
+                return false;
+            }
+            if (chunk[1] == GlbChunkJson && jsonSize == 0)
+            {
+                jsonText = reinterpret_cast<const char*>(bytes + offset + 8);
+                jsonSize = chunk[0];
+            }
+            else if (chunk[1] == GlbChunkBin && !glbBuffer.data)
+            {
+                glbBuffer.data = bytes + offset + 8;
+                glbBuffer.size = chunk[0];
+            }
+            offset += 8 + (size_t(chunk[0]) + 3) / 4 * 4;
+        }
+    }
+
+    JsonValue gltf;
+    if (!JsonValue::parse(jsonText, jsonSize, gltf) || gltf["asset"]["version"].getString().compare(0, 1, "2") != 0)
+    {
+        return false;
+    }
+
+    // buffers without uri refer to the .glb chunk, the others to files next to the .gltf
+    const JsonValue& bufferList = gltf["buffers"];
+    std::vector<GltfBuffer> buffers(bufferList.size());
+    std::vector<std::unique_ptr<MappedFile>> bufferFiles;
+    size_t directoryEnd = path.find_last_of("/\\");
+    string directory = directoryEnd == string::npos ? string() : path.substr(0, directoryEnd + 1);
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        const JsonValue& uri = bufferList[i]["uri"];
+        if (uri.isNull())
+        {
+            buffers[i] = glbBuffer;
+            continue;
+        }
+        // data: URIs are meant for small test assets, production meshes keep binary data in buffers
+        if (uri.getString().compare(0, 5, "data:") == 0)
+        {
+            return false;
+        }
+        bufferFiles.push_back(std::make_unique<MappedFile>());
+        if (!bufferFiles.back()->open(directory + decodeUri(uri.getString())))
+        {
+            return false;
+        }
+        buffers[i].data = static_cast<const uint8_t*>(bufferFiles.back()->getData());
+        buffers[i].size = bufferFiles.back()->getSize();
+        fileBytes += buffers[i].size;
+    }
+
+    // mesh instances of the default scene, all meshes untransformed for files without scenes
+    std::vector<std::pair<uint32, glm::mat4x4>> meshInstances;
+    const JsonValue& scene = gltf["scenes"][gltf["scene"].getUint()];
+    if (gltf.has("scenes"))
+    {
+        for (size_t i = 0; i < scene["nodes"].size(); i++)
+        {
+            collectGltfMeshes(gltf, scene["nodes"][i].getUint(~0u), glm::mat4x4(1.0f), 0, meshInstances);
+        }
+    }
+    else
+    {
+        for (uint32 i = 0; i < gltf["meshes"].size(); i++)
+        {
+            meshInstances.push_back({ i, glm::mat4x4(1.0f) });
+        }
+    }
+
+    // place every triangle primitive in the output arrays
+    std::vector<GltfPrimitive> primitives;
+    uint64 vertexCount = 0, indexCount = 0;
+    for (const std::pair<uint32, glm::mat4x4>& meshInstance : meshInstances)
+    {
+        const JsonValue& primitiveList = gltf["meshes"][meshInstance.first]["primitives"];
+        for (size_t i = 0; i < primitiveList.size(); i++)
+        {
+            const JsonValue& primitiveJson = primitiveList[i];
+            const JsonValue& attributes = primitiveJson["attributes"];
+            // 4: triangles, the default
+            if (primitiveJson["mode"].getUint(4) != 4 || !attributes.has("POSITION"))
+            {
+                continue;
+            }
+
+            GltfPrimitive primitive;
+            primitive.transform = meshInstance.second;
+            primitive.normalTransform = glm::transpose(glm::inverse(glm::mat3x3(meshInstance.second)));
+            primitive.flipWinding = glm::determinant(glm::mat3x3(meshInstance.second)) < 0.0f;
+            if (!getGltfAccessor(gltf, buffers, attributes["POSITION"].getUint(), primitive.positions)
+                || primitive.positions.componentCount != 3
+                || (attributes.has("NORMAL") && (!getGltfAccessor(gltf, buffers, attributes["NORMAL"].getUint(), primitive.normals) || primitive.normals.count != primitive.positions.count || primitive.normals.componentCount != 3))
+                || (attributes.has("TEXCOORD_0") && (!getGltfAccessor(gltf, buffers, attributes["TEXCOORD_0"].getUint(), primitive.texcoords) || primitive.texcoords.count != primitive.positions.count || primitive.texcoords.componentCount != 2))
+                || (primitiveJson.has("indices") && (!getGltfAccessor(gltf, buffers, primitiveJson["indices"].getUint(), primitive.indices) || !isGltfIndexAccessor(primitive.indices))))
+            {
+                return false;
+            }
+
+            primitive.vertexBase = uint32(vertexCount);
+            primitive.indexBase = uint32(indexCount);
+            primitive.indexCount = (primitive.indices.isValid() ? primitive.indices.count : primitive.positions.count) / 3 * 3;
+            vertexCount += primitive.positions.count;
+            indexCount += primitive.indexCount;
+            if (UINT32_MAX < vertexCount || UINT32_MAX < indexCount)
+            {
+                return false;
+            }
+            primitives.push_back(primitive);
+        }
+    }
+    if (indexCount == 0)
+    {
+        return false;
+    }
+
+    mesh.vertices.assign(vertexCount, VertexPNT{});
+    mesh.indices.resize(indexCount);
+    memory.add(mesh.vertices);
+    memory.add(mesh.indices);
+
+    std::vector<GltfTask> tasks;
+    for (uint32 i = 0; i < uint32(primitives.size()); i++)
+    {
+        const GltfPrimitive& primitive = primitives[i];
+        auto addTasks = [&](GltfTaskType type, uint32 count)
+        {
+            for (uint32 begin = 0; begin < count; begin += ImportTaskSize)
+            {
+                tasks.push_back({ i, type, begin, std::min(count, begin + ImportTaskSize) });
+            }
+        };
+        addTasks(GltfTaskType::Positions, primitive.positions.count);
+        addTasks(GltfTaskType::Normals, primitive.normals.isValid() ? primitive.normals.count : 0);
+        addTasks(GltfTaskType::Texcoords, primitive.texcoords.isValid() ? primitive.texcoords.count : 0);
+        addTasks(GltfTaskType::Indices, primitive.indexCount);
+    }
+
+    // index values are checked while they are read, a bad one fails the whole import
+    std::atomic<bool> valid(true);
+    ThreadPool::getInstance().parallelFor(uint32(tasks.size()), [&](uint32 i)
+    {
+        runGltfTask(tasks[i], primitives, mesh);
+        if (tasks[i].type == GltfTaskType::Indices)
+        {
+            const GltfPrimitive& primitive = primitives[tasks[i].primitive];
+            for (uint32 k = tasks[i].begin; k < tasks[i].end; k++)
+            {
+                if (mesh.indices[primitive.indexBase + k] - primitive.vertexBase >= primitive.positions.count)
+                {
+                    valid = false;
+                    break;
+                }
+            }
+        }
+    });
+    if (!valid)
+    {
+        return false;
+    }
+
+    for (const GltfPrimitive& primitive : primitives)
+    {
+        if (!primitive.normals.isValid())
+        {
+            mesh.computeNormals(primitive.indexBase, primitive.indexCount);
+        }
+    }
+    mesh.computeBounds();
+
+    finishStats(stats, timer, fileBytes, memory, mesh);
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Mesh.h"
+#include <iosfwd>
+
+struct MeshImportStats
+{
+    double  milliseconds    = 0.0;
+    uint64  fileBytes       = 0;    // including external glTF buffers
+    uint64  peakBytes       = 0;    // importer allocations at their peak, mapped file pages belong to the OS cache and are not counted
+    uint64  meshBytes       = 0;    // final vertex and index arrays
+
+    double getMegabytesPerSecond() const { return milliseconds > 0.0 ? fileBytes / (milliseconds * 1000.0) : 0.0; }
+    double getPeakRatio() const { return meshBytes ? double(peakBytes) / meshBytes : 0.0; }
+};
+
+void printMeshImportStats(std::ostream& os, const MeshImportStats& stats);
+
+// The importers map the file and parse it on ThreadPool::getInstance(), writing straight into the final vertex and
+// index arrays. They return false for missing files and for content they do not support; mesh is undefined then.
+
+// Wavefront OBJ: positions, texture coordinates, normals and polygonal faces, which are triangulated as fans. Corners
+// with the same position, texture coordinate and normal share a vertex. Without normals in the file they are computed.
+bool importObj(const string& path, Mesh& mesh, MeshImportStats* stats = nullptr);
+
+// glTF 2.0, .gltf with external buffers or .glb: the triangle primitives of all meshes instanced by the default scene,
+// transformed to world space and merged. POSITION, NORMAL and TEXCOORD_0 are read, missing normals are computed.
+bool importGltf(const string& path, Mesh& mesh, MeshImportStats* stats = nullptr);
+
+// Picks the importer by file extension
+bool importMesh(const string& path, Mesh& mesh, MeshImportStats* stats = nullptr);
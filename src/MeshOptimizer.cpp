@@ -0,0 +1,238 @@
+#include "MeshOptimizer.h"
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+
+static uint64 hashVertex(const uint8_t* vertex, size_t vertexSize)
+{
+    // FNV-1a
+    uint64 hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < vertexSize; i++)
+    {
+        hash = (hash ^ vertex[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+size_t generateVertexRemap(const void* vertices, size_t vertexCount, size_t vertexSize, std::vector<uint32>& remap)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+    remap.resize(vertexCount);
+
+    // open addressing with linear probing, at most half full
+    size_t tableSize = 1;
+    while (tableSize < vertexCount * 2)
+    {
+        tableSize *= 2;
+    }
+    std::vector<uint32> table(tableSize, ~0u);
+
+    size_t uniqueCount = 0;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const uint8_t* vertex = bytes + i * vertexSize;
+        size_t slot = size_t(hashVertex(vertex, vertexSize)) & (tableSize - 1);
+        while (table[slot] != ~0u && memcmp(bytes + size_t(table[slot]) * vertexSize, vertex, vertexSize) != 0)
+        {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == ~0u)
+        {
+            table[slot] = uint32(i);
+            uniqueCount++;
+        }
+        remap[i] = table[slot];
+    }
+    return uniqueCount;
+}
+
+size_t generateFetchRemap(const std::vector<uint32>& indices, size_t vertexCount, std::vector<uint32>& remap)
+{
+    remap.assign(vertexCount, ~0u);
+    uint32 usedCount = 0;
+    for (uint32 index : indices)
+    {
+        assert(index < vertexCount);
+        if (remap[index] == ~0u)
+        {
+            remap[index] = usedCount++;
+        }
+    }
+    return usedCount;
+}
+
+void optimizeVertexCache(std::vector<uint32>& indices, size_t vertexCount, uint32 cacheSize)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // triangles around each vertex
+    std::vector<uint32> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        liveTriangles[indices[i]]++;
+    }
+    std::vector<uint32> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+    std::vector<uint32> adjacency(triangleCount * 3);
+    std::vector<uint32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        adjacency[fill[indices[i]]++] = uint32(i / 3);
+    }
+
+    // cache time stamps start far enough in the past that every vertex is a miss
+    std::vector<uint32> cacheTimes(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32> deadEnds;
+    std::vector<uint32> candidates;
+    std::vector<uint32> output;
+    output.reserve(triangleCount * 3);
+    uint32 time = cacheSize + 1;
+    size_t cursor = 0;
+
+    auto isCached = [&](uint32 v) { return time - cacheTimes[v] <= cacheSize; };
+
+    uint32 fanning = indices[0];
+    while (fanning != ~0u)
+    {
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (uint32 a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+        {
+            uint32 triangle = adjacency[a];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+            for (uint32 k = 0; k < 3; k++)
+            {
+                uint32 v = indices[triangle * 3 + k];
+                output.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (!isCached(v))
+                {
+                    cacheTimes[v] = time++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // the next fanning vertex is the one that stays in the cache longest while its triangles are emitted
+        uint32 next = ~0u;
+        int bestPriority = -1;
+        for (uint32 v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+            {
+                continue;
+            }
+            int priority = time - cacheTimes[v] + 2 * liveTriangles[v] <= cacheSize ? int(time - cacheTimes[v]) : 0;
+            if (bestPriority < priority)
+            {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        // dead end: go back to a recently used vertex, then to any one with triangles left
+        while (next == ~0u && !deadEnds.empty())
+        {
+            uint32 v = deadEnds.back();
+            deadEnds.pop_back();
+            next = liveTriangles[v] ? v : ~0u;
+        }
+        for (; next == ~0u && cursor < vertexCount; cursor++)
+        {
+            next = liveTriangles[cursor] ? uint32(cursor) : ~0u;
+        }
+        fanning = next;
+    }
+
+    assert(output.size() == triangleCount * 3);
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+VertexCacheStats VertexCacheStats::analyze(const std::vector<uint32>& indices, size_t vertexCount)
+{
+    VertexCacheStats stats;
+    std::vector<uint32> cacheTimes(vertexCount, 0);
+    uint32 time = VertexCacheSize + 1;
+    size_t usedCount = 0;
+    for (uint32 index : indices)
+    {
+        if (cacheTimes[index] == 0)
+        {
+            usedCount++;
+        }
+        if (time - cacheTimes[index] > VertexCacheSize)
+        {
+            cacheTimes[index] = time++;
+            stats.invocations++;
+        }
+    }
+
+    stats.acmr = indices.size() >= 3 ? float(stats.invocations) / (indices.size() / 3) : 0.0f;
+    stats.atvr = usedCount ? float(stats.invocations) / usedCount : 0.0f;
+    return stats;
+}
+
+VertexCacheStats VertexCacheStats::analyzeNonIndexed(size_t vertexCount)
+{
+    VertexCacheStats stats;
+    stats.invocations = uint32(vertexCount);
+    stats.acmr = vertexCount >= 3 ? 3.0f : 0.0f;
+    stats.atvr = vertexCount ? 1.0f : 0.0f;
+    return stats;
+}
+
+void printVertexCacheStats(std::ostream& os, const VertexCacheStats& before, const VertexCacheStats& after)
+{
+    os << std::fixed << std::setprecision(3)
+       << "vertex shader invocations " << before.invocations << " -> " << after.invocations
+       << ", ACMR " << before.acmr << " -> " << after.acmr << "\n"
+       << std::defaultfloat;
+}
+
+vk::IndexType selectIndexType(size_t vertexCount)
+{
+    return vertexCount <= 0x10000 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+}
+
+IndexData IndexData::pack(const std::vector<uint32>& indices, size_t vertexCount)
+{
+    IndexData data;
+    data.type = selectIndexType(vertexCount);
+    if (data.type == vk::IndexType::eUint16)
+    {
+        data.bytes.resize(indices.size() * sizeof(uint16));
+        uint16* packed = reinterpret_cast<uint16*>(data.bytes.data());
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            assert(indices[i] < vertexCount);
+            packed[i] = uint16(indices[i]);
+        }
+    }
+    else
+    {
+        data.bytes.resize(indices.size() * sizeof(uint32));
+        memcpy(data.bytes.data(), indices.data(), data.bytes.size());
+    }
+    return data;
+}
+
+void optimizeMesh(Mesh& mesh)
+{
+    optimizeMesh(mesh.vertices, mesh.indices);
+    mesh.meshlets.clear();
+    mesh.meshletVertices.clear();
+    mesh.meshletTriangles.clear();
+}
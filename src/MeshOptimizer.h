@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Mesh.h"
+#include <iosfwd>
+
+// Entries of the post-transform vertex cache modelled by optimizeVertexCache and analyzeVertexCache. Hardware has
+// more, but optimizing for a small cache loses little on large ones while the opposite is not true.
+const uint32 VertexCacheSize = 16;
+
+// Vertex shader work of an index buffer under a FIFO post-transform cache of VertexCacheSize entries
+struct VertexCacheStats
+{
+    uint32  invocations = 0;
+    float   acmr = 0.0f;        // invocations per triangle, 0.5 at best for large regular meshes, 3 without reuse
+    float   atvr = 0.0f;        // invocations per vertex, 1 at best
+
+    static VertexCacheStats analyze(const std::vector<uint32>& indices, size_t vertexCount);
+    // A non indexed draw runs the vertex shader for every corner
+    static VertexCacheStats analyzeNonIndexed(size_t vertexCount);
+};
+
+void printVertexCacheStats(std::ostream& os, const VertexCacheStats& before, const VertexCacheStats& after);
+
+// Fills remap with the first of the bitwise identical vertices for every vertex, returns the number of distinct ones
+size_t generateVertexRemap(const void* vertices, size_t vertexCount, size_t vertexSize, std::vector<uint32>& remap);
+
+// Numbers the vertices in the order the indices first use them, unused vertices get ~0u. Returns the used count.
+size_t generateFetchRemap(const std::vector<uint32>& indices, size_t vertexCount, std::vector<uint32>& remap);
+
+// Reorders triangles so consecutive ones share vertices still in the post-transform cache (Tipsify, Sander et al. 2007)
+void optimizeVertexCache(std::vector<uint32>& indices, size_t vertexCount, uint32 cacheSize = VertexCacheSize);
+
+// Smallest index type for vertexCount vertices
+vk::IndexType selectIndexType(size_t vertexCount);
+
+// Indices in the type selectIndexType picks, ready for upload
+struct IndexData
+{
+    vk::IndexType           type = vk::IndexType::eUint32;
+    std::vector<uint8_t>    bytes;
+
+    uint32 getCount() const { return uint32(bytes.size() / (type == vk::IndexType::eUint16 ? 2 : 4)); }
+
+    static IndexData pack(const std::vector<uint32>& indices, size_t vertexCount);
+};
+
+// Keeps only the vertices whose remap entry is not ~0u, each moved to the entry it maps to, and rewrites indices
+template <typename Vertex>
+void remapVertices(std::vector<Vertex>& vertices, std::vector<uint32>& indices, const std::vector<uint32>& remap, size_t newVertexCount)
+{
+    std::vector<Vertex> remapped(newVertexCount);
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        if (remap[i] != ~0u)
+        {
+            remapped[remap[i]] = vertices[i];
+        }
+    }
+    for (uint32& index : indices)
+    {
+        index = remap[index];
+    }
+    vertices.swap(remapped);
+}
+
+// Merges bitwise identical vertices. An empty index list stands for a non indexed triangle list and is created.
+template <typename Vertex>
+void weldVertices(std::vector<Vertex>& vertices, std::vector<uint32>& indices)
+{
+    if (indices.empty())
+    {
+        indices.resize(vertices.size());
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            indices[i] = uint32(i);
+        }
+    }
+
+    std::vector<uint32> remap;
+    generateVertexRemap(vertices.data(), vertices.size(), sizeof(Vertex), remap);
+    for (uint32& index : indices)
+    {
+        index = remap[index];
+    }
+    // the survivors are renumbered densely, in order of first use
+    size_t usedCount = generateFetchRemap(indices, vertices.size(), remap);
+    remapVertices(vertices, indices, remap, usedCount);
+}
+
+// Orders vertices by first use so the vertex fetch walks memory mostly forward, dropping unused ones
+template <typename Vertex>
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32>& indices)
+{
+    std::vector<uint32> remap;
+    size_t usedCount = generateFetchRemap(indices, vertices.size(), remap);
+    remapVertices(vertices, indices, remap, usedCount);
+}
+
+// Welding, triangle order for the post-transform cache, then vertex order for fetch, in the order they depend on
+template <typename Vertex>
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32>& indices)
+{
+    weldVertices(vertices, indices);
+    optimizeVertexCache(indices, vertices.size());
+    optimizeVertexFetch(vertices, indices);
+}
+
+// Meshlets refer to the old order and are cleared, build them again afterwards
+void optimizeMesh(Mesh& mesh);
@@ -0,0 +1,442 @@
+#include "Meshlets.h"
+#include "GraphicsObjects.h"
+#include "MeshImporter.h"
+#include "MeshOptimizer.h"
+#include "math.hpp"
+#include "shaders.hpp"
+#include "utils.hpp"
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+
+const uint32 MeshletCullGroupSize = 128;
+const uint32 MaxGroupCountX = 65535;
+const uint32 MeshletBenchmarkFrames = 16;
+const vk::Extent2D MeshletRenderExtent = { 1280, 720 };
+
+static_assert(MeshletMaxTriangles <= MeshletCullGroupSize, "computeShaderText_MeshletCull writes a triangle per invocation");
+
+// Matches the push constant block of computeShaderText_MeshletCull
+struct MeshletCullPushConstants
+{
+    glm::vec4   planes[6];
+    glm::vec4   cameraPosition;
+    uint32      meshletCount;
+    uint32      groupCountX;
+};
+
+static glm::vec3 getPosition(const VertexPNT& vertex)
+{
+    return glm::vec3(vertex.x, vertex.y, vertex.z);
+}
+
+void buildMeshlets(Mesh& mesh)
+{
+    mesh.meshlets.clear();
+    mesh.meshletVertices.clear();
+    mesh.meshletTriangles.clear();
+
+    const std::vector<uint32>& indices = mesh.indices;
+    const size_t triangleCount = indices.size() / 3;
+    const size_t vertexCount = mesh.vertices.size();
+
+    // triangles around each vertex
+    std::vector<uint32> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        assert(indices[i] < vertexCount);
+        adjacencyOffsets[indices[i] + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+    std::vector<uint32> adjacency(triangleCount * 3);
+    std::vector<uint32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        adjacency[fill[indices[i]]++] = uint32(i / 3);
+    }
+
+    // position of each mesh vertex in the current meshlet, ~0u if it is not part of it
+    std::vector<uint32> localIndices(vertexCount, ~0u);
+    std::vector<bool> used(triangleCount, false);
+    size_t cursor = 0;
+
+    Meshlet meshlet = {};
+    auto getNewVertexCount = [&](uint32 triangle)
+    {
+        uint32 count = 0;
+        for (uint32 k = 0; k < 3; k++)
+        {
+            count += localIndices[indices[triangle * 3 + k]] == ~0u ? 1 : 0;
+        }
+        return count;
+    };
+    auto finishMeshlet = [&]()
+    {
+        if (meshlet.triangleCount == 0)
+        {
+            return;
+        }
+        for (uint32 i = 0; i < meshlet.vertexCount; i++)
+        {
+            localIndices[mesh.meshletVertices[meshlet.vertexOffset + i]] = ~0u;
+        }
+        computeMeshletBounds(mesh, meshlet);
+        mesh.meshlets.push_back(meshlet);
+
+        meshlet = {};
+        meshlet.vertexOffset = uint32(mesh.meshletVertices.size());
+        meshlet.triangleOffset = uint32(mesh.meshletTriangles.size() / 3);
+    };
+
+    for (;;)
+    {
+        // the unused triangle around the meshlet's vertices that adds the fewest new ones
+        uint32 best = ~0u;
+        uint32 bestNewVertexCount = 4;
+        for (uint32 i = 0; i < meshlet.vertexCount && bestNewVertexCount > 0; i++)
+        {
+            uint32 v = mesh.meshletVertices[meshlet.vertexOffset + i];
+            for (uint32 a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+            {
+                uint32 triangle = adjacency[a];
+                uint32 newVertexCount = used[triangle] ? 4 : getNewVertexCount(triangle);
+                if (newVertexCount < bestNewVertexCount)
+                {
+                    best = triangle;
+                    bestNewVertexCount = newVertexCount;
+                }
+            }
+        }
+
+        // nothing connected is left, continue with the next triangle in index order
+        if (best == ~0u)
+        {
+            while (cursor < triangleCount && used[cursor])
+            {
+                cursor++;
+            }
+            if (cursor == triangleCount)
+            {
+                break;
+            }
+            best = uint32(cursor);
+            bestNewVertexCount = getNewVertexCount(best);
+        }
+
+        // a triangle that does not fit seeds the next meshlet, which keeps it next to this one
+        if (meshlet.vertexCount + bestNewVertexCount > MeshletMaxVertices || meshlet.triangleCount == MeshletMaxTriangles)
+        {
+            finishMeshlet();
+        }
+
+        for (uint32 k = 0; k < 3; k++)
+        {
+            uint32 v = indices[best * 3 + k];
+            if (localIndices[v] == ~0u)
+            {
+                localIndices[v] = meshlet.vertexCount++;
+                mesh.meshletVertices.push_back(v);
+            }
+            mesh.meshletTriangles.push_back(uint8_t(localIndices[v]));
+        }
+        meshlet.triangleCount++;
+        used[best] = true;
+    }
+    finishMeshlet();
+}
+
+void computeMeshletBounds(const Mesh& mesh, Meshlet& meshlet)
+{
+    assert(meshlet.vertexCount <= MeshletMaxVertices && meshlet.triangleCount <= MeshletMaxTriangles);
+
+    Aabb box;
+    for (uint32 i = 0; i < meshlet.vertexCount; i++)
+    {
+        box.grow(getPosition(mesh.vertices[mesh.meshletVertices[meshlet.vertexOffset + i]]));
+    }
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    float radius = 0.0f;
+    for (uint32 i = 0; i < meshlet.vertexCount; i++)
+    {
+        radius = std::max(radius, glm::length(getPosition(mesh.vertices[mesh.meshletVertices[meshlet.vertexOffset + i]]) - center));
+    }
+
+    // degenerate triangles face nowhere and are left out of the cone
+    glm::vec3 normals[MeshletMaxTriangles];
+    uint32 normalCount = 0;
+    glm::vec3 axis(0.0f);
+    for (uint32 t = 0; t < meshlet.triangleCount; t++)
+    {
+        const uint8_t* corners = &mesh.meshletTriangles[(meshlet.triangleOffset + t) * 3];
+        glm::vec3 p0 = getPosition(mesh.vertices[mesh.meshletVertices[meshlet.vertexOffset + corners[0]]]);
+        glm::vec3 p1 = getPosition(mesh.vertices[mesh.meshletVertices[meshlet.vertexOffset + corners[1]]]);
+        glm::vec3 p2 = getPosition(mesh.vertices[mesh.meshletVertices[meshlet.vertexOffset + corners[2]]]);
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(n);
+        if (length > 0.0f)
+        {
+            normals[normalCount++] = n / length;
+            axis += n / length;
+        }
+    }
+
+    // the cone holds all normals; if it is wider than a half space some triangle always faces the viewer, which a
+    // cutoff of 1 expresses as the test never passes
+    float axisLength = glm::length(axis);
+    float minDot = 1.0f;
+    axis = axisLength > 1e-6f ? axis / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+    for (uint32 i = 0; i < normalCount; i++)
+    {
+        minDot = std::min(minDot, glm::dot(axis, normals[i]));
+    }
+    bool cullable = axisLength > 1e-6f && minDot > 0.0f;
+
+    memcpy(meshlet.center, &center, sizeof(meshlet.center));
+    meshlet.radius = radius;
+    memcpy(meshlet.coneAxis, &axis, sizeof(meshlet.coneAxis));
+    meshlet.coneCutoff = cullable ? std::sqrt(1.0f - minDot * minDot) : 1.0f;
+}
+
+bool isMeshletVisible(const Meshlet& meshlet, const Frustum& frustum, const glm::vec3& cameraPosition)
+{
+    glm::vec3 center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+    if (!frustum.intersectsSphere(center, meshlet.radius))
+    {
+        return false;
+    }
+
+    glm::vec3 axis(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+    glm::vec3 d = center - cameraPosition;
+    return glm::dot(d, axis) < meshlet.coneCutoff * glm::length(d) + meshlet.radius;
+}
+
+uint32 cullMeshlets(const Mesh& mesh, const Frustum& frustum, const glm::vec3& cameraPosition, std::vector<uint32>& indices)
+{
+    indices.clear();
+    uint32 visibleCount = 0;
+    for (const Meshlet& meshlet : mesh.meshlets)
+    {
+        if (!isMeshletVisible(meshlet, frustum, cameraPosition))
+        {
+            continue;
+        }
+        for (uint32 i = 0; i < meshlet.triangleCount * 3; i++)
+        {
+            indices.push_back(mesh.meshletVertices[meshlet.vertexOffset + mesh.meshletTriangles[meshlet.triangleOffset * 3 + i]]);
+        }
+        visibleCount++;
+    }
+    return visibleCount;
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+GpuMeshletCuller::GpuMeshletCuller(const Device& device, const vk::UniqueCommandPool& commandPool, const Mesh& mesh)
+    : m_device(device)
+    , m_meshletCount(uint32(mesh.meshlets.size()))
+    , m_timer(device)
+{
+    assert(!mesh.meshlets.empty());
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+
+    auto createBuffer = [&](const void* data, size_t size)
+    {
+        std::unique_ptr<Buffer> buffer = std::make_unique<Buffer>(device, size, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                                                                  vk::MemoryPropertyFlagBits::eDeviceLocal);
+        buffer->upload(commandPool, device.getGraphicsQueue(), data, size);
+        return buffer;
+    };
+    m_meshlets = createBuffer(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+    m_meshletVertices = createBuffer(mesh.meshletVertices.data(), mesh.meshletVertices.size() * sizeof(uint32));
+    // the shader reads the bytes as packed uints
+    std::vector<uint8_t> triangles(mesh.meshletTriangles);
+    triangles.resize((triangles.size() + 3) / 4 * 4, 0);
+    m_meshletTriangles = createBuffer(triangles.data(), triangles.size());
+
+    m_indices = std::make_unique<Buffer>(device, mesh.meshletTriangles.size() * sizeof(uint32), vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+                                         vk::MemoryPropertyFlagBits::eDeviceLocal);
+    m_drawCommand = std::make_unique<Buffer>(device, sizeof(vk::DrawIndexedIndirectCommand), vk::BufferUsageFlagBits::eIndirectBuffer |
+                                             vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    // 0: meshlets, 1: meshlet vertices, 2: meshlet triangles, 3: indices, 4: draw command
+    m_descriptorSetLayout = vk::su::createDescriptorSetLayout(vkDevice, std::vector<std::tuple<vk::DescriptorType, uint32_t, vk::ShaderStageFlags>>(
+                                                                            5, { vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute }));
+    vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(MeshletCullPushConstants));
+    m_pipelineLayout = vkDevice->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), 1, &m_descriptorSetLayout.get(), 1, &pushConstantRange));
+
+    m_descriptorPool = vk::su::createDescriptorPool(vkDevice, { { vk::DescriptorType::eStorageBuffer, 5 } });
+    m_descriptorSet = std::move(vkDevice->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(m_descriptorPool.get(), 1, &m_descriptorSetLayout.get())).front());
+
+    vk::DescriptorBufferInfo bufferInfos[5] =
+    {
+        vk::DescriptorBufferInfo(m_meshlets->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_meshletVertices->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_meshletTriangles->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_indices->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_drawCommand->getVKBuffer().get(), 0, VK_WHOLE_SIZE)
+    };
+    vkDevice->updateDescriptorSets(vk::WriteDescriptorSet(m_descriptorSet.get(), 0, 0, 5, vk::DescriptorType::eStorageBuffer, nullptr, bufferInfos), nullptr);
+
+    vk::UniquePipelineCache pipelineCache = vkDevice->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+    vk::UniqueShaderModule shaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eCompute, computeShaderText_MeshletCull);
+    m_pipeline = vk::su::createComputePipeline(vkDevice, pipelineCache, std::make_pair(shaderModule.get(), nullptr), m_pipelineLayout);
+}
+
+GpuMeshletCuller::~GpuMeshletCuller()
+{
+
+}
+
+void GpuMeshletCuller::record(const vk::UniqueCommandBuffer& commandBuffer, const glm::mat4x4& mvp, const glm::vec3& cameraPosition)
+{
+    Frustum frustum = Frustum::fromMatrix(mvp);
+
+    MeshletCullPushConstants pushConstants;
+    for (int i = 0; i < 6; i++)
+    {
+        pushConstants.planes[i] = frustum.planes[i];
+    }
+    pushConstants.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+    pushConstants.meshletCount = m_meshletCount;
+    pushConstants.groupCountX = std::min(m_meshletCount, MaxGroupCountX);
+
+    m_timer.reset(commandBuffer);
+    m_timer.begin(commandBuffer);
+
+    // the draw of the previous frame may still read the indices and the command that get rewritten here
+    commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+                                   vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, nullptr);
+
+    vk::DrawIndexedIndirectCommand drawCommand(0, 1, 0, 0, 0);
+    commandBuffer->updateBuffer(m_drawCommand->getVKBuffer().get(), 0, sizeof(drawCommand), &drawCommand);
+    vk::su::transferToComputeBarrier(commandBuffer);
+
+    commandBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline.get());
+    commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout.get(), 0, m_descriptorSet.get(), nullptr);
+    commandBuffer->pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+    commandBuffer->dispatch(pushConstants.groupCountX, (m_meshletCount + pushConstants.groupCountX - 1) / pushConstants.groupCountX, 1);
+    vk::su::computeToDrawBarrier(commandBuffer);
+
+    m_timer.end(commandBuffer);
+}
+
+void GpuMeshletCuller::recordDraw(const vk::UniqueCommandBuffer& commandBuffer) const
+{
+    commandBuffer->bindIndexBuffer(m_indices->getVKBuffer().get(), 0, vk::IndexType::eUint32);
+    commandBuffer->drawIndexedIndirect(m_drawCommand->getVKBuffer().get(), 0, 1, sizeof(vk::DrawIndexedIndirectCommand));
+}
+
+void printMeshletCullBenchmark(std::ostream& os, const Device& device, const string& path)
+{
+    Mesh mesh;
+    if (!importMesh(path, mesh))
+    {
+        os << "cannot import " << path << "\n";
+        return;
+    }
+    optimizeMesh(mesh);
+    buildMeshlets(mesh);
+    if (mesh.meshlets.empty())
+    {
+        os << path << " has no triangles\n";
+        return;
+    }
+
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+    vk::UniqueCommandPool commandPool = vkDevice->createCommandPoolUnique(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, device.getGraphicsQueueFamilyIndex()));
+    vk::UniqueCommandBuffer commandBuffer = std::move(vkDevice->allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo(commandPool.get(), vk::CommandBufferLevel::ePrimary, 1)).front());
+
+    GpuMeshletCuller culler(device, commandPool, mesh);
+    Buffer vertexBuffer(device, mesh.vertices.size() * sizeof(VertexPNT), vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                        vk::MemoryPropertyFlagBits::eDeviceLocal);
+    vertexBuffer.upload(commandPool, device.getGraphicsQueue(), mesh.vertices.data(), mesh.vertices.size() * sizeof(VertexPNT));
+    Buffer indexBuffer(device, mesh.indices.size() * sizeof(uint32), vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                       vk::MemoryPropertyFlagBits::eDeviceLocal);
+    indexBuffer.upload(commandPool, device.getGraphicsQueue(), mesh.indices.data(), mesh.indices.size() * sizeof(uint32));
+
+    // the normals go in as colors of vertexShaderText_PC_C, the missing w of both reads as 1
+    OffscreenTarget target(device, MeshletRenderExtent);
+    Buffer uniformBuffer(device, sizeof(glm::mat4x4), vk::BufferUsageFlagBits::eUniformBuffer);
+    vk::UniqueDescriptorSetLayout descriptorSetLayout = vk::su::createDescriptorSetLayout(vkDevice, { { vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex } });
+    vk::UniquePipelineLayout pipelineLayout = vkDevice->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo({}, 1, &descriptorSetLayout.get()));
+    vk::UniqueDescriptorPool descriptorPool = vk::su::createDescriptorPool(vkDevice, { { vk::DescriptorType::eUniformBuffer, 1 } });
+    vk::UniqueDescriptorSet descriptorSet = std::move(vkDevice->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(descriptorPool.get(), 1, &descriptorSetLayout.get())).front());
+    vk::DescriptorBufferInfo bufferInfo(uniformBuffer.getVKBuffer().get(), 0, VK_WHOLE_SIZE);
+    vkDevice->updateDescriptorSets(vk::WriteDescriptorSet(descriptorSet.get(), 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &bufferInfo), nullptr);
+
+    vk::UniqueShaderModule vertexShaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eVertex, vertexShaderText_PC_C);
+    vk::UniqueShaderModule fragmentShaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eFragment, fragmentShaderText_C_C);
+    vk::UniquePipelineCache pipelineCache = vkDevice->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+    vk::UniquePipeline pipeline = vk::su::createGraphicsPipeline(vkDevice, pipelineCache, std::make_pair(*vertexShaderModule, nullptr), std::make_pair(*fragmentShaderModule, nullptr),
+                                                                 sizeof(VertexPNT), { { vk::Format::eR32G32B32Sfloat, 0 }, { vk::Format::eR32G32B32Sfloat, 12 } },
+                                                                 vk::FrontFace::eClockwise, true, pipelineLayout, target.getRenderPass());
+
+    // scope 0 draws all triangles, scope 1 the visible meshlets
+    GpuTimer drawTimer(device, 2);
+
+    // close enough that the frustum cuts off part of the mesh, while the normal cones remove its back
+    glm::vec3 center = mesh.bounds.getCenter();
+    float size = std::max(glm::length(mesh.bounds.getExtent()), 1e-3f);
+    glm::mat4x4 projection = vk::su::createProjectionClipMatrix(glm::radians(60.0f), float(MeshletRenderExtent.width) / MeshletRenderExtent.height, 0.01f * size, 2.0f * size);
+
+    uint64 visibleMeshlets = 0;
+    uint64 visibleTriangles = 0;
+    double cullMilliseconds = 0.0;
+    double drawMilliseconds[2] = { 0.0, 0.0 };
+    std::vector<uint32> visibleIndices;
+    for (uint32 frame = 0; frame < MeshletBenchmarkFrames; frame++)
+    {
+        float angle = 6.2831853f * frame / MeshletBenchmarkFrames;
+        glm::vec3 eye = center + 0.75f * size * glm::vec3(std::cos(angle), 0.25f, std::sin(angle));
+        glm::mat4x4 mvp = projection * glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        // the mesh is its own object space, so the CPU reference gives the counts the GPU draws
+        visibleMeshlets += cullMeshlets(mesh, Frustum::fromMatrix(mvp), eye, visibleIndices);
+        visibleTriangles += visibleIndices.size() / 3;
+
+        uniformBuffer.upload(mvp);
+        commandBuffer->begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        culler.record(commandBuffer, mvp, eye);
+        drawTimer.reset(commandBuffer);
+        for (uint32 culled = 0; culled < 2; culled++)
+        {
+            drawTimer.begin(commandBuffer, culled);
+            target.beginRenderPass(commandBuffer);
+            commandBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+            commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout.get(), 0, descriptorSet.get(), nullptr);
+            commandBuffer->bindVertexBuffers(0, vertexBuffer.getVKBuffer().get(), { 0 });
+            if (culled)
+            {
+                culler.recordDraw(commandBuffer);
+            }
+            else
+            {
+                commandBuffer->bindIndexBuffer(indexBuffer.getVKBuffer().get(), 0, vk::IndexType::eUint32);
+                commandBuffer->drawIndexed(uint32(mesh.indices.size()), 1, 0, 0, 0);
+            }
+            commandBuffer->endRenderPass();
+            drawTimer.end(commandBuffer, culled);
+        }
+        commandBuffer->end();
+        device.getGraphicsQueue().submit(vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer.get()), nullptr);
+        device.getGraphicsQueue().waitIdle();
+
+        double milliseconds = 0.0;
+        culler.getLastCullMilliseconds(milliseconds);
+        cullMilliseconds += milliseconds;
+        for (uint32 culled = 0; culled < 2; culled++)
+        {
+            drawTimer.getMilliseconds(culled, milliseconds);
+            drawMilliseconds[culled] += milliseconds;
+        }
+    }
+
+    os << std::fixed << std::setprecision(3) << path << ": " << mesh.meshlets.size() << " meshlets, " << mesh.indices.size() / 3 << " triangles\n"
+       << "visible: " << double(visibleMeshlets) / MeshletBenchmarkFrames << " meshlets, " << double(visibleTriangles) / MeshletBenchmarkFrames << " triangles\n"
+       << "GPU: cull " << cullMilliseconds / MeshletBenchmarkFrames << " ms, draw visible meshlets " << drawMilliseconds[1] / MeshletBenchmarkFrames
+       << " ms, draw all " << drawMilliseconds[0] / MeshletBenchmarkFrames << " ms\n" << std::defaultfloat;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Mesh.h"
+#include "Profiling.h"
+#include <vulkan/vulkan.hpp>
+#include <iosfwd>
+#include <memory>
+
+class Device;
+class Buffer;
+
+// Limits of a meshlet. 64 vertices and 124 triangles fit the output limits of mesh shaders on all vendors, and
+// computeShaderText_MeshletCull handles a meshlet per workgroup of 128 invocations.
+const uint32 MeshletMaxVertices = 64;
+const uint32 MeshletMaxTriangles = 124;
+
+// Splits the indexed triangles of mesh into meshlets, replacing the ones it had. Triangles are taken in index order
+// as seeds and grown over shared vertices, preferring those that add the fewest new vertices, so optimizeMesh
+// before gives meshlets that are compact and still cache friendly.
+void buildMeshlets(Mesh& mesh);
+
+// Bounding sphere and normal cone of a meshlet that has its vertices and triangles filled in
+void computeMeshletBounds(const Mesh& mesh, Meshlet& meshlet);
+
+// The culling computeShaderText_MeshletCull does, in object space: false if the bounding sphere lies outside the
+// frustum or the normal cone shows every triangle facing away from cameraPosition
+bool isMeshletVisible(const Meshlet& meshlet, const Frustum& frustum, const glm::vec3& cameraPosition);
+
+// CPU reference of GpuMeshletCuller, fills indices with the triangles of the visible meshlets and returns their count
+uint32 cullMeshlets(const Mesh& mesh, const Frustum& frustum, const glm::vec3& cameraPosition, std::vector<uint32>& indices);
+
+// Culls the meshlets of a mesh on the GPU every frame. The triangles of the visible meshlets are compacted into an
+// index buffer with 32 bit indices into the mesh vertices, and the index count goes into a VkDrawIndexedIndirectCommand,
+// so drawing never waits for the CPU.
+class GpuMeshletCuller
+{
+public:
+    // mesh must have meshlets, see buildMeshlets
+    GpuMeshletCuller(const Device& device, const vk::UniqueCommandPool& commandPool, const Mesh& mesh);
+    ~GpuMeshletCuller();
+
+    // Records the culling pass outside of a render pass. mvp maps object space to clip space, cameraPosition is in object space.
+    void record(const vk::UniqueCommandBuffer& commandBuffer, const glm::mat4x4& mvp, const glm::vec3& cameraPosition);
+
+    // Binds the compacted indices and draws them, with the vertex buffer and pipeline bound by the caller
+    void recordDraw(const vk::UniqueCommandBuffer& commandBuffer) const;
+
+    const Buffer& getIndexBuffer() const { return *m_indices; }
+    const Buffer& getDrawCommandBuffer() const { return *m_drawCommand; }
+
+    // GPU time of the last recorded culling pass, false until its command buffer completed
+    bool getLastCullMilliseconds(double& milliseconds) const { return m_timer.getMilliseconds(0, milliseconds); }
+
+private:
+    const Device&                   m_device;
+    uint32                          m_meshletCount;
+
+    std::unique_ptr<Buffer>         m_meshlets;
+    std::unique_ptr<Buffer>         m_meshletVertices;
+    std::unique_ptr<Buffer>         m_meshletTriangles;
+    std::unique_ptr<Buffer>         m_indices;
+    std::unique_ptr<Buffer>         m_drawCommand;
+
+    vk::UniqueDescriptorSetLayout   m_descriptorSetLayout;
+    vk::UniquePipelineLayout        m_pipelineLayout;
+    vk::UniqueDescriptorPool        m_descriptorPool;
+    vk::UniqueDescriptorSet         m_descriptorSet;
+    vk::UniquePipeline              m_pipeline;
+
+    GpuTimer                        m_timer;
+};
+
+// Imports the mesh at path, builds its meshlets and renders it offscreen from an orbiting camera, once with all
+// triangles and once with what GpuMeshletCuller leaves visible. Prints the meshlets and triangles that pass the
+// culling and the GPU time of the culling pass and of both draws, averaged over the frames.
+void printMeshletCullBenchmark(std::ostream& os, const Device& device, const string& path);
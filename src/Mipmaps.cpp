@@ -0,0 +1,337 @@
+#include "Mipmaps.h"
+#include "GraphicsObjects.h"
+#include "PixelConversion.h"
+#include "Profiling.h"
+#include "TextureCompression.h"
+#include "ThreadPool.h"
+#include "utils.hpp"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <immintrin.h>
+
+// taps of the Kaiser filter, 3 output pixels to each side at half the resolution
+const int KaiserTaps = 12;
+const float KaiserAlpha = 4.0f;
+// output rows per parallel task
+const uint32 MipBandRows = 16;
+
+uint32 getMipLevelCount(const vk::Extent2D& extent)
+{
+    uint32 levelCount = 1;
+    for (uint32 size = std::max(extent.width, extent.height); size > 1; size >>= 1)
+    {
+        levelCount++;
+    }
+    return levelCount;
+}
+
+vk::Extent2D getMipExtent(const vk::Extent2D& extent, uint32 level)
+{
+    return vk::Extent2D(std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u));
+}
+
+size_t getMipChainSize(const vk::Extent2D& extent, uint32 levelCount, vk::Format format)
+{
+    size_t size = 0;
+    for (uint32 level = 0; level < levelCount; level++)
+    {
+        size += getImageSize(format, getMipExtent(extent, level));
+    }
+    return size;
+}
+
+static void forEachBand(uint32 rowCount, const std::function<void(uint32, uint32)>& func)
+{
+    uint32 bandCount = (rowCount + MipBandRows - 1) / MipBandRows;
+    ThreadPool::getInstance().parallelFor(bandCount, [&](uint32 band)
+    {
+        uint32 firstRow = band * MipBandRows;
+        func(firstRow, std::min(MipBandRows, rowCount - firstRow));
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+// The pixel pairs of an odd sized level that have no partner take their last row or column twice
+static void downsampleBox(const uint8_t* source, const vk::Extent2D& sourceExtent, uint8_t* destination, const vk::Extent2D& extent)
+{
+    forEachBand(extent.height, [&](uint32 firstRow, uint32 rowCount)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rounding = _mm_set1_epi16(2);
+        for (uint32 y = firstRow; y < firstRow + rowCount; y++)
+        {
+            const uint8_t* row0 = source + size_t(std::min(2 * y, sourceExtent.height - 1)) * sourceExtent.width * 4;
+            const uint8_t* row1 = source + size_t(std::min(2 * y + 1, sourceExtent.height - 1)) * sourceExtent.width * 4;
+            uint8_t* output = destination + size_t(y) * extent.width * 4;
+
+            // two output pixels from 4 x 2 source pixels, summed in 16 bits
+            uint32 x = 0;
+            for (; x + 2 <= extent.width && 2 * x + 4 <= sourceExtent.width; x += 2)
+            {
+                __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+                __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+                __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+                __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+                left = _mm_add_epi16(left, _mm_srli_si128(left, 8));
+                right = _mm_add_epi16(right, _mm_srli_si128(right, 8));
+                __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(left, right), rounding), 2);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(output + x * 4), _mm_packus_epi16(sum, zero));
+            }
+            for (; x < extent.width; x++)
+            {
+                uint32 x0 = std::min(2 * x, sourceExtent.width - 1) * 4;
+                uint32 x1 = std::min(2 * x + 1, sourceExtent.width - 1) * 4;
+                for (uint32 c = 0; c < 4; c++)
+                {
+                    output[x * 4 + c] = uint8_t((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+                }
+            }
+        }
+    });
+}
+
+static float besselI0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 16; k++)
+    {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Halving puts every output pixel at the same offsets from its source pixels, so one kernel serves all of them.
+// Tap k reads source pixel 2x + k - 5, whose center lies k - 5.5 source pixels from the output center.
+static void getKaiserWeights(float weights[KaiserTaps])
+{
+    const float Pi = 3.14159265f;
+    float sum = 0.0f;
+    for (int k = 0; k < KaiserTaps; k++)
+    {
+        float d = k - 5.5f;
+        float t = d / (KaiserTaps / 2);
+        float sinc = std::sin(Pi * d / 2.0f) / (Pi * d / 2.0f);
+        weights[k] = sinc * besselI0(KaiserAlpha * std::sqrt(std::max(1.0f - t * t, 0.0f))) / besselI0(KaiserAlpha);
+        sum += weights[k];
+    }
+    for (int k = 0; k < KaiserTaps; k++)
+    {
+        weights[k] /= sum;
+    }
+}
+
+static __m128 loadPixel(const uint8_t* pixel)
+{
+    int32 rgba;
+    memcpy(&rgba, pixel, 4);
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(rgba), zero), zero));
+}
+
+// Horizontal pass into floats at the output width, then the vertical pass, one RGBA pixel per register
+static void downsampleKaiser(const uint8_t* source, const vk::Extent2D& sourceExtent, uint8_t* destination, const vk::Extent2D& extent)
+{
+    float weights[KaiserTaps];
+    getKaiserWeights(weights);
+
+    std::vector<__m128> rows(size_t(extent.width) * sourceExtent.height);
+    forEachBand(sourceExtent.height, [&](uint32 firstRow, uint32 rowCount)
+    {
+        // the source row converted once, with the edge pixels repeated so the taps need no clamping
+        const int32 Padding = KaiserTaps / 2;
+        std::vector<__m128> padded(sourceExtent.width + 2 * Padding);
+        for (uint32 y = firstRow; y < firstRow + rowCount; y++)
+        {
+            const uint8_t* row = source + size_t(y) * sourceExtent.width * 4;
+            for (int32 x = 0; x < int32(padded.size()); x++)
+            {
+                padded[x] = loadPixel(row + clamp<int32>(x - Padding, 0, int32(sourceExtent.width) - 1) * 4);
+            }
+            for (uint32 x = 0; x < extent.width; x++)
+            {
+                const __m128* taps = &padded[2 * x + Padding - 5];
+                __m128 sum = _mm_setzero_ps();
+                for (int k = 0; k < KaiserTaps; k++)
+                {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), taps[k]));
+                }
+                rows[size_t(y) * extent.width + x] = sum;
+            }
+        }
+    });
+
+    forEachBand(extent.height, [&](uint32 firstRow, uint32 rowCount)
+    {
+        for (uint32 y = firstRow; y < firstRow + rowCount; y++)
+        {
+            const __m128* taps[KaiserTaps];
+            for (int k = 0; k < KaiserTaps; k++)
+            {
+                taps[k] = &rows[size_t(clamp<int32>(int32(2 * y) + k - 5, 0, int32(sourceExtent.height) - 1)) * extent.width];
+            }
+
+            uint8_t* output = destination + size_t(y) * extent.width * 4;
+            for (uint32 x = 0; x < extent.width; x++)
+            {
+                __m128 sum = _mm_setzero_ps();
+                for (int k = 0; k < KaiserTaps; k++)
+                {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), taps[k][x]));
+                }
+                // the negative lobes can leave the range, the packs saturate
+                __m128i rgba = _mm_cvtps_epi32(sum);
+                rgba = _mm_packus_epi16(_mm_packs_epi32(rgba, rgba), rgba);
+                int32 packed = _mm_cvtsi128_si32(rgba);
+                memcpy(output + x * 4, &packed, 4);
+            }
+        }
+    });
+}
+
+void generateMipChain(const uint8_t* top, const vk::Extent2D& extent, MipFilter filter, uint8_t* chain)
+{
+    copyPixels(top, extent.width * 4, chain, extent.width * 4, extent);
+
+    uint8_t* level = chain;
+    for (uint32 i = 1; i < getMipLevelCount(extent); i++)
+    {
+        vk::Extent2D sourceExtent = getMipExtent(extent, i - 1);
+        vk::Extent2D levelExtent = getMipExtent(extent, i);
+        uint8_t* nextLevel = level + size_t(sourceExtent.width) * sourceExtent.height * 4;
+        if (filter == MipFilter::Kaiser)
+        {
+            downsampleKaiser(level, sourceExtent, nextLevel, levelExtent);
+        }
+        else
+        {
+            downsampleBox(level, sourceExtent, nextLevel, levelExtent);
+        }
+        level = nextLevel;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+bool canBlitMips(const vk::PhysicalDevice& physicalDevice, vk::Format format)
+{
+    vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+    return (physicalDevice.getFormatProperties(format).optimalTilingFeatures & required) == required;
+}
+
+void recordMipBlits(const vk::UniqueCommandBuffer& commandBuffer, vk::Image image, vk::Format format, const vk::Extent2D& extent, uint32 levelCount)
+{
+    for (uint32 level = 1; level < levelCount; level++)
+    {
+        // the previous level is complete once its own blit or copy has finished writing
+        vk::su::setImageLayout(commandBuffer, image, format, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal, level - 1, 1);
+
+        vk::Extent2D sourceExtent = getMipExtent(extent, level - 1);
+        vk::Extent2D levelExtent = getMipExtent(extent, level);
+        vk::ImageBlit blit(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - 1, 0, 1),
+                           { vk::Offset3D(0, 0, 0), vk::Offset3D(int32(sourceExtent.width), int32(sourceExtent.height), 1) },
+                           vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1),
+                           { vk::Offset3D(0, 0, 0), vk::Offset3D(int32(levelExtent.width), int32(levelExtent.height), 1) });
+        commandBuffer->blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+
+        vk::su::setImageLayout(commandBuffer, image, format, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, level - 1, 1);
+    }
+    vk::su::setImageLayout(commandBuffer, image, format, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, levelCount - 1, 1);
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+// Point samples of an image minified 8 times, one per output pixel, read from level 0 or from level 3
+static uint32 sampleMinified(const uint8_t* level, uint32 levelWidth, uint32 step, uint32 outputSize)
+{
+    uint32 checksum = 0;
+    for (uint32 y = 0; y < outputSize; y++)
+    {
+        const uint8_t* row = level + size_t(y) * step * levelWidth * 4;
+        for (uint32 x = 0; x < outputSize; x++)
+        {
+            checksum += row[x * step * 4];
+        }
+    }
+    return checksum;
+}
+
+void printMipmapBenchmark(std::ostream& os, uint32 size, const Device* device)
+{
+    vk::Extent2D extent(size, size);
+    std::vector<uint8_t> top(size_t(size) * size * 4);
+    fillCheckerboard(top.data(), size * 4, extent, packRgba(32, 64, 128), packRgba(224, 192, 160), 3);
+    std::vector<uint8_t> chain(getMipChainSize(extent, getMipLevelCount(extent)));
+
+    const int RunCount = 3;
+    double megapixels = double(size) * size / 1e6;
+    os << std::fixed << std::setprecision(3) << size << " x " << size << ", " << getMipLevelCount(extent) << " levels, chain "
+       << chain.size() / (1024.0 * 1024.0) << " MB against " << top.size() / (1024.0 * 1024.0) << " MB\n";
+
+    const char* filterNames[] = { "box", "Kaiser" };
+    for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser })
+    {
+        double best = DBL_MAX;
+        for (int run = 0; run < RunCount; run++)
+        {
+            Timer timer;
+            generateMipChain(top.data(), extent, filter, chain.data());
+            best = std::min(best, timer.getElapsedMilliseconds());
+        }
+        os << filterNames[int(filter)] << " chain: " << best << " ms, " << megapixels / (best / 1000.0) << " MP/s\n";
+    }
+
+    // what the texture cache sees when a minified texture has no mips: every sample is on a different cache line
+    const uint32 MinifiedLevel = 3;
+    uint32 outputSize = getMipExtent(extent, MinifiedLevel).width;
+    const uint8_t* level3 = chain.data() + getMipChainSize(extent, MinifiedLevel);
+    double milliseconds[2];
+    uint32 checksums[2];
+    for (int mipmapped = 0; mipmapped < 2; mipmapped++)
+    {
+        milliseconds[mipmapped] = DBL_MAX;
+        for (int run = 0; run < RunCount; run++)
+        {
+            Timer timer;
+            checksums[mipmapped] = mipmapped ? sampleMinified(level3, outputSize, 1, outputSize) : sampleMinified(top.data(), size, 1 << MinifiedLevel, outputSize);
+            milliseconds[mipmapped] = std::min(milliseconds[mipmapped], timer.getElapsedMilliseconds());
+        }
+    }
+    // level 0 rows are read whole, the 32 byte steps are below the cache line size
+    double level0Megabytes = double(outputSize) * size * 4 / (1024.0 * 1024.0);
+    double level3Megabytes = double(outputSize) * outputSize * 4 / (1024.0 * 1024.0);
+    os << "sampling 1/8: level 0 " << milliseconds[0] << " ms, " << level0Megabytes << " MB touched; level 3 " << milliseconds[1] << " ms, "
+       << level3Megabytes << " MB touched (checksums " << checksums[0] << ", " << checksums[1] << ")\n";
+
+    if (device && canBlitMips(device->getPhysicalDevice(), vk::Format::eR8G8B8A8Unorm))
+    {
+        const vk::UniqueDevice& vkDevice = device->getVKDevice();
+        vk::UniqueCommandPool commandPool = vkDevice->createCommandPoolUnique(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlags(), device->getGraphicsQueueFamilyIndex()));
+        Image image(*device, vk::Format::eR8G8B8A8Unorm, extent, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst,
+                    vk::ImageLayout::eUndefined, vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor, getMipLevelCount(extent));
+        GpuTimer timer(*device);
+
+        // level 0 keeps whatever the memory held, the blits take the same time
+        vk::su::oneTimeSubmit(vkDevice, commandPool, device->getGraphicsQueue(), [&](const vk::UniqueCommandBuffer& commandBuffer)
+        {
+            timer.reset(commandBuffer);
+            vk::su::setImageLayout(commandBuffer, image.getVKImage().get(), image.getFormat(), vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+                                   0, image.getMipLevels());
+            timer.begin(commandBuffer);
+            recordMipBlits(commandBuffer, image.getVKImage().get(), image.getFormat(), extent, image.getMipLevels());
+            timer.end(commandBuffer);
+        });
+
+        double blitMilliseconds = 0.0;
+        if (timer.getMilliseconds(0, blitMilliseconds))
+        {
+            os << "GPU blit chain: " << blitMilliseconds << " ms, " << megapixels / (blitMilliseconds / 1000.0) << " MP/s\n";
+        }
+    }
+    os << std::defaultfloat;
+}
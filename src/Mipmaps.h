@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Common.h"
+#include <vulkan/vulkan.hpp>
+#include <iosfwd>
+
+class Device;
+
+// Levels down to 1 x 1, each half the size of the one before rounded down
+uint32 getMipLevelCount(const vk::Extent2D& extent);
+vk::Extent2D getMipExtent(const vk::Extent2D& extent, uint32 level);
+
+// Bytes of the levels [0, levelCount) of a chain with the levels packed one after the other, for the formats of
+// getImageSize
+size_t getMipChainSize(const vk::Extent2D& extent, uint32 levelCount, vk::Format format = vk::Format::eR8G8B8A8Unorm);
+
+enum class MipFilter
+{
+    Box,        // average of 2 x 2 pixels, fast but aliases fine detail
+    Kaiser,     // separable 12 tap windowed sinc, sharper and without the aliasing
+};
+
+// CPU path for formats that cannot be blitted. Writes the whole chain of the RGBA8 image top into chain, level 0
+// included, laid out as in getMipChainSize. Filtering happens on the stored values, so sRGB data gets filtered
+// without conversion to linear.
+void generateMipChain(const uint8_t* top, const vk::Extent2D& extent, MipFilter filter, uint8_t* chain);
+
+// Whether the optimal tiling of format can be the source and destination of linear blits
+bool canBlitMips(const vk::PhysicalDevice& physicalDevice, vk::Format format);
+
+// GPU path: fills levels [1, levelCount) from level 0 with a chain of linear blits, each level reading the one before.
+// Expects all levels in eTransferDstOptimal with level 0 written, leaves them all in eShaderReadOnlyOptimal.
+void recordMipBlits(const vk::UniqueCommandBuffer& commandBuffer, vk::Image image, vk::Format format, const vk::Extent2D& extent, uint32 levelCount);
+
+// CPU chain generation throughput of both filters, the time and bytes read by point sampling an image minified 8
+// times from level 0 against level 3, and with a device the GPU time of the blit chain
+void printMipmapBenchmark(std::ostream& os, uint32 size, const Device* device = nullptr);
@@ -0,0 +1,98 @@
+#include "PerDrawData.h"
+#include "GraphicsObjects.h"
+#include "utils.hpp"
+
+PerDrawData::PerDrawData(const Device& device, uint32 dataSize, vk::ShaderStageFlags stages, uint32 framesInFlight, uint32 maxDrawsPerFrame, uint32 setIndex)
+    : m_device(device)
+    , m_dataSize(dataSize)
+    , m_stages(stages)
+    , m_setIndex(setIndex)
+    , m_data(nullptr)
+    , m_slotSize(0)
+    , m_framesInFlight(framesInFlight)
+    , m_maxDrawsPerFrame(maxDrawsPerFrame)
+    , m_frameIndex(0)
+    , m_drawCount(0)
+{
+    assert(0 < dataSize && dataSize % 4 == 0 && 0 < framesInFlight && 0 < maxDrawsPerFrame);
+
+    const vk::PhysicalDeviceLimits& limits = device.getPhysicalDevice().getProperties().limits;
+    if (dataSize <= limits.maxPushConstantsSize)
+    {
+        return;
+    }
+
+    // power of 2 alignment
+    m_slotSize = (vk::DeviceSize(dataSize) + limits.minUniformBufferOffsetAlignment - 1) & ~(limits.minUniformBufferOffsetAlignment - 1);
+    assert(dataSize <= limits.maxUniformBufferRange);
+
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+    vk::DeviceSize size = m_slotSize * maxDrawsPerFrame * framesInFlight;
+    m_buffer = std::make_unique<Buffer>(device, size, vk::BufferUsageFlagBits::eUniformBuffer);
+    m_data = static_cast<uint8_t*>(vkDevice->mapMemory(m_buffer->getDeviceMemory().get(), 0, size));
+
+    m_descriptorSetLayout = vk::su::createDescriptorSetLayout(vkDevice, { { vk::DescriptorType::eUniformBufferDynamic, 1, stages } });
+    m_descriptorPool = vk::su::createDescriptorPool(vkDevice, { { vk::DescriptorType::eUniformBufferDynamic, 1 } });
+    m_descriptorSet = std::move(vkDevice->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(m_descriptorPool.get(), 1, &m_descriptorSetLayout.get())).front());
+
+    // the range is one slot, the dynamic offset picks which
+    vk::DescriptorBufferInfo bufferInfo(m_buffer->getVKBuffer().get(), 0, dataSize);
+    vkDevice->updateDescriptorSets(vk::WriteDescriptorSet(m_descriptorSet.get(), 0, 0, 1, vk::DescriptorType::eUniformBufferDynamic, nullptr, &bufferInfo), nullptr);
+}
+
+PerDrawData::~PerDrawData()
+{
+    if (m_buffer)
+    {
+        m_device.getVKDevice()->unmapMemory(m_buffer->getDeviceMemory().get());
+    }
+}
+
+string PerDrawData::getShaderHeader(const string& members, bool pushConstants, uint32 setIndex)
+{
+    string declaration = pushConstants ? "layout (push_constant) uniform DrawData\n"
+                                       : "layout (std140, set = " + std::to_string(setIndex) + ", binding = 0) uniform DrawData\n";
+    return "#version 450\n\n" + declaration + "{\n" + members + "} drawData;\n";
+}
+
+vk::UniquePipelineLayout PerDrawData::createPipelineLayout(const std::vector<vk::DescriptorSetLayout>& setLayouts) const
+{
+    if (usesPushConstants())
+    {
+        vk::PushConstantRange pushConstantRange(m_stages, 0, m_dataSize);
+        return m_device.getVKDevice()->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo({}, uint32(setLayouts.size()), setLayouts.data(), 1, &pushConstantRange));
+    }
+
+    assert(setLayouts.size() == m_setIndex);
+    std::vector<vk::DescriptorSetLayout> layouts(setLayouts);
+    layouts.push_back(m_descriptorSetLayout.get());
+    return m_device.getVKDevice()->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo({}, uint32(layouts.size()), layouts.data()));
+}
+
+void PerDrawData::beginFrame()
+{
+    m_frameIndex = (m_frameIndex + 1) % m_framesInFlight;
+    m_drawCount = 0;
+}
+
+bool PerDrawData::write(const vk::UniqueCommandBuffer& commandBuffer, vk::PipelineLayout pipelineLayout, const void* data, vk::PipelineBindPoint bindPoint)
+{
+    if (usesPushConstants())
+    {
+        commandBuffer->pushConstants(pipelineLayout, m_stages, 0, m_dataSize, data);
+        return true;
+    }
+
+    if (m_drawCount == m_maxDrawsPerFrame)
+    {
+        return false;
+    }
+    // the buffer is host coherent, the copy is visible to the submission recorded with it
+    vk::DeviceSize offset = (vk::DeviceSize(m_frameIndex) * m_maxDrawsPerFrame + m_drawCount) * m_slotSize;
+    memcpy(m_data + offset, data, m_dataSize);
+    m_drawCount++;
+
+    uint32 dynamicOffset = uint32(offset);
+    commandBuffer->bindDescriptorSets(bindPoint, pipelineLayout, m_setIndex, 1, &m_descriptorSet.get(), 1, &dynamicOffset);
+    return true;
+}
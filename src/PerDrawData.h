@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Common.h"
+#include <vulkan/vulkan.hpp>
+#include <memory>
+
+class Buffer;
+class Device;
+
+// The per draw data of vertexShaderText_PC_C_DrawData
+struct DrawConstants
+{
+    glm::mat4x4 mvp;
+    uint32      instanceId;     // for material and instance lookups, e.g. into a BindlessTextureTable
+    uint32      padding[3];
+};
+
+// Hands data that changes with every draw to the shaders as push constants, so draws need neither a descriptor set
+// bind nor a buffer write. Data larger than maxPushConstantsSize (at least 128 bytes) falls back to a uniform buffer
+// ring instead: each draw's data is copied to the next aligned slot and the single set is rebound with that slot as
+// its dynamic offset.
+//
+// Shaders declare the data with the header getShaderHeader() returns, which matches the path the device takes.
+class PerDrawData
+{
+public:
+    // The ring has maxDrawsPerFrame slots per frame in flight, its set is bound as setIndex
+    PerDrawData(const Device& device, uint32 dataSize, vk::ShaderStageFlags stages, uint32 framesInFlight, uint32 maxDrawsPerFrame, uint32 setIndex = 0);
+    ~PerDrawData();
+
+    PerDrawData(const PerDrawData&) = delete;
+    PerDrawData& operator=(const PerDrawData&) = delete;
+
+    bool usesPushConstants() const { return !m_buffer; }
+
+    // #version and the declaration of the block DrawData drawData holding members, the GLSL of the data's fields
+    string getShaderHeader(const string& members) const { return getShaderHeader(members, usesPushConstants(), m_setIndex); }
+    static string getShaderHeader(const string& members, bool pushConstants, uint32 setIndex);
+
+    // With the ring's set layout at setIndex, which has to be setLayouts.size(), unless push constants are used
+    vk::UniquePipelineLayout createPipelineLayout(const std::vector<vk::DescriptorSetLayout>& setLayouts = {}) const;
+
+    // Once per frame, after waiting for the fence of the frame framesInFlight frames back
+    void beginFrame();
+
+    // Records data for the draws after it. Returns false once maxDrawsPerFrame draws of the ring's frame used it.
+    bool write(const vk::UniqueCommandBuffer& commandBuffer, vk::PipelineLayout pipelineLayout, const void* data,
+               vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics);
+
+    template <typename DataType>
+    bool write(const vk::UniqueCommandBuffer& commandBuffer, vk::PipelineLayout pipelineLayout, const DataType& data,
+               vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics)
+    {
+        assert(sizeof(DataType) == m_dataSize);
+        return write(commandBuffer, pipelineLayout, static_cast<const void*>(&data), bindPoint);
+    }
+
+private:
+    const Device&                   m_device;
+    uint32                          m_dataSize;
+    vk::ShaderStageFlags            m_stages;
+    uint32                          m_setIndex;
+
+    // the ring, only without push constants
+    std::unique_ptr<Buffer>         m_buffer;
+    uint8_t*                        m_data;                 // persistently mapped
+    vk::DeviceSize                  m_slotSize;             // dataSize aligned to minUniformBufferOffsetAlignment
+    uint32                          m_framesInFlight;
+    uint32                          m_maxDrawsPerFrame;
+    uint32                          m_frameIndex;
+    uint32                          m_drawCount;            // in the current frame
+    vk::UniqueDescriptorSetLayout   m_descriptorSetLayout;
+    vk::UniqueDescriptorPool        m_descriptorPool;
+    vk::UniqueDescriptorSet         m_descriptorSet;
+};
@@ -0,0 +1,224 @@
+#include "PixelConversion.h"
+#include "BatchMath.h"
+#include "ThreadPool.h"
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <immintrin.h>
+
+// Byte shuffles need SSSE3, which every CPU at SimdLevel::Avx has
+#if defined(_MSC_VER)
+#define SSSE3_FUNCTION
+#else
+#define SSSE3_FUNCTION __attribute__((target("ssse3")))
+#endif
+
+// rows per band are chosen so a band is about this large, small enough to balance over the threads
+const size_t PixelBandBytes = 256 * 1024;
+
+static void forEachRowBand(const vk::Extent2D& extent, const std::function<void(uint32, uint32)>& func)
+{
+    size_t rowBytes = size_t(extent.width) * 4;
+    if (rowBytes * extent.height < ParallelPixelBytes)
+    {
+        func(0, extent.height);
+        return;
+    }
+
+    uint32 bandRows = uint32(std::max<size_t>(PixelBandBytes / rowBytes, 1));
+    uint32 bandCount = (extent.height + bandRows - 1) / bandRows;
+    ThreadPool::getInstance().parallelFor(bandCount, [&](uint32 band)
+    {
+        uint32 firstRow = band * bandRows;
+        func(firstRow, std::min(bandRows, extent.height - firstRow));
+    });
+}
+
+static uint8_t* getRow(void* data, size_t rowPitch, uint32 row)
+{
+    return static_cast<uint8_t*>(data) + row * rowPitch;
+}
+
+static const uint8_t* getRow(const void* data, size_t rowPitch, uint32 row)
+{
+    return static_cast<const uint8_t*>(data) + row * rowPitch;
+}
+
+static void fillRow(uint8_t* row, uint32 count, uint32 rgba)
+{
+    __m128i pixels = _mm_set1_epi32(int(rgba));
+    uint32 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i * 4), pixels);
+    }
+    for (; i < count; i++)
+    {
+        memcpy(row + i * 4, &rgba, 4);
+    }
+}
+
+void fillPixels(void* data, size_t rowPitch, const vk::Extent2D& extent, uint32 rgba)
+{
+    assert(rowPitch >= extent.width * 4);
+    forEachRowBand(extent, [&](uint32 firstRow, uint32 rowCount)
+    {
+        for (uint32 row = firstRow; row < firstRow + rowCount; row++)
+        {
+            fillRow(getRow(data, rowPitch, row), extent.width, rgba);
+        }
+    });
+}
+
+void fillCheckerboard(void* data, size_t rowPitch, const vk::Extent2D& extent, uint32 rgba0, uint32 rgba1, uint32 squareSize)
+{
+    assert(rowPitch >= extent.width * 4 && squareSize > 0);
+    forEachRowBand(extent, [&](uint32 firstRow, uint32 rowCount)
+    {
+        for (uint32 row = firstRow; row < firstRow + rowCount; row++)
+        {
+            uint8_t* pixels = getRow(data, rowPitch, row);
+            bool odd = (row / squareSize) & 1;
+            for (uint32 column = 0; column < extent.width; column += squareSize, odd = !odd)
+            {
+                fillRow(pixels + column * 4, std::min(squareSize, extent.width - column), odd ? rgba1 : rgba0);
+            }
+        }
+    });
+}
+
+void copyPixels(const void* source, size_t sourceRowPitch, void* data, size_t rowPitch, const vk::Extent2D& extent)
+{
+    size_t rowBytes = size_t(extent.width) * 4;
+    assert(sourceRowPitch >= rowBytes && rowPitch >= rowBytes);
+    forEachRowBand(extent, [&](uint32 firstRow, uint32 rowCount)
+    {
+        if (sourceRowPitch == rowBytes && rowPitch == rowBytes)
+        {
+            memcpy(getRow(data, rowPitch, firstRow), getRow(source, sourceRowPitch, firstRow), rowBytes * rowCount);
+            return;
+        }
+        for (uint32 row = firstRow; row < firstRow + rowCount; row++)
+        {
+            memcpy(getRow(data, rowPitch, row), getRow(source, sourceRowPitch, row), rowBytes);
+        }
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+static void expandRgbRow(const uint8_t* source, uint8_t* pixels, uint32 begin, uint32 count)
+{
+    for (uint32 i = begin; i < count; i++)
+    {
+        uint32 rgba = packRgba(source[i * 3], source[i * 3 + 1], source[i * 3 + 2]);
+        memcpy(pixels + i * 4, &rgba, 4);
+    }
+}
+
+// 16 byte loads of 4 pixels, the last 4 bytes belong to the next pixels, so the row end is done by expandRgbRow
+SSSE3_FUNCTION static void expandRgbRowSsse3(const uint8_t* source, uint8_t* pixels, uint32 count)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(int(0xff000000));
+    uint32 i = 0;
+    for (; (i + 4) * 3 + 4 <= count * 3; i += 4)
+    {
+        __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+    }
+    expandRgbRow(source, pixels, i, count);
+}
+
+void expandRgbToRgba(const void* source, size_t sourceRowPitch, void* data, size_t rowPitch, const vk::Extent2D& extent)
+{
+    assert(sourceRowPitch >= extent.width * 3 && rowPitch >= extent.width * 4);
+    bool shuffles = getSimdLevel() == SimdLevel::Avx;
+    forEachRowBand(extent, [&](uint32 firstRow, uint32 rowCount)
+    {
+        for (uint32 row = firstRow; row < firstRow + rowCount; row++)
+        {
+            if (shuffles)
+            {
+                expandRgbRowSsse3(getRow(source, sourceRowPitch, row), getRow(data, rowPitch, row), extent.width);
+            }
+            else
+            {
+                expandRgbRow(getRow(source, sourceRowPitch, row), getRow(data, rowPitch, row), 0, extent.width);
+            }
+        }
+    });
+}
+
+// Shifts and masks instead of a byte shuffle, SSE2 is enough for that
+void swapRedBlue(void* data, size_t rowPitch, const vk::Extent2D& extent)
+{
+    assert(rowPitch >= extent.width * 4);
+    forEachRowBand(extent, [&](uint32 firstRow, uint32 rowCount)
+    {
+        const __m128i greenAlpha = _mm_set1_epi32(int(0xff00ff00));
+        const __m128i low = _mm_set1_epi32(0xff);
+        for (uint32 row = firstRow; row < firstRow + rowCount; row++)
+        {
+            uint8_t* pixels = getRow(data, rowPitch, row);
+            uint32 i = 0;
+            for (; i + 4 <= extent.width; i += 4)
+            {
+                __m128i* p = reinterpret_cast<__m128i*>(pixels + i * 4);
+                __m128i v = _mm_loadu_si128(p);
+                __m128i swapped = _mm_or_si128(_mm_and_si128(v, greenAlpha),
+                                               _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 16), low), _mm_slli_epi32(_mm_and_si128(v, low), 16)));
+                _mm_storeu_si128(p, swapped);
+            }
+            for (; i < extent.width; i++)
+            {
+                std::swap(pixels[i * 4], pixels[i * 4 + 2]);
+            }
+        }
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+typedef std::array<uint8_t, 256> ByteTable;
+
+static ByteTable createTable(const std::function<float(float)>& func)
+{
+    ByteTable table;
+    for (int i = 0; i < 256; i++)
+    {
+        table[i] = uint8_t(std::lround(clamp(func(i / 255.0f), 0.0f, 1.0f) * 255.0f));
+    }
+    return table;
+}
+
+static void applyColorTable(void* data, size_t rowPitch, const vk::Extent2D& extent, const ByteTable& table)
+{
+    assert(rowPitch >= extent.width * 4);
+    forEachRowBand(extent, [&](uint32 firstRow, uint32 rowCount)
+    {
+        for (uint32 row = firstRow; row < firstRow + rowCount; row++)
+        {
+            uint8_t* pixels = getRow(data, rowPitch, row);
+            for (uint32 i = 0; i < extent.width * 4; i += 4)
+            {
+                pixels[i] = table[pixels[i]];
+                pixels[i + 1] = table[pixels[i + 1]];
+                pixels[i + 2] = table[pixels[i + 2]];
+            }
+        }
+    });
+}
+
+void convertSrgbToLinear(void* data, size_t rowPitch, const vk::Extent2D& extent)
+{
+    static const ByteTable table = createTable([](float c) { return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f); });
+    applyColorTable(data, rowPitch, extent, table);
+}
+
+void convertLinearToSrgb(void* data, size_t rowPitch, const vk::Extent2D& extent)
+{
+    static const ByteTable table = createTable([](float c) { return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f; });
+    applyColorTable(data, rowPitch, extent, table);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Common.h"
+#include <vulkan/vulkan.hpp>
+
+// Fills and conversions of 8 bit RGBA images. Pitches are the bytes from one row to the next and may be larger than
+// the row, e.g. for linear tiled images. Images of at least ParallelPixelBytes are split into bands of rows that run
+// on the shared ThreadPool.
+
+const size_t ParallelPixelBytes = 1 << 20;
+
+// A pixel as it lies in memory on little endian machines, red in the lowest byte
+inline uint32 packRgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255)
+{
+    return uint32(r) | (uint32(g) << 8) | (uint32(b) << 16) | (uint32(a) << 24);
+}
+
+void fillPixels(void* data, size_t rowPitch, const vk::Extent2D& extent, uint32 rgba);
+
+// Squares of squareSize x squareSize pixels, rgba0 in the top left one
+void fillCheckerboard(void* data, size_t rowPitch, const vk::Extent2D& extent, uint32 rgba0, uint32 rgba1, uint32 squareSize = 16);
+
+void copyPixels(const void* source, size_t sourceRowPitch, void* data, size_t rowPitch, const vk::Extent2D& extent);
+
+// From 3 bytes per pixel, with opaque alpha
+void expandRgbToRgba(const void* source, size_t sourceRowPitch, void* data, size_t rowPitch, const vk::Extent2D& extent);
+
+// In place, between RGBA and BGRA
+void swapRedBlue(void* data, size_t rowPitch, const vk::Extent2D& extent);
+
+// In place through 256 entry tables, alpha stays linear
+void convertSrgbToLinear(void* data, size_t rowPitch, const vk::Extent2D& extent);
+void convertLinearToSrgb(void* data, size_t rowPitch, const vk::Extent2D& extent);
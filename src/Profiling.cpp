@@ -0,0 +1,49 @@
+#include "Profiling.h"
+#include "GraphicsObjects.h"
+
+GpuTimer::GpuTimer(const Device& device, uint32 scopeCount)
+    : m_device(device)
+    , m_scopeCount(scopeCount)
+{
+    m_timestampPeriod = device.getPhysicalDevice().getProperties().limits.timestampPeriod;
+    m_queryPool = device.getVKDevice()->createQueryPoolUnique(vk::QueryPoolCreateInfo(vk::QueryPoolCreateFlags(), vk::QueryType::eTimestamp, scopeCount * 2));
+}
+
+GpuTimer::~GpuTimer()
+{
+
+}
+
+void GpuTimer::reset(const vk::UniqueCommandBuffer& commandBuffer)
+{
+    commandBuffer->resetQueryPool(m_queryPool.get(), 0, m_scopeCount * 2);
+}
+
+void GpuTimer::begin(const vk::UniqueCommandBuffer& commandBuffer, uint32 scope)
+{
+    assert(scope < m_scopeCount);
+    commandBuffer->writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_queryPool.get(), scope * 2);
+}
+
+void GpuTimer::end(const vk::UniqueCommandBuffer& commandBuffer, uint32 scope)
+{
+    assert(scope < m_scopeCount);
+    commandBuffer->writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool.get(), scope * 2 + 1);
+}
+
+bool GpuTimer::getMilliseconds(uint32 scope, double& milliseconds) const
+{
+    assert(scope < m_scopeCount);
+
+    uint64 timestamps[2];
+    vk::Result result = m_device.getVKDevice()->getQueryPoolResults(m_queryPool.get(), scope * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64),
+                                                                     vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess)
+    {
+        return false;
+    }
+
+    // timestampPeriod is in nanoseconds per tick
+    milliseconds = double(timestamps[1] - timestamps[0]) * m_timestampPeriod * 1e-6;
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Common.h"
+#include <vulkan/vulkan.hpp>
+#include <chrono>
+
+class Device;
+
+class Timer
+{
+public:
+    Timer() { reset(); }
+
+    void reset() { m_start = std::chrono::high_resolution_clock::now(); }
+
+    double getElapsedMilliseconds() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start).count();
+    }
+
+private:
+    std::chrono::high_resolution_clock::time_point m_start;
+};
+
+// Measures GPU time of command buffer ranges with timestamp queries, one begin/end pair per scope
+class GpuTimer
+{
+public:
+    GpuTimer(const Device& device, uint32 scopeCount = 1);
+    ~GpuTimer();
+
+    void reset(const vk::UniqueCommandBuffer& commandBuffer);
+    void begin(const vk::UniqueCommandBuffer& commandBuffer, uint32 scope = 0);
+    void end(const vk::UniqueCommandBuffer& commandBuffer, uint32 scope = 0);
+
+    // Returns false as long as the command buffer has not completed
+    bool getMilliseconds(uint32 scope, double& milliseconds) const;
+
+private:
+    const Device&       m_device;
+    uint32              m_scopeCount;
+    float               m_timestampPeriod;
+    vk::UniqueQueryPool m_queryPool;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Common.h"
+#include <cfloat>
+
+// Matches the std430 layout of struct Ray in the compute shaders
+struct Ray
+{
+    glm::vec3   origin;
+    float       tMin;
+    glm::vec3   direction;
+    float       tMax;
+};
+
+struct RayHit
+{
+    float       t           = FLT_MAX;
+    uint32      primitiveId = ~0u;
+    uint32      instanceId  = ~0u;
+    float       u           = 0.0f;
+    float       v           = 0.0f;
+
+    bool isHit() const { return primitiveId != ~0u; }
+};
+
+struct Aabb
+{
+    glm::vec3   min = glm::vec3(FLT_MAX);
+    glm::vec3   max = glm::vec3(-FLT_MAX);
+
+    void grow(const glm::vec3& p)
+    {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void grow(const Aabb& b)
+    {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+
+    // shrinks to the overlap with b, disjoint boxes leave an invalid one
+    void clip(const Aabb& b)
+    {
+        min = glm::max(min, b.min);
+        max = glm::min(max, b.max);
+    }
+
+    bool isValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+
+    glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+    glm::vec3 getExtent() const { return max - min; }
+
+    float getSurfaceArea() const
+    {
+        if (!isValid())
+        {
+            return 0.0f;
+        }
+        glm::vec3 e = max - min;
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+};
+
+// View frustum as six planes (xyz normal pointing inside, w distance) in the space the matrix maps to clip space.
+// The matrix follows Vulkan conventions, 0 <= z <= w.
+struct Frustum
+{
+    glm::vec4   planes[6];
+
+    static Frustum fromMatrix(const glm::mat4x4& m)
+    {
+        // rows of the matrix, glm stores columns
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+        {
+            rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        }
+
+        Frustum frustum;
+        frustum.planes[0] = rows[3] + rows[0];
+        frustum.planes[1] = rows[3] - rows[0];
+        frustum.planes[2] = rows[3] + rows[1];
+        frustum.planes[3] = rows[3] - rows[1];
+        frustum.planes[4] = rows[2];
+        frustum.planes[5] = rows[3] - rows[2];
+        for (glm::vec4& plane : frustum.planes)
+        {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const
+    {
+        for (const glm::vec4& plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Conservative: boxes near the frustum corners may pass although they lie outside
+    bool intersectsAabb(const Aabb& box) const
+    {
+        for (const glm::vec4& plane : planes)
+        {
+            // the corner furthest along the plane normal
+            glm::vec3 p(plane.x >= 0.0f ? box.max.x : box.min.x, plane.y >= 0.0f ? box.max.y : box.min.y, plane.z >= 0.0f ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
@@ -0,0 +1,315 @@
+#include "RaySort.h"
+#include "GraphicsObjects.h"
+#include "shaders.hpp"
+#include "math.hpp"
+#include <numeric>
+#include <iomanip>
+
+const uint32 GpuSortGroupSize = 256;
+const uint32 GpuSortRadixBits = 4;
+const uint32 GpuSortRadixBins = 1 << GpuSortRadixBits;
+
+// Matches the push constant block of the computeShaderText_RaySort* shaders
+struct RaySortPushConstants
+{
+    glm::vec4   boundsMin;
+    glm::vec4   boundsInvExtent;
+    uint32      count;
+    uint32      shift;
+    uint32      groupCount;
+};
+
+// spreads the lower 10 bits so that there are two zero bits between each
+static uint32 expandBits3(uint32 v)
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// spreads the lower 4 bits so that there is a zero bit between each
+static uint32 expandBits2(uint32 v)
+{
+    v &= 0xFu;
+    v = (v | (v << 2)) & 0x33u;
+    v = (v | (v << 1)) & 0x55u;
+    return v;
+}
+
+static glm::vec3 getInvExtent(const Aabb& sceneBounds)
+{
+    return 1.0f / glm::max(sceneBounds.getExtent(), glm::vec3(1e-20f));
+}
+
+static uint32 computeRayKey(const Ray& ray, const glm::vec3& boundsMin, const glm::vec3& invExtent)
+{
+    glm::vec3 o = glm::clamp((ray.origin - boundsMin) * invExtent, 0.0f, 1.0f) * 255.0f;
+    uint32 originCode = (expandBits3(uint32(o.x)) << 2) | (expandBits3(uint32(o.y)) << 1) | expandBits3(uint32(o.z));
+
+    glm::vec2 d = glm::min(vk::su::octahedralEncode(ray.direction) * 16.0f, 15.0f);
+    uint32 directionCode = (expandBits2(uint32(d.x)) << 1) | expandBits2(uint32(d.y));
+
+    return (originCode << 8) | directionCode;
+}
+
+uint32 computeRayKey(const Ray& ray, const Aabb& sceneBounds)
+{
+    return computeRayKey(ray, sceneBounds.min, getInvExtent(sceneBounds));
+}
+
+void computeRayKeys(const std::vector<Ray>& rays, const Aabb& sceneBounds, std::vector<uint32>& keys)
+{
+    glm::vec3 invExtent = getInvExtent(sceneBounds);
+
+    keys.resize(rays.size());
+    for (size_t i = 0; i < rays.size(); i++)
+    {
+        keys[i] = computeRayKey(rays[i], sceneBounds.min, invExtent);
+    }
+}
+
+void radixSortRayIndices(std::vector<uint32>& keys, std::vector<uint32>& indices, std::vector<uint32>& scratchKeys, std::vector<uint32>& scratchIndices)
+{
+    assert(keys.size() == indices.size());
+    const size_t count = keys.size();
+
+    scratchKeys.resize(count);
+    scratchIndices.resize(count);
+
+    for (uint32 shift = 0; shift < 32; shift += 8)
+    {
+        size_t offsets[256] = {};
+        for (uint32 key : keys)
+        {
+            offsets[(key >> shift) & 0xFF]++;
+        }
+
+        // all keys share this digit, nothing to reorder
+        if (offsets[keys.empty() ? 0 : (keys[0] >> shift) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        size_t sum = 0;
+        for (size_t& offset : offsets)
+        {
+            size_t c = offset;
+            offset = sum;
+            sum += c;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t dst = offsets[(keys[i] >> shift) & 0xFF]++;
+            scratchKeys[dst] = keys[i];
+            scratchIndices[dst] = indices[i];
+        }
+
+        keys.swap(scratchKeys);
+        indices.swap(scratchIndices);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+double RaySortBounceStats::getTraceSavingNsPerRay() const
+{
+    if (sortedRays == 0 || unsortedRays == 0)
+    {
+        return 0.0;
+    }
+    return 1e6 * (unsortedTraceMs / double(unsortedRays) - sortedTraceMs / double(sortedRays));
+}
+
+double RaySortBounceStats::getSortNsPerRay() const
+{
+    return sortedRays ? 1e6 * sortMs / double(sortedRays) : 0.0;
+}
+
+RayReorderer::RayReorderer(bool enabled, uint32 baselineInterval)
+    : m_enabled(enabled)
+    , m_baselineInterval(baselineInterval)
+    , m_firstSortedBounce(1)
+    , m_frameIndex(0)
+{
+}
+
+RayReorderer::~RayReorderer()
+{
+
+}
+
+void RayReorderer::trace(uint32 bounce, const std::vector<Ray>& rays, const Aabb& sceneBounds, const TraceFunc& traceFunc)
+{
+    if (m_stats.size() <= bounce)
+    {
+        m_stats.resize(bounce + 1);
+    }
+    RaySortBounceStats& stats = m_stats[bounce];
+
+    bool baselineFrame = m_baselineInterval != 0 && (m_frameIndex % m_baselineInterval) == 0;
+    bool sort = m_enabled && !baselineFrame && m_firstSortedBounce <= bounce;
+
+    Timer timer;
+
+    m_order.resize(rays.size());
+    std::iota(m_order.begin(), m_order.end(), 0u);
+    if (sort)
+    {
+        computeRayKeys(rays, sceneBounds, m_keys);
+        radixSortRayIndices(m_keys, m_order, m_scratchKeys, m_scratchIndices);
+        stats.sortMs += timer.getElapsedMilliseconds();
+    }
+
+    timer.reset();
+    traceFunc(rays, m_order);
+    double traceMs = timer.getElapsedMilliseconds();
+
+    if (sort)
+    {
+        stats.sortedRays += rays.size();
+        stats.sortedTraceMs += traceMs;
+    }
+    else
+    {
+        stats.unsortedRays += rays.size();
+        stats.unsortedTraceMs += traceMs;
+    }
+}
+
+void RayReorderer::printStats(std::ostream& os) const
+{
+    os << "bounce      rays    sort ns/ray   trace ns/ray (sorted / unsorted)   net gain ns/ray\n";
+    for (size_t bounce = 0; bounce < m_stats.size(); bounce++)
+    {
+        const RaySortBounceStats& stats = m_stats[bounce];
+        double sortedNs = stats.sortedRays ? 1e6 * stats.sortedTraceMs / double(stats.sortedRays) : 0.0;
+        double unsortedNs = stats.unsortedRays ? 1e6 * stats.unsortedTraceMs / double(stats.unsortedRays) : 0.0;
+
+        os << std::setw(6) << bounce << std::setw(10) << (stats.sortedRays + stats.unsortedRays) << std::fixed << std::setprecision(2)
+           << std::setw(15) << stats.getSortNsPerRay() << std::setw(17) << sortedNs << " / " << std::setw(10) << unsortedNs
+           << std::setw(24) << (stats.getTraceSavingNsPerRay() - stats.getSortNsPerRay()) << "\n";
+    }
+    os << std::defaultfloat;
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+GpuRaySorter::GpuRaySorter(const Device& device, uint32 maxRays)
+    : m_device(device)
+    , m_maxRays(maxRays)
+    , m_timer(device)
+{
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+
+    uint32 maxGroups = (maxRays + GpuSortGroupSize - 1) / GpuSortGroupSize;
+    for (int i = 0; i < 2; i++)
+    {
+        m_keys[i] = std::make_unique<Buffer>(device, maxRays * sizeof(uint32), vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        m_values[i] = std::make_unique<Buffer>(device, maxRays * sizeof(uint32), vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    }
+    m_histogram = std::make_unique<Buffer>(device, maxGroups * GpuSortRadixBins * sizeof(uint32), vk::BufferUsageFlagBits::eStorageBuffer,
+                                           vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    // 0: rays, 1: keys in, 2: values in, 3: keys out, 4: values out, 5: histogram
+    m_descriptorSetLayout = vk::su::createDescriptorSetLayout(vkDevice, std::vector<std::tuple<vk::DescriptorType, uint32_t, vk::ShaderStageFlags>>(
+                                                                            6, { vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute }));
+    vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(RaySortPushConstants));
+    m_pipelineLayout = vkDevice->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), 1, &m_descriptorSetLayout.get(), 1, &pushConstantRange));
+
+    m_descriptorPool = vk::su::createDescriptorPool(vkDevice, { { vk::DescriptorType::eStorageBuffer, 12 } });
+    vk::DescriptorSetLayout layouts[2] = { m_descriptorSetLayout.get(), m_descriptorSetLayout.get() };
+    std::vector<vk::UniqueDescriptorSet> descriptorSets = vkDevice->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(m_descriptorPool.get(), 2, layouts));
+    for (int i = 0; i < 2; i++)
+    {
+        m_descriptorSets[i] = std::move(descriptorSets[i]);
+
+        vk::DescriptorBufferInfo bufferInfos[5] =
+        {
+            vk::DescriptorBufferInfo(m_keys[i]->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(m_values[i]->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(m_keys[1 - i]->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(m_values[1 - i]->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(m_histogram->getVKBuffer().get(), 0, VK_WHOLE_SIZE)
+        };
+        vkDevice->updateDescriptorSets(vk::WriteDescriptorSet(m_descriptorSets[i].get(), 1, 0, 5, vk::DescriptorType::eStorageBuffer, nullptr, bufferInfos), nullptr);
+    }
+
+    vk::UniquePipelineCache pipelineCache = vkDevice->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+    auto createPipeline = [&](const std::string& shaderText)
+    {
+        vk::UniqueShaderModule shaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eCompute, shaderText);
+        return vk::su::createComputePipeline(vkDevice, pipelineCache, std::make_pair(shaderModule.get(), nullptr), m_pipelineLayout);
+    };
+    m_keyPipeline = createPipeline(computeShaderText_RaySortKeys);
+    m_countPipeline = createPipeline(computeShaderText_RaySortCount);
+    m_scanPipeline = createPipeline(computeShaderText_RaySortScan);
+    m_scatterPipeline = createPipeline(computeShaderText_RaySortScatter);
+}
+
+GpuRaySorter::~GpuRaySorter()
+{
+
+}
+
+void GpuRaySorter::bindRayBuffer(const Buffer& rayBuffer)
+{
+    // the descriptor sets must not be in flight when a different ray buffer gets bound
+    if (m_boundRayBuffer == rayBuffer.getVKBuffer().get())
+    {
+        return;
+    }
+    m_boundRayBuffer = rayBuffer.getVKBuffer().get();
+
+    vk::DescriptorBufferInfo bufferInfo(m_boundRayBuffer, 0, VK_WHOLE_SIZE);
+    for (const vk::UniqueDescriptorSet& descriptorSet : m_descriptorSets)
+    {
+        m_device.getVKDevice()->updateDescriptorSets(vk::WriteDescriptorSet(descriptorSet.get(), 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfo), nullptr);
+    }
+}
+
+void GpuRaySorter::record(const vk::UniqueCommandBuffer& commandBuffer, const Buffer& rayBuffer, uint32 rayCount, const Aabb& sceneBounds)
+{
+    assert(rayCount <= m_maxRays);
+    bindRayBuffer(rayBuffer);
+
+    RaySortPushConstants pushConstants;
+    pushConstants.boundsMin = glm::vec4(sceneBounds.min, 0.0f);
+    pushConstants.boundsInvExtent = glm::vec4(getInvExtent(sceneBounds), 0.0f);
+    pushConstants.count = rayCount;
+    pushConstants.shift = 0;
+    pushConstants.groupCount = (rayCount + GpuSortGroupSize - 1) / GpuSortGroupSize;
+
+    m_timer.reset(commandBuffer);
+    m_timer.begin(commandBuffer);
+
+    commandBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, m_keyPipeline.get());
+    commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout.get(), 0, m_descriptorSets[0].get(), nullptr);
+    commandBuffer->pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+    commandBuffer->dispatch(pushConstants.groupCount, 1, 1);
+    vk::su::computeToComputeBarrier(commandBuffer);
+
+    // an even number of passes, so the sorted indices end up in m_values[0] again
+    for (uint32 pass = 0; pass < 32 / GpuSortRadixBits; pass++)
+    {
+        pushConstants.shift = pass * GpuSortRadixBits;
+        commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout.get(), 0, m_descriptorSets[pass & 1].get(), nullptr);
+        commandBuffer->pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+
+        commandBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, m_countPipeline.get());
+        commandBuffer->dispatch(pushConstants.groupCount, 1, 1);
+        vk::su::computeToComputeBarrier(commandBuffer);
+
+        commandBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, m_scanPipeline.get());
+        commandBuffer->dispatch(1, 1, 1);
+        vk::su::computeToComputeBarrier(commandBuffer);
+
+        commandBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, m_scatterPipeline.get());
+        commandBuffer->dispatch(pushConstants.groupCount, 1, 1);
+        vk::su::computeToComputeBarrier(commandBuffer);
+    }
+
+    m_timer.end(commandBuffer);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Ray.h"
+#include "Profiling.h"
+#include <vulkan/vulkan.hpp>
+#include <functional>
+#include <memory>
+#include <ostream>
+
+class Device;
+class Buffer;
+
+// 32 bit sort key: the 24 bit Morton code of the origin quantized within the scene bounds, followed by the
+// 8 bit Morton code of the octahedral encoded direction. computeShaderText_RaySortKeys computes the same key.
+uint32 computeRayKey(const Ray& ray, const Aabb& sceneBounds);
+void computeRayKeys(const std::vector<Ray>& rays, const Aabb& sceneBounds, std::vector<uint32>& keys);
+
+// Stable LSD radix sort over 8 bit digits which carries the ray indices along. Passes where all keys share
+// the same digit are skipped. The scratch vectors are resized as needed and can be kept around between calls.
+void radixSortRayIndices(std::vector<uint32>& keys, std::vector<uint32>& indices, std::vector<uint32>& scratchKeys, std::vector<uint32>& scratchIndices);
+
+struct RaySortBounceStats
+{
+    uint64  sortedRays      = 0;
+    double  sortMs          = 0.0;
+    double  sortedTraceMs   = 0.0;
+    uint64  unsortedRays    = 0;
+    double  unsortedTraceMs = 0.0;
+
+    // Traversal time saved per ray by sorting, measured against the unsorted baseline frames
+    double getTraceSavingNsPerRay() const;
+    double getSortNsPerRay() const;
+};
+
+// Optional sorting stage between bounces of the CPU tracer. Every baselineInterval frames the bounces are
+// traced unsorted, so the per bounce statistics can weigh the sort cost against the traversal savings.
+class RayReorderer
+{
+public:
+    // Traces rays[order[0]], rays[order[1]], ...
+    using TraceFunc = std::function<void(const std::vector<Ray>& rays, const std::vector<uint32>& order)>;
+
+    RayReorderer(bool enabled = true, uint32 baselineInterval = 16);
+    ~RayReorderer();
+
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+    bool isEnabled() const { return m_enabled; }
+
+    // Primary rays are coherent already, so sorting starts with the first bounce by default
+    void setFirstSortedBounce(uint32 bounce) { m_firstSortedBounce = bounce; }
+
+    void beginFrame() { m_frameIndex++; }
+    void trace(uint32 bounce, const std::vector<Ray>& rays, const Aabb& sceneBounds, const TraceFunc& traceFunc);
+
+    const std::vector<RaySortBounceStats>& getStats() const { return m_stats; }
+    void resetStats() { m_stats.clear(); }
+    void printStats(std::ostream& os) const;
+
+private:
+    bool                            m_enabled;
+    uint32                          m_baselineInterval;
+    uint32                          m_firstSortedBounce;
+    uint64                          m_frameIndex;
+
+    std::vector<uint32>             m_keys;
+    std::vector<uint32>             m_order;
+    std::vector<uint32>             m_scratchKeys;
+    std::vector<uint32>             m_scratchIndices;
+    std::vector<RaySortBounceStats> m_stats;
+};
+
+// GPU path: computes the keys of a ray buffer and sorts the ray indices with a 4 bit per pass radix sort
+class GpuRaySorter
+{
+public:
+    GpuRaySorter(const Device& device, uint32 maxRays);
+    ~GpuRaySorter();
+
+    // Records key generation and sort of rayBuffer (an array of Ray), the sorted ray indices end up in getSortedIndexBuffer()
+    void record(const vk::UniqueCommandBuffer& commandBuffer, const Buffer& rayBuffer, uint32 rayCount, const Aabb& sceneBounds);
+
+    const Buffer& getSortedIndexBuffer() const { return *m_values[0]; }
+
+    // GPU time of the last recorded sort, false until its command buffer completed
+    bool getLastSortMilliseconds(double& milliseconds) const { return m_timer.getMilliseconds(0, milliseconds); }
+
+private:
+    void bindRayBuffer(const Buffer& rayBuffer);
+
+    const Device&                   m_device;
+    uint32                          m_maxRays;
+    vk::Buffer                      m_boundRayBuffer;
+
+    std::unique_ptr<Buffer>         m_keys[2];
+    std::unique_ptr<Buffer>         m_values[2];
+    std::unique_ptr<Buffer>         m_histogram;
+
+    vk::UniqueDescriptorSetLayout   m_descriptorSetLayout;
+    vk::UniquePipelineLayout        m_pipelineLayout;
+    vk::UniqueDescriptorPool        m_descriptorPool;
+    vk::UniqueDescriptorSet         m_descriptorSets[2];    // [i] reads keys/values i and writes 1 - i
+
+    vk::UniquePipeline              m_keyPipeline;
+    vk::UniquePipeline              m_countPipeline;
+    vk::UniquePipeline              m_scanPipeline;
+    vk::UniquePipeline              m_scatterPipeline;
+
+    GpuTimer                        m_timer;
+};
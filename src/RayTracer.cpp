@@ -0,0 +1,220 @@
+#include "RayTracer.h"
+#include "Profiling.h"
+#include <glm/gtc/constants.hpp>
+#include <iomanip>
+
+// offsets secondary ray origins off the surface to avoid self intersection
+const float RayEpsilon = 1e-4f;
+
+static uint32 pcgHash(uint32 v)
+{
+    uint32 state = v * 747796405u + 2891336453u;
+    uint32 word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+static float randomFloat(uint32& seed)
+{
+    seed = pcgHash(seed);
+    return float(seed >> 8) * (1.0f / 16777216.0f);
+}
+
+static glm::vec3 sampleCosineHemisphere(const glm::vec3& n, uint32& seed)
+{
+    // orthonormal basis around n, Duff et al. 2017
+    float sign = n.z >= 0.0f ? 1.0f : -1.0f;
+    float a = -1.0f / (sign + n.z);
+    float b = n.x * n.y * a;
+    glm::vec3 tangent(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+    glm::vec3 bitangent(b, sign + n.y * n.y * a, -n.y);
+
+    float u1 = randomFloat(seed);
+    float u2 = randomFloat(seed);
+    float r = std::sqrt(u1);
+    float phi = 2.0f * glm::pi<float>() * u2;
+    return tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + n * std::sqrt(std::max(0.0f, 1.0f - u1));
+}
+
+CpuRayTracer::CpuRayTracer(const TopLevelAs& scene, const vk::Extent2D& extent, uint32 maxBounces)
+    : m_scene(scene)
+    , m_extent(extent)
+    , m_maxBounces(maxBounces)
+    , m_viewProjectionClip(1.0f)
+    , m_inverseViewProjectionClip(1.0f)
+    , m_skyColor(0.8f, 0.85f, 1.0f)
+    , m_sunDirection(glm::normalize(glm::vec3(0.3f, -1.0f, 0.2f)))
+    , m_sunIrradiance(2.5f)
+{
+}
+
+CpuRayTracer::~CpuRayTracer()
+{
+
+}
+
+void CpuRayTracer::setCamera(const glm::mat4x4& viewProjectionClip)
+{
+    m_viewProjectionClip = viewProjectionClip;
+    m_inverseViewProjectionClip = glm::inverse(viewProjectionClip);
+}
+
+void CpuRayTracer::setSun(const glm::vec3& direction, const glm::vec3& irradiance)
+{
+    m_sunDirection = glm::normalize(direction);
+    m_sunIrradiance = irradiance;
+}
+
+void CpuRayTracer::generatePrimaryRays(uint32 sampleIndex)
+{
+    const uint32 pixelCount = m_extent.width * m_extent.height;
+    m_rays.resize(pixelCount);
+    m_pathPixels.resize(pixelCount);
+    m_pathSeeds.resize(pixelCount);
+    m_pathThroughputs.assign(pixelCount, glm::vec3(1.0f));
+
+    uint32 sampleSeed = pcgHash(sampleIndex);
+    for (uint32 y = 0; y < m_extent.height; y++)
+    {
+        for (uint32 x = 0; x < m_extent.width; x++)
+        {
+            uint32 pixel = y * m_extent.width + x;
+            uint32 seed = pcgHash(pixel ^ sampleSeed);
+
+            // vulkan NDC has y pointing down and depth in [0, 1]
+            glm::vec2 ndc((x + randomFloat(seed)) / m_extent.width * 2.0f - 1.0f, (y + randomFloat(seed)) / m_extent.height * 2.0f - 1.0f);
+            glm::vec4 nearPoint = m_inverseViewProjectionClip * glm::vec4(ndc, 0.0f, 1.0f);
+            glm::vec4 farPoint = m_inverseViewProjectionClip * glm::vec4(ndc, 1.0f, 1.0f);
+            glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+
+            m_rays[pixel] = { origin, 0.0f, glm::normalize(glm::vec3(farPoint) / farPoint.w - origin), FLT_MAX };
+            m_pathPixels[pixel] = pixel;
+            m_pathSeeds[pixel] = seed;
+        }
+    }
+}
+
+void CpuRayTracer::renderSample(uint32 sampleIndex, std::vector<glm::vec4>& radiance)
+{
+    const size_t pixelCount = size_t(m_extent.width) * m_extent.height;
+    radiance.assign(pixelCount, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    m_normalDepth.assign(pixelCount, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    m_albedo.assign(pixelCount, glm::vec4(1.0f));
+
+    m_reorderer.beginFrame();
+    generatePrimaryRays(sampleIndex);
+
+    const Aabb sceneBounds = m_scene.getBounds();
+    for (uint32 bounce = 0; bounce <= m_maxBounces && !m_rays.empty(); bounce++)
+    {
+        m_hits.assign(m_rays.size(), RayHit());
+        m_reorderer.trace(bounce, m_rays, sceneBounds, [&](const std::vector<Ray>& rays, const std::vector<uint32>& order)
+        {
+            Timer timer;
+            for (uint32 i : order)
+            {
+                m_scene.intersect(rays[i], m_hits[i]);
+            }
+
+            double traceMs = timer.getElapsedMilliseconds();
+            (bounce == 0 ? m_stats.primaryRays : m_stats.secondaryRays) += rays.size();
+            (bounce == 0 ? m_stats.primaryMs : m_stats.secondaryMs) += traceMs;
+        });
+
+        m_shadowRays.clear();
+        m_shadowPixels.clear();
+        m_shadowContributions.clear();
+        m_nextRays.clear();
+        m_nextPathPixels.clear();
+        m_nextPathSeeds.clear();
+        m_nextPathThroughputs.clear();
+        for (size_t i = 0; i < m_rays.size(); i++)
+        {
+            const RayHit& hit = m_hits[i];
+            if (!hit.isHit())
+            {
+                radiance[m_pathPixels[i]] += glm::vec4(m_pathThroughputs[i] * m_skyColor, 0.0f);
+                continue;
+            }
+
+            const Instance& instance = m_scene.getInstances()[hit.instanceId];
+            glm::vec3 objectNormal = m_scene.getBlas(instance.blasIndex).getNormal(hit.primitiveId);
+            glm::vec3 normal = glm::normalize(glm::vec3(glm::transpose(instance.inverseTransform) * glm::vec4(objectNormal, 0.0f)));
+            if (glm::dot(normal, m_rays[i].direction) > 0.0f)
+            {
+                normal = -normal;
+            }
+
+            glm::vec3 position = m_rays[i].origin + m_rays[i].direction * hit.t;
+            if (bounce == 0)
+            {
+                glm::vec4 clip = m_viewProjectionClip * glm::vec4(position, 1.0f);
+                m_normalDepth[m_pathPixels[i]] = glm::vec4(normal, clip.z / clip.w);
+                m_albedo[m_pathPixels[i]] = glm::vec4(instance.albedo, 1.0f);
+            }
+
+            // direct sun light, added if the shadow ray gets through
+            float cosSun = glm::dot(normal, m_sunDirection);
+            if (cosSun > 0.0f && m_sunIrradiance != glm::vec3(0.0f))
+            {
+                m_shadowRays.push_back({ position + normal * RayEpsilon, 0.0f, m_sunDirection, FLT_MAX });
+                m_shadowPixels.push_back(m_pathPixels[i]);
+                m_shadowContributions.push_back(m_pathThroughputs[i] * instance.albedo * m_sunIrradiance * (cosSun / glm::pi<float>()));
+            }
+
+            if (bounce == m_maxBounces)
+            {
+                continue;
+            }
+
+            // cosine weighted sampling of a lambertian surface, the throughput simply picks up the albedo
+            uint32 seed = m_pathSeeds[i];
+            m_nextRays.push_back({ position + normal * RayEpsilon, 0.0f, sampleCosineHemisphere(normal, seed), FLT_MAX });
+            m_nextPathPixels.push_back(m_pathPixels[i]);
+            m_nextPathSeeds.push_back(seed);
+            m_nextPathThroughputs.push_back(m_pathThroughputs[i] * instance.albedo);
+        }
+
+        traceShadowRays(radiance);
+
+        m_rays.swap(m_nextRays);
+        m_pathPixels.swap(m_nextPathPixels);
+        m_pathSeeds.swap(m_nextPathSeeds);
+        m_pathThroughputs.swap(m_nextPathThroughputs);
+    }
+}
+
+void CpuRayTracer::traceShadowRays(std::vector<glm::vec4>& radiance)
+{
+    m_shadowOccluded.resize(m_shadowRays.size());
+
+    Timer timer;
+    for (size_t i = 0; i < m_shadowRays.size(); i++)
+    {
+        m_shadowOccluded[i] = m_scene.occluded(m_shadowRays[i]);
+    }
+    m_stats.shadowRays += m_shadowRays.size();
+    m_stats.shadowMs += timer.getElapsedMilliseconds();
+
+    for (size_t i = 0; i < m_shadowRays.size(); i++)
+    {
+        if (!m_shadowOccluded[i])
+        {
+            radiance[m_shadowPixels[i]] += glm::vec4(m_shadowContributions[i], 0.0f);
+        }
+    }
+}
+
+void CpuRayTracer::printStats(std::ostream& os) const
+{
+    auto printLine = [&](const char* name, uint64 rays, double milliseconds)
+    {
+        os << std::setw(10) << name << std::setw(12) << rays << std::fixed << std::setprecision(2) << std::setw(12)
+           << RayTracerStats::getMraysPerSecond(rays, milliseconds) << "\n";
+    };
+
+    os << "      rays       count     Mrays/s\n";
+    printLine("primary", m_stats.primaryRays, m_stats.primaryMs);
+    printLine("secondary", m_stats.secondaryRays, m_stats.secondaryMs);
+    printLine("shadow", m_stats.shadowRays, m_stats.shadowMs);
+    os << std::defaultfloat;
+}
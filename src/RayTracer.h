@@ -0,0 +1,86 @@
+#pragma once
+
+#include "AccelerationStructure.h"
+#include "RaySort.h"
+#include <vulkan/vulkan.hpp>
+#include <ostream>
+
+// Ray counts and trace times per ray type, accumulated since the last CpuRayTracer::resetStats()
+struct RayTracerStats
+{
+    uint64  primaryRays     = 0;
+    double  primaryMs       = 0.0;
+    uint64  secondaryRays   = 0;
+    double  secondaryMs     = 0.0;
+    uint64  shadowRays      = 0;
+    double  shadowMs        = 0.0;
+
+    static double getMraysPerSecond(uint64 rays, double milliseconds) { return milliseconds > 0.0 ? double(rays) / (milliseconds * 1000.0) : 0.0; }
+};
+
+// Wavefront path tracer on the CPU: all paths of a bounce are traced as one batch, which lets the
+// RayReorderer sort the secondary rays in between. Surfaces are diffuse with the instance albedo, lit by the sky
+// and a sun whose visibility is tested with occlusion only shadow rays.
+class CpuRayTracer
+{
+public:
+    CpuRayTracer(const TopLevelAs& scene, const vk::Extent2D& extent, uint32 maxBounces = 2);
+    ~CpuRayTracer();
+
+    // Primary rays are unprojected through the inverse of this matrix, see createModelViewProjectionClipMatrix
+    void setCamera(const glm::mat4x4& viewProjectionClip);
+    void setSkyColor(const glm::vec3& skyColor) { m_skyColor = skyColor; }
+
+    // direction points towards the sun, a zero irradiance turns the shadow rays off
+    void setSun(const glm::vec3& direction, const glm::vec3& irradiance);
+
+    // Traces one path per pixel, usable as ProgressiveAccumulator::SampleFunc
+    void renderSample(uint32 sampleIndex, std::vector<glm::vec4>& radiance);
+
+    // G-buffer of the primary hits of the last sample, as expected by the denoisers: world space normal and depth buffer
+    // depth (1 for the background), and the albedo
+    const std::vector<glm::vec4>& getNormalDepth() const { return m_normalDepth; }
+    const std::vector<glm::vec4>& getAlbedo() const { return m_albedo; }
+
+    RayReorderer& getReorderer() { return m_reorderer; }
+
+    const RayTracerStats& getStats() const { return m_stats; }
+    void resetStats() { m_stats = RayTracerStats(); }
+    void printStats(std::ostream& os) const;
+
+private:
+    void generatePrimaryRays(uint32 sampleIndex);
+    void traceShadowRays(std::vector<glm::vec4>& radiance);
+
+    const TopLevelAs&       m_scene;
+    vk::Extent2D            m_extent;
+    uint32                  m_maxBounces;
+    glm::mat4x4             m_viewProjectionClip;
+    glm::mat4x4             m_inverseViewProjectionClip;
+    glm::vec3               m_skyColor;
+    glm::vec3               m_sunDirection;
+    glm::vec3               m_sunIrradiance;
+    RayReorderer            m_reorderer;
+    RayTracerStats          m_stats;
+
+    std::vector<glm::vec4>  m_normalDepth;
+    std::vector<glm::vec4>  m_albedo;
+
+    // one entry per active path
+    std::vector<Ray>        m_rays;
+    std::vector<RayHit>     m_hits;
+    std::vector<uint32>     m_pathPixels;
+    std::vector<uint32>     m_pathSeeds;
+    std::vector<glm::vec3>  m_pathThroughputs;
+
+    std::vector<Ray>        m_nextRays;
+    std::vector<uint32>     m_nextPathPixels;
+    std::vector<uint32>     m_nextPathSeeds;
+    std::vector<glm::vec3>  m_nextPathThroughputs;
+
+    // one entry per shadow ray of the current bounce
+    std::vector<Ray>        m_shadowRays;
+    std::vector<uint32>     m_shadowPixels;
+    std::vector<glm::vec3>  m_shadowContributions;
+    std::vector<uint8_t>    m_shadowOccluded;
+};
@@ -0,0 +1,101 @@
+#include "StagingRing.h"
+#include "GraphicsObjects.h"
+#include "utils.hpp"
+
+StagingRing::StagingRing(const Device& device, vk::DeviceSize size, vk::BufferUsageFlags usage)
+    : m_device(device)
+    , m_size(size)
+    , m_head(0)
+    , m_used(0)
+    , m_pending(0)
+{
+    m_buffer = std::make_unique<Buffer>(device, size, usage);
+    m_data = static_cast<uint8_t*>(device.getVKDevice()->mapMemory(m_buffer->getDeviceMemory().get(), 0, size));
+}
+
+StagingRing::~StagingRing()
+{
+    waitIdle();
+    m_device.getVKDevice()->unmapMemory(m_buffer->getDeviceMemory().get());
+}
+
+bool StagingRing::allocate(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset, void*& data)
+{
+    assert(alignment && !(alignment & (alignment - 1)));
+    assert(size <= m_size);
+
+    // an allocation that does not fit before the end starts over at 0, the bytes skipped are freed with it
+    vk::DeviceSize start = (m_head + alignment - 1) & ~(alignment - 1);
+    if (start + size > m_size)
+    {
+        start = 0;
+    }
+    vk::DeviceSize consumed = (start >= m_head ? start - m_head : m_size - m_head) + size;
+    if (m_used + consumed > m_size)
+    {
+        return false;
+    }
+
+    m_used += consumed;
+    m_pending += consumed;
+    m_head = start + size;
+    if (m_head == m_size)
+    {
+        m_head = 0;
+    }
+
+    offset = start;
+    data = m_data + start;
+    return true;
+}
+
+vk::Fence StagingRing::getSubmitFence()
+{
+    const vk::UniqueDevice& device = m_device.getVKDevice();
+
+    Batch batch = { m_pending, vk::UniqueFence() };
+    if (m_freeFences.empty())
+    {
+        batch.fence = device->createFenceUnique(vk::FenceCreateInfo());
+    }
+    else
+    {
+        batch.fence = std::move(m_freeFences.back());
+        m_freeFences.pop_back();
+        device->resetFences(batch.fence.get());
+    }
+    m_pending = 0;
+
+    m_batches.push_back(std::move(batch));
+    return m_batches.back().fence.get();
+}
+
+void StagingRing::reclaim()
+{
+    const vk::UniqueDevice& device = m_device.getVKDevice();
+
+    while (!m_batches.empty() && device->getFenceStatus(m_batches.front().fence.get()) == vk::Result::eSuccess)
+    {
+        m_used -= m_batches.front().size;
+        m_freeFences.push_back(std::move(m_batches.front().fence));
+        m_batches.pop_front();
+    }
+
+    // an empty ring starts over at 0, so any size up to the whole ring fits again
+    if (!m_used)
+    {
+        m_head = 0;
+    }
+}
+
+void StagingRing::waitIdle()
+{
+    const vk::UniqueDevice& device = m_device.getVKDevice();
+
+    for (const Batch& batch : m_batches)
+    {
+        while (vk::Result::eTimeout == device->waitForFences(batch.fence.get(), VK_TRUE, vk::su::FenceTimeout))
+            ;
+    }
+    reclaim();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Common.h"
+#include <vulkan/vulkan.hpp>
+#include <deque>
+#include <memory>
+
+class Buffer;
+class Device;
+
+// Host visible buffer, mapped once and handed out front to back, wrapping around at the end. Allocations are only
+// freed as a whole with the submission that read them, so the ring needs no per allocation bookkeeping.
+class StagingRing
+{
+public:
+    StagingRing(const Device& device, vk::DeviceSize size, vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eTransferSrc);
+    ~StagingRing();
+
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    const Buffer& getBuffer() const { return *m_buffer; }
+    vk::DeviceSize getSize() const { return m_size; }
+
+    // Returns false while too much of the ring is still read by submissions in flight, alignment is a power of 2
+    bool allocate(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset, void*& data);
+
+    // Fence for the submission that reads everything allocated since the last call. The ring owns it, it must be
+    // submitted before the next call to reclaim().
+    vk::Fence getSubmitFence();
+
+    // Frees the allocations of the submissions that completed, oldest first
+    void reclaim();
+
+    // Blocks until every submission completed and the whole ring is free
+    void waitIdle();
+
+private:
+    struct Batch
+    {
+        vk::DeviceSize  size;
+        vk::UniqueFence fence;
+    };
+
+    const Device&                   m_device;
+    std::unique_ptr<Buffer>         m_buffer;
+    uint8_t*                        m_data;
+    vk::DeviceSize                  m_size;
+    vk::DeviceSize                  m_head;     // next free byte
+    vk::DeviceSize                  m_used;     // bytes between the oldest batch in flight and m_head
+    vk::DeviceSize                  m_pending;  // bytes allocated since the last getSubmitFence()
+    std::deque<Batch>               m_batches;
+    std::vector<vk::UniqueFence>    m_freeFences;
+};
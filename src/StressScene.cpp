@@ -0,0 +1,380 @@
+#include "StressScene.h"
+#include "AccelerationStructure.h"
+#include "GraphicsObjects.h"
+#include "geometries.hpp"
+#include "math.hpp"
+#include "shaders.hpp"
+#include "utils.hpp"
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <random>
+
+// six vertices per face in coloredCubeData, the first triangle runs from the face's first corner along both edges
+const uint32 CubeFaceCount = 6;
+// room per instance, so the scene volume grows with the instance count
+const float StressInstanceSpacing = 6.0f;
+const uint32 StressBenchmarkFrames = 16;
+// offscreen target the GPU driven frames are drawn into, 16:9 like the orbit camera
+const vk::Extent2D StressRenderExtent = { 1280, 720 };
+
+// uniform in [0, 1) straight from the generator bits, the standard distributions differ between libraries
+static float random01(std::mt19937& rng)
+{
+    return float(rng() >> 8) * (1.0f / 16777216.0f);
+}
+
+static float randomRange(std::mt19937& rng, float a, float b)
+{
+    return a + (b - a) * random01(rng);
+}
+
+static glm::vec3 randomVec3(std::mt19937& rng, float a, float b)
+{
+    float x = randomRange(rng, a, b);
+    float y = randomRange(rng, a, b);
+    float z = randomRange(rng, a, b);
+    return glm::vec3(x, y, z);
+}
+
+static glm::vec3 getPosition(const VertexPC& vertex)
+{
+    return glm::vec3(vertex.x, vertex.y, vertex.z);
+}
+
+// The cube with every face split into gridSize x gridSize quads. Vertices move along the direction from the center,
+// which is the same for the copies of a corner on different faces, so the mesh stays closed.
+static void appendCubeMesh(StressScene& scene, uint32 gridSize, std::mt19937& rng)
+{
+    DrawMesh mesh;
+    mesh.firstIndex = uint32(scene.indices.size());
+    mesh.vertexOffset = int32(scene.vertices.size());
+
+    glm::vec3 frequency = randomVec3(rng, 1.0f, 4.0f);
+    glm::vec3 phase = randomVec3(rng, 0.0f, 6.2831853f);
+    float amplitude = randomRange(rng, 0.05f, 0.3f);
+    glm::vec3 tint = randomVec3(rng, 0.5f, 1.0f);
+
+    for (uint32 face = 0; face < CubeFaceCount; face++)
+    {
+        const VertexPC* corners = &coloredCubeData[face * 6];
+        glm::vec3 origin = getPosition(corners[0]);
+        glm::vec3 t = getPosition(corners[1]) - origin;
+        glm::vec3 s = getPosition(corners[2]) - origin;
+
+        uint32 base = uint32(scene.vertices.size() - mesh.vertexOffset);
+        for (uint32 j = 0; j <= gridSize; j++)
+        {
+            for (uint32 i = 0; i <= gridSize; i++)
+            {
+                glm::vec3 p = origin + s * (float(i) / gridSize) + t * (float(j) / gridSize);
+                glm::vec3 w = glm::sin(frequency * p + phase);
+                p += glm::normalize(p) * amplitude * w.x * w.y * w.z;
+                scene.vertices.push_back({ p.x, p.y, p.z, 1.0f, corners[0].r * tint.r, corners[0].g * tint.g, corners[0].b * tint.b, 1.0f });
+            }
+        }
+
+        // same winding as the two triangles of the face
+        for (uint32 j = 0; j < gridSize; j++)
+        {
+            for (uint32 i = 0; i < gridSize; i++)
+            {
+                uint32 v00 = base + j * (gridSize + 1) + i;
+                uint32 v10 = v00 + 1;
+                uint32 v01 = v00 + gridSize + 1;
+                uint32 v11 = v01 + 1;
+                scene.indices.insert(scene.indices.end(), { v00, v01, v10, v10, v01, v11 });
+            }
+        }
+    }
+
+    mesh.indexCount = uint32(scene.indices.size()) - mesh.firstIndex;
+    for (size_t i = mesh.vertexOffset; i < scene.vertices.size(); i++)
+    {
+        mesh.bounds.grow(getPosition(scene.vertices[i]));
+    }
+    scene.meshes.push_back(mesh);
+}
+
+size_t StressScene::getSizeInBytes() const
+{
+    size_t size = vertices.size() * sizeof(VertexPC) + indices.size() * sizeof(uint32) + instances.size() * sizeof(DrawInstance) +
+                  instanceTextures.size() * sizeof(uint32);
+    for (const std::vector<uint8_t>& texture : textures)
+    {
+        size += texture.size();
+    }
+    return size;
+}
+
+StressScene generateStressScene(const StressSceneSettings& settings)
+{
+    assert(settings.meshCount > 0);
+    std::mt19937 rng(settings.seed);
+    StressScene scene;
+
+    uint32 gridSize = std::max(uint32(std::lround(std::sqrt(settings.trianglesPerMesh / (2.0 * CubeFaceCount)))), 1u);
+    for (uint32 i = 0; i < settings.meshCount; i++)
+    {
+        appendCubeMesh(scene, gridSize, rng);
+    }
+
+    scene.textureSize = settings.textureSize;
+    scene.textures.resize(settings.textureCount);
+    for (std::vector<uint8_t>& texture : scene.textures)
+    {
+        std::array<uint8_t, 3> rgb0 = { uint8_t(rng()), uint8_t(rng()), uint8_t(rng()) };
+        std::array<uint8_t, 3> rgb1 = { uint8_t(rng()), uint8_t(rng()), uint8_t(rng()) };
+        vk::Extent2D extent(settings.textureSize, settings.textureSize);
+        texture.resize(size_t(extent.width) * extent.height * 4);
+        vk::su::CheckerboardImageGenerator(rgb0, rgb1)(texture.data(), extent);
+    }
+
+    float halfSide = 0.5f * StressInstanceSpacing * std::cbrt(float(settings.instanceCount));
+    scene.instances.resize(settings.instanceCount);
+    scene.instanceTextures.resize(settings.instanceCount);
+    for (uint32 i = 0; i < settings.instanceCount; i++)
+    {
+        glm::vec3 position = randomVec3(rng, -halfSide, halfSide);
+        float theta = randomRange(rng, 0.0f, 6.2831853f);
+        float z = randomRange(rng, -1.0f, 1.0f);
+        glm::vec3 axis(std::sqrt(1.0f - z * z) * std::cos(theta), std::sqrt(1.0f - z * z) * std::sin(theta), z);
+        float angle = randomRange(rng, 0.0f, 6.2831853f);
+        float scale = randomRange(rng, 0.5f, 1.5f);
+
+        DrawInstance& instance = scene.instances[i];
+        instance = {};
+        instance.transform = glm::scale(glm::rotate(glm::translate(glm::mat4x4(1.0f), position), angle, axis), glm::vec3(scale));
+        instance.meshId = rng() % settings.meshCount;
+        scene.instanceTextures[i] = settings.textureCount ? rng() % settings.textureCount : 0;
+        scene.bounds.grow(transformAabb(scene.meshes[instance.meshId].bounds, instance.transform));
+    }
+    return scene;
+}
+
+// From the center of the scene looking outwards, a full turn over the benchmark frames
+static glm::mat4x4 getOrbitViewProjection(const Aabb& bounds, uint32 frame)
+{
+    float angle = 6.2831853f * frame / StressBenchmarkFrames;
+    glm::vec3 eye = bounds.getCenter();
+    glm::vec3 direction(std::cos(angle), 0.25f, std::sin(angle));
+    float range = std::max(glm::length(bounds.getExtent()), 1.0f);
+    return vk::su::createProjectionClipMatrix(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, range) * glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// Offscreen color and depth target and the pipeline of vertexShaderText_PC_C_Instanced, shared by all steps
+struct StressRenderer
+{
+    StressRenderer(const Device& device)
+    {
+        const vk::UniqueDevice& vkDevice = device.getVKDevice();
+        vk::Format colorFormat = vk::Format::eR8G8B8A8Unorm;
+        vk::Format depthFormat = vk::su::pickDepthFormat(device.getPhysicalDevice());
+
+        colorImage = std::make_unique<Image>(device, colorFormat, StressRenderExtent, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eColorAttachment,
+                                             vk::ImageLayout::eUndefined, vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor);
+        depthBuffer = std::make_unique<DepthBuffer>(device, depthFormat, StressRenderExtent);
+        renderPass = vk::su::createRenderPass(vkDevice, colorFormat, depthFormat, vk::AttachmentLoadOp::eClear, vk::ImageLayout::eColorAttachmentOptimal);
+        vk::ImageView attachments[2] = { colorImage->getImageView().get(), depthBuffer->getImageView().get() };
+        framebuffer = vkDevice->createFramebufferUnique(vk::FramebufferCreateInfo({}, renderPass.get(), 2, attachments, StressRenderExtent.width,
+                                                                                  StressRenderExtent.height, 1));
+
+        descriptorSetLayout = vk::su::createDescriptorSetLayout(vkDevice, { { vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex },
+                                                                            { vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex },
+                                                                            { vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex } });
+        pipelineLayout = vkDevice->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo({}, 1, &descriptorSetLayout.get()));
+        descriptorPool = vk::su::createDescriptorPool(vkDevice, { { vk::DescriptorType::eUniformBuffer, 1 }, { vk::DescriptorType::eStorageBuffer, 2 } });
+        descriptorSet = std::move(vkDevice->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(descriptorPool.get(), 1, &descriptorSetLayout.get())).front());
+        uniformBuffer = std::make_unique<Buffer>(device, sizeof(glm::mat4x4), vk::BufferUsageFlagBits::eUniformBuffer);
+
+        vk::UniqueShaderModule vertexShaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eVertex, vertexShaderText_PC_C_Instanced);
+        vk::UniqueShaderModule fragmentShaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eFragment, fragmentShaderText_C_C);
+        vk::UniquePipelineCache pipelineCache = vkDevice->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+        pipeline = vk::su::createGraphicsPipeline(vkDevice, pipelineCache, std::make_pair(*vertexShaderModule, nullptr), std::make_pair(*fragmentShaderModule, nullptr),
+                                                  sizeof(VertexPC), { { vk::Format::eR32G32B32A32Sfloat, 0 }, { vk::Format::eR32G32B32A32Sfloat, 16 } },
+                                                  vk::FrontFace::eClockwise, true, pipelineLayout, renderPass);
+    }
+
+    // The culler's buffers change with every step
+    void setInstanceBuffers(const Device& device, const GpuInstanceCuller& culler)
+    {
+        vk::DescriptorBufferInfo bufferInfos[3] = { vk::DescriptorBufferInfo(uniformBuffer->getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+                                                    vk::DescriptorBufferInfo(culler.getInstanceBuffer().getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+                                                    vk::DescriptorBufferInfo(culler.getVisibleInstanceBuffer().getVKBuffer().get(), 0, VK_WHOLE_SIZE) };
+        vk::WriteDescriptorSet writes[2] = { vk::WriteDescriptorSet(descriptorSet.get(), 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &bufferInfos[0]),
+                                             vk::WriteDescriptorSet(descriptorSet.get(), 1, 0, 2, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[1]) };
+        device.getVKDevice()->updateDescriptorSets(2, writes, 0, nullptr);
+    }
+
+    std::unique_ptr<Image>          colorImage;
+    std::unique_ptr<DepthBuffer>    depthBuffer;
+    vk::UniqueRenderPass            renderPass;
+    vk::UniqueFramebuffer           framebuffer;
+    vk::UniqueDescriptorSetLayout   descriptorSetLayout;
+    vk::UniquePipelineLayout        pipelineLayout;
+    vk::UniqueDescriptorPool        descriptorPool;
+    vk::UniqueDescriptorSet         descriptorSet;
+    std::unique_ptr<Buffer>         uniformBuffer;
+    vk::UniquePipeline              pipeline;
+};
+
+// Device local copy of everything the GPU driven frames use besides the culler's buffers
+struct StressSceneUpload
+{
+    StressSceneUpload(const Device& device, const vk::UniqueCommandPool& commandPool, const StressScene& scene)
+        : sizeInBytes(0)
+    {
+        vk::BufferUsageFlags transferDst = vk::BufferUsageFlagBits::eTransferDst;
+        vertexBuffer = std::make_unique<Buffer>(device, scene.vertices.size() * sizeof(VertexPC), vk::BufferUsageFlagBits::eVertexBuffer | transferDst,
+                                                vk::MemoryPropertyFlagBits::eDeviceLocal);
+        vertexBuffer->upload(commandPool, device.getGraphicsQueue(), scene.vertices.data(), scene.vertices.size() * sizeof(VertexPC));
+        indexBuffer = std::make_unique<Buffer>(device, scene.indices.size() * sizeof(uint32), vk::BufferUsageFlagBits::eIndexBuffer | transferDst,
+                                               vk::MemoryPropertyFlagBits::eDeviceLocal);
+        indexBuffer->upload(commandPool, device.getGraphicsQueue(), scene.indices.data(), scene.indices.size() * sizeof(uint32));
+        sizeInBytes = vertexBuffer->getSize() + indexBuffer->getSize();
+
+        // the shaders do not sample them, they only take the memory a textured renderer would
+        const vk::UniqueDevice& vkDevice = device.getVKDevice();
+        vk::Extent2D extent(scene.textureSize, scene.textureSize);
+        for (const std::vector<uint8_t>& pixels : scene.textures)
+        {
+            std::unique_ptr<Image> texture = std::make_unique<Image>(device, vk::Format::eR8G8B8A8Unorm, extent, vk::ImageTiling::eOptimal,
+                                                                     vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, vk::ImageLayout::eUndefined,
+                                                                     vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor);
+            Buffer stagingBuffer(device, pixels.size(), vk::BufferUsageFlagBits::eTransferSrc);
+            stagingBuffer.upload(pixels);
+            vk::su::oneTimeSubmit(vkDevice, commandPool, device.getGraphicsQueue(), [&](const vk::UniqueCommandBuffer& commandBuffer)
+            {
+                vk::Image image = texture->getVKImage().get();
+                vk::su::setImageLayout(commandBuffer, image, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+                commandBuffer->copyBufferToImage(stagingBuffer.getVKBuffer().get(), image, vk::ImageLayout::eTransferDstOptimal,
+                                                 vk::BufferImageCopy(0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+                                                                     vk::Offset3D(0, 0, 0), vk::Extent3D(extent, 1)));
+                vk::su::setImageLayout(commandBuffer, image, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+            });
+            sizeInBytes += vkDevice->getImageMemoryRequirements(texture->getVKImage().get()).size;
+            textures.push_back(std::move(texture));
+        }
+    }
+
+    std::unique_ptr<Buffer>                 vertexBuffer;
+    std::unique_ptr<Buffer>                 indexBuffer;
+    std::vector<std::unique_ptr<Image>>     textures;
+    vk::DeviceSize                          sizeInBytes;
+};
+
+void runStressBenchmark(std::ostream& csv, const std::vector<StressSceneSettings>& steps, const Device* device)
+{
+    // the GPU columns stay empty without a device that can offset gl_InstanceIndex from indirect draws
+    bool gpu = device && device->getEnabledFeatures().drawIndirectFirstInstance;
+    vk::UniqueCommandPool commandPool;
+    vk::UniqueCommandBuffer commandBuffer;
+    std::unique_ptr<StressRenderer> renderer;
+    std::unique_ptr<GpuTimer> drawTimer;
+    if (gpu)
+    {
+        const vk::UniqueDevice& vkDevice = device->getVKDevice();
+        commandPool = vkDevice->createCommandPoolUnique(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, device->getGraphicsQueueFamilyIndex()));
+        commandBuffer = std::move(vkDevice->allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo(commandPool.get(), vk::CommandBufferLevel::ePrimary, 1)).front());
+        renderer = std::make_unique<StressRenderer>(*device);
+        drawTimer = std::make_unique<GpuTimer>(*device);
+    }
+
+    // sceneMB is the generated scene in host memory, gpuMemoryMB the buffers and textures uploaded for the GPU driven frames
+    csv << "seed,instances,meshes,trianglesPerMesh,textures,triangles,visibleInstances,sceneMB,gpuMemoryMB,generateMs,cpuFrameMs,gpuDrivenCpuMs,gpuCullMs,gpuDrawMs\n";
+    for (const StressSceneSettings& settings : steps)
+    {
+        Timer timer;
+        StressScene scene = generateStressScene(settings);
+        double generateMilliseconds = timer.getElapsedMilliseconds();
+
+        uint64 triangles = 0;
+        for (const DrawInstance& instance : scene.instances)
+        {
+            triangles += scene.meshes[instance.meshId].indexCount / 3;
+        }
+
+        // CPU culled frame: frustum test of every instance and the draw list, what a renderer without GPU culling records
+        std::vector<vk::DrawIndexedIndirectCommand> commands;
+        std::vector<uint32> visibleInstances;
+        uint64 visibleCount = 0;
+        timer.reset();
+        for (uint32 frame = 0; frame < StressBenchmarkFrames; frame++)
+        {
+            visibleCount += cullInstances(scene.meshes, scene.instances, Frustum::fromMatrix(getOrbitViewProjection(scene.bounds, frame)), commands, visibleInstances);
+        }
+        double cpuFrameMilliseconds = timer.getElapsedMilliseconds() / StressBenchmarkFrames;
+
+        double gpuDrivenCpuMilliseconds = 0.0;
+        double gpuCullMilliseconds = 0.0;
+        double gpuDrawMilliseconds = 0.0;
+        vk::DeviceSize gpuMemoryBytes = 0;
+        if (gpu && settings.instanceCount > 0)
+        {
+            StressSceneUpload upload(*device, commandPool, scene);
+            GpuInstanceCuller culler(*device, commandPool, scene.meshes, settings.instanceCount);
+            culler.setInstances(scene.instances);
+            renderer->setInstanceBuffers(*device, culler);
+            gpuMemoryBytes = upload.sizeInBytes + culler.getInstanceBuffer().getSize() + culler.getVisibleInstanceBuffer().getSize() +
+                             culler.getDrawCommandBuffer().getSize();
+
+            vk::ClearValue clearValues[2];
+            clearValues[0].color = vk::ClearColorValue(std::array<float, 4>({ 0.2f, 0.2f, 0.2f, 0.2f }));
+            clearValues[1].depthStencil = vk::ClearDepthStencilValue(1.0f, 0);
+            for (uint32 frame = 0; frame < StressBenchmarkFrames; frame++)
+            {
+                glm::mat4x4 viewProjection = getOrbitViewProjection(scene.bounds, frame);
+                timer.reset();
+                renderer->uniformBuffer->upload(viewProjection);
+                commandBuffer->begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+                culler.record(commandBuffer, viewProjection);
+
+                drawTimer->reset(commandBuffer);
+                drawTimer->begin(commandBuffer);
+                commandBuffer->beginRenderPass(vk::RenderPassBeginInfo(renderer->renderPass.get(), renderer->framebuffer.get(),
+                                                                       vk::Rect2D(vk::Offset2D(0, 0), StressRenderExtent), 2, clearValues),
+                                               vk::SubpassContents::eInline);
+                commandBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, renderer->pipeline.get());
+                commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, renderer->pipelineLayout.get(), 0, renderer->descriptorSet.get(), nullptr);
+                commandBuffer->bindVertexBuffers(0, upload.vertexBuffer->getVKBuffer().get(), { 0 });
+                commandBuffer->bindIndexBuffer(upload.indexBuffer->getVKBuffer().get(), 0, vk::IndexType::eUint32);
+                commandBuffer->setViewport(0, vk::Viewport(0.0f, 0.0f, float(StressRenderExtent.width), float(StressRenderExtent.height), 0.0f, 1.0f));
+                commandBuffer->setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), StressRenderExtent));
+                culler.recordDraw(commandBuffer);
+                commandBuffer->endRenderPass();
+                drawTimer->end(commandBuffer);
+                commandBuffer->end();
+                device->getGraphicsQueue().submit(vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer.get()), nullptr);
+                gpuDrivenCpuMilliseconds += timer.getElapsedMilliseconds();
+
+                device->getGraphicsQueue().waitIdle();
+                double milliseconds = 0.0;
+                culler.getLastCullMilliseconds(milliseconds);
+                gpuCullMilliseconds += milliseconds;
+                drawTimer->getMilliseconds(0, milliseconds);
+                gpuDrawMilliseconds += milliseconds;
+            }
+            gpuDrivenCpuMilliseconds /= StressBenchmarkFrames;
+            gpuCullMilliseconds /= StressBenchmarkFrames;
+            gpuDrawMilliseconds /= StressBenchmarkFrames;
+        }
+
+        csv << settings.seed << ',' << settings.instanceCount << ',' << settings.meshCount << ',' << scene.meshes[0].indexCount / 3 << ','
+            << settings.textureCount << ',' << triangles << ',' << visibleCount / StressBenchmarkFrames << ','
+            << std::fixed << std::setprecision(3) << scene.getSizeInBytes() / (1024.0 * 1024.0) << ',';
+        if (gpu)
+        {
+            csv << gpuMemoryBytes / (1024.0 * 1024.0);
+        }
+        csv << ',' << generateMilliseconds << ',' << cpuFrameMilliseconds << ',';
+        if (gpu)
+        {
+            csv << gpuDrivenCpuMilliseconds << ',' << gpuCullMilliseconds << ',' << gpuDrawMilliseconds;
+        }
+        else
+        {
+            csv << ",,";
+        }
+        csv << std::defaultfloat << "\n";
+    }
+}
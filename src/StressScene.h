@@ -0,0 +1,43 @@
+#pragma once
+
+#include "InstanceCulling.h"
+#include <iosfwd>
+
+struct VertexPC;
+
+// Parameters of a generated scene, the same settings give the same scene on every platform
+struct StressSceneSettings
+{
+    uint32  seed = 1;
+    uint32  instanceCount = 1000;
+    uint32  meshCount = 16;
+    uint32  trianglesPerMesh = 768;     // rounded to the nearest 12 n^2, n quads along each edge of the cube
+    uint32  textureCount = 8;
+    uint32  textureSize = 256;
+};
+
+// Variations of the cube from geometries.hpp: every face split into a grid and displaced, scattered as instances
+// through a volume that grows with the instance count so the density stays the same.
+struct StressScene
+{
+    std::vector<VertexPC>               vertices;           // of all meshes, DrawMesh::vertexOffset says where each starts
+    std::vector<uint32>                 indices;
+    std::vector<DrawMesh>               meshes;
+    std::vector<DrawInstance>           instances;
+    std::vector<uint32>                 instanceTextures;   // texture of each instance
+    std::vector<std::vector<uint8_t>>   textures;           // RGBA8 checkerboards, textureSize x textureSize
+    uint32                              textureSize = 0;
+    Aabb                                bounds;
+
+    // Everything a renderer uploads
+    size_t getSizeInBytes() const;
+};
+
+StressScene generateStressScene(const StressSceneSettings& settings);
+
+// Headless scaling benchmark: generates a scene for every entry of steps and writes one CSV row each, with the CPU
+// time of a frame that culls on the CPU. With a device the scene is uploaded and every frame is also rendered GPU
+// driven into an offscreen target: the row adds the device memory of the uploaded buffers and textures, the CPU time
+// to record and submit the culling pass and the indirect draws, and the GPU time of each. Times are averages over an
+// orbiting camera.
+void runStressBenchmark(std::ostream& csv, const std::vector<StressSceneSettings>& steps, const Device* device = nullptr);
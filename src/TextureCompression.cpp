@@ -0,0 +1,711 @@
+#include "TextureCompression.h"
+#include "Mipmaps.h"
+#include "Profiling.h"
+#include "ThreadPool.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <immintrin.h>
+
+// The pixels of a block by channel, so four pixels of a channel fill one SSE register
+struct alignas(16) BlockPixels
+{
+    float channels[4][16];
+};
+
+// BC7 interpolation weights of 4 bit indices, in 64ths
+static const int Bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+bool isBlockCompressed(vk::Format format)
+{
+    return format == vk::Format::eBc1RgbUnormBlock || format == vk::Format::eBc4UnormBlock || format == vk::Format::eBc5UnormBlock ||
+           format == vk::Format::eBc7UnormBlock;
+}
+
+size_t getBlockSize(vk::Format format)
+{
+    assert(isBlockCompressed(format));
+    return format == vk::Format::eBc1RgbUnormBlock || format == vk::Format::eBc4UnormBlock ? 8 : 16;
+}
+
+size_t getImageSize(vk::Format format, const vk::Extent2D& extent)
+{
+    if (!isBlockCompressed(format))
+    {
+        assert(format == vk::Format::eR8G8B8A8Unorm);
+        return size_t(extent.width) * extent.height * 4;
+    }
+    return size_t((extent.width + 3) / 4) * ((extent.height + 3) / 4) * getBlockSize(format);
+}
+
+bool isBlockFormatSupported(const vk::PhysicalDevice& physicalDevice, vk::Format format)
+{
+    return physicalDevice.getFeatures().textureCompressionBC &&
+           (physicalDevice.getFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage);
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+static void loadBlock(const uint8_t* rgba, const vk::Extent2D& extent, uint32 blockX, uint32 blockY, BlockPixels& block)
+{
+    for (uint32 i = 0; i < 16; i++)
+    {
+        uint32 x = std::min(blockX * 4 + i % 4, extent.width - 1);
+        uint32 y = std::min(blockY * 4 + i / 4, extent.height - 1);
+        const uint8_t* pixel = rgba + (size_t(y) * extent.width + x) * 4;
+        for (int c = 0; c < 4; c++)
+        {
+            block.channels[c][i] = pixel[c];
+        }
+    }
+}
+
+// Nearest palette entry of every pixel over the channels [firstChannel, firstChannel + channelCount), four pixels
+// at a time. Returns the squared error.
+static float selectIndices(const BlockPixels& block, int firstChannel, int channelCount, const float palette[][4], int paletteSize, uint8_t indices[16])
+{
+    float error = 0.0f;
+    for (int group = 0; group < 16; group += 4)
+    {
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i bestIndex = _mm_setzero_si128();
+        for (int i = 0; i < paletteSize; i++)
+        {
+            __m128 distance = _mm_setzero_ps();
+            for (int c = 0; c < channelCount; c++)
+            {
+                __m128 d = _mm_sub_ps(_mm_load_ps(&block.channels[firstChannel + c][group]), _mm_set1_ps(palette[i][c]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+            }
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+            bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(i)));
+            best = _mm_min_ps(distance, best);
+        }
+
+        alignas(16) int32 groupIndices[4];
+        alignas(16) float groupErrors[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(groupIndices), bestIndex);
+        _mm_store_ps(groupErrors, best);
+        for (int k = 0; k < 4; k++)
+        {
+            indices[group + k] = uint8_t(groupIndices[k]);
+            error += groupErrors[k];
+        }
+    }
+    return error;
+}
+
+// Ends of the line the block's colors get projected on. Fast takes the bounding box, with the channels that fall
+// while the widest one rises flipped. The others take the principal axis through the mean.
+static void fitEndpoints(const BlockPixels& block, int firstChannel, int channelCount, CompressionQuality quality, float endpoints[2][4])
+{
+    float minimum[4], maximum[4], mean[4];
+    int widest = 0;
+    for (int c = 0; c < channelCount; c++)
+    {
+        const float* values = block.channels[firstChannel + c];
+        minimum[c] = *std::min_element(values, values + 16);
+        maximum[c] = *std::max_element(values, values + 16);
+        mean[c] = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            mean[c] += values[i] / 16.0f;
+        }
+        if (maximum[c] - minimum[c] > maximum[widest] - minimum[widest])
+        {
+            widest = c;
+        }
+    }
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c0 = 0; c0 < channelCount; c0++)
+        {
+            for (int c1 = 0; c1 < channelCount; c1++)
+            {
+                covariance[c0][c1] += (block.channels[firstChannel + c0][i] - mean[c0]) * (block.channels[firstChannel + c1][i] - mean[c1]);
+            }
+        }
+    }
+
+    if (quality == CompressionQuality::Fast)
+    {
+        for (int c = 0; c < channelCount; c++)
+        {
+            // inset by a 16th of the range, the ends of the box are rarely hit exactly
+            float inset = (maximum[c] - minimum[c]) / 16.0f;
+            bool falling = covariance[widest][c] < 0.0f;
+            endpoints[0][c] = falling ? maximum[c] - inset : minimum[c] + inset;
+            endpoints[1][c] = falling ? minimum[c] + inset : maximum[c] - inset;
+        }
+        return;
+    }
+
+    float axis[4];
+    for (int c = 0; c < channelCount; c++)
+    {
+        axis[c] = covariance[widest][c];
+    }
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float largest = 0.0f;
+        for (int c0 = 0; c0 < channelCount; c0++)
+        {
+            for (int c1 = 0; c1 < channelCount; c1++)
+            {
+                next[c0] += covariance[c0][c1] * axis[c1];
+            }
+            largest = std::max(largest, std::abs(next[c0]));
+        }
+        if (largest == 0.0f)
+        {
+            break;
+        }
+        for (int c = 0; c < channelCount; c++)
+        {
+            axis[c] = next[c] / largest;
+        }
+    }
+
+    float lengthSquared = 0.0f;
+    for (int c = 0; c < channelCount; c++)
+    {
+        lengthSquared += axis[c] * axis[c];
+    }
+    float tMin = 0.0f, tMax = 0.0f;
+    if (lengthSquared > 0.0f)
+    {
+        tMin = FLT_MAX;
+        tMax = -FLT_MAX;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = 0.0f;
+            for (int c = 0; c < channelCount; c++)
+            {
+                t += (block.channels[firstChannel + c][i] - mean[c]) * axis[c];
+            }
+            tMin = std::min(tMin, t / lengthSquared);
+            tMax = std::max(tMax, t / lengthSquared);
+        }
+    }
+    for (int c = 0; c < channelCount; c++)
+    {
+        endpoints[0][c] = clamp(mean[c] + axis[c] * tMin, 0.0f, 255.0f);
+        endpoints[1][c] = clamp(mean[c] + axis[c] * tMax, 0.0f, 255.0f);
+    }
+}
+
+// Endpoints with the least squared error when pixel i sits at weights[i] between them
+static void refineEndpoints(const BlockPixels& block, int firstChannel, int channelCount, const float weights[16], float endpoints[2][4])
+{
+    float a = 0.0f, b = 0.0f, c = 0.0f;
+    float x[4] = {}, y[4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        float t = weights[i];
+        a += (1.0f - t) * (1.0f - t);
+        b += (1.0f - t) * t;
+        c += t * t;
+        for (int ch = 0; ch < channelCount; ch++)
+        {
+            x[ch] += (1.0f - t) * block.channels[firstChannel + ch][i];
+            y[ch] += t * block.channels[firstChannel + ch][i];
+        }
+    }
+
+    float determinant = a * c - b * b;
+    if (std::abs(determinant) < 1e-6f)
+    {
+        return;
+    }
+    for (int ch = 0; ch < channelCount; ch++)
+    {
+        endpoints[0][ch] = clamp((c * x[ch] - b * y[ch]) / determinant, 0.0f, 255.0f);
+        endpoints[1][ch] = clamp((a * y[ch] - b * x[ch]) / determinant, 0.0f, 255.0f);
+    }
+}
+
+static int getRefinementCount(CompressionQuality quality)
+{
+    return quality == CompressionQuality::Fast ? 0 : quality == CompressionQuality::Normal ? 1 : 3;
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+static uint16 packRgb565(const float color[4])
+{
+    uint32 r = uint32(std::lround(color[0] * 31.0f / 255.0f));
+    uint32 g = uint32(std::lround(color[1] * 63.0f / 255.0f));
+    uint32 b = uint32(std::lround(color[2] * 31.0f / 255.0f));
+    return uint16((r << 11) | (g << 5) | b);
+}
+
+static void unpackRgb565(uint16 packed, float color[4])
+{
+    uint32 r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = float((r << 3) | (r >> 2));
+    color[1] = float((g << 2) | (g >> 4));
+    color[2] = float((b << 3) | (b >> 2));
+    color[3] = 255.0f;
+}
+
+// Always the four color mode, with color 0 above color 1. Equal colors select index 0 everywhere.
+static void encodeBc1(const BlockPixels& block, CompressionQuality quality, uint8_t* output)
+{
+    const float IndexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    float endpoints[2][4];
+    fitEndpoints(block, 0, 3, quality, endpoints);
+
+    float bestError = FLT_MAX;
+    uint16 bestColors[2];
+    uint8_t bestIndices[16];
+    for (int iteration = 0; ; iteration++)
+    {
+        uint16 colors[2] = { packRgb565(endpoints[0]), packRgb565(endpoints[1]) };
+        if (colors[0] < colors[1])
+        {
+            std::swap(colors[0], colors[1]);
+            std::swap(endpoints[0], endpoints[1]);
+        }
+
+        float palette[4][4];
+        unpackRgb565(colors[0], palette[0]);
+        unpackRgb565(colors[1], palette[1]);
+        for (int c = 0; c < 4; c++)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+
+        uint8_t indices[16];
+        float error = selectIndices(block, 0, 3, palette, 4, indices);
+        if (error < bestError)
+        {
+            bestError = error;
+            bestColors[0] = colors[0];
+            bestColors[1] = colors[1];
+            memcpy(bestIndices, indices, 16);
+        }
+        if (iteration == getRefinementCount(quality))
+        {
+            break;
+        }
+
+        float weights[16];
+        for (int i = 0; i < 16; i++)
+        {
+            weights[i] = IndexWeights[indices[i]];
+        }
+        refineEndpoints(block, 0, 3, weights, endpoints);
+    }
+
+    uint32 indexBits = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        indexBits |= uint32(bestColors[0] == bestColors[1] ? 0 : bestIndices[i]) << (2 * i);
+    }
+    memcpy(output, bestColors, 4);
+    memcpy(output + 4, &indexBits, 4);
+}
+
+// Always the eight value mode, red 0 above red 1
+static void encodeBc4(const BlockPixels& block, int channel, CompressionQuality quality, uint8_t* output)
+{
+    const float* values = block.channels[channel];
+    float endpoints[2][4] = { { *std::max_element(values, values + 16) }, { *std::min_element(values, values + 16) } };
+
+    float bestError = FLT_MAX;
+    int bestEnds[2];
+    uint8_t bestIndices[16];
+    for (int iteration = 0; ; iteration++)
+    {
+        int ends[2] = { clamp(int(std::lround(endpoints[0][0])), 0, 255), clamp(int(std::lround(endpoints[1][0])), 0, 255) };
+        if (ends[0] < ends[1])
+        {
+            std::swap(ends[0], ends[1]);
+            std::swap(endpoints[0], endpoints[1]);
+        }
+
+        float palette[8][4];
+        palette[0][0] = float(ends[0]);
+        palette[1][0] = float(ends[1]);
+        for (int i = 2; i < 8; i++)
+        {
+            palette[i][0] = ((8 - i) * ends[0] + (i - 1) * ends[1]) / 7.0f;
+        }
+
+        uint8_t indices[16];
+        float error = selectIndices(block, channel, 1, palette, 8, indices);
+        if (error < bestError)
+        {
+            bestError = error;
+            bestEnds[0] = ends[0];
+            bestEnds[1] = ends[1];
+            memcpy(bestIndices, indices, 16);
+        }
+        if (iteration == getRefinementCount(quality))
+        {
+            break;
+        }
+
+        float weights[16];
+        for (int i = 0; i < 16; i++)
+        {
+            weights[i] = indices[i] < 2 ? float(indices[i]) : (indices[i] - 1) / 7.0f;
+        }
+        refineEndpoints(block, channel, 1, weights, endpoints);
+    }
+
+    uint64 indexBits = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        indexBits |= uint64(bestIndices[i]) << (3 * i);
+    }
+    output[0] = uint8_t(bestEnds[0]);
+    output[1] = uint8_t(bestEnds[1]);
+    memcpy(output + 2, &indexBits, 6);
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+// Least significant bit first, as BC7 blocks are laid out
+struct BitWriter
+{
+    uint8_t*    output;
+    uint32      position;
+
+    void write(uint32 value, uint32 bitCount)
+    {
+        for (uint32 i = 0; i < bitCount; i++, position++)
+        {
+            output[position >> 3] |= uint8_t(((value >> i) & 1) << (position & 7));
+        }
+    }
+};
+
+struct Bc7Endpoints
+{
+    int     quantized[2][4];    // 7 bits
+    int     pbits[2];
+};
+
+static float evaluateBc7(const BlockPixels& block, const float endpoints[2][4], const int pbits[2], Bc7Endpoints& result, uint8_t indices[16])
+{
+    int ends[2][4];
+    for (int e = 0; e < 2; e++)
+    {
+        result.pbits[e] = pbits[e];
+        for (int c = 0; c < 4; c++)
+        {
+            result.quantized[e][c] = clamp(int(std::lround((endpoints[e][c] - pbits[e]) / 2.0f)), 0, 127);
+            ends[e][c] = result.quantized[e][c] * 2 + pbits[e];
+        }
+    }
+
+    float palette[16][4];
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            palette[i][c] = float(((64 - Bc7Weights[i]) * ends[0][c] + Bc7Weights[i] * ends[1][c] + 32) >> 6);
+        }
+    }
+    return selectIndices(block, 0, 4, palette, 16, indices);
+}
+
+// The p-bit that loses least when the endpoint drops to 7 bits
+static int choosePbit(const float endpoint[4])
+{
+    float errors[2] = {};
+    for (int pbit = 0; pbit < 2; pbit++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            float d = endpoint[c] - (clamp(int(std::lround((endpoint[c] - pbit) / 2.0f)), 0, 127) * 2 + pbit);
+            errors[pbit] += d * d;
+        }
+    }
+    return errors[1] < errors[0] ? 1 : 0;
+}
+
+static void encodeBc7(const BlockPixels& block, CompressionQuality quality, uint8_t* output)
+{
+    float endpoints[2][4];
+    fitEndpoints(block, 0, 4, quality, endpoints);
+
+    float bestError = FLT_MAX;
+    Bc7Endpoints best;
+    uint8_t bestIndices[16];
+    for (int iteration = 0; ; iteration++)
+    {
+        int candidates[4][2] = { { choosePbit(endpoints[0]), choosePbit(endpoints[1]) }, { 0, 0 }, { 0, 1 }, { 1, 0 } };
+        int candidateCount = quality == CompressionQuality::High ? 4 : 1;
+        if (quality == CompressionQuality::High)
+        {
+            candidates[0][0] = candidates[0][1] = 1;
+        }
+        for (int candidate = 0; candidate < candidateCount; candidate++)
+        {
+            Bc7Endpoints quantized;
+            uint8_t indices[16];
+            float error = evaluateBc7(block, endpoints, candidates[candidate], quantized, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                best = quantized;
+                memcpy(bestIndices, indices, 16);
+            }
+        }
+        if (iteration == getRefinementCount(quality))
+        {
+            break;
+        }
+
+        float weights[16];
+        for (int i = 0; i < 16; i++)
+        {
+            weights[i] = Bc7Weights[bestIndices[i]] / 64.0f;
+        }
+        refineEndpoints(block, 0, 4, weights, endpoints);
+    }
+
+    // the first index is stored without its top bit, which therefore has to be 0
+    if (bestIndices[0] >= 8)
+    {
+        std::swap(best.quantized[0], best.quantized[1]);
+        std::swap(best.pbits[0], best.pbits[1]);
+        for (int i = 0; i < 16; i++)
+        {
+            bestIndices[i] = uint8_t(15 - bestIndices[i]);
+        }
+    }
+
+    memset(output, 0, 16);
+    BitWriter writer = { output, 0 };
+    writer.write(1 << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        writer.write(best.quantized[0][c], 7);
+        writer.write(best.quantized[1][c], 7);
+    }
+    writer.write(best.pbits[0], 1);
+    writer.write(best.pbits[1], 1);
+    writer.write(bestIndices[0], 3);
+    for (int i = 1; i < 16; i++)
+    {
+        writer.write(bestIndices[i], 4);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+void compressImage(const uint8_t* rgba, const vk::Extent2D& extent, vk::Format format, CompressionQuality quality, uint8_t* blocks)
+{
+    const uint32 blocksX = (extent.width + 3) / 4;
+    const uint32 blocksY = (extent.height + 3) / 4;
+    const size_t blockSize = getBlockSize(format);
+
+    ThreadPool::getInstance().parallelFor(blocksY, [&](uint32 blockY)
+    {
+        BlockPixels block;
+        for (uint32 blockX = 0; blockX < blocksX; blockX++)
+        {
+            loadBlock(rgba, extent, blockX, blockY, block);
+            uint8_t* output = blocks + (size_t(blockY) * blocksX + blockX) * blockSize;
+            switch (format)
+            {
+            case vk::Format::eBc1RgbUnormBlock:
+                encodeBc1(block, quality, output);
+                break;
+            case vk::Format::eBc4UnormBlock:
+                encodeBc4(block, 0, quality, output);
+                break;
+            case vk::Format::eBc5UnormBlock:
+                encodeBc4(block, 0, quality, output);
+                encodeBc4(block, 1, quality, output + 8);
+                break;
+            default:
+                encodeBc7(block, quality, output);
+                break;
+            }
+        }
+    });
+}
+
+void compressMipChain(const uint8_t* chain, const vk::Extent2D& extent, uint32 levelCount, vk::Format format, CompressionQuality quality, uint8_t* blocks)
+{
+    for (uint32 level = 0; level < levelCount; level++)
+    {
+        vk::Extent2D levelExtent = getMipExtent(extent, level);
+        compressImage(chain, levelExtent, format, quality, blocks);
+        chain += getImageSize(vk::Format::eR8G8B8A8Unorm, levelExtent);
+        blocks += getImageSize(format, levelExtent);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+// Decoders for what the encoders above write, only used to measure the error
+
+static void decodeBc4(const uint8_t* input, int channel, uint8_t pixels[16][4])
+{
+    int ends[2] = { input[0], input[1] };
+    int palette[8] = { ends[0], ends[1] };
+    for (int i = 2; i < 8; i++)
+    {
+        palette[i] = ends[0] > ends[1] ? ((8 - i) * ends[0] + (i - 1) * ends[1] + 3) / 7 : i < 6 ? ((6 - i) * ends[0] + (i - 1) * ends[1] + 2) / 5 : (i == 6 ? 0 : 255);
+    }
+    uint64 indexBits = 0;
+    memcpy(&indexBits, input + 2, 6);
+    for (int i = 0; i < 16; i++)
+    {
+        pixels[i][channel] = uint8_t(palette[(indexBits >> (3 * i)) & 7]);
+    }
+}
+
+static void decodeBlock(const uint8_t* input, vk::Format format, uint8_t pixels[16][4])
+{
+    memset(pixels, 0, 16 * 4);
+    for (int i = 0; i < 16; i++)
+    {
+        pixels[i][3] = 255;
+    }
+
+    if (format == vk::Format::eBc1RgbUnormBlock)
+    {
+        uint16 colors[2];
+        uint32 indexBits;
+        memcpy(colors, input, 4);
+        memcpy(&indexBits, input + 4, 4);
+        float palette[4][4];
+        unpackRgb565(colors[0], palette[0]);
+        unpackRgb565(colors[1], palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = colors[0] > colors[1] ? (2.0f * palette[0][c] + palette[1][c]) / 3.0f : (palette[0][c] + palette[1][c]) / 2.0f;
+            palette[3][c] = colors[0] > colors[1] ? (palette[0][c] + 2.0f * palette[1][c]) / 3.0f : 0.0f;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                pixels[i][c] = uint8_t(std::lround(palette[(indexBits >> (2 * i)) & 3][c]));
+            }
+        }
+    }
+    else if (format == vk::Format::eBc4UnormBlock)
+    {
+        decodeBc4(input, 0, pixels);
+    }
+    else if (format == vk::Format::eBc5UnormBlock)
+    {
+        decodeBc4(input, 0, pixels);
+        decodeBc4(input + 8, 1, pixels);
+    }
+    else
+    {
+        assert((input[0] & 0x7f) == 1 << 6);
+        uint32 position = 7;
+        auto read = [&](uint32 bitCount)
+        {
+            uint32 value = 0;
+            for (uint32 i = 0; i < bitCount; i++, position++)
+            {
+                value |= uint32((input[position >> 3] >> (position & 7)) & 1) << i;
+            }
+            return value;
+        };
+        int ends[2][4];
+        for (int c = 0; c < 4; c++)
+        {
+            ends[0][c] = read(7) << 1;
+            ends[1][c] = read(7) << 1;
+        }
+        uint32 pbits[2] = { read(1), read(1) };
+        for (int c = 0; c < 4; c++)
+        {
+            ends[0][c] |= pbits[0];
+            ends[1][c] |= pbits[1];
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            uint32 index = read(i == 0 ? 3 : 4);
+            for (int c = 0; c < 4; c++)
+            {
+                pixels[i][c] = uint8_t(((64 - Bc7Weights[index]) * ends[0][c] + Bc7Weights[index] * ends[1][c] + 32) >> 6);
+            }
+        }
+    }
+}
+
+// Over the channels format stores
+static double getPsnr(const uint8_t* rgba, const vk::Extent2D& extent, vk::Format format, const uint8_t* blocks)
+{
+    int channelCount = format == vk::Format::eBc1RgbUnormBlock ? 3 : format == vk::Format::eBc4UnormBlock ? 1 : format == vk::Format::eBc5UnormBlock ? 2 : 4;
+    const uint32 blocksX = (extent.width + 3) / 4;
+    double squaredError = 0.0;
+    for (uint32 y = 0; y < extent.height; y += 4)
+    {
+        for (uint32 x = 0; x < extent.width; x += 4)
+        {
+            uint8_t pixels[16][4];
+            decodeBlock(blocks + (size_t(y / 4) * blocksX + x / 4) * getBlockSize(format), format, pixels);
+            for (uint32 i = 0; i < 16; i++)
+            {
+                if (x + i % 4 < extent.width && y + i / 4 < extent.height)
+                {
+                    const uint8_t* pixel = rgba + ((size_t(y) + i / 4) * extent.width + x + i % 4) * 4;
+                    for (int c = 0; c < channelCount; c++)
+                    {
+                        double d = double(pixel[c]) - pixels[i][c];
+                        squaredError += d * d;
+                    }
+                }
+            }
+        }
+    }
+    double meanSquaredError = squaredError / (double(extent.width) * extent.height * channelCount);
+    return meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : 99.0;
+}
+
+void printCompressionBenchmark(std::ostream& os, uint32 size)
+{
+    // smooth gradients with a little noise, closer to photographs than a checkerboard
+    vk::Extent2D extent(size, size);
+    std::vector<uint8_t> rgba(size_t(size) * size * 4);
+    std::mt19937 rng(1);
+    for (uint32 y = 0; y < size; y++)
+    {
+        for (uint32 x = 0; x < size; x++)
+        {
+            uint8_t* pixel = &rgba[(size_t(y) * size + x) * 4];
+            pixel[0] = uint8_t(clamp(128.0f + 100.0f * std::sin(x * 0.02f) + int(rng() & 15) - 8, 0.0f, 255.0f));
+            pixel[1] = uint8_t(clamp(128.0f + 100.0f * std::cos(y * 0.015f) + int(rng() & 15) - 8, 0.0f, 255.0f));
+            pixel[2] = uint8_t((x + y) * 255 / (2 * size));
+            pixel[3] = uint8_t(clamp(255.0f * x / size + int(rng() & 7) - 4, 0.0f, 255.0f));
+        }
+    }
+
+    double megapixels = double(size) * size / 1e6;
+    os << std::fixed << std::setprecision(2) << size << " x " << size << ", " << rgba.size() / (1024.0 * 1024.0) << " MB as RGBA8\n";
+    const char* qualityNames[] = { "fast", "normal", "high" };
+    for (vk::Format format : { vk::Format::eBc1RgbUnormBlock, vk::Format::eBc4UnormBlock, vk::Format::eBc5UnormBlock, vk::Format::eBc7UnormBlock })
+    {
+        std::vector<uint8_t> blocks(getImageSize(format, extent));
+        for (CompressionQuality quality : { CompressionQuality::Fast, CompressionQuality::Normal, CompressionQuality::High })
+        {
+            Timer timer;
+            compressImage(rgba.data(), extent, format, quality, blocks.data());
+            double milliseconds = timer.getElapsedMilliseconds();
+            os << vk::to_string(format) << " " << qualityNames[int(quality)] << ": " << milliseconds << " ms, " << megapixels / (milliseconds / 1000.0)
+               << " MP/s, " << getPsnr(rgba.data(), extent, format, blocks.data()) << " dB, " << double(rgba.size()) / blocks.size() << ":1\n";
+        }
+    }
+    os << std::defaultfloat;
+}
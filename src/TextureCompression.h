@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Common.h"
+#include <vulkan/vulkan.hpp>
+#include <iosfwd>
+
+// Block compression of RGBA8 images into 4 x 4 pixel blocks:
+//   eBc1RgbUnormBlock  8 bytes, RGB from two 565 endpoints
+//   eBc4UnormBlock     8 bytes, red only, for masks and height maps
+//   eBc5UnormBlock     16 bytes, red and green as two BC4 blocks, for normal maps
+//   eBc7UnormBlock     16 bytes, RGBA, always mode 6: one subset with 7 bit endpoints, a p-bit each and 4 bit indices
+enum class CompressionQuality
+{
+    Fast,       // endpoints from the bounding box of each block
+    Normal,     // principal axis endpoints refined once by least squares
+    High,       // more refinement, and for BC7 every p-bit combination
+};
+
+bool isBlockCompressed(vk::Format format);
+size_t getBlockSize(vk::Format format);
+
+// Bytes of one level of format, for RGBA8 and the block formats above
+size_t getImageSize(vk::Format format, const vk::Extent2D& extent);
+
+// Whether the device can sample format from optimal tiling, which needs the textureCompressionBC feature
+bool isBlockFormatSupported(const vk::PhysicalDevice& physicalDevice, vk::Format format);
+
+// Block rows are encoded in parallel on the shared ThreadPool. Blocks along the right and bottom edges of sizes
+// that are not multiples of 4 repeat the edge pixels.
+void compressImage(const uint8_t* rgba, const vk::Extent2D& extent, vk::Format format, CompressionQuality quality, uint8_t* blocks);
+
+// The levels of a chain laid out as generateMipChain writes it, compressed one after the other
+void compressMipChain(const uint8_t* chain, const vk::Extent2D& extent, uint32 levelCount, vk::Format format, CompressionQuality quality, uint8_t* blocks);
+
+// Encode throughput in MP/s and PSNR of every format and quality for a generated size x size image
+void printCompressionBenchmark(std::ostream& os, uint32 size);
@@ -0,0 +1,590 @@
+#include "TextureStreamer.h"
+#include "GraphicsObjects.h"
+#include "Mipmaps.h"
+#include "StagingRing.h"
+#include "TextureCompression.h"
+#include "Profiling.h"
+#include "geometries.hpp"
+#include "math.hpp"
+#include "shaders.hpp"
+#include "utils.hpp"
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+
+// Loads in progress at once, each holds its old and its new image
+static const uint32 MaxLoadCount = 4;
+
+static const size_t PrefetchPageSize = 4096;
+
+static const uint32 StreamingBenchmarkFrames = 240;
+static const vk::Extent2D StreamingRenderExtent = { 1280, 720 };
+
+bool TextureStreamer::isSupported(const Device& device)
+{
+    return device.getEnabledFeatures().fragmentStoresAndAtomics;
+}
+
+TextureStreamer::TextureStreamer(const Device& device, vk::DeviceSize budget, uint32 maxTextureCount)
+    : m_device(device)
+    , m_budget(budget)
+    , m_maxTextureCount(maxTextureCount)
+    , m_residentBytes(0)
+    , m_retiredBytes(0)
+    , m_frame(0)
+    , m_uploadedBytes(0)
+    , m_evictedBytes(0)
+    , m_imagesReplaced(false)
+    , m_quit(false)
+{
+    assert(isSupported(device));
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+
+    vk::DeviceSize bufferSize = vk::DeviceSize(maxTextureCount) * sizeof(uint32);
+    m_feedbackBuffer = std::make_unique<Buffer>(device, bufferSize, vk::BufferUsageFlagBits::eStorageBuffer);
+    m_residencyBuffer = std::make_unique<Buffer>(device, bufferSize, vk::BufferUsageFlagBits::eStorageBuffer);
+    m_feedback = static_cast<uint32*>(vkDevice->mapMemory(m_feedbackBuffer->getDeviceMemory().get(), 0, bufferSize));
+    m_residency = static_cast<uint32*>(vkDevice->mapMemory(m_residencyBuffer->getDeviceMemory().get(), 0, bufferSize));
+    std::fill(m_feedback, m_feedback + maxTextureCount, ~0u);
+    std::fill(m_residency, m_residency + maxTextureCount, 0u);
+
+    m_prefetchThread = std::thread(&TextureStreamer::prefetchLoop, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wakeCondition.notify_all();
+    m_prefetchThread.join();
+
+    const vk::UniqueDevice& vkDevice = m_device.getVKDevice();
+    vkDevice->unmapMemory(m_feedbackBuffer->getDeviceMemory().get());
+    vkDevice->unmapMemory(m_residencyBuffer->getDeviceMemory().get());
+}
+
+uint32 TextureStreamer::addTexture(const string& path)
+{
+    if (m_textures.size() == m_maxTextureCount)
+    {
+        return ~0u;
+    }
+
+    std::unique_ptr<StreamedTexture> texture = std::make_unique<StreamedTexture>();
+    if (!texture->file.open(path))
+    {
+        return ~0u;
+    }
+    const vk::PhysicalDevice& physicalDevice = m_device.getPhysicalDevice();
+    vk::Format format = texture->file.getFormat();
+    if (isBlockCompressed(format) && !(m_device.getEnabledFeatures().textureCompressionBC && isBlockFormatSupported(physicalDevice, format)))
+    {
+        return ~0u;
+    }
+
+    // the tail starts at the first level no larger than TailSize, or at the last level of files without a full chain
+    vk::Extent2D extent = texture->file.getExtent();
+    uint32 levelCount = texture->file.getLevelCount();
+    uint32 tailLevel = levelCount - 1;
+    while (tailLevel > 0 && std::max(getMipExtent(extent, tailLevel - 1).width, getMipExtent(extent, tailLevel - 1).height) <= TailSize)
+    {
+        tailLevel--;
+    }
+
+    texture->copyAlignment = getKtx2CopyAlignment(physicalDevice, format);
+    texture->tailLevel = tailLevel;
+    texture->firstResidentLevel = levelCount;
+    texture->requestedLevel = tailLevel;
+    texture->lastUsedFrame = m_frame;
+    texture->loadLevel = levelCount;
+    texture->uploadLevel = levelCount;
+    texture->nextRow = 0;
+    texture->prefetched = false;
+
+    uint32 index = uint32(m_textures.size());
+    m_residency[index] = tailLevel;
+    m_textures.push_back(std::move(texture));
+    return index;
+}
+
+const Image* TextureStreamer::getImage(uint32 index) const
+{
+    assert(index < m_textures.size());
+    return m_textures[index]->image.get();
+}
+
+uint32 TextureStreamer::getFirstResidentLevel(uint32 index) const
+{
+    assert(index < m_textures.size());
+    return m_textures[index]->firstResidentLevel;
+}
+
+void TextureStreamer::readFeedback()
+{
+    m_retiredImages.clear();
+    m_residentBytes -= m_retiredBytes;
+    m_retiredBytes = 0;
+
+    // the buffer is host coherent, and the shaders of the next frame only run after the next submission
+    for (uint32 index = 0; index < m_textures.size(); index++)
+    {
+        if (m_feedback[index] != ~0u)
+        {
+            StreamedTexture& texture = *m_textures[index];
+            texture.requestedLevel = std::min(m_feedback[index], texture.tailLevel);
+            texture.lastUsedFrame = m_frame;
+            m_feedback[index] = ~0u;
+        }
+    }
+}
+
+bool TextureStreamer::update(const vk::UniqueCommandBuffer& commandBuffer, StagingRing& ring, vk::DeviceSize uploadBudget)
+{
+    m_frame++;
+    m_imagesReplaced = false;
+
+    std::vector<uint32> prefetched;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        prefetched.swap(m_prefetched);
+    }
+    for (uint32 index : prefetched)
+    {
+        m_textures[index]->prefetched = true;
+    }
+
+    // loads whose pages are in memory, until the upload budget or the ring runs out
+    uint32 loadCount = 0;
+    vk::DeviceSize uploaded = 0;
+    bool ringFull = false;
+    for (uint32 index = 0; index < m_textures.size(); index++)
+    {
+        StreamedTexture& texture = *m_textures[index];
+        if (texture.loadImage && texture.prefetched && !ringFull && uploaded < uploadBudget)
+        {
+            ringFull = !continueLoad(index, ring, uploadBudget, uploaded, commandBuffer);
+        }
+        loadCount += texture.loadImage != nullptr;
+    }
+
+    // new loads, textures without anything resident first, then the ones used most recently
+    std::vector<uint32> candidates;
+    for (uint32 index = 0; index < m_textures.size(); index++)
+    {
+        const StreamedTexture& texture = *m_textures[index];
+        if (!texture.loadImage && texture.requestedLevel < texture.firstResidentLevel)
+        {
+            candidates.push_back(index);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](uint32 a, uint32 b)
+    {
+        const StreamedTexture& textureA = *m_textures[a];
+        const StreamedTexture& textureB = *m_textures[b];
+        bool emptyA = !textureA.image;
+        bool emptyB = !textureB.image;
+        if (emptyA != emptyB)
+        {
+            return emptyA;
+        }
+        return textureA.lastUsedFrame > textureB.lastUsedFrame;
+    });
+    for (uint32 index : candidates)
+    {
+        if (loadCount == MaxLoadCount)
+        {
+            break;
+        }
+        StreamedTexture& texture = *m_textures[index];
+        uint32 level = texture.image ? texture.requestedLevel : texture.tailLevel;
+        if (makeRoom(getResidentSize(texture, level), texture, commandBuffer))
+        {
+            startLoad(index, level, commandBuffer);
+            loadCount++;
+        }
+    }
+    return m_imagesReplaced;
+}
+
+TextureStreamer::Stats TextureStreamer::getStats() const
+{
+    Stats stats = {};
+    stats.textureCount = uint32(m_textures.size());
+    for (const std::unique_ptr<StreamedTexture>& texture : m_textures)
+    {
+        stats.loadCount += texture->loadImage != nullptr;
+    }
+    stats.residentBytes = m_residentBytes;
+    stats.budget = m_budget;
+    stats.uploadedBytes = m_uploadedBytes;
+    stats.evictedBytes = m_evictedBytes;
+    return stats;
+}
+
+vk::DeviceSize TextureStreamer::getResidentSize(const StreamedTexture& texture, uint32 firstLevel) const
+{
+    vk::DeviceSize size = 0;
+    for (uint32 level = firstLevel; level < texture.file.getLevelCount(); level++)
+    {
+        size += getImageSize(texture.file.getFormat(), getMipExtent(texture.file.getExtent(), level));
+    }
+    return size;
+}
+
+// Replaced images only count as freed here once they are destroyed, so loads wait for the frame after the evictions
+// that made room for them and the images never add up to more than the budget. Tails are loaded regardless.
+bool TextureStreamer::makeRoom(vk::DeviceSize size, const StreamedTexture& forTexture, const vk::UniqueCommandBuffer& commandBuffer)
+{
+    while (m_residentBytes - m_retiredBytes + size > m_budget)
+    {
+        // textures resident finer than shaders ask for first, then the ones used less recently than forTexture, each
+        // least recently used first
+        uint32 victim = ~0u;
+        bool victimTrimmed = false;
+        for (uint32 index = 0; index < m_textures.size(); index++)
+        {
+            const StreamedTexture& texture = *m_textures[index];
+            if (&texture == &forTexture || texture.loadImage || !texture.image)
+            {
+                continue;
+            }
+            bool trimmed = texture.firstResidentLevel < texture.requestedLevel;
+            bool stale = texture.lastUsedFrame < forTexture.lastUsedFrame && texture.firstResidentLevel < texture.tailLevel;
+            if (!trimmed && !stale)
+            {
+                continue;
+            }
+            if (victim == ~0u || (trimmed && !victimTrimmed) ||
+                (trimmed == victimTrimmed && texture.lastUsedFrame < m_textures[victim]->lastUsedFrame))
+            {
+                victim = index;
+                victimTrimmed = trimmed;
+            }
+        }
+        if (victim == ~0u)
+        {
+            break;
+        }
+        const StreamedTexture& texture = *m_textures[victim];
+        evict(victim, victimTrimmed ? texture.requestedLevel : texture.tailLevel, commandBuffer);
+    }
+    return !forTexture.image || m_residentBytes + size <= m_budget;
+}
+
+void TextureStreamer::startLoad(uint32 index, uint32 level, const vk::UniqueCommandBuffer& commandBuffer)
+{
+    StreamedTexture& texture = *m_textures[index];
+    assert(level < texture.firstResidentLevel && !texture.loadImage);
+
+    uint32 levelCount = texture.file.getLevelCount();
+    texture.loadImage = std::make_unique<Image>(m_device, texture.file.getFormat(), getMipExtent(texture.file.getExtent(), level), vk::ImageTiling::eOptimal,
+                                                vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+                                                vk::ImageLayout::eUndefined, vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor, levelCount - level);
+    texture.loadLevel = level;
+    texture.uploadLevel = texture.firstResidentLevel;
+    texture.nextRow = 0;
+    texture.prefetched = false;
+    m_residentBytes += getResidentSize(texture, level);
+
+    // the new levels stay in eTransferDstOptimal over the frames it takes to upload them
+    vk::su::setImageLayout(commandBuffer, texture.loadImage->getVKImage().get(), texture.file.getFormat(), vk::ImageLayout::eUndefined,
+                           vk::ImageLayout::eTransferDstOptimal, 0, texture.firstResidentLevel - level);
+
+    PrefetchJob job;
+    job.index = index;
+    for (uint32 missingLevel = level; missingLevel < texture.firstResidentLevel; missingLevel++)
+    {
+        job.ranges.push_back(std::make_pair(texture.file.getLevelData(missingLevel), texture.file.getLevelSize(missingLevel)));
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_prefetchJobs.push_back(std::move(job));
+    }
+    m_wakeCondition.notify_one();
+}
+
+// Returns false when the ring is full
+bool TextureStreamer::continueLoad(uint32 index, StagingRing& ring, vk::DeviceSize uploadBudget, vk::DeviceSize& uploaded, const vk::UniqueCommandBuffer& commandBuffer)
+{
+    StreamedTexture& texture = *m_textures[index];
+    vk::Image image = texture.loadImage->getVKImage().get();
+    vk::Format format = texture.file.getFormat();
+
+    // coarse to fine, the image only gets used once all of them are in
+    while (texture.uploadLevel > texture.loadLevel)
+    {
+        if (uploaded >= uploadBudget)
+        {
+            return true;
+        }
+        uint32 level = texture.uploadLevel - 1;
+        vk::DeviceSize copied = uploaded;
+        bool recorded = recordKtx2Rows(commandBuffer, ring, texture.file, level, image, level - texture.loadLevel, texture.copyAlignment, uploadBudget,
+                                       texture.nextRow, uploaded);
+        m_uploadedBytes += uploaded - copied;
+        if (!recorded)
+        {
+            return false;
+        }
+        if (texture.nextRow == texture.file.getRowCount(level))
+        {
+            texture.uploadLevel = level;
+            texture.nextRow = 0;
+        }
+    }
+
+    // the levels that were resident come from the old image
+    uint32 levelCount = texture.file.getLevelCount();
+    uint32 newLevelCount = texture.firstResidentLevel - texture.loadLevel;
+    if (texture.image)
+    {
+        vk::Image oldImage = texture.image->getVKImage().get();
+        uint32 oldLevelCount = levelCount - texture.firstResidentLevel;
+        vk::su::setImageLayout(commandBuffer, oldImage, format, vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferSrcOptimal, 0, oldLevelCount);
+        vk::su::setImageLayout(commandBuffer, image, format, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, newLevelCount, oldLevelCount);
+
+        std::vector<vk::ImageCopy> copyRegions;
+        for (uint32 level = 0; level < oldLevelCount; level++)
+        {
+            vk::Extent2D extent = getMipExtent(texture.file.getExtent(), texture.firstResidentLevel + level);
+            copyRegions.push_back(vk::ImageCopy(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1), vk::Offset3D(0, 0, 0),
+                                                vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, newLevelCount + level, 0, 1), vk::Offset3D(0, 0, 0),
+                                                vk::Extent3D(extent, 1)));
+        }
+        commandBuffer->copyImage(oldImage, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, copyRegions);
+    }
+    vk::su::setImageLayout(commandBuffer, image, format, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, 0, levelCount - texture.loadLevel);
+
+    replaceImage(index, std::move(texture.loadImage), texture.loadLevel);
+    return true;
+}
+
+void TextureStreamer::evict(uint32 index, uint32 level, const vk::UniqueCommandBuffer& commandBuffer)
+{
+    StreamedTexture& texture = *m_textures[index];
+    assert(texture.image && !texture.loadImage && level > texture.firstResidentLevel);
+
+    vk::Format format = texture.file.getFormat();
+    uint32 levelCount = texture.file.getLevelCount();
+    uint32 keptLevelCount = levelCount - level;
+    uint32 droppedLevelCount = level - texture.firstResidentLevel;
+    std::unique_ptr<Image> image = std::make_unique<Image>(m_device, format, getMipExtent(texture.file.getExtent(), level), vk::ImageTiling::eOptimal,
+                                                           vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+                                                           vk::ImageLayout::eUndefined, vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor, keptLevelCount);
+
+    vk::Image oldImage = texture.image->getVKImage().get();
+    vk::su::setImageLayout(commandBuffer, oldImage, format, vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferSrcOptimal, droppedLevelCount, keptLevelCount);
+    vk::su::setImageLayout(commandBuffer, image->getVKImage().get(), format, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, 0, keptLevelCount);
+
+    std::vector<vk::ImageCopy> copyRegions;
+    for (uint32 kept = 0; kept < keptLevelCount; kept++)
+    {
+        vk::Extent2D extent = getMipExtent(texture.file.getExtent(), level + kept);
+        copyRegions.push_back(vk::ImageCopy(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, droppedLevelCount + kept, 0, 1), vk::Offset3D(0, 0, 0),
+                                            vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, kept, 0, 1), vk::Offset3D(0, 0, 0), vk::Extent3D(extent, 1)));
+    }
+    commandBuffer->copyImage(oldImage, vk::ImageLayout::eTransferSrcOptimal, image->getVKImage().get(), vk::ImageLayout::eTransferDstOptimal, copyRegions);
+    vk::su::setImageLayout(commandBuffer, image->getVKImage().get(), format, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, 0, keptLevelCount);
+
+    m_residentBytes += getResidentSize(texture, level);
+    m_evictedBytes += getResidentSize(texture, texture.firstResidentLevel) - getResidentSize(texture, level);
+    replaceImage(index, std::move(image), level);
+}
+
+// The old image stays alive until the submission that copies from it and the draws of the frame before completed
+void TextureStreamer::replaceImage(uint32 index, std::unique_ptr<Image> image, uint32 firstLevel)
+{
+    StreamedTexture& texture = *m_textures[index];
+    if (texture.image)
+    {
+        vk::DeviceSize size = getResidentSize(texture, texture.firstResidentLevel);
+        m_retiredImages.push_back({ std::move(texture.image), size });
+        m_retiredBytes += size;
+    }
+    texture.image = std::move(image);
+    texture.firstResidentLevel = firstLevel;
+    texture.loadLevel = firstLevel;
+    texture.uploadLevel = firstLevel;
+    m_residency[index] = firstLevel;
+    m_imagesReplaced = true;
+}
+
+void TextureStreamer::prefetchLoop()
+{
+    for (;;)
+    {
+        PrefetchJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeCondition.wait(lock, [this]() { return m_quit || !m_prefetchJobs.empty(); });
+            if (m_quit)
+            {
+                return;
+            }
+            job = std::move(m_prefetchJobs.front());
+            m_prefetchJobs.pop_front();
+        }
+
+        // a read of every page faults it in from the file, the render thread then copies from memory
+        for (const std::pair<const uint8_t*, size_t>& range : job.ranges)
+        {
+            const volatile uint8_t* data = range.first;
+            for (size_t offset = 0; offset < range.second; offset += PrefetchPageSize)
+            {
+                data[offset];
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_prefetched.push_back(job.index);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+void printTextureStreamingBenchmark(std::ostream& os, const Device& device, const std::vector<string>& paths, uint32 budgetMegabytes)
+{
+    if (!TextureStreamer::isSupported(device))
+    {
+        os << "the device cannot write the feedback from fragment shaders\n";
+        return;
+    }
+
+    const vk::UniqueDevice& vkDevice = device.getVKDevice();
+    vk::UniqueCommandPool commandPool = vkDevice->createCommandPoolUnique(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, device.getGraphicsQueueFamilyIndex()));
+    vk::UniqueCommandBuffer commandBuffer = std::move(vkDevice->allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo(commandPool.get(), vk::CommandBufferLevel::ePrimary, 1)).front());
+
+    TextureStreamer streamer(device, vk::DeviceSize(budgetMegabytes) << 20);
+    std::vector<uint32> indices;
+    for (const string& path : paths)
+    {
+        uint32 index = streamer.addTexture(path);
+        if (index == ~0u)
+        {
+            os << "cannot stream " << path << "\n";
+            continue;
+        }
+        indices.push_back(index);
+    }
+    if (indices.empty())
+    {
+        return;
+    }
+    StagingRing ring(device, 64 << 20);
+    const vk::DeviceSize uploadBudget = 16 << 20;
+
+    OffscreenTarget target(device, StreamingRenderExtent);
+    Buffer vertexBuffer(device, sizeof(texturedCubeData), vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    vertexBuffer.upload(commandPool, device.getGraphicsQueue(), texturedCubeData, sizeof(texturedCubeData));
+    Buffer uniformBuffer(device, sizeof(glm::mat4x4), vk::BufferUsageFlagBits::eUniformBuffer);
+    vk::UniqueSampler sampler = vkDevice->createSamplerUnique(vk::SamplerCreateInfo(vk::SamplerCreateFlags(), vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear,
+                                                                                    vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat,
+                                                                                    0.0f, false, 1.0f, false, vk::CompareOp::eNever, 0.0f, VK_LOD_CLAMP_NONE));
+
+    // bindings of vertexShaderText_PT_T and fragmentShaderText_T_C_Streamed, one set per texture
+    vk::UniqueDescriptorSetLayout descriptorSetLayout = vk::su::createDescriptorSetLayout(vkDevice, {
+        { vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex },
+        { vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment },
+        { vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment },
+        { vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment } });
+    vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eFragment, 0, sizeof(uint32));
+    vk::UniquePipelineLayout pipelineLayout = vkDevice->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo({}, 1, &descriptorSetLayout.get(), 1, &pushConstantRange));
+    uint32 setCount = uint32(indices.size());
+    vk::UniqueDescriptorPool descriptorPool = vk::su::createDescriptorPool(vkDevice, { { vk::DescriptorType::eUniformBuffer, setCount },
+                                                                                      { vk::DescriptorType::eCombinedImageSampler, setCount },
+                                                                                      { vk::DescriptorType::eStorageBuffer, 2 * setCount } });
+    std::vector<vk::DescriptorSetLayout> setLayouts(setCount, descriptorSetLayout.get());
+    std::vector<vk::UniqueDescriptorSet> descriptorSets = vkDevice->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(descriptorPool.get(), setCount, setLayouts.data()));
+
+    vk::DescriptorBufferInfo bufferInfos[3] = {
+        vk::DescriptorBufferInfo(uniformBuffer.getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(streamer.getFeedbackBuffer().getVKBuffer().get(), 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(streamer.getResidencyBuffer().getVKBuffer().get(), 0, VK_WHOLE_SIZE)
+    };
+    for (const vk::UniqueDescriptorSet& descriptorSet : descriptorSets)
+    {
+        vkDevice->updateDescriptorSets({ vk::WriteDescriptorSet(descriptorSet.get(), 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &bufferInfos[0]),
+                                         vk::WriteDescriptorSet(descriptorSet.get(), 2, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[1]),
+                                         vk::WriteDescriptorSet(descriptorSet.get(), 3, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[2]) }, nullptr);
+    }
+
+    vk::UniqueShaderModule vertexShaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eVertex, vertexShaderText_PT_T);
+    vk::UniqueShaderModule fragmentShaderModule = vk::su::createShaderModule(vkDevice, vk::ShaderStageFlagBits::eFragment, fragmentShaderText_T_C_Streamed);
+    vk::UniquePipelineCache pipelineCache = vkDevice->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+    vk::UniquePipeline pipeline = vk::su::createGraphicsPipeline(vkDevice, pipelineCache, std::make_pair(*vertexShaderModule, nullptr), std::make_pair(*fragmentShaderModule, nullptr),
+                                                                 sizeof(VertexPT), { { vk::Format::eR32G32B32A32Sfloat, 0 }, { vk::Format::eR32G32Sfloat, 16 } },
+                                                                 vk::FrontFace::eClockwise, true, pipelineLayout, target.getRenderPass());
+
+    // the cubes of all textures overlap, so every texture covers the same pixels and asks for the same levels
+    glm::mat4x4 projection = vk::su::createProjectionClipMatrix(glm::radians(45.0f), float(StreamingRenderExtent.width) / StreamingRenderExtent.height, 0.1f, 100.0f);
+    GpuTimer drawTimer(device);
+    double updateMilliseconds = 0.0;
+    double drawMilliseconds = 0.0;
+    for (uint32 frame = 0; frame < StreamingBenchmarkFrames; frame++)
+    {
+        // from far away to filling the view over the first three quarters of the frames
+        float approach = std::min(float(frame) / (0.75f * StreamingBenchmarkFrames), 1.0f);
+        glm::vec3 eye = 64.0f * std::pow(2.5f / 64.0f, approach) * glm::normalize(glm::vec3(1.0f, 0.75f, -1.0f));
+        uniformBuffer.upload(projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+        // the submission of the previous frame completed
+        Timer timer;
+        streamer.readFeedback();
+        ring.reclaim();
+        commandBuffer->begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        if (streamer.update(commandBuffer, ring, uploadBudget))
+        {
+            for (uint32 i = 0; i < setCount; i++)
+            {
+                const Image* image = streamer.getImage(indices[i]);
+                if (image)
+                {
+                    vk::DescriptorImageInfo imageInfo(sampler.get(), image->getImageView().get(), vk::ImageLayout::eShaderReadOnlyOptimal);
+                    vkDevice->updateDescriptorSets(vk::WriteDescriptorSet(descriptorSets[i].get(), 1, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfo), nullptr);
+                }
+            }
+        }
+        updateMilliseconds += timer.getElapsedMilliseconds();
+
+        drawTimer.reset(commandBuffer);
+        drawTimer.begin(commandBuffer);
+        target.beginRenderPass(commandBuffer);
+        commandBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+        commandBuffer->bindVertexBuffers(0, vertexBuffer.getVKBuffer().get(), { 0 });
+        for (uint32 i = 0; i < setCount; i++)
+        {
+            // textures whose tail is still loading have nothing to sample
+            if (streamer.getImage(indices[i]))
+            {
+                commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout.get(), 0, descriptorSets[i].get(), nullptr);
+                commandBuffer->pushConstants(pipelineLayout.get(), vk::ShaderStageFlagBits::eFragment, 0, sizeof(uint32), &indices[i]);
+                commandBuffer->draw(uint32(sizeof(texturedCubeData) / sizeof(texturedCubeData[0])), 1, 0, 0);
+            }
+        }
+        commandBuffer->endRenderPass();
+        drawTimer.end(commandBuffer);
+        // readFeedback maps the requests once the fence signaled
+        commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eHost, {},
+                                       vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eHostRead), nullptr, nullptr);
+        commandBuffer->end();
+
+        vk::Fence fence = ring.getSubmitFence();
+        device.getGraphicsQueue().submit(vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer.get()), fence);
+        while (vk::Result::eTimeout == vkDevice->waitForFences(fence, VK_TRUE, vk::su::FenceTimeout))
+            ;
+
+        double milliseconds = 0.0;
+        drawTimer.getMilliseconds(0, milliseconds);
+        drawMilliseconds += milliseconds;
+    }
+    vkDevice->waitIdle();
+
+    TextureStreamer::Stats stats = streamer.getStats();
+    os << std::fixed << std::setprecision(1);
+    os << stats.textureCount << " textures, " << stats.residentBytes * 1e-6 << " of " << stats.budget * 1e-6 << " MB resident, " << stats.loadCount << " loads in progress\n";
+    os << stats.uploadedBytes * 1e-6 << " MB uploaded, " << stats.evictedBytes * 1e-6 << " MB evicted over " << StreamingBenchmarkFrames << " frames\n";
+    os << std::setprecision(3) << "per frame: update " << updateMilliseconds / StreamingBenchmarkFrames << " ms CPU, draw " << drawMilliseconds / StreamingBenchmarkFrames << " ms GPU\n";
+    os << std::defaultfloat;
+}
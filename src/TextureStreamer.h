@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Common.h"
+#include "Ktx2Texture.h"
+#include <vulkan/vulkan.hpp>
+#include <condition_variable>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class Buffer;
+class Device;
+class Image;
+class StagingRing;
+
+// Keeps the mips of many KTX2 textures resident only as far as the shaders ask for them, within a memory budget.
+//
+// Every texture's image holds its resident levels only, from the first resident level of the chain down to 1 x 1,
+// so sampling can never go finer than what is resident and the memory of the rest is not allocated at all. The
+// levels from TailSize down are always resident. Shaders that sample a texture write the finest level they would
+// have used, in levels of the whole chain, to the feedback buffer (see fragmentShaderText_T_C_Streamed).
+// update() then loads what was asked for, most recently used textures first: a worker thread reads the pages of the
+// missing levels ahead, the levels are copied through the StagingRing over as many frames as the upload budget
+// takes, and the image is replaced by a larger one holding the old levels and the new ones. When the budget is full,
+// textures that shaders asked for more detail than they use get their finest levels dropped, then the textures used
+// least recently lose everything above their tail.
+//
+// Expects one frame in flight: readFeedback() is called once the submission with the previous update() completed.
+// The device has to be idle when the streamer is destroyed.
+class TextureStreamer
+{
+public:
+    struct Stats
+    {
+        uint32          textureCount;
+        uint32          loadCount;          // loads in progress
+        vk::DeviceSize  residentBytes;      // images, including the ones being loaded and the replaced ones not yet destroyed
+        vk::DeviceSize  budget;
+        uint64          uploadedBytes;
+        uint64          evictedBytes;       // of levels dropped
+    };
+
+    // Levels this size and smaller are always resident
+    static const uint32 TailSize = 64;
+
+    // Whether the device was created with fragmentStoresAndAtomics, which the feedback writes need
+    static bool isSupported(const Device& device);
+
+    TextureStreamer(const Device& device, vk::DeviceSize budget, uint32 maxTextureCount = 1024);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // Returns the index shaders know the texture by, or ~0u when the file cannot be opened as a Ktx2File or the
+    // device cannot sample its format. Its tail is loaded by the next update().
+    uint32 addTexture(const string& path);
+
+    // One uint per texture, the finest level any shader asked for since the last readFeedback(), ~0u when none.
+    // Bound as a storage buffer to the shaders that sample streamed textures.
+    const Buffer& getFeedbackBuffer() const { return *m_feedbackBuffer; }
+
+    // One uint per texture, the level of the chain that is level 0 of its image
+    const Buffer& getResidencyBuffer() const { return *m_residencyBuffer; }
+
+    // nullptr until the tail is loaded. The image and its view are replaced whenever update() returns true.
+    const Image* getImage(uint32 index) const;
+    uint32 getFirstResidentLevel(uint32 index) const;
+
+    // Takes over the levels the shaders asked for and resets the feedback buffer for the next frame. Destroys the
+    // images that update() replaced, which the completed submission was the last to use.
+    void readFeedback();
+
+    // Evicts, starts loads and records the uploads of up to about uploadBudget bytes. The command buffer is submitted
+    // with ring.getSubmitFence(), and the draws recorded after this have to use the current images. Returns true when
+    // any image was replaced, so descriptors need to be written again.
+    bool update(const vk::UniqueCommandBuffer& commandBuffer, StagingRing& ring, vk::DeviceSize uploadBudget);
+
+    Stats getStats() const;
+
+private:
+    struct StreamedTexture
+    {
+        Ktx2File                file;
+        vk::DeviceSize          copyAlignment;
+        uint32                  tailLevel;          // first level of the tail
+        uint32                  firstResidentLevel; // getLevelCount() while nothing is resident
+        uint32                  requestedLevel;
+        uint64                  lastUsedFrame;
+        std::unique_ptr<Image>  image;
+
+        // a load in progress fills loadImage with the levels [loadLevel, firstResidentLevel) first, the ones still
+        // missing from uploadLevel down, then takes over the resident ones from image
+        std::unique_ptr<Image>  loadImage;
+        uint32                  loadLevel;
+        uint32                  uploadLevel;
+        uint32                  nextRow;
+        bool                    prefetched;
+    };
+
+    // Ranges of the mapped file the prefetch thread reads a byte of every page of
+    struct PrefetchJob
+    {
+        uint32                                          index;
+        std::vector<std::pair<const uint8_t*, size_t>>  ranges;
+    };
+
+    struct RetiredImage
+    {
+        std::unique_ptr<Image>  image;
+        vk::DeviceSize          size;
+    };
+
+    vk::DeviceSize getResidentSize(const StreamedTexture& texture, uint32 firstLevel) const;
+    bool makeRoom(vk::DeviceSize size, const StreamedTexture& forTexture, const vk::UniqueCommandBuffer& commandBuffer);
+    void startLoad(uint32 index, uint32 level, const vk::UniqueCommandBuffer& commandBuffer);
+    bool continueLoad(uint32 index, StagingRing& ring, vk::DeviceSize uploadBudget, vk::DeviceSize& uploaded, const vk::UniqueCommandBuffer& commandBuffer);
+    void evict(uint32 index, uint32 level, const vk::UniqueCommandBuffer& commandBuffer);
+    void replaceImage(uint32 index, std::unique_ptr<Image> image, uint32 firstLevel);
+    void prefetchLoop();
+
+    const Device&                                   m_device;
+    vk::DeviceSize                                  m_budget;
+    uint32                                          m_maxTextureCount;
+    std::vector<std::unique_ptr<StreamedTexture>>   m_textures;
+    std::unique_ptr<Buffer>                         m_feedbackBuffer;
+    std::unique_ptr<Buffer>                         m_residencyBuffer;
+    uint32*                                         m_feedback;         // both persistently mapped
+    uint32*                                         m_residency;
+    std::vector<RetiredImage>                       m_retiredImages;
+    vk::DeviceSize                                  m_residentBytes;
+    vk::DeviceSize                                  m_retiredBytes;
+    uint64                                          m_frame;
+    uint64                                          m_uploadedBytes;
+    uint64                                          m_evictedBytes;
+    bool                                            m_imagesReplaced;   // by the current update()
+
+    // shared with the prefetch thread
+    std::thread                                     m_prefetchThread;
+    std::mutex                                      m_mutex;
+    std::condition_variable                         m_wakeCondition;
+    std::deque<PrefetchJob>                         m_prefetchJobs;
+    std::vector<uint32>                             m_prefetched;
+    bool                                            m_quit;
+};
+
+// Draws a cube textured with each file, approaching it over the frames, through a streamer with a budget of
+// budgetMegabytes, and prints the upload and eviction totals with the CPU time of update() and the GPU time of the draws
+void printTextureStreamingBenchmark(std::ostream& os, const Device& device, const std::vector<string>& paths, uint32 budgetMegabytes);
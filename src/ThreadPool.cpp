@@ -0,0 +1,109 @@
+#include "ThreadPool.h"
+
+// set while a thread works on a job, nested parallelFor calls would otherwise wait for themselves
+static thread_local bool t_insideJob = false;
+
+ThreadPool::ThreadPool(uint32 threadCount)
+    : m_generation(0)
+    , m_busyWorkers(0)
+    , m_quit(false)
+    , m_func(nullptr)
+    , m_count(0)
+    , m_next(0)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (uint32 i = 1; i < threadCount; i++)
+    {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wakeCondition.notify_all();
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::getInstance()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::parallelFor(uint32 count, const std::function<void(uint32)>& func)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (m_workers.empty() || count == 1 || t_insideJob)
+    {
+        for (uint32 i = 0; i < count; i++)
+        {
+            func(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> jobLock(m_jobMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_func = &func;
+        m_count = count;
+        m_next = 0;
+        m_busyWorkers = uint32(m_workers.size());
+        m_generation++;
+    }
+    m_wakeCondition.notify_all();
+
+    runJob();
+
+    // every worker has to have seen the job before m_func goes out of scope
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this] { return m_busyWorkers == 0; });
+    m_func = nullptr;
+}
+
+void ThreadPool::runJob()
+{
+    t_insideJob = true;
+    for (uint32 i = m_next++; i < m_count; i = m_next++)
+    {
+        (*m_func)(i);
+    }
+    t_insideJob = false;
+}
+
+void ThreadPool::workerLoop()
+{
+    uint64 generation = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_wakeCondition.wait(lock, [&] { return m_quit || m_generation != generation; });
+        if (m_quit)
+        {
+            return;
+        }
+        generation = m_generation;
+
+        lock.unlock();
+        runJob();
+        lock.lock();
+
+        if (--m_busyWorkers == 0)
+        {
+            m_doneCondition.notify_one();
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Common.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Fixed set of worker threads for data parallel loops. The calling thread takes part in the work, so a pool with
+// threadCount 1 has no workers and runs everything inline.
+class ThreadPool
+{
+public:
+    // 0 uses one thread per hardware thread
+    explicit ThreadPool(uint32 threadCount = 0);
+    ~ThreadPool();
+
+    // including the calling thread
+    uint32 getThreadCount() const { return uint32(m_workers.size()) + 1; }
+
+    // Calls func(i) for every i in [0, count) and returns when all calls are done. Indices are handed out one at a time,
+    // so uneven work per index balances itself. Calls from inside func run serially on the calling thread.
+    void parallelFor(uint32 count, const std::function<void(uint32)>& func);
+
+    // Shared pool sized to the machine, created on first use
+    static ThreadPool& getInstance();
+
+private:
+    void workerLoop();
+    void runJob();
+
+    std::vector<std::thread>            m_workers;
+    std::mutex                          m_jobMutex;         // one parallelFor at a time
+    std::mutex                          m_mutex;
+    std::condition_variable             m_wakeCondition;
+    std::condition_variable             m_doneCondition;
+    uint64                              m_generation;
+    uint32                              m_busyWorkers;
+    bool                                m_quit;
+
+    const std::function<void(uint32)>*  m_func;
+    uint32                              m_count;
+    std::atomic<uint32>                 m_next;
+};
@@ -0,0 +1,147 @@
+#include "VertexCompression.h"
+#include "geometries.hpp"
+#include "math.hpp"
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstring>
+
+static uint32 getPackedSize(VertexSemantic semantic, const VertexCompressionSettings& settings)
+{
+    switch (semantic)
+    {
+    case VertexSemantic::Position: return settings.position == PositionEncoding::Float ? 12 : 8;
+    default: return 4;
+    }
+}
+
+static vk::Format getPackedFormat(VertexSemantic semantic, const VertexCompressionSettings& settings)
+{
+    switch (semantic)
+    {
+    case VertexSemantic::Position:
+        switch (settings.position)
+        {
+        case PositionEncoding::Float: return vk::Format::eR32G32B32Sfloat;
+        case PositionEncoding::Half: return vk::Format::eR16G16B16A16Sfloat;
+        default: return vk::Format::eR16G16B16A16Snorm;
+        }
+    case VertexSemantic::Normal: return vk::Format::eR16G16Snorm;
+    case VertexSemantic::Color: return vk::Format::eR8G8B8A8Unorm;
+    case VertexSemantic::Texcoord: return vk::Format::eR16G16Sfloat;
+    default: return vk::Format::eUndefined;
+    }
+}
+
+glm::mat4x4 CompressedVertices::getDequantizationMatrix() const
+{
+    return glm::scale(glm::translate(glm::mat4x4(1.0f), positionCenter), positionScale);
+}
+
+CompressedVertices compressVertices(const void* vertices, size_t vertexCount, size_t vertexStride, const std::vector<VertexAttributeSource>& attributes,
+                                    const VertexCompressionSettings& settings)
+{
+    const uint8_t* source = static_cast<const uint8_t*>(vertices);
+    auto read = [&](size_t vertex, const VertexAttributeSource& attribute, uint32 component)
+    {
+        float value;
+        memcpy(&value, source + vertex * vertexStride + attribute.offset + component * sizeof(float), sizeof(float));
+        return value;
+    };
+
+    CompressedVertices compressed;
+    compressed.vertexCount = uint32(vertexCount);
+    for (const VertexAttributeSource& attribute : attributes)
+    {
+        compressed.layout.attributes.push_back({ getPackedFormat(attribute.semantic, settings), compressed.layout.stride });
+        compressed.layout.stride += getPackedSize(attribute.semantic, settings);
+    }
+
+    // positions are packed relative to the bounds, a degenerate axis keeps a scale of 1 so nothing divides by 0
+    const VertexAttributeSource* position = nullptr;
+    for (const VertexAttributeSource& attribute : attributes)
+    {
+        position = attribute.semantic == VertexSemantic::Position ? &attribute : position;
+    }
+    if (position && settings.position != PositionEncoding::Float && vertexCount)
+    {
+        Aabb bounds;
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            bounds.grow(glm::vec3(read(i, *position, 0), read(i, *position, 1), read(i, *position, 2)));
+        }
+        compressed.positionCenter = (bounds.min + bounds.max) * 0.5f;
+        if (settings.position == PositionEncoding::Snorm16)
+        {
+            glm::vec3 halfExtent = (bounds.max - bounds.min) * 0.5f;
+            compressed.positionScale = glm::vec3(halfExtent.x > 0.0f ? halfExtent.x : 1.0f, halfExtent.y > 0.0f ? halfExtent.y : 1.0f,
+                                                 halfExtent.z > 0.0f ? halfExtent.z : 1.0f);
+        }
+    }
+
+    compressed.data.resize(vertexCount * compressed.layout.stride);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        uint8_t* target = compressed.data.data() + i * compressed.layout.stride;
+        for (size_t a = 0; a < attributes.size(); a++)
+        {
+            const VertexAttributeSource& attribute = attributes[a];
+            uint8_t* packed = target + compressed.layout.attributes[a].second;
+            switch (attribute.semantic)
+            {
+            case VertexSemantic::Position:
+            {
+                glm::vec3 p(read(i, attribute, 0), read(i, attribute, 1), read(i, attribute, 2));
+                glm::vec3 q = (p - compressed.positionCenter) / compressed.positionScale;
+                if (settings.position == PositionEncoding::Float)
+                {
+                    memcpy(packed, &p, 12);
+                }
+                else
+                {
+                    uint64 bits = settings.position == PositionEncoding::Half ? glm::packHalf4x16(glm::vec4(q, 1.0f)) : glm::packSnorm4x16(glm::vec4(q, 1.0f));
+                    memcpy(packed, &bits, 8);
+                }
+                break;
+            }
+            case VertexSemantic::Normal:
+            {
+                uint32 bits = glm::packSnorm2x16(vk::su::octahedralEncode(glm::vec3(read(i, attribute, 0), read(i, attribute, 1), read(i, attribute, 2))) * 2.0f - 1.0f);
+                memcpy(packed, &bits, 4);
+                break;
+            }
+            case VertexSemantic::Color:
+            {
+                uint32 bits = glm::packUnorm4x8(glm::vec4(read(i, attribute, 0), read(i, attribute, 1), read(i, attribute, 2), read(i, attribute, 3)));
+                memcpy(packed, &bits, 4);
+                break;
+            }
+            case VertexSemantic::Texcoord:
+            {
+                uint32 bits = glm::packHalf2x16(glm::vec2(read(i, attribute, 0), read(i, attribute, 1)));
+                memcpy(packed, &bits, 4);
+                break;
+            }
+            }
+        }
+    }
+    return compressed;
+}
+
+CompressedVertices compressVertices(const std::vector<VertexPC>& vertices, const VertexCompressionSettings& settings)
+{
+    return compressVertices(vertices.data(), vertices.size(), sizeof(VertexPC),
+                            { { VertexSemantic::Position, offsetof(VertexPC, x) }, { VertexSemantic::Color, offsetof(VertexPC, r) } }, settings);
+}
+
+CompressedVertices compressVertices(const std::vector<VertexPT>& vertices, const VertexCompressionSettings& settings)
+{
+    return compressVertices(vertices.data(), vertices.size(), sizeof(VertexPT),
+                            { { VertexSemantic::Position, offsetof(VertexPT, x) }, { VertexSemantic::Texcoord, offsetof(VertexPT, u) } }, settings);
+}
+
+CompressedVertices compressVertices(const std::vector<VertexPNT>& vertices, const VertexCompressionSettings& settings)
+{
+    return compressVertices(vertices.data(), vertices.size(), sizeof(VertexPNT),
+                            { { VertexSemantic::Position, offsetof(VertexPNT, x) }, { VertexSemantic::Normal, offsetof(VertexPNT, nx) },
+                              { VertexSemantic::Texcoord, offsetof(VertexPNT, u) } }, settings);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Mesh.h"
+
+struct VertexPC;
+struct VertexPT;
+
+// What a vertex attribute holds, which decides how it is packed
+enum class VertexSemantic
+{
+    Position,   // 3 floats, a fourth w = 1 is dropped
+    Normal,     // 3 floats, unit length
+    Color,      // 4 floats in [0, 1]
+    Texcoord,   // 2 floats
+};
+
+enum class PositionEncoding
+{
+    Float,      // eR32G32B32Sfloat, unchanged
+    Half,       // eR16G16B16A16Sfloat, relative to the bounds center
+    Snorm16,    // eR16G16B16A16Snorm, relative to the bounds, 1/65535 of the extent per step
+};
+
+struct VertexCompressionSettings
+{
+    PositionEncoding    position = PositionEncoding::Snorm16;
+};
+
+// Attribute of an uncompressed vertex struct
+struct VertexAttributeSource
+{
+    VertexSemantic  semantic;
+    uint32          offset;
+};
+
+// Packed vertices and the layout createGraphicsPipeline needs for them. The packed formats are:
+//
+//   Position   as set in VertexCompressionSettings, 4 components with w = 1 so shaders keep reading a vec4
+//   Normal     eR16G16Snorm, octahedral: n = (x, y, 1 - |x| - |y|); if (n.z < 0) n.xy = (1 - |n.yx|) * sign(n.xy);
+//              n = normalize(n)
+//   Color      eR8G8B8A8Unorm
+//   Texcoord   eR16G16Sfloat
+//
+// Positions relative to the bounds are undone by getDequantizationMatrix, which goes in front of the model matrix,
+// so vertex shaders need no changes.
+struct CompressedVertices
+{
+    VertexLayout            layout;
+    std::vector<uint8_t>    data;
+    uint32                  vertexCount = 0;
+    glm::vec3               positionCenter = glm::vec3(0.0f);
+    glm::vec3               positionScale = glm::vec3(1.0f);
+
+    glm::mat4x4 getDequantizationMatrix() const;
+};
+
+CompressedVertices compressVertices(const void* vertices, size_t vertexCount, size_t vertexStride, const std::vector<VertexAttributeSource>& attributes,
+                                    const VertexCompressionSettings& settings = VertexCompressionSettings());
+
+CompressedVertices compressVertices(const std::vector<VertexPC>& vertices, const VertexCompressionSettings& settings = VertexCompressionSettings());
+CompressedVertices compressVertices(const std::vector<VertexPT>& vertices, const VertexCompressionSettings& settings = VertexCompressionSettings());
+CompressedVertices compressVertices(const std::vector<VertexPNT>& vertices, const VertexCompressionSettings& settings = VertexCompressionSettings());
@@ -6,6 +6,19 @@
 #include "SPIRV/GlslangToSpv.h"
 #include "OGLCompilersDLL/InitializeDll.h"
 #include "GraphicsObjects.h"
+#include "MeshOptimizer.h"
+#include "VertexCompression.h"
+#include "StressScene.h"
+#include "BatchMath.h"
+#include "Mipmaps.h"
+#include "TextureCompression.h"
+#include "AsyncTextureLoader.h"
+#include "BindlessTextureTable.h"
+#include "PerDrawData.h"
+#include "Meshlets.h"
+#include "TextureStreamer.h"
+#include <fstream>
+#include <iostream>
 
 #if _DEBUG
 #pragma comment(lib, "glslangd.lib")
@@ -27,19 +40,32 @@
 
 #pragma comment(lib, "vulkan-1.lib")
 
-glm::mat4x4 createModelViewProjectionClipMatrix(float rot, vk::Extent2D const& extent)
+// Scaling benchmark over generated scenes without a window, the CSV goes to csvPath or stdout
+int runHeadlessBenchmark(const char* appName, const char* csvPath)
 {
-    float fov = glm::radians(45.0f);
-    if (extent.width > extent.height)
+    vk::UniqueInstance instance = vk::su::createInstance(appName, appName, {}, {});
+    Device device(instance->enumeratePhysicalDevices().front());
+
+    std::vector<StressSceneSettings> steps;
+    for (uint32 instanceCount = 1000; instanceCount <= 256000; instanceCount *= 4)
     {
-        fov *= static_cast<float>(extent.height) / static_cast<float>(extent.width);
+        StressSceneSettings settings;
+        settings.instanceCount = instanceCount;
+        steps.push_back(settings);
     }
 
-    glm::mat4x4 model = glm::rotate(glm::mat4x4(1.0f), glm::radians(rot), glm::vec3(0, 1, 0));
-    glm::mat4x4 view = glm::lookAt(glm::vec3(-5.0f, 3.0f, -10.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
-    glm::mat4x4 projection = glm::perspective(fov, 1.0f, 0.1f, 100.0f);
-    glm::mat4x4 clip = glm::mat4x4(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 0.5f, 1.0f);   // vulkan clip space has inverted y and half z !
-    return clip * projection * view * model;
+    std::ofstream file;
+    if (csvPath)
+    {
+        file.open(csvPath);
+        if (!file)
+        {
+            std::cerr << "cannot write " << csvPath << "\n";
+            return 1;
+        }
+    }
+    runStressBenchmark(csvPath ? file : std::cout, steps, &device);
+    return 0;
 }
 
 int main(int argc, char** argv)
@@ -48,61 +74,144 @@ int main(int argc, char** argv)
 
     const char* appName = "Ray GPU";
 
-    //vk::UniqueInstance instance = vk::su::createInstance(appName, appName, {}, vk::su::getInstanceExtensions(), VK_API_VERSION_1_0);
+    // RayGpu --benchmark [file.csv]
+    if (argc > 1 && string(argv[1]) == "--benchmark")
+    {
+        int result = runHeadlessBenchmark(appName, argc > 2 ? argv[2] : nullptr);
+        glslang::FinalizeProcess();
+        return result;
+    }
 
-    //vk::PhysicalDevice physicalDevice = instance->enumeratePhysicalDevices().front();
+    // RayGpu --math-benchmark [instance count]
+    if (argc > 1 && string(argv[1]) == "--math-benchmark")
+    {
+        printBatchMathBenchmark(std::cout, argc > 2 ? std::stoul(argv[2]) : 100000);
+        glslang::FinalizeProcess();
+        return 0;
+    }
 
-    //vk::su::SurfaceData surfaceData(instance, appName, appName, vk::Extent2D(500, 500));
+    // RayGpu --mip-benchmark [size]
+    if (argc > 1 && string(argv[1]) == "--mip-benchmark")
+    {
+        {
+            vk::UniqueInstance instance = vk::su::createInstance(appName, appName, {}, {});
+            Device device(instance->enumeratePhysicalDevices().front());
+            printMipmapBenchmark(std::cout, argc > 2 ? uint32(std::stoul(argv[2])) : 4096, &device);
+        }
+        glslang::FinalizeProcess();
+        return 0;
+    }
 
-    //std::pair<uint32_t, uint32_t> graphicsAndPresentQueueFamilyIndex = vk::su::findGraphicsAndPresentQueueFamilyIndex(physicalDevice, *surfaceData.surface);
-    
-    //vk::UniqueDevice device = vk::su::createDevice(physicalDevice, graphicsAndPresentQueueFamilyIndex.first, vk::su::getDeviceExtensions());
+    // RayGpu --compression-benchmark [size]
+    if (argc > 1 && string(argv[1]) == "--compression-benchmark")
+    {
+        printCompressionBenchmark(std::cout, argc > 2 ? uint32(std::stoul(argv[2])) : 1024);
+        glslang::FinalizeProcess();
+        return 0;
+    }
 
-    vk::UniqueCommandPool commandPool = vk::su::createCommandPool(device, graphicsAndPresentQueueFamilyIndex.first);
-    vk::UniqueCommandBuffer commandBuffer = std::move(device->allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo(commandPool.get(), vk::CommandBufferLevel::ePrimary, 1)).front());
+    // RayGpu --texture-load-benchmark file...
+    if (argc > 1 && string(argv[1]) == "--texture-load-benchmark")
+    {
+        {
+            vk::UniqueInstance instance = vk::su::createInstance(appName, appName, {}, {});
+            Device device(instance->enumeratePhysicalDevices().front());
+            printTextureLoadBenchmark(std::cout, device, std::vector<string>(argv + 2, argv + argc));
+        }
+        glslang::FinalizeProcess();
+        return 0;
+    }
 
-    //vk::Queue graphicsQueue = device->getQueue(graphicsAndPresentQueueFamilyIndex.first, 0);
-    //vk::Queue presentQueue = device->getQueue(graphicsAndPresentQueueFamilyIndex.second, 0);
+    // RayGpu --meshlet-benchmark file
+    if (argc > 2 && string(argv[1]) == "--meshlet-benchmark")
+    {
+        {
+            vk::UniqueInstance instance = vk::su::createInstance(appName, appName, {}, {});
+            Device device(instance->enumeratePhysicalDevices().front());
+            printMeshletCullBenchmark(std::cout, device, argv[2]);
+        }
+        glslang::FinalizeProcess();
+        return 0;
+    }
 
-    //vk::su::SwapChainData swapChainData(physicalDevice, device, *surfaceData.surface, surfaceData.extent, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
-    //                                    vk::UniqueSwapchainKHR(), graphicsAndPresentQueueFamilyIndex.first, graphicsAndPresentQueueFamilyIndex.second);
+    // RayGpu --texture-streaming-benchmark budget-in-MB file.ktx2...
+    if (argc > 3 && string(argv[1]) == "--texture-streaming-benchmark")
+    {
+        {
+            vk::UniqueInstance instance = vk::su::createInstance(appName, appName, {}, {});
+            Device device(instance->enumeratePhysicalDevices().front());
+            printTextureStreamingBenchmark(std::cout, device, std::vector<string>(argv + 3, argv + argc), uint32(std::stoul(argv[2])));
+        }
+        glslang::FinalizeProcess();
+        return 0;
+    }
 
-    vk::su::DepthBufferData depthBufferData(physicalDevice, device, vk::Format::eD16Unorm, surfaceData.extent);
+    // RayGpu --bindless-benchmark [material count]
+    if (argc > 1 && string(argv[1]) == "--bindless-benchmark")
+    {
+        {
+            vk::UniqueInstance instance = vk::su::createInstance(appName, appName, {}, {});
+            Device device(instance->enumeratePhysicalDevices().front());
+            printBindlessBenchmark(std::cout, device, argc > 2 ? uint32(std::stoul(argv[2])) : 1024);
+        }
+        glslang::FinalizeProcess();
+        return 0;
+    }
 
-    vk::su::BufferData uniformBufferData(physicalDevice, device, sizeof(glm::mat4x4), vk::BufferUsageFlagBits::eUniformBuffer);
-    vk::su::copyToDevice(device, uniformBufferData.deviceMemory, vk::su::createModelViewProjectionClipMatrix(surfaceData.extent));
+    vk::UniqueInstance instance = vk::su::createInstance(appName, appName, {}, vk::su::getInstanceExtensions());
 
-    vk::UniqueDescriptorSetLayout descriptorSetLayout = vk::su::createDescriptorSetLayout(device, { {vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex} });
-    vk::UniquePipelineLayout pipelineLayout = device->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), 1, &descriptorSetLayout.get()));
+    vk::PhysicalDevice physicalDevice = instance->enumeratePhysicalDevices().front();
 
-    vk::UniqueRenderPass renderPass = vk::su::createRenderPass(device, vk::su::pickSurfaceFormat(physicalDevice.getSurfaceFormatsKHR(surfaceData.surface.get())).format, depthBufferData.format);
+    RenderWindow window(instance, 500, 500, appName);
+    Device graphicsDevice(window, physicalDevice);
+    const vk::UniqueDevice& device = graphicsDevice.getVKDevice();
 
-    vk::UniqueShaderModule vertexShaderModule = vk::su::createShaderModule(device, vk::ShaderStageFlagBits::eVertex, vertexShaderText_PC_C);
-    vk::UniqueShaderModule fragmentShaderModule = vk::su::createShaderModule(device, vk::ShaderStageFlagBits::eFragment, fragmentShaderText_C_C);
+    vk::UniqueCommandPool commandPool = device->createCommandPoolUnique(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, graphicsDevice.getGraphicsQueueFamilyIndex()));
+    vk::UniqueCommandBuffer commandBuffer = std::move(device->allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo(commandPool.get(), vk::CommandBufferLevel::ePrimary, 1)).front());
+
+    SwapChain swapChain(graphicsDevice, window, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc, vk::UniqueSwapchainKHR());
+    const vk::Extent2D& extent = swapChain.getExtent();
+
+    DepthBuffer depthBuffer(graphicsDevice, vk::Format::eD16Unorm, extent);
 
-    std::vector<vk::UniqueFramebuffer> framebuffers = vk::su::createFramebuffers(device, renderPass, swapChainData.imageViews, depthBufferData.imageView, surfaceData.extent);
+    // a single cube is drawn per frame, DrawConstants fits the 128 bytes of push constants every device allows
+    PerDrawData drawData(graphicsDevice, sizeof(DrawConstants), vk::ShaderStageFlagBits::eVertex, 1, 1);
+    vk::UniquePipelineLayout pipelineLayout = drawData.createPipelineLayout();
 
-    vk::su::BufferData vertexBufferData(physicalDevice, device, sizeof(coloredCubeData), vk::BufferUsageFlagBits::eVertexBuffer);
-    vk::su::copyToDevice(device, vertexBufferData.deviceMemory, coloredCubeData, sizeof(coloredCubeData) / sizeof(coloredCubeData[0]));
+    vk::UniqueRenderPass renderPass = vk::su::createRenderPass(device, swapChain.getColorFormat(), depthBuffer.getFormat());
 
-    vk::UniqueDescriptorPool descriptorPool = vk::su::createDescriptorPool(device, { {vk::DescriptorType::eUniformBuffer, 1} });
-    vk::UniqueDescriptorSet descriptorSet = std::move(device->allocateDescriptorSetsUnique(vk::DescriptorSetAllocateInfo(*descriptorPool, 1, &*descriptorSetLayout)).front());
+    vk::UniqueShaderModule vertexShaderModule = vk::su::createShaderModule(device, vk::ShaderStageFlagBits::eVertex,
+                                                                           drawData.getShaderHeader(drawDataMembers_MVP_Instance) + vertexShaderText_PC_C_DrawData);
+    vk::UniqueShaderModule fragmentShaderModule = vk::su::createShaderModule(device, vk::ShaderStageFlagBits::eFragment, fragmentShaderText_C_C);
+
+    std::vector<vk::UniqueFramebuffer> framebuffers = vk::su::createFramebuffers(device, renderPass, swapChain.getImageViews(), depthBuffer.getImageView(), extent);
+
+    // the cube repeats the shared corners of its faces, welding them leaves 24 vertices for 36 indices
+    std::vector<VertexPC> cubeVertices(std::begin(coloredCubeData), std::end(coloredCubeData));
+    std::vector<uint32> cubeIndices;
+    optimizeMesh(cubeVertices, cubeIndices);
+    printVertexCacheStats(std::cout, VertexCacheStats::analyzeNonIndexed(std::size(coloredCubeData)), VertexCacheStats::analyze(cubeIndices, cubeVertices.size()));
+    IndexData cubeIndexData = IndexData::pack(cubeIndices, cubeVertices.size());
+    // 12 instead of 32 bytes per vertex, the pipeline takes its vertex input from the packed layout
+    CompressedVertices cubeCompressed = compressVertices(cubeVertices);
 
-    vk::su::updateDescriptorSets(device, descriptorSet, { {vk::DescriptorType::eUniformBuffer, uniformBufferData.buffer, vk::UniqueBufferView()} }, {});
+    Buffer vertexBuffer(graphicsDevice, cubeCompressed.data.size(), vk::BufferUsageFlagBits::eVertexBuffer);
+    vertexBuffer.upload(cubeCompressed.data.data(), cubeCompressed.data.size(), 0);
+    Buffer indexBuffer(graphicsDevice, cubeIndexData.bytes.size(), vk::BufferUsageFlagBits::eIndexBuffer);
+    indexBuffer.upload(cubeIndexData.bytes.data(), cubeIndexData.bytes.size(), 0);
 
     vk::UniquePipelineCache pipelineCache = device->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
     vk::UniquePipeline graphicsPipeline = vk::su::createGraphicsPipeline(device, pipelineCache, std::make_pair(*vertexShaderModule, nullptr), std::make_pair(*fragmentShaderModule, nullptr),
-                                                                         sizeof(coloredCubeData[0]), { { vk::Format::eR32G32B32A32Sfloat, 0 }, { vk::Format::eR32G32B32A32Sfloat, 16 } },
+                                                                         cubeCompressed.layout.stride, cubeCompressed.layout.attributes,
                                                                          vk::FrontFace::eClockwise, true, pipelineLayout, renderPass);
     /* VULKAN_KEY_START */
 
     
 
     float testAngle = 0;
+    // the camera does not move, only the model turns
+    const glm::mat4x4 viewProjection = vk::su::createViewProjectionClipMatrix(extent);
 
-    // Get the index of the next available swapchain image:
-    vk::UniqueSemaphore imageAcquiredSemaphore = device->createSemaphoreUnique(vk::SemaphoreCreateInfo());
-    
     MSG msg;
     ZeroMemory(&msg, sizeof(msg));
 
@@ -114,31 +223,34 @@ int main(int argc, char** argv)
             DispatchMessage(&msg);
         }
 
-        vk::ResultValue<uint32_t> currentBuffer = device->acquireNextImageKHR(swapChainData.swapChain.get(), vk::su::FenceTimeout, imageAcquiredSemaphore.get(), nullptr);
-        assert(currentBuffer.result == vk::Result::eSuccess);
-        assert(currentBuffer.value < framebuffers.size());
+        swapChain.Acquire();
 
         //////////////////////////////////////////////////////////////////////////
 
         testAngle += 0.01;
 
-        vk::su::copyToDevice(device, uniformBufferData.deviceMemory, createModelViewProjectionClipMatrix(testAngle, surfaceData.extent));
+        // the previous frame's fence was waited for below
+        drawData.beginFrame();
+
+        DrawConstants drawConstants = {};
+        drawConstants.mvp = viewProjection * glm::rotate(glm::mat4x4(1.0f), glm::radians(testAngle), glm::vec3(0, 1, 0)) * cubeCompressed.getDequantizationMatrix();
 
         commandBuffer->begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlags()));
 
         vk::ClearValue clearValues[2];
         clearValues[0].color = vk::ClearColorValue(std::array<float, 4>({ 0.2f, 0.2f, 0.2f, 0.2f }));
         clearValues[1].depthStencil = vk::ClearDepthStencilValue(1.0f, 0);
-        vk::RenderPassBeginInfo renderPassBeginInfo(renderPass.get(), framebuffers[currentBuffer.value].get(), vk::Rect2D(vk::Offset2D(0, 0), surfaceData.extent), 2, clearValues);
+        vk::RenderPassBeginInfo renderPassBeginInfo(renderPass.get(), framebuffers[swapChain.getCurrentImageIndex()].get(), vk::Rect2D(vk::Offset2D(0, 0), extent), 2, clearValues);
         commandBuffer->beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
         commandBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline.get());
-        commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout.get(), 0, descriptorSet.get(), nullptr);
+        drawData.write(commandBuffer, pipelineLayout.get(), drawConstants);
 
-        commandBuffer->bindVertexBuffers(0, *vertexBufferData.buffer, { 0 });
-        commandBuffer->setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(surfaceData.extent.width), static_cast<float>(surfaceData.extent.height), 0.0f, 1.0f));
-        commandBuffer->setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), surfaceData.extent));
+        commandBuffer->bindVertexBuffers(0, vertexBuffer.getVKBuffer().get(), { 0 });
+        commandBuffer->bindIndexBuffer(indexBuffer.getVKBuffer().get(), 0, cubeIndexData.type);
+        commandBuffer->setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f));
+        commandBuffer->setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
 
-        commandBuffer->draw(12 * 3, 1, 0, 0);
+        commandBuffer->drawIndexed(cubeIndexData.getCount(), 1, 0, 0, 0);
         commandBuffer->endRenderPass();
         commandBuffer->end();
 
@@ -147,13 +259,13 @@ int main(int argc, char** argv)
         vk::UniqueFence drawFence = device->createFenceUnique(vk::FenceCreateInfo());
 
         vk::PipelineStageFlags waitDestinationStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
-        vk::SubmitInfo submitInfo(1, &imageAcquiredSemaphore.get(), &waitDestinationStageMask, 1, &commandBuffer.get());
-        graphicsQueue.submit(submitInfo, drawFence.get());
+        vk::SubmitInfo submitInfo(1, &swapChain.getImageAcquiredSemaphore().get(), &waitDestinationStageMask, 1, &commandBuffer.get());
+        graphicsDevice.getGraphicsQueue().submit(submitInfo, drawFence.get());
         
         while (vk::Result::eTimeout == device->waitForFences(drawFence.get(), VK_TRUE, vk::su::FenceTimeout))
             ;
 
-        presentQueue.presentKHR(vk::PresentInfoKHR(0, nullptr, 1, &swapChainData.swapChain.get(), &currentBuffer.value));
+        swapChain.Present();
     }
     //Sleep(1000);
 
@@ -161,7 +273,6 @@ int main(int argc, char** argv)
 
     device->waitIdle();
 
-    DestroyWindow(surfaceData.window);
     glslang::FinalizeProcess();
 
     return 0;
@@ -20,6 +20,12 @@ namespace vk
   namespace su
   {
     glm::mat4x4 createModelViewProjectionClipMatrix(vk::Extent2D const& extent)
+    {
+      glm::mat4x4 model = glm::mat4x4(1.0f);
+      return createViewProjectionClipMatrix(extent) * model;
+    }
+
+    glm::mat4x4 createViewProjectionClipMatrix(vk::Extent2D const& extent)
     {
       float fov = glm::radians(45.0f);
       if (extent.width > extent.height)
@@ -27,11 +33,41 @@ namespace vk
         fov *= static_cast<float>(extent.height) / static_cast<float>(extent.width);
       }
 
-      glm::mat4x4 model = glm::mat4x4(1.0f);
       glm::mat4x4 view = glm::lookAt(glm::vec3(-5.0f, 3.0f, -10.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
       glm::mat4x4 projection = glm::perspective(fov, 1.0f, 0.1f, 100.0f);
       glm::mat4x4 clip = glm::mat4x4(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 0.5f, 1.0f);   // vulkan clip space has inverted y and half z !
-      return clip * projection * view * model;
+      return clip * projection * view;
+    }
+
+    glm::mat4x4 createProjectionClipMatrix(float fovY, float aspect, float zNear, float zFar)
+    {
+      glm::mat4x4 clip = glm::mat4x4(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 0.5f, 1.0f);
+      return clip * glm::perspective(fovY, aspect, zNear, zFar);
+    }
+
+    glm::vec2 octahedralEncode(glm::vec3 const& direction)
+    {
+      // degenerate normals of zero length end up at the center instead of NaN
+      glm::vec3 n = direction / std::max(std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z), 1e-20f);
+      glm::vec2 p(n.x, n.y);
+      if (n.z < 0.0f)
+      {
+        // fold the lower hemisphere over the diagonals
+        p = glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+      }
+      return p * 0.5f + 0.5f;
+    }
+
+    glm::vec3 octahedralDecode(glm::vec2 const& encoded)
+    {
+      glm::vec2 p = encoded * 2.0f - 1.0f;
+      glm::vec3 n(p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y));
+      if (n.z < 0.0f)
+      {
+        n.x = (1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f);
+        n.y = (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f);
+      }
+      return glm::normalize(n);
     }
   }
 }
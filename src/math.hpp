@@ -23,5 +23,13 @@ namespace vk
   namespace su
   {
     glm::mat4x4 createModelViewProjectionClipMatrix(vk::Extent2D const& extent);
+    // the camera of createModelViewProjectionClipMatrix without a model, for callers that apply their own per object
+    glm::mat4x4 createViewProjectionClipMatrix(vk::Extent2D const& extent);
+    // perspective projection followed by the change to vulkan clip space, 0 <= z <= w and y pointing down
+    glm::mat4x4 createProjectionClipMatrix(float fovY, float aspect, float zNear, float zFar);
+
+    // maps a direction onto the octahedron unfolded into [0,1]^2
+    glm::vec2 octahedralEncode(glm::vec3 const& direction);
+    glm::vec3 octahedralDecode(glm::vec2 const& encoded);
   }
 }
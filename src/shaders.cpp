@@ -86,7 +86,7 @@ namespace vk
       return true;
     }
 
-    vk::UniqueShaderModule createShaderModule(vk::UniqueDevice &device, vk::ShaderStageFlagBits shaderStage, std::string const& shaderText)
+    vk::UniqueShaderModule createShaderModule(vk::UniqueDevice const& device, vk::ShaderStageFlagBits shaderStage, std::string const& shaderText)
     {
       std::vector<unsigned int> shaderSPV;
       bool ok = GLSLtoSPV(shaderStage, shaderText, shaderSPV);
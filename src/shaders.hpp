@@ -21,7 +21,7 @@ namespace vk
 {
   namespace su
   {
-    vk::UniqueShaderModule createShaderModule(vk::UniqueDevice &device, vk::ShaderStageFlagBits shaderStage, std::string const& shaderText);
+    vk::UniqueShaderModule createShaderModule(vk::UniqueDevice const& device, vk::ShaderStageFlagBits shaderStage, std::string const& shaderText);
 
     bool GLSLtoSPV(const vk::ShaderStageFlagBits shaderType, std::string const& glslShader, std::vector<unsigned int> &spvShader);
   }
@@ -52,6 +52,59 @@ void main()
 }
 )";
 
+// vertex shader with (P)osition and (C)olor in and (C)olor out, for the instances GpuInstanceCuller left visible
+const std::string vertexShaderText_PC_C_Instanced = R"(
+#version 450
+
+struct DrawInstance
+{
+  mat4 transform;
+  uint meshId;
+  uint padding[3];
+};
+
+layout (std140, binding = 0) uniform UniformBuffer
+{
+  mat4 viewProjection;
+} uniformBuffer;
+
+layout (std430, binding = 1) readonly buffer Instances { DrawInstance instances[]; };
+layout (std430, binding = 2) readonly buffer VisibleInstances { uint visibleInstances[]; };
+
+layout (location = 0) in vec4 pos;
+layout (location = 1) in vec4 inColor;
+
+layout (location = 0) out vec4 outColor;
+
+void main()
+{
+  outColor = inColor;
+  gl_Position = uniformBuffer.viewProjection * instances[visibleInstances[gl_InstanceIndex]].transform * pos;
+}
+)";
+
+// the fields of DrawConstants, for PerDrawData::getShaderHeader
+const std::string drawDataMembers_MVP_Instance = R"(
+  mat4 mvp;
+  uint instanceId;
+)";
+
+// vertex shader with (P)osition and (C)olor in and (C)olor and instance ID out, following PerDrawData::getShaderHeader
+const std::string vertexShaderText_PC_C_DrawData = R"(
+layout (location = 0) in vec4 pos;
+layout (location = 1) in vec4 inColor;
+
+layout (location = 0) out vec4 outColor;
+layout (location = 1) flat out uint outInstanceId;
+
+void main()
+{
+  outColor = inColor;
+  outInstanceId = drawData.instanceId;
+  gl_Position = drawData.mvp * pos;
+}
+)";
+
 // vertex shader with (P)osition and (T)exCoord in and (T)exCoord out
 const std::string vertexShaderText_PT_T = R"(
 #version 400
@@ -76,6 +129,37 @@ void main()
 }
 )";
 
+// vertex shader with (P)osition and (T)exCoord in and (T)exCoord and material ID out, for fragmentShaderText_T_C_Bindless.
+// Instance i is the cube in cell i of a gridSize x gridSize grid, textured with material i.
+const std::string vertexShaderText_PT_T_Material = R"(
+#version 450
+
+layout (std140, binding = 0) uniform UniformBuffer
+{
+  mat4 mvp;
+} uniformBuffer;
+
+layout (push_constant) uniform PushConstants
+{
+  uint gridSize;
+};
+
+layout (location = 0) in vec4 pos;
+layout (location = 1) in vec2 inTexCoord;
+
+layout (location = 0) out vec2 outTexCoord;
+layout (location = 1) flat out uint outMaterialId;
+
+void main()
+{
+  uint instance = uint(gl_InstanceIndex);
+  vec2 cell = vec2(instance % gridSize, instance / gridSize) - 0.5 * float(gridSize - 1);
+  outTexCoord = inTexCoord;
+  outMaterialId = instance;
+  gl_Position = uniformBuffer.mvp * vec4(pos.xyz + vec3(3.0 * cell, 0.0), 1.0);
+}
+)";
+
 
 // fragment shader with (C)olor in and (C)olor out
 const std::string fragmentShaderText_C_C = R"(
@@ -113,3 +197,1153 @@ void main()
 }
 )";
 
+// fragment shader sampling a texture of the TextureStreamer, whose image starts at residentLevels[textureIndex] of the
+// chain, and asking for the finest level it would have used
+const std::string fragmentShaderText_T_C_Streamed = R"(
+#version 450
+
+layout (binding = 1) uniform sampler2D tex;
+
+layout (std430, binding = 2) buffer Feedback
+{
+  uint requestedLevels[];
+};
+
+layout (std430, binding = 3) readonly buffer Residency
+{
+  uint residentLevels[];
+};
+
+layout (push_constant) uniform PushConstants
+{
+  uint textureIndex;
+};
+
+layout (location = 0) in vec2 inTexCoord;
+
+layout (location = 0) out vec4 outColor;
+
+void main()
+{
+  // the lod is relative to the resident image, and negative where it magnifies
+  int level = max(int(residentLevels[textureIndex]) + int(floor(textureQueryLod(tex, inTexCoord).y)), 0);
+  if (uint(level) < requestedLevels[textureIndex])
+  {
+    atomicMin(requestedLevels[textureIndex], uint(level));
+  }
+  outColor = texture(tex, inTexCoord);
+}
+)";
+
+
+// fragment shader with (T)exCoord and material ID in and (C)olor out, sampling the material's texture from the
+// BindlessTextureTable bound as set 1
+const std::string fragmentShaderText_T_C_Bindless = R"(
+#version 450
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (set = 1, binding = 0) uniform sampler2D textures[];
+
+layout (location = 0) in vec2 inTexCoord;
+layout (location = 1) flat in uint inMaterialId;
+
+layout (location = 0) out vec4 outColor;
+
+void main()
+{
+  // the ID may differ between the invocations of a draw when one draw covers many materials
+  outColor = texture(textures[nonuniformEXT(inMaterialId)], inTexCoord);
+}
+)";
+
+// compute shader merging a batch of samples into the progressive accumulation image
+// both images hold the mean in rgb and the luminance M2 (sum of squared differences) in a, merged with Chan's formula
+const std::string computeShaderText_Accumulate = R"(
+#version 450
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (binding = 0, rgba32f) uniform image2D accumulation;
+layout (binding = 1, rgba32f) uniform readonly image2D batch;
+
+layout (push_constant) uniform PushConstants
+{
+  uint accumulatedSamples;
+  uint batchSamples;
+} pc;
+
+float luminance(vec3 c)
+{
+  return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(pixel, imageSize(accumulation))))
+  {
+    return;
+  }
+
+  vec4 b = imageLoad(batch, pixel);
+  if (pc.accumulatedSamples == 0)
+  {
+    imageStore(accumulation, pixel, b);
+    return;
+  }
+
+  vec4 a = imageLoad(accumulation, pixel);
+  float na = float(pc.accumulatedSamples);
+  float nb = float(pc.batchSamples);
+  float n = na + nb;
+
+  float deltaLuminance = luminance(b.rgb) - luminance(a.rgb);
+  vec3 mean = a.rgb + (b.rgb - a.rgb) * (nb / n);
+  float m2 = a.a + b.a + deltaLuminance * deltaLuminance * na * nb / n;
+  imageStore(accumulation, pixel, vec4(mean, m2));
+}
+)";
+
+// compute shaders sorting ray indices by a Morton key of their quantized origin and direction, see RaySort.h
+const std::string raySortShaderHeader = R"(
+#version 450
+
+layout (local_size_x = 256) in;
+
+struct Ray
+{
+  vec4 originTMin;
+  vec4 directionTMax;
+};
+
+layout (std430, binding = 0) readonly buffer Rays { Ray rays[]; };
+layout (std430, binding = 1) buffer KeysIn { uint keysIn[]; };
+layout (std430, binding = 2) buffer ValuesIn { uint valuesIn[]; };
+layout (std430, binding = 3) writeonly buffer KeysOut { uint keysOut[]; };
+layout (std430, binding = 4) writeonly buffer ValuesOut { uint valuesOut[]; };
+layout (std430, binding = 5) buffer Histogram { uint histogram[]; };
+
+layout (push_constant) uniform PushConstants
+{
+  vec4 boundsMin;
+  vec4 boundsInvExtent;
+  uint count;
+  uint shift;
+  uint groupCount;
+} pc;
+)";
+
+const std::string computeShaderText_RaySortKeys = raySortShaderHeader + R"(
+uint expandBits3(uint v)
+{
+  v = (v * 0x00010001u) & 0xFF0000FFu;
+  v = (v * 0x00000101u) & 0x0F00F00Fu;
+  v = (v * 0x00000011u) & 0xC30C30C3u;
+  v = (v * 0x00000005u) & 0x49249249u;
+  return v;
+}
+
+uint expandBits2(uint v)
+{
+  v &= 0xFu;
+  v = (v | (v << 2)) & 0x33u;
+  v = (v | (v << 1)) & 0x55u;
+  return v;
+}
+
+vec2 octahedralEncode(vec3 n)
+{
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  vec2 p = n.xy;
+  if (n.z < 0.0)
+  {
+    p = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+  }
+  return p * 0.5 + 0.5;
+}
+
+void main()
+{
+  uint i = gl_GlobalInvocationID.x;
+  if (i >= pc.count)
+  {
+    return;
+  }
+
+  uvec3 o = uvec3(clamp((rays[i].originTMin.xyz - pc.boundsMin.xyz) * pc.boundsInvExtent.xyz, 0.0, 1.0) * 255.0);
+  uint originCode = (expandBits3(o.x) << 2) | (expandBits3(o.y) << 1) | expandBits3(o.z);
+
+  uvec2 d = uvec2(min(octahedralEncode(rays[i].directionTMax.xyz) * 16.0, vec2(15.0)));
+  uint directionCode = (expandBits2(d.x) << 1) | expandBits2(d.y);
+
+  keysIn[i] = (originCode << 8) | directionCode;
+  valuesIn[i] = i;
+}
+)";
+
+// per workgroup histogram of the current 4 bit digit, stored digit major so a single scan yields the scatter offsets
+const std::string computeShaderText_RaySortCount = raySortShaderHeader + R"(
+shared uint localHistogram[16];
+
+void main()
+{
+  uint lid = gl_LocalInvocationIndex;
+  if (lid < 16)
+  {
+    localHistogram[lid] = 0;
+  }
+  barrier();
+
+  uint i = gl_GlobalInvocationID.x;
+  if (i < pc.count)
+  {
+    atomicAdd(localHistogram[(keysIn[i] >> pc.shift) & 15u], 1u);
+  }
+  barrier();
+
+  if (lid < 16)
+  {
+    histogram[lid * pc.groupCount + gl_WorkGroupID.x] = localHistogram[lid];
+  }
+}
+)";
+
+// exclusive scan over the whole histogram, run as a single workgroup
+const std::string computeShaderText_RaySortScan = raySortShaderHeader + R"(
+shared uint temp[256];
+
+void main()
+{
+  uint lid = gl_LocalInvocationIndex;
+  uint total = 16 * pc.groupCount;
+  uint carry = 0;
+
+  for (uint base = 0; base < total; base += 256)
+  {
+    uint i = base + lid;
+    uint value = i < total ? histogram[i] : 0;
+    temp[lid] = value;
+    barrier();
+
+    for (uint offset = 1; offset < 256; offset <<= 1)
+    {
+      uint t = lid >= offset ? temp[lid - offset] : 0;
+      barrier();
+      temp[lid] += t;
+      barrier();
+    }
+
+    if (i < total)
+    {
+      histogram[i] = carry + temp[lid] - value;
+    }
+    carry += temp[255];
+    barrier();
+  }
+}
+)";
+
+// stable scatter, the rank within the workgroup counts the preceding elements with the same digit
+const std::string computeShaderText_RaySortScatter = raySortShaderHeader + R"(
+shared uint digits[256];
+
+void main()
+{
+  uint lid = gl_LocalInvocationIndex;
+  uint i = gl_GlobalInvocationID.x;
+  bool valid = i < pc.count;
+
+  uint key = valid ? keysIn[i] : 0;
+  uint digit = valid ? (key >> pc.shift) & 15u : 16u;
+  digits[lid] = digit;
+  barrier();
+
+  if (!valid)
+  {
+    return;
+  }
+
+  uint rank = 0;
+  for (uint j = 0; j < lid; j++)
+  {
+    rank += digits[j] == digit ? 1 : 0;
+  }
+
+  uint dst = histogram[digit * pc.groupCount + gl_WorkGroupID.x] + rank;
+  keysOut[dst] = key;
+  valuesOut[dst] = valuesIn[i];
+}
+)";
+
+// compute shader traversing the two level acceleration structure uploaded by GpuAccelerationStructure, see AccelerationStructure.h
+// the structs match their C++ counterparts, leaf and child indices of a BLAS are relative to its entry in blasInfos
+const std::string traceShaderHeader = R"(
+#version 450
+
+#define BVH_MAX_DEPTH 64
+#define BVH_INNER_NODE 0x80000000u
+
+layout (local_size_x = 64) in;
+
+const float FLT_MAX = 3.402823466e+38;
+
+struct Ray
+{
+  vec4 originTMin;
+  vec4 directionTMax;
+};
+
+struct RayHit
+{
+  float t;
+  uint primitiveId;
+  uint instanceId;
+  float u;
+  float v;
+};
+
+struct BvhNode
+{
+  vec3 boundsMin;
+  uint leftFirst;
+  vec3 boundsMax;
+  uint count;     // primitive count of a leaf, BVH_INNER_NODE | split axis for inner nodes
+};
+
+struct BvhTriangle
+{
+  vec3 v0;
+  uint primitiveId;
+  vec3 edge1;
+  float pad0;
+  vec3 edge2;
+  float pad1;
+};
+
+struct Instance
+{
+  mat4 transform;
+  mat4 inverseTransform;
+  vec3 albedo;
+  uint blasIndex;
+};
+
+layout (std430, binding = 0) readonly buffer Rays { Ray rays[]; };
+layout (std430, binding = 2) readonly buffer Order { uint order[]; };
+layout (std430, binding = 3) readonly buffer TlasNodes { BvhNode tlasNodes[]; };
+layout (std430, binding = 4) readonly buffer TlasIndices { uint tlasIndices[]; };
+layout (std430, binding = 5) readonly buffer Instances { Instance instances[]; };
+layout (std430, binding = 6) readonly buffer BlasNodes { BvhNode blasNodes[]; };
+layout (std430, binding = 7) readonly buffer BlasInfos { uvec2 blasInfos[]; };   // x: first node, y: first triangle
+layout (std430, binding = 8) readonly buffer Triangles { BvhTriangle triangles[]; };
+
+layout (push_constant) uniform PushConstants
+{
+  uint rayCount;
+  uint useOrder;
+} pc;
+
+float intersectAabb(vec3 origin, vec3 invDirection, float tMin, float tMax, vec3 boundsMin, vec3 boundsMax)
+{
+  vec3 t0 = (boundsMin - origin) * invDirection;
+  vec3 t1 = (boundsMax - origin) * invDirection;
+  vec3 tNear = min(t0, t1);
+  vec3 tFar = max(t0, t1);
+  float tEnter = max(max(tNear.x, tNear.y), max(tNear.z, tMin));
+  float tExit = min(min(tFar.x, tFar.y), min(tFar.z, tMax));
+  return tEnter <= tExit ? tEnter : FLT_MAX;
+}
+
+// Moeller-Trumbore, shrinks tMax on a hit
+bool intersectTriangle(BvhTriangle triangle, vec3 origin, vec3 direction, float tMin, inout float tMax, inout RayHit hit)
+{
+  vec3 p = cross(direction, triangle.edge2);
+  float determinant = dot(triangle.edge1, p);
+  if (abs(determinant) < 1e-12)
+  {
+    return false;
+  }
+
+  float invDeterminant = 1.0 / determinant;
+  vec3 s = origin - triangle.v0;
+  float u = dot(s, p) * invDeterminant;
+  if (u < 0.0 || u > 1.0)
+  {
+    return false;
+  }
+
+  vec3 q = cross(s, triangle.edge1);
+  float v = dot(direction, q) * invDeterminant;
+  if (v < 0.0 || u + v > 1.0)
+  {
+    return false;
+  }
+
+  float t = dot(triangle.edge2, q) * invDeterminant;
+  if (t < tMin || t > tMax)
+  {
+    return false;
+  }
+
+  tMax = t;
+  hit.t = t;
+  hit.primitiveId = triangle.primitiveId;
+  hit.u = u;
+  hit.v = v;
+  return true;
+}
+
+// closest hit in one BLAS, the ray is in object space
+bool traverseBlas(uint blasIndex, vec3 origin, vec3 direction, float tMin, inout float tMax, inout RayHit hit)
+{
+  uvec2 info = blasInfos[blasIndex];
+  vec3 invDirection = 1.0 / direction;
+  if (intersectAabb(origin, invDirection, tMin, tMax, blasNodes[info.x].boundsMin, blasNodes[info.x].boundsMax) == FLT_MAX)
+  {
+    return false;
+  }
+
+  uint stackNodes[BVH_MAX_DEPTH];
+  float stackT[BVH_MAX_DEPTH];
+  uint stackSize = 0;
+  uint nodeIndex = info.x;
+  bool hitAny = false;
+  while (true)
+  {
+    BvhNode node = blasNodes[nodeIndex];
+    if ((node.count & BVH_INNER_NODE) == 0)
+    {
+      for (uint i = node.leftFirst; i < node.leftFirst + node.count; i++)
+      {
+        hitAny = intersectTriangle(triangles[info.y + i], origin, direction, tMin, tMax, hit) || hitAny;
+      }
+    }
+    else
+    {
+      uint nearIndex = info.x + node.leftFirst;
+      uint farIndex = nearIndex + 1;
+      float tNear = intersectAabb(origin, invDirection, tMin, tMax, blasNodes[nearIndex].boundsMin, blasNodes[nearIndex].boundsMax);
+      float tFar = intersectAabb(origin, invDirection, tMin, tMax, blasNodes[farIndex].boundsMin, blasNodes[farIndex].boundsMax);
+      if (tFar < tNear)
+      {
+        float t = tNear; tNear = tFar; tFar = t;
+        uint n = nearIndex; nearIndex = farIndex; farIndex = n;
+      }
+
+      if (tNear != FLT_MAX)
+      {
+        if (tFar != FLT_MAX)
+        {
+          stackNodes[stackSize] = farIndex;
+          stackT[stackSize] = tFar;
+          stackSize++;
+        }
+        nodeIndex = nearIndex;
+        continue;
+      }
+    }
+
+    // pop the next node which is still in front of the closest hit
+    bool found = false;
+    while (stackSize != 0 && !found)
+    {
+      stackSize--;
+      nodeIndex = stackNodes[stackSize];
+      found = stackT[stackSize] <= tMax;
+    }
+    if (!found)
+    {
+      break;
+    }
+  }
+  return hitAny;
+}
+
+// closest hit over all instances, the ray is transformed into object space on entering a BLAS
+// the direction stays unnormalized, so t is the same in both spaces
+void traceClosest(vec3 origin, vec3 direction, float tMin, float tMax, inout RayHit hit)
+{
+  vec3 invDirection = 1.0 / direction;
+  if (intersectAabb(origin, invDirection, tMin, tMax, tlasNodes[0].boundsMin, tlasNodes[0].boundsMax) == FLT_MAX)
+  {
+    return;
+  }
+
+  uint stackNodes[BVH_MAX_DEPTH];
+  float stackT[BVH_MAX_DEPTH];
+  uint stackSize = 0;
+  uint nodeIndex = 0;
+  while (true)
+  {
+    BvhNode node = tlasNodes[nodeIndex];
+    if ((node.count & BVH_INNER_NODE) == 0)
+    {
+      for (uint i = node.leftFirst; i < node.leftFirst + node.count; i++)
+      {
+        uint instanceIndex = tlasIndices[i];
+        mat4 inverseTransform = instances[instanceIndex].inverseTransform;
+        vec3 objectOrigin = (inverseTransform * vec4(origin, 1.0)).xyz;
+        vec3 objectDirection = (inverseTransform * vec4(direction, 0.0)).xyz;
+        if (traverseBlas(instances[instanceIndex].blasIndex, objectOrigin, objectDirection, tMin, tMax, hit))
+        {
+          hit.instanceId = instanceIndex;
+        }
+      }
+    }
+    else
+    {
+      uint nearIndex = node.leftFirst;
+      uint farIndex = nearIndex + 1;
+      float tNear = intersectAabb(origin, invDirection, tMin, tMax, tlasNodes[nearIndex].boundsMin, tlasNodes[nearIndex].boundsMax);
+      float tFar = intersectAabb(origin, invDirection, tMin, tMax, tlasNodes[farIndex].boundsMin, tlasNodes[farIndex].boundsMax);
+      if (tFar < tNear)
+      {
+        float t = tNear; tNear = tFar; tFar = t;
+        uint n = nearIndex; nearIndex = farIndex; farIndex = n;
+      }
+
+      if (tNear != FLT_MAX)
+      {
+        if (tFar != FLT_MAX)
+        {
+          stackNodes[stackSize] = farIndex;
+          stackT[stackSize] = tFar;
+          stackSize++;
+        }
+        nodeIndex = nearIndex;
+        continue;
+      }
+    }
+
+    bool found = false;
+    while (stackSize != 0 && !found)
+    {
+      stackSize--;
+      nodeIndex = stackNodes[stackSize];
+      found = stackT[stackSize] <= tMax;
+    }
+    if (!found)
+    {
+      break;
+    }
+  }
+}
+bool hitsTriangle(BvhTriangle triangle, vec3 origin, vec3 direction, float tMin, float tMax)
+{
+  RayHit hit;
+  return intersectTriangle(triangle, origin, direction, tMin, tMax, hit);
+}
+
+// occlusion only: returns on the first triangle within [tMin, tMax]. Without a closest hit to cull against, the
+// children are visited front to back along the split axis instead of sorting them by entry distance.
+bool occludedBlas(uint blasIndex, vec3 origin, vec3 direction, float tMin, float tMax)
+{
+  uvec2 info = blasInfos[blasIndex];
+  vec3 invDirection = 1.0 / direction;
+  if (intersectAabb(origin, invDirection, tMin, tMax, blasNodes[info.x].boundsMin, blasNodes[info.x].boundsMax) == FLT_MAX)
+  {
+    return false;
+  }
+
+  uint stack[BVH_MAX_DEPTH];
+  uint stackSize = 0;
+  uint nodeIndex = info.x;
+  while (true)
+  {
+    BvhNode node = blasNodes[nodeIndex];
+    if ((node.count & BVH_INNER_NODE) == 0)
+    {
+      for (uint i = node.leftFirst; i < node.leftFirst + node.count; i++)
+      {
+        if (hitsTriangle(triangles[info.y + i], origin, direction, tMin, tMax))
+        {
+          return true;
+        }
+      }
+    }
+    else
+    {
+      bool backwards = direction[node.count & 3] < 0.0;
+      uint firstIndex = info.x + node.leftFirst + (backwards ? 1 : 0);
+      uint secondIndex = info.x + node.leftFirst + (backwards ? 0 : 1);
+      bool hitFirst = intersectAabb(origin, invDirection, tMin, tMax, blasNodes[firstIndex].boundsMin, blasNodes[firstIndex].boundsMax) != FLT_MAX;
+      bool hitSecond = intersectAabb(origin, invDirection, tMin, tMax, blasNodes[secondIndex].boundsMin, blasNodes[secondIndex].boundsMax) != FLT_MAX;
+      if (hitFirst || hitSecond)
+      {
+        if (hitFirst && hitSecond)
+        {
+          stack[stackSize++] = secondIndex;
+        }
+        nodeIndex = hitFirst ? firstIndex : secondIndex;
+        continue;
+      }
+    }
+
+    if (stackSize == 0)
+    {
+      break;
+    }
+    nodeIndex = stack[--stackSize];
+  }
+  return false;
+}
+
+bool traceOcclusion(vec3 origin, vec3 direction, float tMin, float tMax)
+{
+  vec3 invDirection = 1.0 / direction;
+  if (intersectAabb(origin, invDirection, tMin, tMax, tlasNodes[0].boundsMin, tlasNodes[0].boundsMax) == FLT_MAX)
+  {
+    return false;
+  }
+
+  uint stack[BVH_MAX_DEPTH];
+  uint stackSize = 0;
+  uint nodeIndex = 0;
+  while (true)
+  {
+    BvhNode node = tlasNodes[nodeIndex];
+    if ((node.count & BVH_INNER_NODE) == 0)
+    {
+      for (uint i = node.leftFirst; i < node.leftFirst + node.count; i++)
+      {
+        uint instanceIndex = tlasIndices[i];
+        mat4 inverseTransform = instances[instanceIndex].inverseTransform;
+        vec3 objectOrigin = (inverseTransform * vec4(origin, 1.0)).xyz;
+        vec3 objectDirection = (inverseTransform * vec4(direction, 0.0)).xyz;
+        if (occludedBlas(instances[instanceIndex].blasIndex, objectOrigin, objectDirection, tMin, tMax))
+        {
+          return true;
+        }
+      }
+    }
+    else
+    {
+      bool backwards = direction[node.count & 3] < 0.0;
+      uint firstIndex = node.leftFirst + (backwards ? 1 : 0);
+      uint secondIndex = node.leftFirst + (backwards ? 0 : 1);
+      bool hitFirst = intersectAabb(origin, invDirection, tMin, tMax, tlasNodes[firstIndex].boundsMin, tlasNodes[firstIndex].boundsMax) != FLT_MAX;
+      bool hitSecond = intersectAabb(origin, invDirection, tMin, tMax, tlasNodes[secondIndex].boundsMin, tlasNodes[secondIndex].boundsMax) != FLT_MAX;
+      if (hitFirst || hitSecond)
+      {
+        if (hitFirst && hitSecond)
+        {
+          stack[stackSize++] = secondIndex;
+        }
+        nodeIndex = hitFirst ? firstIndex : secondIndex;
+        continue;
+      }
+    }
+
+    if (stackSize == 0)
+    {
+      break;
+    }
+    nodeIndex = stack[--stackSize];
+  }
+  return false;
+}
+)";
+
+// one invocation per ray, invocation i traces ray order[i] when useOrder is set
+const std::string computeShaderText_TraceClosest = traceShaderHeader + R"(
+layout (std430, binding = 1) writeonly buffer Hits { RayHit hits[]; };
+
+void main()
+{
+  uint index = gl_GlobalInvocationID.x;
+  if (index >= pc.rayCount)
+  {
+    return;
+  }
+
+  uint rayIndex = pc.useOrder != 0 ? order[index] : index;
+  Ray ray = rays[rayIndex];
+
+  RayHit hit;
+  hit.t = FLT_MAX;
+  hit.primitiveId = 0xFFFFFFFFu;
+  hit.instanceId = 0xFFFFFFFFu;
+  hit.u = 0.0;
+  hit.v = 0.0;
+  traceClosest(ray.originTMin.xyz, ray.directionTMax.xyz, ray.originTMin.w, ray.directionTMax.w, hit);
+  hits[rayIndex] = hit;
+}
+)";
+
+// occlusion only, for shadow and visibility rays: writes 1 for rays that hit anything within [tMin, tMax], 0 otherwise
+const std::string computeShaderText_TraceOcclusion = traceShaderHeader + R"(
+layout (std430, binding = 1) writeonly buffer Occluded { uint occluded[]; };
+
+void main()
+{
+  uint index = gl_GlobalInvocationID.x;
+  if (index >= pc.rayCount)
+  {
+    return;
+  }
+
+  uint rayIndex = pc.useOrder != 0 ? order[index] : index;
+  Ray ray = rays[rayIndex];
+  occluded[rayIndex] = traceOcclusion(ray.originTMin.xyz, ray.directionTMax.xyz, ray.originTMin.w, ray.directionTMax.w) ? 1 : 0;
+}
+)";
+
+// compute shaders of GpuDenoiser (SVGF), see Denoiser.h. CpuDenoiser in Denoiser.cpp follows them step by step,
+// changes to the constants or weights have to be made in both places
+const std::string denoiseShaderHeader = R"(
+#version 450
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (binding = 0, rgba32f) uniform readonly image2D radiance;
+layout (binding = 1, rgba32f) uniform readonly image2D normalDepth;
+layout (binding = 2, rgba8) uniform readonly image2D albedo;
+layout (binding = 3, rgba32f) uniform image2D historyNormalDepth;
+layout (binding = 4, rgba32f) uniform readonly image2D historyColorIn;
+layout (binding = 5, rgba32f) uniform readonly image2D historyMomentsIn;
+layout (binding = 6, rgba32f) uniform writeonly image2D historyColorOut;
+layout (binding = 7, rgba32f) uniform image2D historyMomentsOut;
+layout (binding = 8, rgba32f) uniform readonly image2D filterIn;
+layout (binding = 9, rgba32f) uniform writeonly image2D filterOut;
+layout (binding = 10, rgba32f) uniform writeonly image2D denoised;
+
+layout (push_constant) uniform PushConstants
+{
+  mat4 reprojection;      // current NDC to previous clip space
+  float colorAlpha;
+  float momentsAlpha;
+  float phiColor;
+  float phiNormal;
+  float phiDepth;
+  int stepSize;
+  uint writeHistory;
+  uint historyValid;
+} pc;
+
+const float AlbedoEpsilon = 1e-3;
+const float MaxHistoryLength = 32.0;
+const float ReprojectionNormalThreshold = 0.9;
+const float ReprojectionDepthTolerance = 2.0;
+const float MinReprojectionWeight = 0.01;
+const float ShortHistoryLength = 4.0;
+
+float luminance(vec3 c)
+{
+  return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 albedoFactor(ivec2 pixel)
+{
+  return max(imageLoad(albedo, pixel).rgb, vec3(AlbedoEpsilon));
+}
+
+bool isBackground(vec4 nd)
+{
+  return nd.w >= 1.0;
+}
+
+bool isInside(ivec2 pixel, ivec2 size)
+{
+  return all(greaterThanEqual(pixel, ivec2(0))) && all(lessThan(pixel, size));
+}
+
+// smaller of the one sided differences per axis, so depth discontinuities do not blow it up
+float depthGradient(ivec2 pixel, ivec2 size)
+{
+  float d = imageLoad(normalDepth, pixel).w;
+  float left = imageLoad(normalDepth, clamp(pixel - ivec2(1, 0), ivec2(0), size - 1)).w;
+  float right = imageLoad(normalDepth, clamp(pixel + ivec2(1, 0), ivec2(0), size - 1)).w;
+  float up = imageLoad(normalDepth, clamp(pixel - ivec2(0, 1), ivec2(0), size - 1)).w;
+  float down = imageLoad(normalDepth, clamp(pixel + ivec2(0, 1), ivec2(0), size - 1)).w;
+  return max(min(abs(right - d), abs(d - left)), min(abs(down - d), abs(d - up)));
+}
+
+float edgeWeight(vec4 center, vec4 nd, float depthTolerance)
+{
+  float depthWeight = exp(-abs(center.w - nd.w) / (depthTolerance + 1e-5));
+  float normalWeight = pow(max(0.0, dot(center.xyz, nd.xyz)), pc.phiNormal);
+  return depthWeight * normalWeight;
+}
+)";
+
+// reprojects the history with a bilinear filter over the consistent taps and blends in the demodulated frame
+const std::string computeShaderText_DenoiseTemporal = denoiseShaderHeader + R"(
+void main()
+{
+  ivec2 size = imageSize(radiance);
+  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+  if (!isInside(pixel, size))
+  {
+    return;
+  }
+
+  vec4 center = imageLoad(normalDepth, pixel);
+  vec3 illumination = imageLoad(radiance, pixel).rgb / albedoFactor(pixel);
+  float lum = luminance(illumination);
+
+  vec3 historyColor = vec3(0.0);
+  vec2 historyMoments = vec2(0.0);
+  float historyLength = 0.0;
+  float weightSum = 0.0;
+  if (pc.historyValid != 0 && !isBackground(center))
+  {
+    vec2 ndc = (vec2(pixel) + 0.5) / vec2(size) * 2.0 - 1.0;
+    vec4 previousClip = pc.reprojection * vec4(ndc, center.w, 1.0);
+    vec3 previousNdc = previousClip.xyz / previousClip.w;
+    vec2 previousPixel = (previousNdc.xy * 0.5 + 0.5) * vec2(size) - 0.5;
+    vec2 base = floor(previousPixel);
+    vec2 f = previousPixel - base;
+    float depthTolerance = ReprojectionDepthTolerance * depthGradient(pixel, size) + 1e-5;
+    for (int k = 0; k < 4; k++)
+    {
+      ivec2 tap = ivec2(base) + ivec2(k & 1, k >> 1);
+      if (!isInside(tap, size))
+      {
+        continue;
+      }
+
+      vec4 previous = imageLoad(historyNormalDepth, tap);
+      if (dot(center.xyz, previous.xyz) < ReprojectionNormalThreshold || abs(previous.w - previousNdc.z) > depthTolerance)
+      {
+        continue;
+      }
+
+      float w = ((k & 1) != 0 ? f.x : 1.0 - f.x) * ((k >> 1) != 0 ? f.y : 1.0 - f.y);
+      vec4 moments = imageLoad(historyMomentsIn, tap);
+      historyColor += w * imageLoad(historyColorIn, tap).rgb;
+      historyMoments += w * moments.xy;
+      historyLength += w * moments.z;
+      weightSum += w;
+    }
+  }
+
+  float length = 1.0;
+  float colorAlpha = 1.0;
+  float momentsAlpha = 1.0;
+  if (weightSum > MinReprojectionWeight)
+  {
+    historyColor /= weightSum;
+    historyMoments /= weightSum;
+    length = min(historyLength / weightSum + 1.0, MaxHistoryLength);
+    colorAlpha = max(pc.colorAlpha, 1.0 / length);
+    momentsAlpha = max(pc.momentsAlpha, 1.0 / length);
+  }
+
+  vec3 color = mix(historyColor, illumination, colorAlpha);
+  vec2 moments = mix(historyMoments, vec2(lum, lum * lum), momentsAlpha);
+  imageStore(filterOut, pixel, vec4(color, 0.0));
+  imageStore(historyMomentsOut, pixel, vec4(moments, length, 0.0));
+}
+)";
+
+// variance from the temporal moments, estimated spatially over 7x7 pixels where the history is still short
+const std::string computeShaderText_DenoiseVariance = denoiseShaderHeader + R"(
+void main()
+{
+  ivec2 size = imageSize(radiance);
+  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+  if (!isInside(pixel, size))
+  {
+    return;
+  }
+
+  vec4 moments = imageLoad(historyMomentsOut, pixel);
+  vec4 center = imageLoad(normalDepth, pixel);
+  vec3 color = imageLoad(filterIn, pixel).rgb;
+  if (ShortHistoryLength <= moments.z || isBackground(center))
+  {
+    imageStore(filterOut, pixel, vec4(color, max(0.0, moments.y - moments.x * moments.x)));
+    return;
+  }
+
+  float gradient = depthGradient(pixel, size);
+  vec3 colorSum = vec3(0.0);
+  vec2 momentsSum = vec2(0.0);
+  float weightSum = 0.0;
+  for (int dy = -3; dy <= 3; dy++)
+  {
+    for (int dx = -3; dx <= 3; dx++)
+    {
+      ivec2 tap = pixel + ivec2(dx, dy);
+      if (!isInside(tap, size))
+      {
+        continue;
+      }
+
+      float w = (dx == 0 && dy == 0) ? 1.0 : edgeWeight(center, imageLoad(normalDepth, tap), pc.phiDepth * gradient * length(vec2(dx, dy)));
+      colorSum += w * imageLoad(filterIn, tap).rgb;
+      momentsSum += w * imageLoad(historyMomentsOut, tap).xy;
+      weightSum += w;
+    }
+  }
+
+  vec2 m = momentsSum / weightSum;
+  float variance = max(0.0, m.y - m.x * m.x) * ShortHistoryLength / moments.z;
+  imageStore(filterOut, pixel, vec4(colorSum / weightSum, variance));
+}
+)";
+
+// one a-trous iteration with a 5x5 B3 spline kernel spread by stepSize, the first one also feeds the history
+const std::string computeShaderText_DenoiseAtrous = denoiseShaderHeader + R"(
+const float kernel[3] = float[](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+const float gaussian[2] = float[](1.0 / 2.0, 1.0 / 4.0);
+
+void main()
+{
+  ivec2 size = imageSize(radiance);
+  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+  if (!isInside(pixel, size))
+  {
+    return;
+  }
+
+  vec4 center = imageLoad(normalDepth, pixel);
+  vec4 c = imageLoad(filterIn, pixel);
+  vec4 result = c;
+  if (!isBackground(center))
+  {
+    // a 3x3 gaussian of the variance makes the luminance edge stopping more stable
+    float variance = 0.0;
+    for (int dy = -1; dy <= 1; dy++)
+    {
+      for (int dx = -1; dx <= 1; dx++)
+      {
+        ivec2 tap = clamp(pixel + ivec2(dx, dy), ivec2(0), size - 1);
+        variance += gaussian[abs(dx)] * gaussian[abs(dy)] * imageLoad(filterIn, tap).w;
+      }
+    }
+
+    float luminanceTolerance = pc.phiColor * sqrt(max(0.0, variance)) + 1e-6;
+    float gradient = depthGradient(pixel, size);
+    float lum = luminance(c.rgb);
+
+    float weightSum = kernel[0] * kernel[0];
+    vec3 colorSum = weightSum * c.rgb;
+    float varianceSum = weightSum * weightSum * c.w;
+    for (int dy = -2; dy <= 2; dy++)
+    {
+      for (int dx = -2; dx <= 2; dx++)
+      {
+        ivec2 tap = pixel + ivec2(dx, dy) * pc.stepSize;
+        if ((dx == 0 && dy == 0) || !isInside(tap, size))
+        {
+          continue;
+        }
+
+        vec4 t = imageLoad(filterIn, tap);
+        float w = kernel[abs(dx)] * kernel[abs(dy)]
+                * edgeWeight(center, imageLoad(normalDepth, tap), pc.phiDepth * gradient * float(pc.stepSize) * length(vec2(dx, dy)))
+                * exp(-abs(lum - luminance(t.rgb)) / luminanceTolerance);
+        colorSum += w * t.rgb;
+        varianceSum += w * w * t.w;
+        weightSum += w;
+      }
+    }
+    result = vec4(colorSum / weightSum, varianceSum / (weightSum * weightSum));
+  }
+
+  imageStore(filterOut, pixel, result);
+  if (pc.writeHistory != 0)
+  {
+    imageStore(historyColorOut, pixel, result);
+  }
+}
+)";
+
+// brings the albedo back and keeps the G-buffer for the next reprojection
+const std::string computeShaderText_DenoiseModulate = denoiseShaderHeader + R"(
+void main()
+{
+  ivec2 size = imageSize(radiance);
+  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+  if (!isInside(pixel, size))
+  {
+    return;
+  }
+
+  imageStore(denoised, pixel, vec4(imageLoad(filterIn, pixel).rgb * albedoFactor(pixel), 1.0));
+  imageStore(historyNormalDepth, pixel, imageLoad(normalDepth, pixel));
+}
+)";
+
+// culls meshlets against the frustum and by their normal cone, one workgroup per meshlet, and appends the triangles
+// of the visible ones to an index buffer drawn with vkCmdDrawIndexedIndirect, see Meshlets.h
+const std::string computeShaderText_MeshletCull = R"(
+#version 450
+
+layout (local_size_x = 128) in;
+
+struct Meshlet
+{
+  uint vertexOffset;
+  uint vertexCount;
+  uint triangleOffset;
+  uint triangleCount;
+  vec4 centerRadius;
+  vec4 coneAxisCutoff;
+};
+
+layout (std430, binding = 0) readonly buffer Meshlets { Meshlet meshlets[]; };
+layout (std430, binding = 1) readonly buffer MeshletVertices { uint meshletVertices[]; };
+layout (std430, binding = 2) readonly buffer MeshletTriangles { uint meshletTriangles[]; };
+layout (std430, binding = 3) writeonly buffer Indices { uint indices[]; };
+layout (std430, binding = 4) buffer DrawCommand
+{
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int vertexOffset;
+  uint firstInstance;
+} draw;
+
+layout (push_constant) uniform PushConstants
+{
+  vec4 planes[6];
+  vec4 cameraPosition;
+  uint meshletCount;
+  uint groupCountX;
+} pc;
+
+shared uint firstIndex;
+
+bool isVisible(Meshlet meshlet)
+{
+  vec3 center = meshlet.centerRadius.xyz;
+  float radius = meshlet.centerRadius.w;
+  for (int i = 0; i < 6; i++)
+  {
+    if (dot(pc.planes[i].xyz, center) + pc.planes[i].w < -radius)
+    {
+      return false;
+    }
+  }
+
+  vec3 d = center - pc.cameraPosition.xyz;
+  return dot(d, meshlet.coneAxisCutoff.xyz) < meshlet.coneAxisCutoff.w * length(d) + radius;
+}
+
+// the triangles are bytes, four to a uint
+uint getLocalVertex(uint corner)
+{
+  return (meshletTriangles[corner >> 2] >> ((corner & 3) * 8)) & 0xFF;
+}
+
+void main()
+{
+  // the same for the whole workgroup, so the barrier below stays in uniform control flow
+  uint m = gl_WorkGroupID.y * pc.groupCountX + gl_WorkGroupID.x;
+  if (m >= pc.meshletCount)
+  {
+    return;
+  }
+
+  Meshlet meshlet = meshlets[m];
+  uint t = gl_LocalInvocationIndex;
+  if (t == 0)
+  {
+    firstIndex = isVisible(meshlet) ? atomicAdd(draw.indexCount, meshlet.triangleCount * 3) : ~0u;
+  }
+  barrier();
+
+  if (firstIndex == ~0u || t >= meshlet.triangleCount)
+  {
+    return;
+  }
+  for (uint k = 0; k < 3; k++)
+  {
+    uint localVertex = getLocalVertex((meshlet.triangleOffset + t) * 3 + k);
+    indices[firstIndex + t * 3 + k] = meshletVertices[meshlet.vertexOffset + localVertex];
+  }
+}
+)";
+
+// frustum culls the world space bounds of every instance and adds the visible ones to the indirect draw command
+// of their mesh, see InstanceCulling.h
+const std::string computeShaderText_InstanceCull = R"(
+#version 450
+
+layout (local_size_x = 256) in;
+
+struct DrawInstance
+{
+  mat4 transform;
+  uint meshId;
+  uint padding[3];
+};
+
+struct DrawCommand
+{
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int vertexOffset;
+  uint firstInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Instances { DrawInstance instances[]; };
+layout (std430, binding = 1) readonly buffer MeshBounds { vec4 meshBounds[]; };
+layout (std430, binding = 2) buffer DrawCommands { DrawCommand commands[]; };
+layout (std430, binding = 3) writeonly buffer VisibleInstances { uint visibleInstances[]; };
+layout (std430, binding = 4) buffer VisibleCount { uint visibleCount; };
+
+layout (push_constant) uniform PushConstants
+{
+  vec4 planes[6];
+  uint instanceCount;
+} pc;
+
+shared uint groupVisibleCount;
+
+// Arvo's method, like transformAabb
+bool isVisible(mat4 transform, vec3 boundsMin, vec3 boundsMax)
+{
+  vec3 worldMin = transform[3].xyz;
+  vec3 worldMax = transform[3].xyz;
+  for (int column = 0; column < 3; column++)
+  {
+    vec3 a = transform[column].xyz * boundsMin[column];
+    vec3 b = transform[column].xyz * boundsMax[column];
+    worldMin += min(a, b);
+    worldMax += max(a, b);
+  }
+
+  for (int i = 0; i < 6; i++)
+  {
+    vec3 p = mix(worldMin, worldMax, greaterThanEqual(pc.planes[i].xyz, vec3(0.0)));
+    if (dot(pc.planes[i].xyz, p) + pc.planes[i].w < 0.0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void main()
+{
+  if (gl_LocalInvocationIndex == 0)
+  {
+    groupVisibleCount = 0;
+  }
+  barrier();
+
+  uint i = gl_GlobalInvocationID.x;
+  if (i < pc.instanceCount)
+  {
+    uint meshId = instances[i].meshId;
+    if (isVisible(instances[i].transform, meshBounds[meshId * 2].xyz, meshBounds[meshId * 2 + 1].xyz))
+    {
+      uint slot = atomicAdd(commands[meshId].instanceCount, 1);
+      visibleInstances[commands[meshId].firstInstance + slot] = i;
+      atomicAdd(groupVisibleCount, 1);
+    }
+  }
+  barrier();
+
+  // one global atomic per workgroup
+  if (gl_LocalInvocationIndex == 0 && groupVisibleCount > 0)
+  {
+    atomicAdd(visibleCount, groupVisibleCount);
+  }
+}
+)";
@@ -16,6 +16,7 @@
 #include "utils.hpp"
 #include "vulkan/vulkan.hpp"
 #include "Common.h"
+#include "PixelConversion.h"
 #include <iomanip>
 #include <numeric>
 
@@ -48,12 +49,38 @@ namespace vk
       return device->allocateMemoryUnique(vk::MemoryAllocateInfo(memoryRequirements.size, memoryTypeIndex));
     }
 
+    void computeToComputeBarrier(vk::UniqueCommandBuffer const& commandBuffer)
+    {
+      // makes the writes of one dispatch visible to the next one
+      vk::MemoryBarrier memoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+      commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, nullptr, nullptr);
+    }
+
+    void computeToDrawBarrier(vk::UniqueCommandBuffer const& commandBuffer)
+    {
+      // makes indirect draw arguments, index and vertex data written by a dispatch visible to the draws that read them
+      vk::MemoryBarrier memoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eIndexRead |
+                                                                        vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eShaderRead);
+      commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                     vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader,
+                                     {}, memoryBarrier, nullptr, nullptr);
+    }
+
     vk::UniqueCommandPool createCommandPool(vk::UniqueDevice &device, uint32_t queueFamilyIndex)
     {
       vk::CommandPoolCreateInfo commandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamilyIndex);
       return device->createCommandPoolUnique(commandPoolCreateInfo);
     }
 
+    vk::UniquePipeline createComputePipeline(vk::UniqueDevice const& device, vk::UniquePipelineCache const& pipelineCache,
+                                             std::pair<vk::ShaderModule, vk::SpecializationInfo const*> const& computeShaderData, vk::UniquePipelineLayout const& pipelineLayout)
+    {
+      vk::PipelineShaderStageCreateInfo pipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eCompute, computeShaderData.first, "main",
+                                                                      computeShaderData.second);
+      vk::ComputePipelineCreateInfo computePipelineCreateInfo(vk::PipelineCreateFlags(), pipelineShaderStageCreateInfo, pipelineLayout.get());
+      return device->createComputePipelineUnique(pipelineCache.get(), computePipelineCreateInfo);
+    }
+
     vk::UniqueDebugUtilsMessengerEXT createDebugUtilsMessenger(vk::UniqueInstance &instance)
     {
       vk::DebugUtilsMessageSeverityFlagsEXT severityFlags(vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning | vk::DebugUtilsMessageSeverityFlagBitsEXT::eError);
@@ -61,7 +88,7 @@ namespace vk
       return instance->createDebugUtilsMessengerEXTUnique(vk::DebugUtilsMessengerCreateInfoEXT({}, severityFlags, messageTypeFlags, &vk::su::debugUtilsMessengerCallback));
     }
 
-    vk::UniqueDescriptorPool createDescriptorPool(vk::UniqueDevice &device, std::vector<vk::DescriptorPoolSize> const& poolSizes)
+    vk::UniqueDescriptorPool createDescriptorPool(vk::UniqueDevice const& device, std::vector<vk::DescriptorPoolSize> const& poolSizes)
     {
       assert(!poolSizes.empty());
       uint32_t maxSets = std::accumulate(poolSizes.begin(), poolSizes.end(), 0, [](uint32_t sum, vk::DescriptorPoolSize const& dps) { return sum + dps.descriptorCount; });
@@ -83,7 +110,7 @@ namespace vk
     }
 
 
-    std::vector<vk::UniqueFramebuffer> createFramebuffers(vk::UniqueDevice &device, vk::UniqueRenderPass &renderPass, std::vector<vk::UniqueImageView> const& imageViews, vk::UniqueImageView const& depthImageView, vk::Extent2D const& extent)
+    std::vector<vk::UniqueFramebuffer> createFramebuffers(vk::UniqueDevice const& device, vk::UniqueRenderPass &renderPass, std::vector<vk::UniqueImageView> const& imageViews, vk::UniqueImageView const& depthImageView, vk::Extent2D const& extent)
     {
       vk::ImageView attachments[2];
       attachments[1] = depthImageView.get();
@@ -226,7 +253,7 @@ namespace vk
       return instance;
     }
 
-    vk::UniqueRenderPass createRenderPass(vk::UniqueDevice &device, vk::Format colorFormat, vk::Format depthFormat, vk::AttachmentLoadOp loadOp, vk::ImageLayout colorFinalLayout)
+    vk::UniqueRenderPass createRenderPass(vk::UniqueDevice const& device, vk::Format colorFormat, vk::Format depthFormat, vk::AttachmentLoadOp loadOp, vk::ImageLayout colorFinalLayout)
     {
       std::vector<vk::AttachmentDescription> attachmentDescriptions;
       assert(colorFormat != vk::Format::eUndefined);
@@ -345,7 +372,8 @@ namespace vk
       throw std::runtime_error("failed to find supported format!");
     }
 
-    void setImageLayout(vk::UniqueCommandBuffer const& commandBuffer, vk::Image image, vk::Format format, vk::ImageLayout oldImageLayout, vk::ImageLayout newImageLayout)
+    void setImageLayout(vk::UniqueCommandBuffer const& commandBuffer, vk::Image image, vk::Format format, vk::ImageLayout oldImageLayout, vk::ImageLayout newImageLayout,
+                        uint32_t baseMipLevel, uint32_t levelCount)
     {
       vk::AccessFlags sourceAccessMask;
       switch (oldImageLayout)
@@ -353,9 +381,15 @@ namespace vk
         case vk::ImageLayout::eTransferDstOptimal:
           sourceAccessMask = vk::AccessFlagBits::eTransferWrite;
           break;
+        case vk::ImageLayout::eTransferSrcOptimal:
+          sourceAccessMask = vk::AccessFlagBits::eTransferRead;
+          break;
         case vk::ImageLayout::ePreinitialized:
           sourceAccessMask = vk::AccessFlagBits::eHostWrite;
           break;
+        case vk::ImageLayout::eShaderReadOnlyOptimal:
+          sourceAccessMask = vk::AccessFlagBits::eShaderRead;
+          break;
         case vk::ImageLayout::eGeneral:     // sourceAccessMask is empty
         case vk::ImageLayout::eUndefined:
           break;
@@ -372,8 +406,12 @@ namespace vk
           sourceStage = vk::PipelineStageFlagBits::eHost;
           break;
         case vk::ImageLayout::eTransferDstOptimal:
+        case vk::ImageLayout::eTransferSrcOptimal:
           sourceStage = vk::PipelineStageFlagBits::eTransfer;
           break;
+        case vk::ImageLayout::eShaderReadOnlyOptimal:
+          sourceStage = vk::PipelineStageFlagBits::eFragmentShader;
+          break;
         case vk::ImageLayout::eUndefined:
           sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
           break;
@@ -445,7 +483,7 @@ namespace vk
         aspectMask = vk::ImageAspectFlagBits::eColor;
       }
 
-      vk::ImageSubresourceRange imageSubresourceRange(aspectMask, 0, 1, 0, 1);
+      vk::ImageSubresourceRange imageSubresourceRange(aspectMask, baseMipLevel, levelCount, 0, 1);
       vk::ImageMemoryBarrier imageMemoryBarrier(sourceAccessMask, destinationAccessMask, oldImageLayout, newImageLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, imageSubresourceRange);
       return commandBuffer->pipelineBarrier(sourceStage, destinationStage, {}, nullptr, nullptr, imageMemoryBarrier);
     }
@@ -459,6 +497,13 @@ namespace vk
         ;
     }
 
+    void transferToComputeBarrier(vk::UniqueCommandBuffer const& commandBuffer)
+    {
+      // makes fills and copies visible to the next dispatch
+      vk::MemoryBarrier memoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+      commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, nullptr, nullptr);
+    }
+
 
     CheckerboardImageGenerator::CheckerboardImageGenerator(std::array<uint8_t, 3> const& rgb0, std::array<uint8_t, 3> const& rgb1)
       : m_rgb0(rgb0)
@@ -468,19 +513,7 @@ namespace vk
     void CheckerboardImageGenerator::operator()(void* data, vk::Extent2D &extent) const
     {
       // Checkerboard of 16x16 pixel squares
-      uint8_t *pImageMemory = static_cast<uint8_t *>(data);
-      for (uint32_t row = 0; row < extent.height; row++)
-      {
-        for (uint32_t col = 0; col < extent.width; col++)
-        {
-          std::array<uint8_t, 3> const& rgb = (((row & 0x10) == 0) ^ ((col & 0x10) == 0)) ? m_rgb1 : m_rgb0;
-          pImageMemory[0] = rgb[0];
-          pImageMemory[1] = rgb[1];
-          pImageMemory[2] = rgb[2];
-          pImageMemory[3] = 255;
-          pImageMemory += 4;
-        }
-      }
+      fillCheckerboard(data, extent.width * 4, extent, packRgba(m_rgb0[0], m_rgb0[1], m_rgb0[2]), packRgba(m_rgb1[0], m_rgb1[1], m_rgb1[2]), 16);
     }
 
     MonochromeImageGenerator::MonochromeImageGenerator(std::array<unsigned char, 3> const& rgb)
@@ -490,18 +523,7 @@ namespace vk
     void MonochromeImageGenerator::operator()(void* data, vk::Extent2D &extent) const
     {
       // fill in with the monochrome color
-      unsigned char *pImageMemory = static_cast<unsigned char*>(data);
-      for (uint32_t row = 0; row < extent.height; row++)
-      {
-        for (uint32_t col = 0; col < extent.width; col++)
-        {
-          pImageMemory[0] = m_rgb[0];
-          pImageMemory[1] = m_rgb[1];
-          pImageMemory[2] = m_rgb[2];
-          pImageMemory[3] = 255;
-          pImageMemory += 4;
-        }
-      }
+      fillPixels(data, extent.width * 4, extent, packRgba(m_rgb[0], m_rgb[1], m_rgb[2]));
     }
 
     PixelsImageGenerator::PixelsImageGenerator(vk::Extent2D const& extent, size_t channels, unsigned char const* pixels)
@@ -509,13 +531,20 @@ namespace vk
       , m_channels(channels)
       , m_pixels(pixels)
     {
-      assert(m_channels == 4);
+      assert(m_channels == 3 || m_channels == 4);
     }
 
     void PixelsImageGenerator::operator()(void* data, vk::Extent2D & extent) const
     {
       assert(extent == m_extent);
-      memcpy(data, m_pixels, m_extent.width * m_extent.height * m_channels);
+      if (m_channels == 3)
+      {
+        expandRgbToRgba(m_pixels, m_extent.width * 3, data, m_extent.width * 4, m_extent);
+      }
+      else
+      {
+        copyPixels(m_pixels, m_extent.width * 4, data, m_extent.width * 4, m_extent);
+      }
     }
 
 
@@ -539,4 +568,4 @@ std::ostream& operator<<(std::ostream& os, vk::su::UUID const& uuid)
   }
   os << std::setfill(' ') << std::dec;
   return os;
-}
\ No newline at end of file
+}
\ No newline at end of file
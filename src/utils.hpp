@@ -33,8 +33,8 @@ namespace vk
       void operator()(void* data, vk::Extent2D &extent) const;
 
     private:
-      std::array<uint8_t, 3> const& m_rgb0;
-      std::array<uint8_t, 3> const& m_rgb1;
+      std::array<uint8_t, 3> m_rgb0;
+      std::array<uint8_t, 3> m_rgb1;
     };
 
     class MonochromeImageGenerator
@@ -45,12 +45,13 @@ namespace vk
       void operator()(void* data, vk::Extent2D &extent) const;
 
       private:
-      std::array<unsigned char, 3> const& m_rgb;
+      std::array<unsigned char, 3> m_rgb;
     };
 
     class PixelsImageGenerator
     {
       public:
+      // channels is 4, or 3 for pixels that get an opaque alpha
       PixelsImageGenerator(vk::Extent2D const& extent, size_t channels, unsigned char const* pixels);
 
       void operator()(void* data, vk::Extent2D & extent) const;
@@ -131,27 +132,36 @@ namespace vk
 
     vk::UniqueDeviceMemory allocateMemory(vk::UniqueDevice const& device, vk::PhysicalDeviceMemoryProperties const& memoryProperties, vk::MemoryRequirements const& memoryRequirements,
                                           vk::MemoryPropertyFlags memoryPropertyFlags);
+    void computeToComputeBarrier(vk::UniqueCommandBuffer const& commandBuffer);
+    void computeToDrawBarrier(vk::UniqueCommandBuffer const& commandBuffer);
     vk::UniqueCommandPool createCommandPool(vk::UniqueDevice &device, uint32_t queueFamilyIndex);
+    vk::UniquePipeline createComputePipeline(vk::UniqueDevice const& device, vk::UniquePipelineCache const& pipelineCache,
+                                             std::pair<vk::ShaderModule, vk::SpecializationInfo const*> const& computeShaderData, vk::UniquePipelineLayout const& pipelineLayout);
     vk::UniqueDebugUtilsMessengerEXT createDebugUtilsMessenger(vk::UniqueInstance &instance);
-    vk::UniqueDescriptorPool createDescriptorPool(vk::UniqueDevice &device, std::vector<vk::DescriptorPoolSize> const& poolSizes);
+    vk::UniqueDescriptorPool createDescriptorPool(vk::UniqueDevice const& device, std::vector<vk::DescriptorPoolSize> const& poolSizes);
     vk::UniqueDescriptorSetLayout createDescriptorSetLayout(vk::UniqueDevice const& device, std::vector<std::tuple<vk::DescriptorType, uint32_t, vk::ShaderStageFlags>> const& bindingData,
                                                             vk::DescriptorSetLayoutCreateFlags flags = {});
-    std::vector<vk::UniqueFramebuffer> createFramebuffers(vk::UniqueDevice &device, vk::UniqueRenderPass &renderPass, std::vector<vk::UniqueImageView> const& imageViews, vk::UniqueImageView const& depthImageView, vk::Extent2D const& extent);
+    std::vector<vk::UniqueFramebuffer> createFramebuffers(vk::UniqueDevice const& device, vk::UniqueRenderPass &renderPass, std::vector<vk::UniqueImageView> const& imageViews, vk::UniqueImageView const& depthImageView, vk::Extent2D const& extent);
     vk::UniquePipeline createGraphicsPipeline(vk::UniqueDevice const& device, vk::UniquePipelineCache const& pipelineCache,
                                               std::pair<vk::ShaderModule, vk::SpecializationInfo const*> const& vertexShaderData,
                                               std::pair<vk::ShaderModule, vk::SpecializationInfo const*> const& fragmentShaderData, uint32_t vertexStride,
                                               std::vector<std::pair<vk::Format, uint32_t>> const& vertexInputAttributeFormatOffset, vk::FrontFace frontFace, bool depthBuffered,
                                               vk::UniquePipelineLayout const& pipelineLayout, vk::UniqueRenderPass const& renderPass);
+    vk::UniqueInstance createInstance(std::string const& appName, std::string const& engineName, std::vector<std::string> const& layers, std::vector<std::string> const& extensions,
+                                      uint32_t apiVersion = VK_API_VERSION_1_1);
     
-    vk::UniqueRenderPass createRenderPass(vk::UniqueDevice &device, vk::Format colorFormat, vk::Format depthFormat, vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eClear, vk::ImageLayout colorFinalLayout = vk::ImageLayout::ePresentSrcKHR);
+    vk::UniqueRenderPass createRenderPass(vk::UniqueDevice const& device, vk::Format colorFormat, vk::Format depthFormat, vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eClear, vk::ImageLayout colorFinalLayout = vk::ImageLayout::ePresentSrcKHR);
     VkBool32 debugUtilsMessengerCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageTypes, VkDebugUtilsMessengerCallbackDataEXT const * pCallbackData, void * /*pUserData*/);
     uint32_t findMemoryType(vk::PhysicalDeviceMemoryProperties const& memoryProperties, uint32_t typeBits, vk::MemoryPropertyFlags requirementsMask);
     std::vector<std::string> getInstanceExtensions();
     vk::Format pickDepthFormat(vk::PhysicalDevice const& physicalDevice);
-    void setImageLayout(vk::UniqueCommandBuffer const& commandBuffer, vk::Image image, vk::Format format, vk::ImageLayout oldImageLayout, vk::ImageLayout newImageLayout);
+    // transitions the mip levels [baseMipLevel, baseMipLevel + levelCount) of the first array layer
+    void setImageLayout(vk::UniqueCommandBuffer const& commandBuffer, vk::Image image, vk::Format format, vk::ImageLayout oldImageLayout, vk::ImageLayout newImageLayout,
+                        uint32_t baseMipLevel = 0, uint32_t levelCount = 1);
     void submitAndWait(vk::UniqueDevice &device, vk::Queue queue, vk::UniqueCommandBuffer &commandBuffer);
+    void transferToComputeBarrier(vk::UniqueCommandBuffer const& commandBuffer);
 
   }
 }
 
-std::ostream& operator<<(std::ostream& os, vk::su::UUID const& uuid);
\ No newline at end of file
+std::ostream& operator<<(std::ostream& os, vk::su::UUID const& uuid);
\ No newline at end of file